@@ -0,0 +1,1710 @@
+/*
+* The Sleuth Kit
+*
+* This software is distributed under the Common Public License 1.0
+*/
+
+/*
+ * This is a test file for The Sleuth Kit that does not need the external
+ * test images, so that it can run with "make check".  It makes its disk
+ * images when it runs (in the current directory) and compares the results
+ * of the API functions with simpler ways of getting the same data.
+ */
+#include "tsk/tsk_tools_i.h"
+#include "tsk/fs/tsk_fs_i.h"
+#include "tsk/fs/tsk_ext2fs.h"
+#include "tsk/fs/tsk_ffs.h"
+
+#include "tsk_thread.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+static const char *s_srcdir;
+
+/* ext2 image in the source directory with a tree of directories that is
+ * five levels deep, deleted files, and a file in nine runs (FRAG_PATH).
+ * It was made with "mkfs.ext2 -b 1024 -N 256 -d" and debugfs. */
+#define FIXTURE_IMG "fixture_ext2.img"
+#define FRAG_PATH   "/frag.bin"
+
+#define DATA_IMG    "fixture_data.img"  // Image of pseudo-random bytes
+#define DATA_SIZE   (4 * 1024 * 1024)
+
+static char *s_data;            // Content of DATA_IMG
+
+
+/* Pseudo-random numbers so that every run reads the same ranges */
+static uint32_t
+next_rand(uint32_t * a_state)
+{
+    *a_state = *a_state * 1103515245 + 12345;
+    return (*a_state >> 8) & 0xffffff;
+}
+
+/* Writes a_len bytes from a_buf to a new file.
+ * @returns 1 on error */
+static int
+write_file(const char *a_path, const char *a_buf, size_t a_len)
+{
+    FILE *hFile;
+
+    if ((hFile = fopen(a_path, "wb")) == NULL) {
+        fprintf(stderr, "Error creating %s\n", a_path);
+        return 1;
+    }
+    if (fwrite(a_buf, a_len, 1, hFile) != 1) {
+        fprintf(stderr, "Error writing %s\n", a_path);
+        fclose(hFile);
+        return 1;
+    }
+    fclose(hFile);
+    return 0;
+}
+
+/* Makes DATA_IMG and keeps its content in s_data.
+ * @returns 1 on error */
+static int
+make_data_img()
+{
+    uint32_t state = 1;
+    size_t i;
+
+    if ((s_data = (char *) malloc(DATA_SIZE)) == NULL) {
+        fprintf(stderr, "Error allocating memory\n");
+        return 1;
+    }
+    for (i = 0; i < DATA_SIZE; i++)
+        s_data[i] = (char) next_rand(&state);
+    return write_file(DATA_IMG, s_data, DATA_SIZE);
+}
+
+/* Opens an image with the given options.
+ * @returns NULL on error */
+static TSK_IMG_INFO *
+open_img(const char *a_path, const TSK_IMG_OPTIONS * a_opts)
+{
+    const TSK_TCHAR *images[1];
+    TSK_IMG_INFO *img;
+
+    images[0] = (const TSK_TCHAR *) a_path;
+    if ((img = tsk_img_open_ex(1, images, TSK_IMG_TYPE_DETECT, 0,
+                a_opts)) == NULL) {
+        fprintf(stderr, "Error opening %s\n", a_path);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+    }
+    return img;
+}
+
+
+/* Opens FIXTURE_IMG with the given options and the file system in it.
+ * @returns NULL on error */
+static TSK_FS_INFO *
+open_fixture_fs(const TSK_IMG_OPTIONS * a_opts, TSK_IMG_INFO ** a_img)
+{
+    char path[512];
+    TSK_FS_INFO *fs;
+
+    snprintf(path, sizeof(path), "%s/%s", s_srcdir, FIXTURE_IMG);
+    if ((*a_img = open_img(path, a_opts)) == NULL)
+        return NULL;
+
+    if ((fs = tsk_fs_open_img(*a_img, 0, TSK_FS_TYPE_DETECT)) == NULL) {
+        fprintf(stderr, "Error opening the file system in %s\n", path);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        tsk_img_close(*a_img);
+    }
+    return fs;
+}
+
+/* Content of a file as given by a file walk */
+typedef struct {
+    char *buf;
+    TSK_OFF_T len;
+    int failed;
+} WALK_DATA;
+
+static TSK_WALK_RET_ENUM
+walk_copy_act(TSK_FS_FILE * a_fs_file, TSK_OFF_T a_off, TSK_DADDR_T a_addr,
+    char *a_buf, size_t a_size, TSK_FS_BLOCK_FLAG_ENUM a_flags,
+    void *a_ptr)
+{
+    WALK_DATA *data = (WALK_DATA *) a_ptr;
+
+    if ((a_off < 0) || (a_off + (TSK_OFF_T) a_size > data->len)) {
+        fprintf(stderr, "File walk gave %" PRIuSIZE " bytes at offset %"
+            PRIdOFF " in a file of %" PRIdOFF " bytes\n", a_size, a_off,
+            data->len);
+        data->failed = 1;
+        return TSK_WALK_ERROR;
+    }
+    memcpy(&data->buf[a_off], a_buf, a_size);
+    return TSK_WALK_CONT;
+}
+
+/* Gets the content of a file with a file walk.  The caller frees the
+ * buffer.
+ * @returns NULL on error */
+static char *
+walk_file(TSK_FS_FILE * a_fs_file, TSK_FS_FILE_WALK_FLAG_ENUM a_flags)
+{
+    WALK_DATA data;
+
+    memset(&data, 0, sizeof(data));
+    data.len = a_fs_file->meta->size;
+    if ((data.buf = (char *) malloc((size_t) data.len)) == NULL) {
+        fprintf(stderr, "Error allocating memory\n");
+        return NULL;
+    }
+    if ((tsk_fs_file_walk(a_fs_file, a_flags, walk_copy_act, &data))
+        || (data.failed)) {
+        fprintf(stderr, "Error walking inode %" PRIuINUM "\n",
+            a_fs_file->meta->addr);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        free(data.buf);
+        return NULL;
+    }
+    return data.buf;
+}
+
+/* Gets the content of FRAG_PATH with a file walk.
+ * @returns NULL on error */
+static char *
+walk_frag_file(TSK_FS_INFO * a_fs, TSK_FS_FILE_WALK_FLAG_ENUM a_flags,
+    TSK_OFF_T * a_len)
+{
+    TSK_FS_FILE *fs_file;
+    char *buf;
+
+    if ((fs_file = tsk_fs_file_open(a_fs, NULL, FRAG_PATH)) == NULL) {
+        fprintf(stderr, "Error opening %s\n", FRAG_PATH);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return NULL;
+    }
+    *a_len = fs_file->meta->size;
+    buf = walk_file(fs_file, a_flags);
+    tsk_fs_file_close(fs_file);
+    return buf;
+}
+
+
+/* Reads random ranges of DATA_IMG and compares them with s_data */
+class CacheReader : public TskThread {
+public:
+    CacheReader(TSK_IMG_INFO * img, uint32_t seed) :
+        m_img(img), m_seed(seed), m_failed(0) {}
+
+    void operator()() {
+        char buf[20000];
+
+        for (int i = 0; i < 3000; ++i) {
+            size_t len = 1 + next_rand(&m_seed) % sizeof(buf);
+            TSK_OFF_T off = next_rand(&m_seed) % DATA_SIZE;
+            ssize_t cnt;
+
+            // some reads run past the end of the image
+            if ((i % 500) == 0)
+                off = DATA_SIZE - 100;
+            if (off + (TSK_OFF_T) len > DATA_SIZE)
+                len = (size_t) (DATA_SIZE - off);
+
+            cnt = tsk_img_read(m_img, off, buf, len);
+            if ((cnt != (ssize_t) len) || (memcmp(buf, &s_data[off], len))) {
+                fprintf(stderr, "Cached read at %" PRIdOFF " of %" PRIuSIZE
+                    " bytes has the wrong data\n", off, len);
+                m_failed = 1;
+                return;
+            }
+        }
+    }
+
+    int failed() const { return m_failed; }
+
+private:
+    TSK_IMG_INFO *m_img;
+    uint32_t m_seed;
+    int m_failed;
+};
+
+/* Reads DATA_IMG from several threads through caches of several sizes,
+ * including ones that are small enough that lines are evicted while other
+ * threads use them */
+static int
+test_cache_threads()
+{
+    const size_t nthreads = 8;
+    const unsigned int cache_nums[] = { 0, 1, 4, TSK_IMG_INFO_CACHE_NUM };
+    const size_t cache_lens[] = { 512, 4096, TSK_IMG_INFO_CACHE_LEN };
+    size_t n, l, i;
+
+    for (n = 0; n < sizeof(cache_nums) / sizeof(cache_nums[0]); n++) {
+        for (l = 0; l < sizeof(cache_lens) / sizeof(cache_lens[0]); l++) {
+            TSK_IMG_OPTIONS opts;
+            TSK_IMG_INFO *img;
+            TskThread *readers[nthreads];
+            int failed = 0;
+
+            tsk_img_options_init(&opts);
+            opts.cache_num = cache_nums[n];
+            opts.cache_len = cache_lens[l];
+            if ((img = open_img(DATA_IMG, &opts)) == NULL)
+                return 1;
+
+            for (i = 0; i < nthreads; i++)
+                readers[i] = new CacheReader(img, (uint32_t) (i + 1));
+            TskThread::run(readers, nthreads);
+            for (i = 0; i < nthreads; i++) {
+                failed |= ((CacheReader *) readers[i])->failed();
+                delete readers[i];
+            }
+            tsk_img_close(img);
+
+            if (failed) {
+                fprintf(stderr, "Cache with %u lines of %" PRIuSIZE
+                    " bytes failed\n", cache_nums[n], cache_lens[l]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+/* Gives prefetch hints for random ranges of DATA_IMG, reads them (giving up
+ * on some streams part way through), and compares them with s_data */
+class PrefetchReader : public TskThread {
+public:
+    PrefetchReader(TSK_IMG_INFO * img, uint32_t seed) :
+        m_img(img), m_seed(seed), m_failed(0) {}
+
+    void operator()() {
+        char buf[20000];
+
+        for (int i = 0; i < 200; ++i) {
+            TSK_IMG_RANGE ranges[8];
+            uint64_t id;
+            size_t r;
+
+            for (r = 0; r < 8; r++) {
+                ranges[r].len = 1 + next_rand(&m_seed) % sizeof(buf);
+                ranges[r].off =
+                    next_rand(&m_seed) % (DATA_SIZE - sizeof(buf));
+            }
+            if ((id = tsk_img_prefetch(m_img, ranges, 8)) == 0) {
+                fprintf(stderr, "tsk_img_prefetch did not start a stream\n");
+                m_failed = 1;
+                return;
+            }
+
+            for (r = 0; r < 8; r++) {
+                if (tsk_img_read(m_img, ranges[r].off, buf,
+                        ranges[r].len) != (ssize_t) ranges[r].len
+                    || memcmp(buf, &s_data[ranges[r].off], ranges[r].len)) {
+                    fprintf(stderr, "Prefetched read at %" PRIdOFF
+                        " has the wrong data\n", ranges[r].off);
+                    m_failed = 1;
+                    return;
+                }
+                if ((i % 3 == 0) && (r == 1))
+                    break;
+            }
+            tsk_img_prefetch_cancel(m_img, id);
+        }
+    }
+
+    int failed() const { return m_failed; }
+
+private:
+    TSK_IMG_INFO *m_img;
+    uint32_t m_seed;
+    int m_failed;
+};
+
+/* Reads with prefetch hints from several threads, and compares file walks
+ * that give hints for the runs of a fragmented file with and without the
+ * prefetch worker */
+static int
+test_prefetch()
+{
+    const size_t nthreads = 8;
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    TskThread *readers[nthreads];
+    TSK_IMG_RANGE range;
+    char *buf1, *buf2;
+    TSK_OFF_T len1, len2;
+    int failed = 0;
+    size_t i;
+
+    // the hints do nothing without the prefetch option
+    tsk_img_options_init(&opts);
+    if ((img = open_img(DATA_IMG, &opts)) == NULL)
+        return 1;
+    range.off = 0;
+    range.len = 4096;
+    if (tsk_img_prefetch(img, &range, 1) != 0) {
+        fprintf(stderr, "tsk_img_prefetch started a stream without a worker\n");
+        return 1;
+    }
+    tsk_img_close(img);
+
+    opts.prefetch = 1;
+    opts.cache_num = 8;
+    opts.cache_len = 4096;
+    if ((img = open_img(DATA_IMG, &opts)) == NULL)
+        return 1;
+    for (i = 0; i < nthreads; i++)
+        readers[i] = new PrefetchReader(img, (uint32_t) (i + 100));
+    TskThread::run(readers, nthreads);
+    for (i = 0; i < nthreads; i++) {
+        failed |= ((PrefetchReader *) readers[i])->failed();
+        delete readers[i];
+    }
+    tsk_img_close(img);
+    if (failed)
+        return 1;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+    if ((buf1 = walk_frag_file(fs, (TSK_FS_FILE_WALK_FLAG_ENUM) 0,
+                &len1)) == NULL)
+        return 1;
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+
+    opts.prefetch = 1;
+    opts.cache_num = 2;
+    opts.cache_len = 1024;
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+    if ((buf2 = walk_frag_file(fs, (TSK_FS_FILE_WALK_FLAG_ENUM) 0,
+                &len2)) == NULL)
+        return 1;
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+
+    if ((len1 != len2) || (memcmp(buf1, buf2, (size_t) len1))) {
+        fprintf(stderr, "File walk with prefetch has different data\n");
+        return 1;
+    }
+    free(buf1);
+    free(buf2);
+    return 0;
+}
+
+
+/* Splits DATA_IMG into segments, reads all of them through a pool that
+ * keeps two of them open, and checks the data and the open file counts
+ * that the image details show */
+static int
+test_split_pool()
+{
+    const int nsegs = 4;
+    const size_t seg_len = DATA_SIZE / nsegs;
+    char names[nsegs][64];
+    const TSK_TCHAR *images[nsegs];
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    uint32_t state = 7;
+    char buf[8192];
+    char line[512];
+    FILE *hFile;
+    int i, rows = 0, evicted = 0;
+
+    for (i = 0; i < nsegs; i++) {
+        snprintf(names[i], sizeof(names[i]), "fixture_split.%03d", i + 1);
+        images[i] = (const TSK_TCHAR *) names[i];
+        if (write_file(names[i], &s_data[i * seg_len], seg_len))
+            return 1;
+    }
+
+    tsk_img_options_init(&opts);
+    opts.cache_num = 0;
+    opts.max_open_files = 2;
+    if ((img = tsk_img_open_ex(nsegs, images, TSK_IMG_TYPE_DETECT, 0,
+                &opts)) == NULL) {
+        fprintf(stderr, "Error opening split image\n");
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+
+    // the reads go back and forth between the segments and across them
+    for (i = 0; i < 400; i++) {
+        size_t len = 1 + next_rand(&state) % sizeof(buf);
+        TSK_OFF_T off = next_rand(&state) % (DATA_SIZE - sizeof(buf));
+
+        if (i % 50 == 0)
+            off = seg_len - 100;
+        if ((tsk_img_read(img, off, buf, len) != (ssize_t) len)
+            || (memcmp(buf, &s_data[off], len))) {
+            fprintf(stderr, "Split read at %" PRIdOFF
+                " has the wrong data\n", off);
+            return 1;
+        }
+    }
+
+    if ((hFile = tmpfile()) == NULL) {
+        fprintf(stderr, "Error creating temporary file\n");
+        return 1;
+    }
+    img->imgstat(img, hFile);
+    rewind(hFile);
+    while (fgets(line, sizeof(line), hFile)) {
+        const char *cp;
+
+        if ((cp = strstr(line, "evictions: ")) == NULL)
+            continue;
+        rows++;
+        if (atoi(cp + strlen("evictions: ")) > 0)
+            evicted++;
+    }
+    fclose(hFile);
+    tsk_img_close(img);
+
+    if ((rows != nsegs) || (evicted == 0)) {
+        fprintf(stderr, "Image details show %d segments and %d that were "
+            "closed to make room\n", rows, evicted);
+        return 1;
+    }
+
+    for (i = 0; i < nsegs; i++)
+        remove(names[i]);
+    return 0;
+}
+
+
+/* Adds up a histogram of TSK_IMG_STATS */
+static uint64_t
+hist_sum(const uint64_t * a_hist)
+{
+    uint64_t sum = 0;
+    int i;
+
+    for (i = 0; i < TSK_IMG_STATS_HIST_NUM; i++)
+        sum += a_hist[i];
+    return sum;
+}
+
+/* Checks that the stats option counts the reads of opening a file system
+ * and that a trace has one record for each read */
+static int
+test_img_stats()
+{
+    const char *trace = "fixture_trace.bin";
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_STATS stats;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    uint32_t state = 3;
+    uint64_t bytes = 0;
+    char buf[4096];
+    char magic[8];
+    FILE *hFile;
+    long trace_len;
+    int i;
+
+    // nothing is counted without the option
+    tsk_img_options_init(&opts);
+    if ((img = open_img(DATA_IMG, &opts)) == NULL)
+        return 1;
+    if (tsk_img_get_stats(img, &stats) == 0) {
+        fprintf(stderr, "tsk_img_get_stats worked without the stats option\n");
+        return 1;
+    }
+    tsk_error_reset();
+    tsk_img_close(img);
+
+    opts.stats = 1;
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+    if (tsk_img_get_stats(img, &stats)) {
+        fprintf(stderr, "Error getting statistics\n");
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+    if ((stats.reads == 0) || (stats.backend_reads == 0)
+        || (stats.cache_misses == 0)
+        || (hist_sum(stats.read_size_hist) != stats.reads)) {
+        fprintf(stderr, "Opening a file system counted %" PRIu64
+            " reads and %" PRIu64 " backend reads\n", stats.reads,
+            stats.backend_reads);
+        return 1;
+    }
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+
+    tsk_img_options_init(&opts);
+    if ((img = open_img(DATA_IMG, &opts)) == NULL)
+        return 1;
+    if (tsk_img_stats_start(img, (const TSK_TCHAR *) trace)) {
+        fprintf(stderr, "Error starting statistics\n");
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+    for (i = 0; i < 100; i++) {
+        size_t len = 1 + next_rand(&state) % sizeof(buf);
+        TSK_OFF_T off = next_rand(&state) % (DATA_SIZE - len);
+
+        if (tsk_img_read(img, off, buf, len) != (ssize_t) len) {
+            fprintf(stderr, "Error reading %s\n", DATA_IMG);
+            return 1;
+        }
+        bytes += len;
+    }
+    if (tsk_img_get_stats(img, &stats)) {
+        fprintf(stderr, "Error getting statistics\n");
+        return 1;
+    }
+    tsk_img_close(img);
+
+    if ((stats.reads != 100) || (stats.read_bytes != bytes)
+        || (hist_sum(stats.read_size_hist) != 100)
+        || (stats.cache_hits + stats.cache_misses < 100)) {
+        fprintf(stderr, "Wrong statistics: %" PRIu64 " reads of %" PRIu64
+            " bytes, %" PRIu64 " hits and %" PRIu64 " misses\n",
+            stats.reads, stats.read_bytes, stats.cache_hits,
+            stats.cache_misses);
+        return 1;
+    }
+
+    // the magic value and a 12-byte record for each read
+    if ((hFile = fopen(trace, "rb")) == NULL) {
+        fprintf(stderr, "Error opening trace file\n");
+        return 1;
+    }
+    if ((fread(magic, sizeof(magic), 1, hFile) != 1)
+        || (memcmp(magic, TSK_IMG_TRACE_MAGIC, sizeof(magic)))) {
+        fprintf(stderr, "Trace file has the wrong magic value\n");
+        fclose(hFile);
+        return 1;
+    }
+    fseek(hFile, 0, SEEK_END);
+    trace_len = ftell(hFile);
+    fclose(hFile);
+    if (trace_len != 8 + 100 * 12) {
+        fprintf(stderr, "Trace file has %ld bytes\n", trace_len);
+        return 1;
+    }
+    remove(trace);
+    return 0;
+}
+
+
+#define MBR_IMG     "fixture_mbr.img"   // FIXTURE_IMG in a DOS partition
+#define MBR_START   63                  // First sector of the partition
+
+/* Makes MBR_IMG from FIXTURE_IMG.
+ * @returns 1 on error */
+static int
+make_mbr_img()
+{
+    char path[512];
+    char *buf;
+    FILE *hFile;
+    long fs_len;
+    size_t len;
+    int i, ret;
+
+    snprintf(path, sizeof(path), "%s/%s", s_srcdir, FIXTURE_IMG);
+    if ((hFile = fopen(path, "rb")) == NULL) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return 1;
+    }
+    fseek(hFile, 0, SEEK_END);
+    fs_len = ftell(hFile);
+    rewind(hFile);
+
+    len = MBR_START * 512 + fs_len;
+    if ((buf = (char *) calloc(len, 1)) == NULL) {
+        fprintf(stderr, "Error allocating memory\n");
+        fclose(hFile);
+        return 1;
+    }
+    if (fread(&buf[MBR_START * 512], fs_len, 1, hFile) != 1) {
+        fprintf(stderr, "Error reading %s\n", path);
+        fclose(hFile);
+        free(buf);
+        return 1;
+    }
+    fclose(hFile);
+
+    // one Linux partition entry (little-endian start and length) and the
+    // signature
+    buf[446 + 4] = (char) 0x83;
+    for (i = 0; i < 4; i++) {
+        buf[446 + 8 + i] = (char) ((MBR_START >> (8 * i)) & 0xff);
+        buf[446 + 12 + i] = (char) (((fs_len / 512) >> (8 * i)) & 0xff);
+    }
+    buf[510] = (char) 0x55;
+    buf[511] = (char) 0xaa;
+
+    ret = write_file(MBR_IMG, buf, len);
+    free(buf);
+    return ret;
+}
+
+#define READV_NUM   48          // Number of ranges in each vectored read
+#define READV_MAX   20000       // Largest range
+
+/* Fills in ranges that are shuffled, next to each other, overlapping,
+ * and past the end of the data */
+static void
+readv_ranges(TSK_IMG_IOVEC * a_vecs, char *a_bufs, TSK_OFF_T a_size,
+    uint32_t * a_state)
+{
+    TSK_OFF_T base = next_rand(a_state) % a_size;
+    size_t i;
+
+    for (i = 0; i < READV_NUM; i++) {
+        TSK_IMG_IOVEC *vec = &a_vecs[i];
+
+        vec->buf = &a_bufs[i * READV_MAX];
+        vec->len = 1 + next_rand(a_state) % READV_MAX;
+        if ((i > 0) && (i % 4 == 1))    // right after the one before
+            vec->off = a_vecs[i - 1].off + a_vecs[i - 1].len;
+        else if (i % 4 == 2)    // near the others
+            vec->off = base + next_rand(a_state) % (8 * READV_MAX);
+        else
+            vec->off = next_rand(a_state) % a_size;
+
+        if (i == READV_NUM - 1)
+            vec->off = a_size - 100;    // runs past the end
+        if (vec->off >= a_size)
+            vec->off = a_size - 1;
+    }
+}
+
+/* Compares the ranges of a vectored read with reads of one range at a
+ * time.
+ * @returns 1 if they differ */
+static int
+readv_compare(const char *a_api, const TSK_IMG_IOVEC * a_vecs,
+    ssize_t a_total, ssize_t(*a_read) (void *, TSK_OFF_T, char *, size_t),
+    void *a_ptr)
+{
+    char buf[READV_MAX];
+    ssize_t total = 0;
+    size_t i;
+
+    for (i = 0; i < READV_NUM; i++) {
+        ssize_t cnt = a_read(a_ptr, a_vecs[i].off, buf, a_vecs[i].len);
+
+        if (cnt != a_vecs[i].cnt) {
+            fprintf(stderr, "%s: range %" PRIuSIZE " at %" PRIdOFF
+                " gave %zd bytes instead of %zd\n", a_api, i,
+                a_vecs[i].off, a_vecs[i].cnt, cnt);
+            return 1;
+        }
+        if ((cnt > 0) && (memcmp(buf, a_vecs[i].buf, cnt))) {
+            fprintf(stderr, "%s: range %" PRIuSIZE " at %" PRIdOFF
+                " has different data\n", a_api, i, a_vecs[i].off);
+            return 1;
+        }
+        total += cnt;
+    }
+
+    if (total != a_total) {
+        fprintf(stderr, "%s: returned %zd instead of %zd\n", a_api,
+            a_total, total);
+        return 1;
+    }
+    return 0;
+}
+
+static ssize_t
+readv_img_read(void *a_ptr, TSK_OFF_T a_off, char *a_buf, size_t a_len)
+{
+    return tsk_img_read((TSK_IMG_INFO *) a_ptr, a_off, a_buf, a_len);
+}
+
+static ssize_t
+readv_fs_read(void *a_ptr, TSK_OFF_T a_off, char *a_buf, size_t a_len)
+{
+    return tsk_fs_read((TSK_FS_INFO *) a_ptr, a_off, a_buf, a_len);
+}
+
+static ssize_t
+readv_vs_part_read(void *a_ptr, TSK_OFF_T a_off, char *a_buf, size_t a_len)
+{
+    return tsk_vs_part_read((const TSK_VS_PART_INFO *) a_ptr, a_off, a_buf,
+        a_len);
+}
+
+/* Compares tsk_img_readv(), tsk_vs_part_readv() and tsk_fs_readv() with
+ * tsk_img_read(), tsk_vs_part_read() and tsk_fs_read() on MBR_IMG */
+static int
+test_readv()
+{
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_VS_INFO *vs;
+    TSK_FS_INFO *fs;
+    const TSK_VS_PART_INFO *part = NULL;
+    TSK_IMG_IOVEC vecs[READV_NUM];
+    uint32_t state = 11;
+    char *bufs;
+    ssize_t total;
+    TSK_PNUM_T i;
+    int iter;
+
+    if (make_mbr_img())
+        return 1;
+
+    tsk_img_options_init(&opts);
+    if ((img = open_img(MBR_IMG, &opts)) == NULL)
+        return 1;
+    if ((vs = tsk_vs_open(img, 0, TSK_VS_TYPE_DETECT)) == NULL) {
+        fprintf(stderr, "Error opening the partitions of %s\n", MBR_IMG);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+    for (i = 0; i < vs->part_count; i++) {
+        const TSK_VS_PART_INFO *p = tsk_vs_part_get(vs, i);
+        if ((p != NULL) && (p->start == MBR_START)
+            && (p->flags & TSK_VS_PART_FLAG_ALLOC))
+            part = p;
+    }
+    if (part == NULL) {
+        fprintf(stderr, "Error finding the partition of %s\n", MBR_IMG);
+        return 1;
+    }
+    if ((fs = tsk_fs_open_vol(part, TSK_FS_TYPE_DETECT)) == NULL) {
+        fprintf(stderr, "Error opening the file system in %s\n", MBR_IMG);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+
+    if ((bufs = (char *) malloc(READV_NUM * READV_MAX)) == NULL) {
+        fprintf(stderr, "Error allocating memory\n");
+        return 1;
+    }
+
+    for (iter = 0; iter < 20; iter++) {
+        readv_ranges(vecs, bufs, img->size, &state);
+        total = tsk_img_readv(img, vecs, READV_NUM);
+        if (readv_compare("tsk_img_readv", vecs, total, readv_img_read,
+                img))
+            return 1;
+
+        readv_ranges(vecs, bufs, part->len * vs->block_size, &state);
+        total = tsk_vs_part_readv(part, vecs, READV_NUM);
+        if (readv_compare("tsk_vs_part_readv", vecs, total,
+                readv_vs_part_read, (void *) part))
+            return 1;
+
+        readv_ranges(vecs, bufs, fs->block_count * fs->block_size, &state);
+        total = tsk_fs_readv(fs, vecs, READV_NUM);
+        if (readv_compare("tsk_fs_readv", vecs, total, readv_fs_read, fs))
+            return 1;
+    }
+
+    // a bad range fails the whole call
+    readv_ranges(vecs, bufs, img->size, &state);
+    vecs[READV_NUM / 2].off = -1;
+    if (tsk_img_readv(img, vecs, READV_NUM) != -1) {
+        fprintf(stderr, "tsk_img_readv did not fail on a negative offset\n");
+        return 1;
+    }
+    tsk_error_reset();
+
+    free(bufs);
+    tsk_fs_close(fs);
+    tsk_vs_close(vs);
+    tsk_img_close(img);
+    remove(MBR_IMG);
+    return 0;
+}
+
+
+/* Compares a walk in large chunks with a walk of one block at a time for
+ * each allocated file */
+static TSK_WALK_RET_ENUM
+large_chunks_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    int *failed = (int *) a_ptr;
+    char *buf1, *buf2;
+
+    if ((a_fs_file->meta->type != TSK_FS_META_TYPE_REG)
+        || (a_fs_file->meta->size == 0))
+        return TSK_WALK_CONT;
+
+    buf1 = walk_file(a_fs_file, (TSK_FS_FILE_WALK_FLAG_ENUM) 0);
+    buf2 = walk_file(a_fs_file, TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS);
+    if ((buf1 == NULL) || (buf2 == NULL)
+        || (memcmp(buf1, buf2, (size_t) a_fs_file->meta->size))) {
+        fprintf(stderr, "Walk of inode %" PRIuINUM
+            " in large chunks has different data\n",
+            a_fs_file->meta->addr);
+        *failed = 1;
+    }
+    free(buf1);
+    free(buf2);
+    return (*failed) ? TSK_WALK_STOP : TSK_WALK_CONT;
+}
+
+static int
+test_large_chunks()
+{
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    int i, failed = 0;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+
+    // the default size covers whole runs and a size of one block splits them
+    for (i = 0; i < 2; i++) {
+        fs->walk_chunk_len = (i == 0) ? 0 : fs->block_size;
+        if (tsk_fs_meta_walk(fs, fs->first_inum, fs->last_inum,
+                TSK_FS_META_FLAG_ALLOC, large_chunks_act, &failed)) {
+            fprintf(stderr, "Error walking the fixture file system\n");
+            tsk_error_print(stderr);
+            tsk_error_reset();
+            return 1;
+        }
+        if (failed)
+            break;
+    }
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+/* Names found by a directory walk.  The unordered parallel walk calls
+ * back from all of its threads, so the lock protects the names. */
+typedef struct {
+    tsk_lock_t lock;
+    std::vector < std::string > names;
+    uint8_t error;              // 1 to return an error in the middle of the tree
+} DIR_NAMES;
+
+static TSK_WALK_RET_ENUM
+dir_names_act(TSK_FS_FILE * a_fs_file, const char *a_path, void *a_ptr)
+{
+    DIR_NAMES *dir_names = (DIR_NAMES *) a_ptr;
+    char buf[64];
+
+    // the meta can be NULL for deleted names
+    snprintf(buf, sizeof(buf), " %" PRIuINUM " %d %d",
+        a_fs_file->name->meta_addr, (int) a_fs_file->name->flags,
+        (a_fs_file->meta) ? (int) a_fs_file->meta->type : -1);
+
+    tsk_take_lock(&dir_names->lock);
+    dir_names->names.push_back(std::string(a_path) +
+        a_fs_file->name->name + buf);
+    tsk_release_lock(&dir_names->lock);
+
+    /* Skip the rest of the directories two levels down in the tree after
+     * their first subdirectory, whose own subdirectories the worker
+     * threads are still loading */
+    if ((dir_names->error) && (strncmp(a_path, "tree/dir", 8) == 0)
+        && (strchr(a_path + 5, '/') == a_path + strlen(a_path) - 1)
+        && (strcmp(a_fs_file->name->name, "dir1") == 0))
+        return TSK_WALK_ERROR;
+    return TSK_WALK_CONT;
+}
+
+/* Runs a_num_threads parallel dir walks and compares the names with a
+ * serial walk.  Ordered walks must also keep the same order. */
+static int
+test_dir_walk_parallel_fs(TSK_FS_INFO * a_fs,
+    TSK_FS_DIR_WALK_FLAG_ENUM a_flags, uint8_t a_error)
+{
+    const TSK_FS_DIR_WALK_FLAG_ENUM flags = (TSK_FS_DIR_WALK_FLAG_ENUM)
+        (TSK_FS_DIR_WALK_FLAG_RECURSE | TSK_FS_DIR_WALK_FLAG_ALLOC |
+        TSK_FS_DIR_WALK_FLAG_UNALLOC | a_flags);
+    DIR_NAMES serial, parallel;
+    int ret = 1;
+
+    tsk_init_lock(&serial.lock);
+    tsk_init_lock(&parallel.lock);
+    serial.error = parallel.error = a_error;
+
+    if (tsk_fs_dir_walk(a_fs, a_fs->root_inum, flags, dir_names_act,
+            &serial)) {
+        fprintf(stderr, "Error in serial dir walk\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+    if (tsk_fs_dir_walk_parallel(a_fs, a_fs->root_inum, flags,
+            dir_names_act, &parallel, 4)) {
+        fprintf(stderr, "Error in parallel dir walk\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+    if ((a_flags & TSK_FS_DIR_WALK_FLAG_ORDERED) == 0) {
+        std::sort(serial.names.begin(), serial.names.end());
+        std::sort(parallel.names.begin(), parallel.names.end());
+    }
+    if (parallel.names != serial.names) {
+        fprintf(stderr, "Parallel dir walk (flags %d, error %d) found %"
+            PRIuSIZE " names that differ from the %" PRIuSIZE
+            " of the serial walk\n", (int) a_flags, (int) a_error,
+            parallel.names.size(), serial.names.size());
+        goto done;
+    }
+    ret = 0;
+
+  done:
+    tsk_error_reset();
+    tsk_deinit_lock(&serial.lock);
+    tsk_deinit_lock(&parallel.lock);
+    return ret;
+}
+
+static int
+test_dir_walk_parallel()
+{
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    int i, failed = 0;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+
+    // the walks with errors free directories that can still be loading
+    for (i = 0; (i < 50) && (failed == 0); i++) {
+        failed = test_dir_walk_parallel_fs(fs,
+            (TSK_FS_DIR_WALK_FLAG_ENUM) 0, 0)
+            || test_dir_walk_parallel_fs(fs, TSK_FS_DIR_WALK_FLAG_ORDERED, 0)
+            || test_dir_walk_parallel_fs(fs, TSK_FS_DIR_WALK_FLAG_ORDERED,
+            1);
+    }
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+/* Compares a TSK_FS_INUM_SET with a std::set that has the same addresses */
+static int
+test_inum_set()
+{
+    TSK_FS_INUM_SET *set;
+    std::set < TSK_INUM_T > ref;
+    std::set < TSK_INUM_T >::const_iterator it;
+    TSK_INUM_T inum, next;
+    uint32_t state = 1;
+    int i;
+
+    if ((set = tsk_fs_inum_set_alloc()) == NULL) {
+        fprintf(stderr, "Error allocating inum set\n");
+        return 1;
+    }
+
+    for (i = 0; i < 200000; i++) {
+        if (i < 20000)          // dense range
+            inum = 1000 + next_rand(&state) % 30000;
+        else if (i < 20100)     // far apart
+            inum = (TSK_INUM_T) next_rand(&state) * next_rand(&state);
+        else                    // a chunk that fills up
+            inum = 5000000 + next_rand(&state) % 65536;
+
+        if (tsk_fs_inum_set_add(set, inum)) {
+            fprintf(stderr, "Error adding %" PRIuINUM " to inum set\n",
+                inum);
+            tsk_error_print(stderr);
+            tsk_error_reset();
+            tsk_fs_inum_set_free(set);
+            return 1;
+        }
+        ref.insert(inum);
+    }
+
+    if (tsk_fs_inum_set_count(set) != ref.size()) {
+        fprintf(stderr, "Inum set has %" PRIuINUM " addresses instead of %"
+            PRIuSIZE "\n", tsk_fs_inum_set_count(set), ref.size());
+        tsk_fs_inum_set_free(set);
+        return 1;
+    }
+
+    // walk the set in order
+    inum = 0;
+    for (it = ref.begin(); it != ref.end(); it++) {
+        if ((tsk_fs_inum_set_next(set, inum, &next) == 0)
+            || (next != *it)) {
+            fprintf(stderr, "Inum set has the wrong address after %"
+                PRIuINUM "\n", inum);
+            tsk_fs_inum_set_free(set);
+            return 1;
+        }
+        inum = next + 1;
+    }
+    if (tsk_fs_inum_set_next(set, inum, &next)) {
+        fprintf(stderr, "Inum set has an address after the last one\n");
+        tsk_fs_inum_set_free(set);
+        return 1;
+    }
+
+    for (i = 0; i < 100000; i++) {
+        inum = next_rand(&state) % 35000;
+        if (i % 2)
+            inum += 5000000;
+        if (tsk_fs_inum_set_find(set, inum) != (ref.count(inum) ? 1 : 0)) {
+            fprintf(stderr, "Inum set has the wrong result for %" PRIuINUM
+                "\n", inum);
+            tsk_fs_inum_set_free(set);
+            return 1;
+        }
+    }
+
+    tsk_fs_inum_set_free(set);
+    return 0;
+}
+
+
+/* Collects the unallocated inodes that names point to */
+static TSK_WALK_RET_ENUM
+named_unalloc_act(TSK_FS_FILE * a_fs_file, const char *a_path, void *a_ptr)
+{
+    std::set < TSK_INUM_T > *named = (std::set < TSK_INUM_T > *)a_ptr;
+
+    if ((a_fs_file->meta)
+        && (a_fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC))
+        named->insert(a_fs_file->meta->addr);
+    return TSK_WALK_CONT;
+}
+
+/* Compares tsk_fs_dir_get_list_inum_named() after a full dir walk with
+ * the unallocated inodes that the walk found names for */
+static int
+test_list_inum_named()
+{
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    TSK_LIST *list, *node;
+    std::set < TSK_INUM_T > named;
+    std::set < TSK_INUM_T >::const_iterator it;
+    uint64_t count = 0;
+    int failed = 0;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+
+    if (tsk_fs_dir_get_list_inum_named(fs) != NULL) {
+        fprintf(stderr, "List of named inodes exists before a walk\n");
+        failed = 1;
+    }
+    else if (tsk_fs_dir_walk(fs, fs->root_inum,
+            (TSK_FS_DIR_WALK_FLAG_ENUM) (TSK_FS_DIR_WALK_FLAG_RECURSE |
+                TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_UNALLOC),
+            named_unalloc_act, &named)) {
+        fprintf(stderr, "Error walking the fixture file system\n");
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        failed = 1;
+    }
+    else if (named.empty()) {
+        fprintf(stderr, "Fixture has no names of unallocated inodes\n");
+        failed = 1;
+    }
+    else if ((list = tsk_fs_dir_get_list_inum_named(fs)) == NULL) {
+        fprintf(stderr, "No list of named inodes after a walk\n");
+        failed = 1;
+    }
+    else {
+        for (node = list; node; node = node->next)
+            count += node->len;
+        for (it = named.begin(); it != named.end(); it++) {
+            if (tsk_list_find(list, *it) == 0)
+                break;
+        }
+        if ((count != named.size()) || (it != named.end())
+            || (tsk_fs_dir_get_list_inum_named(fs) != list)) {
+            fprintf(stderr, "List of %" PRIu64 " named inodes differs "
+                "from the %" PRIuSIZE " of the walk\n", count,
+                named.size());
+            failed = 1;
+        }
+    }
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+/* Adds a line with the fields of a TSK_FS_META_BATCH record to a_recs */
+static void
+meta_rec_add(std::vector < std::string > *a_recs, TSK_INUM_T a_addr,
+    int a_flags, int a_type, int a_mode, TSK_OFF_T a_size, time_t a_mtime,
+    time_t a_atime, time_t a_ctime, time_t a_crtime, TSK_UID_T a_uid,
+    TSK_GID_T a_gid)
+{
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "%" PRIuINUM " %d %d %d %" PRIdOFF
+        " %lld %lld %lld %lld %" PRIuUID " %" PRIuGID, a_addr, a_flags,
+        a_type, a_mode, a_size, (long long) a_mtime, (long long) a_atime,
+        (long long) a_ctime, (long long) a_crtime, a_uid, a_gid);
+    a_recs->push_back(buf);
+}
+
+static TSK_WALK_RET_ENUM
+meta_serial_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    TSK_FS_META *meta = a_fs_file->meta;
+
+    meta_rec_add((std::vector < std::string > *)a_ptr, meta->addr,
+        meta->flags, meta->type, meta->mode, meta->size, meta->mtime,
+        meta->atime, meta->ctime, meta->crtime, meta->uid, meta->gid);
+    return TSK_WALK_CONT;
+}
+
+static TSK_WALK_RET_ENUM
+meta_batch_act(const TSK_FS_META_BATCH * a_batch, void *a_ptr)
+{
+    size_t i;
+
+    if ((a_batch->count == 0) || (a_batch->count > TSK_FS_META_BATCH_SIZE)) {
+        fprintf(stderr, "Batched meta walk gave %" PRIuSIZE " records\n",
+            a_batch->count);
+        return TSK_WALK_ERROR;
+    }
+    for (i = 0; i < a_batch->count; i++) {
+        meta_rec_add((std::vector < std::string > *)a_ptr,
+            a_batch->addr[i], a_batch->flags[i], a_batch->type[i],
+            a_batch->mode[i], a_batch->size[i], a_batch->mtime[i],
+            a_batch->atime[i], a_batch->ctime[i], a_batch->crtime[i],
+            a_batch->uid[i], a_batch->gid[i]);
+    }
+    return TSK_WALK_CONT;
+}
+
+/* Compares the records of tsk_fs_meta_walk_batch() with the metadata
+ * that tsk_fs_meta_walk() gives in the same order */
+static int
+test_meta_walk_batch()
+{
+    const TSK_FS_META_FLAG_ENUM flags = (TSK_FS_META_FLAG_ENUM)
+        (TSK_FS_META_FLAG_ALLOC | TSK_FS_META_FLAG_UNALLOC);
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    std::vector < std::string > serial, batched;
+    int failed = 0;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+
+    if ((tsk_fs_meta_walk(fs, fs->first_inum, fs->last_inum, flags,
+                meta_serial_act, &serial))
+        || (tsk_fs_meta_walk_batch(fs, fs->first_inum, fs->last_inum,
+                flags, meta_batch_act, &batched))) {
+        fprintf(stderr, "Error walking the fixture file system\n");
+        tsk_error_print(stderr);
+        failed = 1;
+    }
+    else if (batched != serial) {
+        fprintf(stderr, "Batched meta walk gave %" PRIuSIZE
+            " records that differ from the %" PRIuSIZE " files of the "
+            "meta walk\n", batched.size(), serial.size());
+        failed = 1;
+    }
+    tsk_error_reset();
+
+    if ((failed == 0)
+        && ((tsk_fs_meta_walk_batch(NULL, 0, 0, flags, meta_batch_act,
+                    &batched) == 0)
+            || (tsk_error_get_errno() != TSK_ERR_FS_ARG))) {
+        fprintf(stderr,
+            "Batched meta walk did not report a NULL file system\n");
+        failed = 1;
+    }
+    tsk_error_reset();
+
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+/* Ranges that the parallel meta walk gave to the inode_walk of a file
+ * system that has no image */
+static tsk_lock_t s_ranges_lock;
+static std::vector < std::pair < TSK_INUM_T, TSK_INUM_T > >s_ranges;
+
+static uint8_t
+ranges_inode_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_start, TSK_INUM_T a_end,
+    TSK_FS_META_FLAG_ENUM a_flags, TSK_FS_META_WALK_CB a_cb, void *a_ptr)
+{
+    tsk_take_lock(&s_ranges_lock);
+    s_ranges.push_back(std::make_pair(a_start, a_end));
+    tsk_release_lock(&s_ranges_lock);
+    return 0;
+}
+
+static TSK_WALK_RET_ENUM
+ranges_act(TSK_FS_FILE * a_fs_file, int a_thread, void *a_ptr)
+{
+    return TSK_WALK_CONT;
+}
+
+/* Runs a parallel meta walk of a_fs from a_start to a_end and checks
+ * that the ranges cover the walk and end at the ends of groups of
+ * a_group_len inodes (of which the first starts at a_group_first) */
+static int
+meta_walk_par_ranges(TSK_FS_INFO * a_fs, TSK_INUM_T a_start,
+    TSK_INUM_T a_end, TSK_INUM_T a_group_len, TSK_INUM_T a_group_first)
+{
+    TSK_INUM_T next = a_start;
+    size_t i;
+
+    s_ranges.clear();
+    a_fs->tag = TSK_FS_INFO_TAG;
+    a_fs->endian = TSK_LIT_ENDIAN;
+    a_fs->inode_walk = ranges_inode_walk;
+    if (tsk_fs_meta_walk_parallel(a_fs, a_start, a_end,
+            TSK_FS_META_FLAG_ALLOC, ranges_act, NULL, 4)) {
+        fprintf(stderr, "Error in parallel meta walk\n");
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+
+    std::sort(s_ranges.begin(), s_ranges.end());
+    for (i = 0; i < s_ranges.size(); i++) {
+        if ((s_ranges[i].first != next)
+            || (s_ranges[i].second < s_ranges[i].first)
+            || ((s_ranges[i].second != a_end)
+                && ((s_ranges[i].second + 1 -
+                        a_group_first) % a_group_len))) {
+            fprintf(stderr, "Parallel meta walk of type %d has range %"
+                PRIuINUM "-%" PRIuINUM " (groups of %" PRIuINUM ")\n",
+                (int) a_fs->ftype, s_ranges[i].first, s_ranges[i].second,
+                a_group_len);
+            return 1;
+        }
+        next = s_ranges[i].second + 1;
+    }
+    if ((next != a_end + 1) || (s_ranges.size() < 2)) {
+        fprintf(stderr, "Parallel meta walk of type %d has %" PRIuSIZE
+            " ranges that end at %" PRIuINUM "\n", (int) a_fs->ftype,
+            s_ranges.size(), next - 1);
+        return 1;
+    }
+    return 0;
+}
+
+/* Checks the ranges of a parallel meta walk with group sizes that do not
+ * divide the number of addresses that a thread walks at a time */
+static int
+test_meta_walk_par_groups()
+{
+    EXT2FS_INFO ext2fs;
+    ext2fs_sb ext2_sb;
+    FFS_INFO ffs;
+    ffs_sb1 ffs_sb;
+    int failed = 0;
+
+    tsk_init_lock(&s_ranges_lock);
+
+    memset(&ext2fs, 0, sizeof(ext2fs));
+    memset(&ext2_sb, 0, sizeof(ext2_sb));
+    ext2fs.fs = &ext2_sb;
+    ext2fs.fs_info.ftype = TSK_FS_TYPE_EXT2;
+    ext2fs.fs_info.first_inum = 1;
+    ext2fs.fs_info.last_inum = 30001;
+    ext2_sb.s_inodes_per_group[0] = 3000 & 0xff;
+    ext2_sb.s_inodes_per_group[1] = 3000 >> 8;
+
+    memset(&ffs, 0, sizeof(ffs));
+    memset(&ffs_sb, 0, sizeof(ffs_sb));
+    ffs.fs.sb1 = &ffs_sb;
+    ffs.fs_info.ftype = TSK_FS_TYPE_FFS1;
+    ffs.fs_info.first_inum = 0;
+    ffs.fs_info.last_inum = 29999;
+    ffs_sb.cg_inode_num[0] = 2944 & 0xff;
+    ffs_sb.cg_inode_num[1] = 2944 >> 8;
+
+    failed = meta_walk_par_ranges(&ext2fs.fs_info, 1, 30001, 3000, 1)
+        || meta_walk_par_ranges(&ext2fs.fs_info, 4500, 29000, 3000, 1)
+        || meta_walk_par_ranges(&ffs.fs_info, 0, 29999, 2944, 0)
+        || meta_walk_par_ranges(&ffs.fs_info, 100, 20000, 2944, 0);
+
+    tsk_deinit_lock(&s_ranges_lock);
+    return failed;
+}
+
+
+#define INDEX_PATH          "fixture_index.bin"
+#define BLOCK_OWNERS_MAX    16  // Owners of a block that are compared
+
+/* Checks that the block index has the blocks of the files */
+typedef struct {
+    const TSK_FS_BLOCK_INDEX *index;
+    TSK_INUM_T inum;
+    size_t blocks;
+    int failed;
+} INDEX_CHECK;
+
+static TSK_WALK_RET_ENUM
+index_block_act(TSK_FS_FILE * a_fs_file, TSK_OFF_T a_off, TSK_DADDR_T a_addr,
+    char *a_buf, size_t a_size, TSK_FS_BLOCK_FLAG_ENUM a_flags,
+    void *a_ptr)
+{
+    INDEX_CHECK *check = (INDEX_CHECK *) a_ptr;
+    std::vector < TSK_FS_BLOCK_INDEX_EXTENT > owners;
+    ssize_t cnt, i;
+
+    if (a_flags & TSK_FS_BLOCK_FLAG_SPARSE)
+        return TSK_WALK_CONT;
+
+    // a block can have more owners than fit in a fixed buffer
+    if ((cnt = tsk_fs_block_index_find(check->index, a_addr, NULL, 0)) > 0) {
+        owners.resize(cnt);
+        cnt = tsk_fs_block_index_find(check->index, a_addr, &owners[0],
+            owners.size());
+    }
+    for (i = 0; i < cnt; i++) {
+        if ((owners[i].inum == check->inum) && (owners[i].addr == a_addr)
+            && (owners[i].len == 1)) {
+            check->blocks++;
+            return TSK_WALK_CONT;
+        }
+    }
+    fprintf(stderr, "Block index does not have block %" PRIuDADDR
+        " of inode %" PRIuINUM "\n", a_addr, check->inum);
+    check->failed = 1;
+    return TSK_WALK_STOP;
+}
+
+static TSK_WALK_RET_ENUM
+index_file_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    INDEX_CHECK *check = (INDEX_CHECK *) a_ptr;
+    const TSK_FS_ATTR *fs_attr;
+
+    // the index only has non-resident attributes
+    if (((fs_attr = tsk_fs_file_attr_get(a_fs_file)) == NULL)
+        || ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0)) {
+        tsk_error_reset();
+        return TSK_WALK_CONT;
+    }
+
+    check->inum = a_fs_file->meta->addr;
+    if (tsk_fs_file_walk(a_fs_file, (TSK_FS_FILE_WALK_FLAG_ENUM)
+            (TSK_FS_FILE_WALK_FLAG_AONLY | TSK_FS_FILE_WALK_FLAG_SLACK),
+            index_block_act, check)) {
+        tsk_error_reset();
+    }
+    return (check->failed) ? TSK_WALK_STOP : TSK_WALK_CONT;
+}
+
+/* Compares the owners of each block in two block indexes */
+static int
+block_index_compare(TSK_FS_INFO * a_fs, const TSK_FS_BLOCK_INDEX * a_index1,
+    const TSK_FS_BLOCK_INDEX * a_index2)
+{
+    TSK_DADDR_T addr;
+
+    if (tsk_fs_block_index_count(a_index1) !=
+        tsk_fs_block_index_count(a_index2)) {
+        fprintf(stderr, "Loaded block index has %" PRIuSIZE
+            " extents instead of %" PRIuSIZE "\n",
+            tsk_fs_block_index_count(a_index2),
+            tsk_fs_block_index_count(a_index1));
+        return 1;
+    }
+    for (addr = a_fs->first_block; addr <= a_fs->last_block; addr++) {
+        TSK_FS_BLOCK_INDEX_EXTENT owners1[BLOCK_OWNERS_MAX];
+        TSK_FS_BLOCK_INDEX_EXTENT owners2[BLOCK_OWNERS_MAX];
+        ssize_t cnt1, cnt2, i;
+
+        cnt1 = tsk_fs_block_index_find(a_index1, addr, owners1,
+            BLOCK_OWNERS_MAX);
+        cnt2 = tsk_fs_block_index_find(a_index2, addr, owners2,
+            BLOCK_OWNERS_MAX);
+        if (cnt1 != cnt2) {
+            fprintf(stderr, "Loaded block index has %zd owners of block %"
+                PRIuDADDR " instead of %zd\n", cnt2, addr, cnt1);
+            return 1;
+        }
+        for (i = 0; (i < cnt1) && (i < BLOCK_OWNERS_MAX); i++) {
+            if ((owners1[i].inum != owners2[i].inum)
+                || (owners1[i].type != owners2[i].type)
+                || (owners1[i].id != owners2[i].id)
+                || (owners1[i].offset != owners2[i].offset)) {
+                fprintf(stderr, "Loaded block index has a different "
+                    "owner of block %" PRIuDADDR "\n", addr);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Builds a block index, checks that it has the blocks of the allocated
+ * files, and checks that a saved and loaded copy gives the same owners */
+static int
+test_block_index()
+{
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    TSK_FS_BLOCK_INDEX *index = NULL, *loaded = NULL;
+    INDEX_CHECK check;
+    int failed = 1;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+
+    if ((index = tsk_fs_block_index_build(fs)) == NULL) {
+        fprintf(stderr, "Error building block index\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+
+    memset(&check, 0, sizeof(check));
+    check.index = index;
+    if (tsk_fs_meta_walk(fs, fs->first_inum, fs->last_inum,
+            TSK_FS_META_FLAG_ALLOC, index_file_act, &check)) {
+        fprintf(stderr, "Error walking the fixture file system\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+    if ((check.failed) || (check.blocks == 0)) {
+        fprintf(stderr, "Block index is wrong (%" PRIuSIZE
+            " blocks found)\n", check.blocks);
+        goto done;
+    }
+
+    if (tsk_fs_block_index_save(index, (const TSK_TCHAR *) INDEX_PATH)) {
+        fprintf(stderr, "Error saving block index\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+    if ((loaded =
+            tsk_fs_block_index_load(fs,
+                (const TSK_TCHAR *) INDEX_PATH)) == NULL) {
+        fprintf(stderr, "Error loading block index\n");
+        tsk_error_print(stderr);
+        goto done;
+    }
+    failed = block_index_compare(fs, index, loaded);
+
+  done:
+    tsk_error_reset();
+    remove(INDEX_PATH);
+    if (index)
+        tsk_fs_block_index_free(index);
+    if (loaded)
+        tsk_fs_block_index_free(loaded);
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+#define LOOKUP_RUNS 300         // Runs in the attribute of test_run_lookup()
+
+/* Finds the run of an offset by going through the run list */
+static TSK_FS_ATTR_RUN *
+run_list_find(const TSK_FS_ATTR * a_fs_attr, TSK_DADDR_T a_blk)
+{
+    TSK_FS_ATTR_RUN *run;
+
+    for (run = a_fs_attr->nrd.run; run; run = run->next) {
+        if (run->offset + run->len > a_blk)
+            return run;
+    }
+    return NULL;
+}
+
+/* Looks up random offsets with tsk_fs_attr_run_find(), which makes the
+ * run table of the attribute the first time, and compares the runs with
+ * those of the run list */
+class RunLookup : public TskThread {
+public:
+    RunLookup(const TSK_FS_ATTR * fs_attr, uint32_t seed) :
+        m_fs_attr(fs_attr), m_seed(seed), m_failed(0) {}
+
+    void operator()() {
+        TSK_DADDR_T blocks = m_fs_attr->nrd.run_end->offset +
+            m_fs_attr->nrd.run_end->len;
+
+        for (int i = 0; i < 5000; ++i) {
+            // some offsets are past the last run
+            TSK_DADDR_T blk = next_rand(&m_seed) % (blocks + 10);
+
+            if (tsk_fs_attr_run_find(m_fs_attr, blk) !=
+                run_list_find(m_fs_attr, blk)) {
+                fprintf(stderr, "Run table has the wrong run for block %"
+                    PRIuDADDR "\n", blk);
+                m_failed = 1;
+                return;
+            }
+        }
+    }
+
+    int failed() const { return m_failed; }
+
+private:
+    const TSK_FS_ATTR *m_fs_attr;
+    uint32_t m_seed;
+    int m_failed;
+};
+
+/* Checks the run table of an attribute with many runs from several
+ * threads and after a run is added, and compares random reads of
+ * FRAG_PATH with a walk of the file */
+static int
+test_run_lookup()
+{
+    const size_t nthreads = 8;
+    TSK_IMG_OPTIONS opts;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    TSK_FS_FILE *fs_file;
+    TSK_FS_ATTR *fs_attr;
+    TSK_FS_ATTR_RUN *run;
+    TskThread *lookups[nthreads];
+    TSK_OFF_T len;
+    char *data, buf[4096];
+    uint32_t state = 1;
+    size_t i;
+    int failed = 0;
+
+    tsk_img_options_init(&opts);
+    if ((fs = open_fixture_fs(&opts, &img)) == NULL)
+        return 1;
+    if ((data = walk_frag_file(fs, (TSK_FS_FILE_WALK_FLAG_ENUM) 0,
+                &len)) == NULL)
+        return 1;
+    if ((fs_file = tsk_fs_file_open(fs, NULL, FRAG_PATH)) == NULL) {
+        fprintf(stderr, "Error opening %s\n", FRAG_PATH);
+        tsk_error_print(stderr);
+        tsk_error_reset();
+        return 1;
+    }
+
+    for (i = 0; (i < 500) && (failed == 0); i++) {
+        TSK_OFF_T off = next_rand(&state) % len;
+        size_t cnt = 1 + next_rand(&state) % sizeof(buf);
+
+        if (off + (TSK_OFF_T) cnt > len)
+            cnt = (size_t) (len - off);
+        if ((tsk_fs_file_read(fs_file, off, buf, cnt,
+                    (TSK_FS_FILE_READ_FLAG_ENUM) 0) != (ssize_t) cnt)
+            || (memcmp(buf, &data[off], cnt))) {
+            fprintf(stderr, "Read of %s at %" PRIdOFF " differs from "
+                "its walk\n", FRAG_PATH, off);
+            tsk_error_print(stderr);
+            tsk_error_reset();
+            failed = 1;
+        }
+    }
+    free(data);
+
+    // an attribute with runs of 1 to 5 blocks
+    if ((fs_attr = tsk_fs_attr_alloc(TSK_FS_ATTR_NONRES)) == NULL) {
+        fprintf(stderr, "Error allocating attribute\n");
+        return 1;
+    }
+    fs_attr->fs_file = fs_file;
+    for (i = 0; i < LOOKUP_RUNS; i++) {
+        if ((run = tsk_fs_attr_run_alloc()) == NULL) {
+            fprintf(stderr, "Error allocating run\n");
+            return 1;
+        }
+        run->addr = 1000 + i * 10;
+        run->len = 1 + i % 5;
+        tsk_fs_attr_append_run(fs, fs_attr, run);
+    }
+    while (fs_attr->nrd.run_end->next)
+        fs_attr->nrd.run_end = fs_attr->nrd.run_end->next;
+
+    for (i = 0; i < nthreads; i++)
+        lookups[i] = new RunLookup(fs_attr, (uint32_t) (i + 1));
+    TskThread::run(lookups, nthreads);
+    for (i = 0; i < nthreads; i++) {
+        failed |= ((RunLookup *) lookups[i])->failed();
+        delete lookups[i];
+    }
+
+    // a file system can add a run to the list after the table is made
+    if ((failed == 0) && ((run = tsk_fs_attr_run_alloc()) != NULL)) {
+        run->offset = fs_attr->nrd.run_end->offset +
+            fs_attr->nrd.run_end->len;
+        run->len = 7;
+        fs_attr->nrd.run_end->next = run;
+        fs_attr->nrd.run_end = run;
+        if (tsk_fs_attr_run_find(fs_attr, run->offset + 3) != run) {
+            fprintf(stderr, "Run table does not have an added run\n");
+            failed = 1;
+        }
+    }
+
+    tsk_fs_attr_free(fs_attr);
+    tsk_fs_file_close(fs_file);
+    tsk_fs_close(fs);
+    tsk_img_close(img);
+    return failed;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    // automake gives the source directory of the test in srcdir
+    if (argc == 2)
+        s_srcdir = argv[1];
+    else if ((s_srcdir = getenv("srcdir")) == NULL)
+        s_srcdir = ".";
+
+    if (make_data_img())
+        return 1;
+
+    if (test_cache_threads())
+        return 1;
+    if (test_prefetch())
+        return 1;
+    if (test_split_pool())
+        return 1;
+    if (test_img_stats())
+        return 1;
+    if (test_readv())
+        return 1;
+    if (test_large_chunks())
+        return 1;
+    if (test_dir_walk_parallel())
+        return 1;
+    if (test_inum_set())
+        return 1;
+    if (test_list_inum_named())
+        return 1;
+    if (test_meta_walk_batch())
+        return 1;
+    if (test_meta_walk_par_groups())
+        return 1;
+    if (test_block_index())
+        return 1;
+    if (test_run_lookup())
+        return 1;
+
+    remove(DATA_IMG);
+    free(s_data);
+    printf("Tests Passed\n");
+    return 0;
+}
@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include <algorithm>
+#include <vector>
+
 static TSK_WALK_RET_ENUM
 proc_dir(TSK_FS_FILE* fs_file, const char* path, void* stuff)
 {
@@ -118,6 +121,109 @@ proc_fs(TSK_FS_INFO* fs, FILE* log)
     }
 }
 
+// Fields of a file that the serial and parallel inode walks must agree on
+struct MetaRec {
+    TSK_INUM_T addr;
+    int flags;
+    int type;
+    TSK_OFF_T size;
+    time_t mtime;
+
+    bool operator<(const MetaRec& other) const {
+        return addr < other.addr;
+    }
+    bool operator!=(const MetaRec& other) const {
+        return (addr != other.addr) || (flags != other.flags)
+            || (type != other.type) || (size != other.size)
+            || (mtime != other.mtime);
+    }
+};
+
+static MetaRec
+make_meta_rec(const TSK_FS_FILE* fs_file)
+{
+    MetaRec rec;
+    rec.addr = fs_file->meta->addr;
+    rec.flags = fs_file->meta->flags;
+    rec.type = fs_file->meta->type;
+    rec.size = fs_file->meta->size;
+    rec.mtime = fs_file->meta->mtime;
+    return rec;
+}
+
+static TSK_WALK_RET_ENUM
+meta_serial_act(TSK_FS_FILE* fs_file, void* ptr)
+{
+    ((std::vector<MetaRec>*)ptr)->push_back(make_meta_rec(fs_file));
+    return TSK_WALK_CONT;
+}
+
+// Each walker thread has its own vector, so no lock is needed
+static TSK_WALK_RET_ENUM
+meta_parallel_act(TSK_FS_FILE* fs_file, int thread, void* ptr)
+{
+    ((std::vector<MetaRec>*)ptr)[thread].push_back(make_meta_rec(fs_file));
+    return TSK_WALK_CONT;
+}
+
+// Run tsk_fs_meta_walk_parallel() with several threads and check that it
+// returns the same files as tsk_fs_meta_walk().
+static int
+test_meta_walk_parallel(TSK_FS_INFO* fs)
+{
+    const int nthreads = 4;
+    const TSK_FS_META_FLAG_ENUM flags = (TSK_FS_META_FLAG_ENUM)
+        (TSK_FS_META_FLAG_ALLOC | TSK_FS_META_FLAG_UNALLOC);
+    std::vector<MetaRec> serial;
+    std::vector<MetaRec> per_thread[nthreads];
+    std::vector<MetaRec> parallel;
+
+    if (tsk_fs_meta_walk(fs, fs->first_inum, fs->last_inum, flags,
+            meta_serial_act, &serial)) {
+        fprintf(stderr, "serial meta walk failed\n");
+        tsk_error_print(stderr);
+        return 1;
+    }
+    if (tsk_fs_meta_walk_parallel(fs, fs->first_inum, fs->last_inum, flags,
+            meta_parallel_act, per_thread, nthreads)) {
+        fprintf(stderr, "parallel meta walk failed\n");
+        tsk_error_print(stderr);
+        return 1;
+    }
+
+    for (int i = 0; i < nthreads; ++i) {
+        parallel.insert(parallel.end(), per_thread[i].begin(),
+            per_thread[i].end());
+    }
+    std::sort(serial.begin(), serial.end());
+    std::sort(parallel.begin(), parallel.end());
+    if (serial.size() != parallel.size()) {
+        fprintf(stderr, "parallel meta walk returned %" PRIuSIZE
+            " files instead of %" PRIuSIZE "\n", parallel.size(),
+            serial.size());
+        return 1;
+    }
+    for (size_t i = 0; i < serial.size(); ++i) {
+        if (serial[i] != parallel[i]) {
+            fprintf(stderr, "parallel meta walk differs at inode %" PRIuINUM
+                "\n", serial[i].addr);
+            return 1;
+        }
+    }
+
+    // a bad file system is reported as an error
+    tsk_error_reset();
+    if ((tsk_fs_meta_walk_parallel(NULL, 0, 0, flags, meta_parallel_act,
+                per_thread, nthreads) == 0)
+        || (tsk_error_get_errno() != TSK_ERR_FS_ARG)) {
+        fprintf(stderr, "parallel meta walk did not report a NULL file system\n");
+        return 1;
+    }
+    tsk_error_reset();
+
+    return 0;
+}
+
 class MyThread : public TskThread {
 public:
     // The threads share the same TSK_FS_INFO
@@ -241,6 +347,12 @@ main(int argc, char** argv1)
         exit(1);
     }
 
+    if (test_meta_walk_parallel(fs)) {
+        tsk_fs_close(fs);
+        tsk_img_close(img);
+        exit(1);
+    }
+
     TskThread** threads = new TskThread*[nthreads];
     for (size_t i = 0; i < nthreads; ++i) {
         threads[i] = new MyThread(i, fs, niters);
@@ -20,7 +20,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-ahkvV] [-i imgtype] [-b dev_sector_size] [-d database] [-z ZONE] image [image]\n"),
+        ("usage: %s [-ahksvV] [-i imgtype] [-b dev_sector_size] [-d database] [-t num_threads] [-T trace_file] [-z ZONE] image [image]\n"),
         progname);
     tsk_fprintf(stderr, "\t-a: Add image to existing database, instead of creating a new one (requires -d to specify database)\n");
     tsk_fprintf(stderr, "\t-k: Don't create block data table\n");
@@ -30,6 +30,9 @@ usage()
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
     tsk_fprintf(stderr, "\t-d database: Path for the database (default is the same directory as the image, with name derived from image name)\n");
+    tsk_fprintf(stderr, "\t-s: Print I/O statistics of the image reads at the end\n");
+    tsk_fprintf(stderr, "\t-t num_threads: Number of threads to load directories with (default is 1)\n");
+    tsk_fprintf(stderr, "\t-T trace_file: Write a trace of the image reads to trace_file\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: Print version\n");
     tsk_fprintf(stderr, "\t-z: Time zone of original machine (i.e. EST5EDT or GMT)\n");
@@ -53,6 +56,9 @@ main(int argc, char **argv1)
     bool blkMapFlag = true;   // true if we are going to write the block map
     bool createDbFlag = true; // true if we are going to create a new database
     bool calcHash = false;
+    bool imgStats = false;
+    TSK_TCHAR *traceFile = NULL;
+    int dirWalkThreads = 1;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -68,7 +74,7 @@ main(int argc, char **argv1)
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("ab:d:hi:kvVz:"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("ab:d:hi:kst:T:vVz:"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -116,6 +122,22 @@ main(int argc, char **argv1)
             database = OPTARG;
             break;
 
+        case _TSK_T('s'):
+            imgStats = true;
+            break;
+        case _TSK_T('t'):
+            dirWalkThreads = (int) TSTRTOUL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG || dirWalkThreads < 1) {
+                TFPRINTF(stderr,
+                    _TSK_T
+                    ("invalid argument: number of threads must be positive: %s\n"),
+                    OPTARG);
+                usage();
+            }
+            break;
+        case _TSK_T('T'):
+            traceFile = OPTARG;
+            break;
         case _TSK_T('v'):
             tsk_verbose++;
             break;
@@ -172,6 +194,9 @@ main(int argc, char **argv1)
     autoDb->createBlockMap(blkMapFlag);
     autoDb->hashFiles(calcHash);
     autoDb->setAddUnallocSpace(true);
+    autoDb->setDirWalkThreads(dirWalkThreads);
+    if (imgStats || traceFile)
+        autoDb->enableImageStats(traceFile);
 
     if (autoDb->startAddImage(argc - OPTIND, &argv[OPTIND], imgtype, ssize)) {
         std::vector<TskAuto::error_record> errors = autoDb->getErrorList();
@@ -186,6 +211,9 @@ main(int argc, char **argv1)
     }
     TFPRINTF(stdout, _TSK_T("Database stored at: %s\n"), database);
 
+    if (imgStats)
+        autoDb->printImageStats(stdout);
+
     autoDb->closeImage();
     delete tskCase;
     delete autoDb;
@@ -31,7 +31,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-dsu unit_addr] [-vV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] image [images]\n"),
+        ("usage: %s [-dsu unit_addr] [-vV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] image [images]\n"),
         progname);
     tsk_fprintf(stderr, "Slowly calculates the opposite block number\n");
     tsk_fprintf(stderr, "\tOne of the following must be given:\n");
@@ -47,6 +47,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
@@ -62,6 +64,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -89,9 +92,11 @@ main(int argc, char **argv1)
 
 
     progname = argv[0];
+
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:d:f:i:o:s:u:vV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:d:f:i:o:s:u:vV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -110,6 +115,12 @@ main(int argc, char **argv1)
             }
             break;
 
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('d'):
             type |= TSK_FS_BLKCALC_DD;
             count = TSTRTOULL(OPTARG, &cp, 0);
@@ -202,8 +213,8 @@ main(int argc, char **argv1)
 
 
     if ((img =
-            tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype,
-                ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND, &argv[OPTIND], imgtype,
+                ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
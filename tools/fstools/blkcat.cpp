@@ -32,7 +32,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-ahsvVw] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] [-u usize] image [images] unit_addr [num]\n"),
+        ("usage: %s [-ahsvVw] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] [-u usize] image [images] unit_addr [num]\n"),
         progname);
     tsk_fprintf(stderr, "\t-a: displays in all ASCII \n");
     tsk_fprintf(stderr, "\t-h: displays in hexdump-like fashion\n");
@@ -40,6 +40,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr,
@@ -63,6 +65,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -91,9 +94,11 @@ main(int argc, char **argv1)
 
 
     progname = argv[0];
+
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("ab:f:hi:o:su:vVw"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("ab:C:f:hi:o:su:vVw"))) > 0) {
         switch (ch) {
         case _TSK_T('a'):
             format |= TSK_FS_BLKCAT_ASCII;
@@ -108,6 +113,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, BLKLS_TYPE) == 0) {
                 fstype = TSK_FS_TYPE_RAW;
@@ -208,8 +219,8 @@ main(int argc, char **argv1)
     /* Get the block address */
     if (format & TSK_FS_BLKCAT_STAT) {
         if ((img =
-                tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                    imgtype, ssize)) == NULL) {
+                tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                    imgtype, ssize, &img_opts)) == NULL) {
             tsk_error_print(stderr);
             exit(1);
         }
@@ -234,8 +245,8 @@ main(int argc, char **argv1)
             }
 
             if ((img =
-                    tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
                 tsk_error_print(stderr);
                 exit(1);
             }
@@ -262,8 +273,8 @@ main(int argc, char **argv1)
             }
 
             if ((img =
-                    tsk_img_open(argc - OPTIND - 2, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND - 2, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
 
                 tsk_error_print(stderr);
                 exit(1);
@@ -35,7 +35,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-aAelvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] image [images] [start-stop]\n"),
+        ("usage: %s [-aAelvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] image [images] [start-stop]\n"),
         progname);
     tsk_fprintf(stderr, "\t-e: every block (including file system metadata blocks)\n");
     tsk_fprintf(stderr,
@@ -48,6 +48,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr,
@@ -70,6 +72,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -98,9 +101,10 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("aAb:ef:i:lo:svV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("aAb:C:ef:i:lo:svV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -125,6 +129,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('e'):
             flags |= (TSK_FS_BLOCK_WALK_FLAG_ALLOC | TSK_FS_BLOCK_WALK_FLAG_UNALLOC);
             break;
@@ -189,7 +199,8 @@ main(int argc, char **argv1)
         }
 
         /* There should be no other arguments */
-        img = tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype, ssize);
+        img = tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+            imgtype, ssize, &img_opts);
 
         if (img == NULL) {
             tsk_error_print(stderr);
@@ -216,8 +227,8 @@ main(int argc, char **argv1)
         if ((dash = TSTRCHR(argv[argc - 1], _TSK_T('-'))) == NULL) {
             /* No dash in arg - therefore it is an image file name */
             if ((img =
-                    tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
                 tsk_error_print(stderr);
                 exit(1);
             }
@@ -239,8 +250,8 @@ main(int argc, char **argv1)
                 /* Not a number - consider it a file name */
                 *dash = _TSK_T('-');
                 if ((img =
-                        tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                            imgtype, ssize)) == NULL) {
+                        tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                            imgtype, ssize, &img_opts)) == NULL) {
                     tsk_error_print(stderr);
                     exit(1);
                 }
@@ -262,8 +273,8 @@ main(int argc, char **argv1)
                     dash--;
                     *dash = _TSK_T('-');
                     if ((img =
-                            tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                                imgtype, ssize)) == NULL) {
+                            tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                                imgtype, ssize, &img_opts)) == NULL) {
                         tsk_error_print(stderr);
                         exit(1);
                     }
@@ -281,8 +292,8 @@ main(int argc, char **argv1)
                     set_bounds = 0;
                     /* It was a block range, so do not include it in the open */
                     if ((img =
-                            tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                                imgtype, ssize)) == NULL) {
+                            tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                                imgtype, ssize, &img_opts)) == NULL) {
                         tsk_error_print(stderr);
                         exit(1);
                     }
@@ -24,7 +24,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-vV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] image [images] addr\n"),
+        ("usage: %s [-vV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] [-x index_file] image [images] addr\n"),
         progname);
     tsk_fprintf(stderr,
         "\t-f fstype: File system type (use '-f list' for supported types)\n");
@@ -32,10 +32,14 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-v: Verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: Print version\n");
+    tsk_fprintf(stderr,
+        "\t-x index_file: Block index to use (it is made if the file does not exist)\n");
 
     exit(1);
 }
@@ -47,6 +51,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -58,6 +63,7 @@ main(int argc, char **argv1)
     TSK_DADDR_T addr;
     TSK_TCHAR **argv;
     unsigned int ssize = 0;
+    TSK_TCHAR *index_path = NULL;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -71,9 +77,10 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:uvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:f:i:o:uvVx:"))) > 0) {
         switch (ch) {
         case _TSK_T('b'):
             ssize = (unsigned int) TSTRTOUL(OPTARG, &cp, 0);
@@ -85,6 +92,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_fs_type_print(stderr);
@@ -121,6 +134,9 @@ main(int argc, char **argv1)
         case _TSK_T('V'):
             tsk_version_print(stdout);
             exit(0);
+        case _TSK_T('x'):
+            index_path = OPTARG;
+            break;
         case _TSK_T('?'):
         default:
             TFPRINTF(stderr, _TSK_T("Invalid argument: %s\n"),
@@ -143,8 +159,8 @@ main(int argc, char **argv1)
 
     /* open image */
     if ((img =
-            tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                imgtype, ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                imgtype, ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
@@ -181,6 +197,19 @@ main(int argc, char **argv1)
     }
 
 
+    if (index_path) {
+        TSK_FS_BLOCK_INDEX *index;
+
+        if (((index = tsk_fs_block_index_open(fs, index_path)) == NULL)
+            || (tsk_fs_block_index_attach(fs, index))) {
+            tsk_error_print(stderr);
+            tsk_fs_block_index_free(index);
+            fs->close(fs);
+            img->close(img);
+            exit(1);
+        }
+    }
+
     if (tsk_fs_blkstat(fs, addr)) {
         tsk_error_print(stderr);
         fs->close(fs);
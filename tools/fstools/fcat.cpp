@@ -20,7 +20,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-hRsvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] file_path image [images]\n"),
+        ("usage: %s [-hRsvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] file_path image [images]\n"),
         progname);
     tsk_fprintf(stderr, "\t-h: Do not display holes in sparse files\n");
     tsk_fprintf(stderr,
@@ -30,6 +30,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-f fstype: File system type (use '-f list' for supported types)\n");
     tsk_fprintf(stderr,
@@ -45,6 +47,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -73,9 +76,10 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:hi:o:rRsvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:f:hi:o:rRsvV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -92,6 +96,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_fs_type_print(stderr);
@@ -156,8 +166,8 @@ main(int argc, char **argv1)
     TSTRNCPY(path, argv[OPTIND], TSTRLEN(argv[OPTIND]) + 1);
 
     if ((img =
-            tsk_img_open(argc - OPTIND - 1, &argv[OPTIND+1],
-                imgtype, ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND+1],
+                imgtype, ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
@@ -28,7 +28,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-aduvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] image [images] inode\n"),
+        ("usage: %s [-aduvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] image [images] inode\n"),
         progname);
     tsk_fprintf(stderr, "\t-a: Find all occurrences\n");
     tsk_fprintf(stderr, "\t-d: Find deleted entries ONLY\n");
@@ -39,6 +39,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-v: Verbose output to stderr\n");
@@ -53,6 +55,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -82,9 +85,10 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("ab:df:i:o:uvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("ab:C:df:i:o:uvV"))) > 0) {
         switch (ch) {
         case _TSK_T('a'):
             ffind_flags |= TSK_FS_FFIND_ALL;
@@ -99,6 +103,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('d'):
             dir_walk_flags |= TSK_FS_DIR_WALK_FLAG_UNALLOC;
             break;
@@ -173,8 +183,8 @@ main(int argc, char **argv1)
 
     /* open image */
     if ((img =
-            tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                imgtype, ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                imgtype, ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
@@ -31,7 +31,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-alvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] [-d unit_addr] [-n file] [-p par_addr] [-z ZONE] image [images]\n"),
+        ("usage: %s [-alvV] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] [-d unit_addr] [-n file] [-p par_addr] [-x index_file] [-z ZONE] image [images]\n"),
         progname);
     tsk_fprintf(stderr, "\t-a: find all inodes\n");
     tsk_fprintf(stderr,
@@ -45,12 +45,16 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-f fstype: File system type (use '-f list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-o imgoffset: The offset of the file system in the image (in sectors)\n");
     tsk_fprintf(stderr, "\t-v: Verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: Print version\n");
+    tsk_fprintf(stderr,
+        "\t-x index_file: Block index to use (it is made if the file does not exist)\n");
     tsk_fprintf(stderr,
         "\t-z ZONE: Time zone setting when -l -p is given\n");
 
@@ -66,6 +70,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -80,6 +85,7 @@ main(int argc, char **argv1)
     TSK_TCHAR *path = NULL;
     TSK_TCHAR **argv;
     unsigned int ssize = 0;
+    TSK_TCHAR *index_path = NULL;
 
 #ifdef TSK_WIN32
     // On Windows, get the wide arguments (mingw doesn't support wmain)
@@ -93,11 +99,12 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
     localflags = 0;
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("ab:d:f:i:ln:o:p:vVz:"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("ab:C:d:f:i:ln:o:p:vVx:z:"))) > 0) {
         switch (ch) {
         case _TSK_T('a'):
             localflags |= TSK_FS_IFIND_ALL;
@@ -112,6 +119,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('d'):
             if (type) {
                 tsk_fprintf(stderr,
@@ -196,6 +209,9 @@ main(int argc, char **argv1)
         case 'V':
             tsk_version_print(stdout);
             exit(0);
+        case 'x':
+            index_path = OPTARG;
+            break;
         case 'z':
             {
                 TSK_TCHAR envstr[32];
@@ -231,8 +247,8 @@ main(int argc, char **argv1)
 
 
     if ((img =
-            tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype,
-                ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND, &argv[OPTIND], imgtype,
+                ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         if (path)
             free(path);
@@ -265,6 +281,18 @@ main(int argc, char **argv1)
             img->close(img);
             exit(1);
         }
+        if (index_path) {
+            TSK_FS_BLOCK_INDEX *index;
+
+            if (((index = tsk_fs_block_index_open(fs, index_path)) == NULL)
+                || (tsk_fs_block_index_attach(fs, index))) {
+                tsk_error_print(stderr);
+                tsk_fs_block_index_free(index);
+                fs->close(fs);
+                img->close(img);
+                exit(1);
+            }
+        }
         if (tsk_fs_ifind_data(fs, (TSK_FS_IFIND_FLAG_ENUM) localflags,
                 block)) {
             tsk_error_print(stderr);
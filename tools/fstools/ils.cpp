@@ -34,7 +34,7 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-emOpvV] [-aAlLzZ] [-f fstype] [-i imgtype] [-b dev_sector_size] [-o imgoffset] [-s seconds] image [images] [inum[-end]]\n"),
+        ("usage: %s [-emOpvV] [-aAlLzZ] [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-o imgoffset] [-s seconds] image [images] [inum[-end]]\n"),
         progname);
     tsk_fprintf(stderr, "\t-e: Display all inodes\n");
     tsk_fprintf(stderr, "\t-m: Display output in the mactime format\n");
@@ -54,6 +54,8 @@ usage()
         "\t-i imgtype: The format of the image file (use '-i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
         "\t-f fstype: File system type (use '-f list' for supported types)\n");
     tsk_fprintf(stderr,
@@ -71,6 +73,7 @@ main(int argc, char **argv1)
 {
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
 
     TSK_OFF_T imgaddr = 0;
     TSK_FS_TYPE_ENUM fstype = TSK_FS_TYPE_DETECT;
@@ -99,6 +102,7 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
     /*
@@ -106,7 +110,7 @@ main(int argc, char **argv1)
      * combinations.
      */
     while ((ch =
-            GETOPT(argc, argv, _TSK_T("aAb:ef:i:lLmo:Oprs:vVzZ"))) > 0) {
+            GETOPT(argc, argv, _TSK_T("aAb:C:ef:i:lLmo:Oprs:vVzZ"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -123,6 +127,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_fs_type_print(stderr);
@@ -227,8 +237,8 @@ main(int argc, char **argv1)
             /* Not a number - consider it a file name */
             image = argv[OPTIND];
             if ((img =
-                    tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
                 tsk_error_print(stderr);
                 exit(1);
             }
@@ -245,8 +255,8 @@ main(int argc, char **argv1)
             set_range = 0;
             image = argv[OPTIND];
             if ((img =
-                    tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
                 tsk_error_print(stderr);
                 exit(1);
             }
@@ -268,8 +278,8 @@ main(int argc, char **argv1)
             *dash = _TSK_T('-');
             image = argv[OPTIND];
             if ((img =
-                    tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                        imgtype, ssize)) == NULL) {
+                    tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                        imgtype, ssize, &img_opts)) == NULL) {
                 tsk_error_print(stderr);
                 exit(1);
             }
@@ -289,8 +299,8 @@ main(int argc, char **argv1)
                 *dash = '-';
                 image = argv[OPTIND];
                 if ((img =
-                        tsk_img_open(argc - OPTIND, &argv[OPTIND],
-                            imgtype, ssize)) == NULL) {
+                        tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+                            imgtype, ssize, &img_opts)) == NULL) {
                     tsk_error_print(stderr);
                     exit(1);
                 }
@@ -306,8 +316,8 @@ main(int argc, char **argv1)
                 /* It was a block range, so do not include it in the open */
                 image = argv[OPTIND];
                 if ((img =
-                        tsk_img_open(argc - OPTIND - 1, &argv[OPTIND],
-                            imgtype, ssize)) == NULL) {
+                        tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+                            imgtype, ssize, &img_opts)) == NULL) {
                     tsk_error_print(stderr);
                     exit(1);
                 }
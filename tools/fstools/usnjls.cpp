@@ -26,7 +26,7 @@ usage()
 {
     TFPRINTF(stderr,
              _TSK_T
-             ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size]"
+             ("usage: %s [-f fstype] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]]"
               " [-o imgoffset] [-lmvV] image [inode]\n"),
              progname);
     tsk_fprintf(stderr,
@@ -35,6 +35,9 @@ usage()
     tsk_fprintf(stderr,
                 "\t-b dev_sector_size: The size (in bytes)"
                 " of the device sectors\n");
+    tsk_fprintf(stderr,
+                "\t-C cache_lines[:line_size]: Image read cache geometry"
+                " (0 lines disables the cache)\n");
     tsk_fprintf(stderr,
                 "\t-f fstype: File system type "
                 "(use '-f list' for supported types)\n");
@@ -54,6 +57,7 @@ int
 main(int argc, char **argv1)
 {
     TSK_IMG_INFO *img = NULL;
+    TSK_IMG_OPTIONS img_opts;
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
 
     TSK_FS_INFO *fs = NULL;
@@ -80,9 +84,10 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:f:i:o:lmvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:f:i:o:lmvV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'): {
             default:
@@ -100,6 +105,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('f'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_fs_type_print(stderr);
@@ -156,7 +167,8 @@ main(int argc, char **argv1)
      * Check the final argument and see if it is a number
      */
     if (tsk_fs_parse_inum(argv[argc - 1], &inum, NULL, NULL, NULL, NULL)) {
-        img = tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype, ssize);
+        img = tsk_img_open_ex(argc - OPTIND, &argv[OPTIND],
+            imgtype, ssize, &img_opts);
         if (img == NULL) {
             tsk_error_print(stderr);
             exit(1);
@@ -194,7 +206,8 @@ main(int argc, char **argv1)
         inum = jrnl_file->name->meta_addr;
         tsk_fs_file_close(jrnl_file);
     } else {
-        img = tsk_img_open(argc - OPTIND - 1, &argv[OPTIND], imgtype, ssize);
+        img = tsk_img_open_ex(argc - OPTIND - 1, &argv[OPTIND],
+            imgtype, ssize, &img_opts);
         if (img == NULL) {
             tsk_error_print(stderr);
             exit(1);
@@ -21,12 +21,16 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-vV] [-i imgtype] [-b dev_sector_size] [-s start_sector] [-e stop_sector] image\n"),
+        ("usage: %s [-vV] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] [-t threads] [-s start_sector] [-e stop_sector] image\n"),
         progname);
     tsk_fprintf(stderr,
         "\t-i imgtype: The format of the image file (use 'i list' for supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
+    tsk_fprintf(stderr,
+        "\t-t threads: Number of threads that decompress E01 and VMDK data\n");
     tsk_fprintf(stderr,
         "\t-s start_sector: The sector number to start at\n");
     tsk_fprintf(stderr,
@@ -42,6 +46,7 @@ int
 main(int argc, char **argv1)
 {
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     int ch;
     TSK_OFF_T start_sector = 0;
@@ -63,8 +68,9 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:i:vVs:e:"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:i:t:vVs:e:"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -81,6 +87,22 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
+        case _TSK_T('t'):
+            img_opts.decode_threads =
+                (unsigned int) TSTRTOUL(OPTARG, &cp, 0);
+            if (*cp || *cp == *OPTARG) {
+                TFPRINTF(stderr,
+                    _TSK_T("invalid argument: number of threads: %s\n"),
+                    OPTARG);
+                usage();
+            }
+            break;
         case _TSK_T('i'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_img_type_print(stderr);
@@ -134,8 +156,8 @@ main(int argc, char **argv1)
     }
 
     if ((img =
-            tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype,
-                ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND, &argv[OPTIND], imgtype,
+                ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
@@ -17,13 +17,16 @@ usage()
 {
     TFPRINTF(stderr,
         _TSK_T
-        ("usage: %s [-tvV] [-i imgtype] [-b dev_sector_size] image\n"),
+        ("usage: %s [-stvV] [-i imgtype] [-b dev_sector_size] [-C cache_lines[:line_size]] image\n"),
         progname);
+    tsk_fprintf(stderr, "\t-s: display I/O statistics of the image reads\n");
     tsk_fprintf(stderr, "\t-t: display type only\n");
     tsk_fprintf(stderr,
         "\t-i imgtype: The format of the image file (use '-i list' for list of supported types)\n");
     tsk_fprintf(stderr,
         "\t-b dev_sector_size: The size (in bytes) of the device sectors\n");
+    tsk_fprintf(stderr,
+        "\t-C cache_lines[:line_size]: Image read cache geometry (0 lines disables the cache)\n");
     tsk_fprintf(stderr, "\t-v: verbose output to stderr\n");
     tsk_fprintf(stderr, "\t-V: Print version\n");
 
@@ -35,6 +38,7 @@ int
 main(int argc, char **argv1)
 {
     TSK_IMG_INFO *img;
+    TSK_IMG_OPTIONS img_opts;
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     int ch;
     uint8_t type = 0;
@@ -54,8 +58,9 @@ main(int argc, char **argv1)
 #endif
 
     progname = argv[0];
+    tsk_img_options_init(&img_opts);
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("b:i:tvV"))) > 0) {
+    while ((ch = GETOPT(argc, argv, _TSK_T("b:C:i:stvV"))) > 0) {
         switch (ch) {
         case _TSK_T('?'):
         default:
@@ -72,6 +77,12 @@ main(int argc, char **argv1)
                 usage();
             }
             break;
+        case _TSK_T('C'):
+            if (tsk_img_parse_cache_opt(OPTARG, &img_opts)) {
+                tsk_error_print(stderr);
+                usage();
+            }
+            break;
         case _TSK_T('i'):
             if (TSTRCMP(OPTARG, _TSK_T("list")) == 0) {
                 tsk_img_type_print(stderr);
@@ -85,6 +96,10 @@ main(int argc, char **argv1)
             }
             break;
 
+        case _TSK_T('s'):
+            img_opts.stats = 1;
+            break;
+
         case _TSK_T('t'):
             type = 1;
             break;
@@ -106,8 +121,8 @@ main(int argc, char **argv1)
     }
 
     if ((img =
-            tsk_img_open(argc - OPTIND, &argv[OPTIND], imgtype,
-                ssize)) == NULL) {
+            tsk_img_open_ex(argc - OPTIND, &argv[OPTIND], imgtype,
+                ssize, &img_opts)) == NULL) {
         tsk_error_print(stderr);
         exit(1);
     }
@@ -120,6 +135,9 @@ main(int argc, char **argv1)
         img->imgstat(img, stdout);
     }
 
+    if (img_opts.stats)
+        tsk_img_stats_print(img, stdout);
+
     tsk_img_close(img);
     exit(0);
 }
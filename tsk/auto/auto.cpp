@@ -26,12 +26,14 @@ TskAuto::TskAuto()
     m_tag = TSK_AUTO_TAG;
     m_volFilterFlags = (TSK_VS_PART_FLAG_ENUM)(TSK_VS_PART_FLAG_ALLOC | TSK_VS_PART_FLAG_UNALLOC);
     m_fileFilterFlags = TSK_FS_DIR_WALK_FLAG_RECURSE;
+    m_dirWalkThreads = 1;
     m_stopAllProcessing = false;
     m_internalOpen = false;
     m_curVsPartValid = false;
     m_curVsPartDescr = "";
     m_imageWriterEnabled = false;
     m_imageWriterPath = NULL;
+    m_imageStatsEnabled = false;
 }
 
 
@@ -85,7 +87,7 @@ uint8_t
     m_internalOpen = true;
     m_img_info = tsk_img_open(a_numImg, a_images, a_imgType, a_sSize);
     if (m_img_info)
-        return 0;
+        return startImageStats();
     else
         return 1;
 }
@@ -113,12 +115,31 @@ uint8_t
     m_internalOpen = true;
     m_img_info = tsk_img_open_utf8(a_numImg, a_images, a_imgType, a_sSize);
 	if (m_img_info) {
-		return 0;
+		return startImageStats();
 	}
     else
         return 1;
 }
 
+/**
+ * Starts the I/O statistics of the image that was just opened, if they were
+ * enabled.  The image is closed if they can not be started.
+ * @returns 1 on error (messages were NOT registered), 0 on success
+ */
+uint8_t TskAuto::startImageStats()
+{
+    if (m_imageStatsEnabled == false)
+        return 0;
+
+    if (tsk_img_stats_start(m_img_info,
+            m_imageTracePath.empty() ? NULL : m_imageTracePath.c_str())) {
+        tsk_img_close(m_img_info);
+        m_img_info = NULL;
+        return 1;
+    }
+    return 0;
+}
+
 /**
  * Uses the already opened image for future analysis. This must be called before any
  * of the findFilesInXXX() methods. Note that the TSK_IMG_INFO will not
@@ -178,6 +199,19 @@ void
     m_fileFilterFlags = file_flags;
 }
 
+/**
+ * Set the number of threads that load the directories of each file system.
+ * processFile() is still called from the calling thread and in the same
+ * order as a serial walk. See tsk_fs_dir_walk_parallel() for details.
+ * This must be called before the findFilesInXX() method.
+ * @param a_numThreads Number of threads (1, the default, for a serial walk)
+ */
+void
+ TskAuto::setDirWalkThreads(int a_numThreads)
+{
+    m_dirWalkThreads = a_numThreads;
+}
+
 /**
  * @return The size of the image in bytes or -1 if the 
  * image is not open.
@@ -547,10 +581,20 @@ TSK_RETVAL_ENUM
     else if (retval == TSK_FILTER_SKIP)
         return TSK_OK;
 
-    /* Walk the files, starting at the given inum */
-    if (tsk_fs_dir_walk(a_fs_info, a_inum,
+    /* Walk the files, starting at the given inum.  The parallel walk is
+     * ordered so that processFile() is called from this thread in the
+     * same order as the serial walk. */
+    uint8_t walkRet;
+    if (m_dirWalkThreads > 1)
+        walkRet = tsk_fs_dir_walk_parallel(a_fs_info, a_inum,
             (TSK_FS_DIR_WALK_FLAG_ENUM) (TSK_FS_DIR_WALK_FLAG_RECURSE |
-                m_fileFilterFlags), dirWalkCb, this)) {
+                TSK_FS_DIR_WALK_FLAG_ORDERED | m_fileFilterFlags),
+            dirWalkCb, this, m_dirWalkThreads);
+    else
+        walkRet = tsk_fs_dir_walk(a_fs_info, a_inum,
+            (TSK_FS_DIR_WALK_FLAG_ENUM) (TSK_FS_DIR_WALK_FLAG_RECURSE |
+                m_fileFilterFlags), dirWalkCb, this);
+    if (walkRet) {
 
         tsk_error_set_errstr2(
             "Error walking directory in file system at offset %" PRIuOFF, a_fs_info->offset);
@@ -657,6 +701,23 @@ TskAuto::disableImageWriter() {
 	m_imageWriterEnabled = false;
 }
 
+void
+TskAuto::enableImageStats(const TSK_TCHAR * a_traceFile)
+{
+    m_imageStatsEnabled = true;
+    if (a_traceFile)
+        m_imageTracePath = a_traceFile;
+    else
+        m_imageTracePath.clear();
+}
+
+void
+TskAuto::printImageStats(FILE * hFile)
+{
+    if (m_img_info)
+        tsk_img_stats_print(m_img_info, hFile);
+}
+
 uint8_t TskAuto::registerError() {
     // add to our list of errors
     error_record er;
@@ -95,6 +95,7 @@ class TskAuto {
 
     void setFileFilterFlags(TSK_FS_DIR_WALK_FLAG_ENUM);
     void setVolFilterFlags(TSK_VS_PART_FLAG_ENUM);
+    void setDirWalkThreads(int a_numThreads);
 
     /**
      * TskAuto calls this method before it processes the volume system that is found in an 
@@ -149,6 +150,19 @@ class TskAuto {
 	* Disables image writer
 	*/
 	virtual void disableImageWriter();
+
+    /**
+     * Collects I/O statistics for the images that are opened after this is called.
+     * See tsk_img_stats_start() for details.
+     * @param a_traceFile Path of a file to write a trace of the image reads to (or NULL for no trace)
+     */
+    void enableImageStats(const TSK_TCHAR * a_traceFile = NULL);
+
+    /**
+     * Prints the I/O statistics of the open image (if enableImageStats() was called).
+     * @param hFile Handle to print to
+     */
+    void printImageStats(FILE * hFile);
     
     /**
      * Internal method that TskAuto calls when it encounters issues while processing an image.
@@ -215,6 +229,7 @@ class TskAuto {
   private:
     TSK_VS_PART_FLAG_ENUM m_volFilterFlags;
     TSK_FS_DIR_WALK_FLAG_ENUM m_fileFilterFlags;
+    int m_dirWalkThreads;       ///< Number of threads that load directories (1 for a serial walk)
     
     std::vector<error_record> m_errors;
 
@@ -228,6 +243,7 @@ class TskAuto {
         const TSK_VS_PART_INFO * vs_part, void *ptr);
 
     TSK_RETVAL_ENUM findFilesInFsInt(TSK_FS_INFO *, TSK_INUM_T inum);
+    uint8_t startImageStats();
 
     std::string m_curVsPartDescr; ///< description string of the current volume being processed
     TSK_VS_PART_FLAG_ENUM m_curVsPartFlag; ///< Flag of the current volume being processed
@@ -252,6 +268,8 @@ class TskAuto {
     uint8_t isNonResident(const TSK_FS_ATTR * fs_attr);
 	bool m_imageWriterEnabled;
     TSK_TCHAR * m_imageWriterPath;
+    bool m_imageStatsEnabled;   ///< True if I/O statistics are collected for opened images
+    std::basic_string<TSK_TCHAR> m_imageTracePath;      ///< Trace file for the image reads (empty for no trace)
 
     
     TSK_RETVAL_ENUM processAttributes(TSK_FS_FILE * fs_file,
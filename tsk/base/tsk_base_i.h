@@ -39,6 +39,72 @@ extern "C" {
     extern void tsk_take_lock(tsk_lock_t *);
     extern void tsk_release_lock(tsk_lock_t *);
 
+#ifdef TSK_MULTITHREAD_LIB
+#ifdef TSK_WIN32
+    typedef struct {
+        CONDITION_VARIABLE cond;
+    } tsk_cond_t;
+
+    typedef struct {
+        HANDLE handle;
+    } tsk_thread_t;
+
+#else
+    typedef struct {
+        pthread_cond_t cond;
+    } tsk_cond_t;
+
+    typedef struct {
+        pthread_t thread;
+    } tsk_thread_t;
+#endif
+
+    // single threaded lib
+#else
+    typedef struct {
+        void *dummy;
+    } tsk_cond_t;
+
+    typedef struct {
+        void *dummy;
+    } tsk_thread_t;
+#endif
+
+    typedef void (*TSK_THREAD_FUNC) (void *);
+
+    extern void tsk_init_cond(tsk_cond_t *);
+    extern void tsk_deinit_cond(tsk_cond_t *);
+    extern void tsk_cond_wait(tsk_cond_t *, tsk_lock_t *);
+    extern void tsk_cond_signal(tsk_cond_t *);
+    extern void tsk_cond_broadcast(tsk_cond_t *);
+    extern uint8_t tsk_thread_create(tsk_thread_t *, TSK_THREAD_FUNC,
+        void *);
+    extern void tsk_thread_join(tsk_thread_t *);
+
+/* Atomic loads and stores for values that one thread writes with a lock
+ * held and other threads read without it.  A store makes the writes that
+ * came before it visible to a thread that loads the value. */
+#if defined(TSK_MULTITHREAD_LIB) && defined(_MSC_VER)
+#define tsk_atomic_load_ptr(p) \
+    InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL)
+#define tsk_atomic_store_ptr(p, v) \
+    InterlockedExchangePointer((PVOID volatile *)(p), (PVOID)(v))
+#define tsk_atomic_load_u64(p) \
+    ((uint64_t) InterlockedCompareExchange64((LONGLONG volatile *)(p), 0, 0))
+#define tsk_atomic_store_u64(p, v) \
+    InterlockedExchange64((LONGLONG volatile *)(p), (LONGLONG)(v))
+#elif defined(TSK_MULTITHREAD_LIB) && defined(__GNUC__)
+#define tsk_atomic_load_ptr(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define tsk_atomic_store_ptr(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define tsk_atomic_load_u64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define tsk_atomic_store_u64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define tsk_atomic_load_ptr(p) (*(p))
+#define tsk_atomic_store_ptr(p, v) (*(p) = (v))
+#define tsk_atomic_load_u64(p) (*(p))
+#define tsk_atomic_store_u64(p, v) (*(p) = (v))
+#endif
+
 #ifndef rounddown
 #define rounddown(x, y)	\
     ((((x) % (y)) == 0) ? (x) : \
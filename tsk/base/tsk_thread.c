@@ -0,0 +1,227 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file tsk_thread.c
+ * Contains the condition variable and thread wrappers that are used
+ * by the library's background workers.  Like the locks in tsk_lock.c,
+ * they map to pthreads or Win32 calls.  In a single-threaded build, the
+ * condition variables do nothing and threads can not be created, so
+ * callers must be able to do their work without a worker thread.
+ */
+
+#include "tsk_base_i.h"
+
+#ifdef TSK_MULTITHREAD_LIB
+
+/* Arguments handed to the thread start routine */
+typedef struct {
+    TSK_THREAD_FUNC func;
+    void *arg;
+} TSK_THREAD_START;
+
+#ifdef TSK_WIN32
+
+void
+tsk_init_cond(tsk_cond_t * cond)
+{
+    InitializeConditionVariable(&cond->cond);
+}
+
+void
+tsk_deinit_cond(tsk_cond_t * cond)
+{
+}
+
+void
+tsk_cond_wait(tsk_cond_t * cond, tsk_lock_t * lock)
+{
+    SleepConditionVariableCS(&cond->cond, &lock->critical_section,
+        INFINITE);
+}
+
+void
+tsk_cond_signal(tsk_cond_t * cond)
+{
+    WakeConditionVariable(&cond->cond);
+}
+
+void
+tsk_cond_broadcast(tsk_cond_t * cond)
+{
+    WakeAllConditionVariable(&cond->cond);
+}
+
+static DWORD WINAPI
+tsk_thread_start(LPVOID a_ptr)
+{
+    TSK_THREAD_START start = *(TSK_THREAD_START *) a_ptr;
+    free(a_ptr);
+    start.func(start.arg);
+    return 0;
+}
+
+/**
+ * \internal
+ * Start a new thread that runs func(arg).
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_thread_create(tsk_thread_t * thread, TSK_THREAD_FUNC func, void *arg)
+{
+    TSK_THREAD_START *start;
+
+    if ((start =
+            (TSK_THREAD_START *) tsk_malloc(sizeof(TSK_THREAD_START))) ==
+        NULL)
+        return 1;
+    start->func = func;
+    start->arg = arg;
+
+    thread->handle = CreateThread(NULL, 0, tsk_thread_start, start, 0,
+        NULL);
+    if (thread->handle == NULL) {
+        free(start);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUX_GENERIC);
+        tsk_error_set_errstr("tsk_thread_create: CreateThread failed %d",
+            (int) GetLastError());
+        return 1;
+    }
+    return 0;
+}
+
+void
+tsk_thread_join(tsk_thread_t * thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    thread->handle = NULL;
+}
+
+#else
+
+void
+tsk_init_cond(tsk_cond_t * cond)
+{
+    pthread_cond_init(&cond->cond, NULL);
+}
+
+void
+tsk_deinit_cond(tsk_cond_t * cond)
+{
+    pthread_cond_destroy(&cond->cond);
+}
+
+void
+tsk_cond_wait(tsk_cond_t * cond, tsk_lock_t * lock)
+{
+    pthread_cond_wait(&cond->cond, &lock->mutex);
+}
+
+void
+tsk_cond_signal(tsk_cond_t * cond)
+{
+    pthread_cond_signal(&cond->cond);
+}
+
+void
+tsk_cond_broadcast(tsk_cond_t * cond)
+{
+    pthread_cond_broadcast(&cond->cond);
+}
+
+static void *
+tsk_thread_start(void *a_ptr)
+{
+    TSK_THREAD_START start = *(TSK_THREAD_START *) a_ptr;
+    free(a_ptr);
+    start.func(start.arg);
+    return NULL;
+}
+
+/**
+ * \internal
+ * Start a new thread that runs func(arg).
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_thread_create(tsk_thread_t * thread, TSK_THREAD_FUNC func, void *arg)
+{
+    TSK_THREAD_START *start;
+    int e;
+
+    if ((start =
+            (TSK_THREAD_START *) tsk_malloc(sizeof(TSK_THREAD_START))) ==
+        NULL)
+        return 1;
+    start->func = func;
+    start->arg = arg;
+
+    if ((e = pthread_create(&thread->thread, NULL, tsk_thread_start,
+                start)) != 0) {
+        free(start);
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_AUX_GENERIC);
+        tsk_error_set_errstr("tsk_thread_create: pthread_create failed %d",
+            e);
+        return 1;
+    }
+    return 0;
+}
+
+void
+tsk_thread_join(tsk_thread_t * thread)
+{
+    pthread_join(thread->thread, NULL);
+}
+
+#endif
+
+    // single-threaded
+#else
+
+void
+tsk_init_cond(tsk_cond_t * cond)
+{
+}
+
+void
+tsk_deinit_cond(tsk_cond_t * cond)
+{
+}
+
+void
+tsk_cond_wait(tsk_cond_t * cond, tsk_lock_t * lock)
+{
+}
+
+void
+tsk_cond_signal(tsk_cond_t * cond)
+{
+}
+
+void
+tsk_cond_broadcast(tsk_cond_t * cond)
+{
+}
+
+uint8_t
+tsk_thread_create(tsk_thread_t * thread, TSK_THREAD_FUNC func, void *arg)
+{
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_AUX_GENERIC);
+    tsk_error_set_errstr
+        ("tsk_thread_create: library was built without thread support");
+    return 1;
+}
+
+void
+tsk_thread_join(tsk_thread_t * thread)
+{
+}
+
+#endif
@@ -57,6 +57,29 @@ blkstat_act(const TSK_FS_BLOCK * fs_block, void *ptr)
         }
     }
 
+    /* Print the files that own the block if there is an index of them */
+    if (fs_block->fs_info->block_index) {
+        TSK_FS_BLOCK_INDEX_EXTENT owners[8];
+        ssize_t cnt, i;
+
+        if ((cnt = tsk_fs_block_index_find(fs_block->fs_info->block_index,
+                    fs_block->addr, owners, 8)) < 0)
+            return TSK_WALK_ERROR;
+        if (cnt == 0)
+            tsk_printf("Owner: None\n");
+        for (i = 0; i < cnt && i < 8; i++) {
+            if (TSK_FS_TYPE_ISNTFS(fs_block->fs_info->ftype))
+                tsk_printf("Owner: %" PRIuINUM "-%" PRIu32 "-%" PRIu16,
+                    owners[i].inum, (uint32_t) owners[i].type,
+                    owners[i].id);
+            else
+                tsk_printf("Owner: %" PRIuINUM, owners[i].inum);
+            tsk_printf(" (offset %" PRIdOFF ")\n", owners[i].offset);
+        }
+        if (cnt > 8)
+            tsk_printf("Owner: %" PRIuSIZE " more\n", (size_t) (cnt - 8));
+    }
+
     return TSK_WALK_STOP;
 }
 
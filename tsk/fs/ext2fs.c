@@ -614,6 +614,8 @@ ext2fs_dinode_copy(EXT2FS_INFO * ext2fs, TSK_FS_META * fs_meta,
 
     fs_meta->attr_state = TSK_FS_META_ATTR_EMPTY;
     if (fs_meta->attr) {
+        // keep the runs of the previous inode for reuse
+        tsk_fs_pool_put_meta_runs(fs, fs_meta);
         tsk_fs_attrlist_markunused(fs_meta->attr);
     }
 
@@ -1101,6 +1103,9 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     unsigned int myflags;
     ext2fs_inode *dino_buf = NULL;
     unsigned int size = 0;
+    uint8_t *imap = NULL;       // copy of the inode bitmap of imap_grp
+    EXT2_GRPNUM_T imap_grp = 0;
+    uint8_t imap_loaded = 0;
 
     // clean up any error messages that are lying around
     tsk_error_reset();
@@ -1185,6 +1190,14 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         return 1;
     }
 
+    /* Each walk keeps its own copy of the inode bitmap of the current
+     * group so that walks of different ranges in other threads do not
+     * make each other reload the shared one for every inode. */
+    if ((imap = (uint8_t *) tsk_malloc(fs->block_size)) == NULL) {
+        free(dino_buf);
+        return 1;
+    }
+
     for (inum = start_inum; inum <= end_inum_tmp; inum++) {
         int retval;
         EXT2_GRPNUM_T grp_num;
@@ -1199,13 +1212,20 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
             (EXT2_GRPNUM_T) ((inum - 1) / tsk_getu32(fs->endian,
                 ext2fs->fs->s_inodes_per_group));
 
-        /* lock access to imap_buf */
-        tsk_take_lock(&ext2fs->lock);
+        if ((imap_loaded == 0) || (imap_grp != grp_num)) {
+            /* lock access to imap_buf */
+            tsk_take_lock(&ext2fs->lock);
 
-        if (ext2fs_imap_load(ext2fs, grp_num)) {
+            if (ext2fs_imap_load(ext2fs, grp_num)) {
+                tsk_release_lock(&ext2fs->lock);
+                free(dino_buf);
+                free(imap);
+                return 1;
+            }
+            memcpy(imap, ext2fs->imap_buf, fs->block_size);
             tsk_release_lock(&ext2fs->lock);
-            free(dino_buf);
-            return 1;
+            imap_grp = grp_num;
+            imap_loaded = 1;
         }
         ibase =
             grp_num * tsk_getu32(fs->endian,
@@ -1215,17 +1235,16 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         /*
          * Apply the allocated/unallocated restriction.
          */
-        myflags = (isset(ext2fs->imap_buf, inum - ibase) ?
+        myflags = (isset(imap, inum - ibase) ?
             TSK_FS_META_FLAG_ALLOC : TSK_FS_META_FLAG_UNALLOC);
 
-        tsk_release_lock(&ext2fs->lock);
-
         if ((flags & myflags) != myflags)
             continue;
 
         if (ext2fs_dinode_load(ext2fs, inum, dino_buf)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 1;
         }
 
@@ -1255,6 +1274,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (ext2fs_dinode_copy(ext2fs, fs_file->meta, inum, dino_buf)) {
             tsk_fs_meta_close(fs_file->meta);
             free(dino_buf);
+            free(imap);
             return 1;
         }
 
@@ -1262,11 +1282,13 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 1;
         }
     }
@@ -1280,6 +1302,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 1;
         }
         /* call action */
@@ -1287,11 +1310,13 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
             free(dino_buf);
+            free(imap);
             return 1;
         }
     }
@@ -1303,6 +1328,7 @@ ext2fs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 
     tsk_fs_file_close(fs_file);
     free(dino_buf);
+    free(imap);
 
     return 0;
 }
@@ -1541,7 +1567,7 @@ ext2fs_make_data_run_extent(TSK_FS_INFO * fs_info, TSK_FS_ATTR * fs_attr,
     ext2fs_extent * extent)
 {
     TSK_FS_ATTR_RUN *data_run;
-    data_run = tsk_fs_attr_run_alloc();
+    data_run = tsk_fs_pool_get_run(fs_info);
     if (data_run == NULL) {
         return 1;
     }
@@ -1607,7 +1633,7 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
         return 1;
     }
 
-    data_run = tsk_fs_attr_run_alloc();
+    data_run = tsk_fs_pool_get_run(fs_info);
     if (data_run == NULL) {
         free(buf);
         return 1;
@@ -1616,7 +1642,7 @@ ext2fs_make_data_run_extent_index(TSK_FS_INFO * fs_info,
     data_run->len = fs_blocksize;
 
     if (tsk_fs_attr_add_run(fs_info, fs_attr_extent, data_run)) {
-        tsk_fs_attr_run_free(data_run);
+        tsk_fs_pool_put_runs(fs_info, data_run);
         free(buf);
         return 1;
     }
@@ -3387,7 +3413,7 @@ ext2fs_journ_open(EXT2FS_INFO * ext2fs)
 	ssize_t len;
 
 
-	ext2fs->jinfo = jinfo =	(EXT2FS_JINFO *)tsk_fs_malloc(sizeof(EXT2FS_JINFO));
+	ext2fs->jinfo = jinfo =	(EXT2FS_JINFO *)tsk_malloc(sizeof(EXT2FS_JINFO));
 	if (jinfo == NULL)
 		return 1;
 	
@@ -70,6 +70,160 @@ tsk_fs_attr_run_free(TSK_FS_ATTR_RUN * fs_attr_run)
 }
 
 
+#define TSK_FS_ATTR_RUN_TABLE_MIN 16    ///< Run lists that are shorter than this are searched from the head
+
+/* Array view of the run list of a non-resident attribute.  The list is
+ * still what the file systems build and what callers walk, but reads
+ * find the run that has an offset with a binary search of the ends of the
+ * runs instead of going through the list from its head every time.  This
+ * matters for fragmented files that have many thousands of runs. */
+struct TSK_FS_ATTR_RUN_TABLE {
+    const TSK_FS_ATTR_RUN *head;        // nrd.run when the table was made
+    const TSK_FS_ATTR_RUN *run_end;     // nrd.run_end when the table was made
+    const TSK_FS_ATTR_RUN *tail;        // Last run in the list
+    TSK_DADDR_T tail_end;       // Offset (in blocks) of the end of tail
+    size_t count;               // Number of runs in the arrays (0 if the list is searched from the head)
+    TSK_DADDR_T *ends;          // Offset (in blocks) of the end of each run
+    TSK_FS_ATTR_RUN **runs;     // The runs, in list order
+};
+
+/**
+ * \internal
+ * Free the run table of an attribute.  Called when its run list changes.
+ *
+ * @param a_fs_attr Attribute (its table can be NULL)
+ */
+void
+tsk_fs_attr_run_table_free(TSK_FS_ATTR * a_fs_attr)
+{
+    TSK_FS_ATTR_RUN_TABLE *table = a_fs_attr->run_table;
+
+    if (table == NULL)
+        return;
+    free(table->ends);
+    free(table);
+    a_fs_attr->run_table = NULL;
+}
+
+/* Make the run table of an attribute.
+ * @returns NULL on error */
+static TSK_FS_ATTR_RUN_TABLE *
+fs_attr_run_table_make(const TSK_FS_ATTR * a_fs_attr)
+{
+    TSK_FS_ATTR_RUN_TABLE *table;
+    TSK_FS_ATTR_RUN *run;
+    TSK_DADDR_T prev_end = 0;
+    uint8_t sorted = 1;
+    size_t cnt = 0, i;
+
+    if ((table = (TSK_FS_ATTR_RUN_TABLE *)
+            tsk_malloc(sizeof(TSK_FS_ATTR_RUN_TABLE))) == NULL)
+        return NULL;
+    table->head = a_fs_attr->nrd.run;
+    table->run_end = a_fs_attr->nrd.run_end;
+
+    for (run = a_fs_attr->nrd.run; run; run = run->next) {
+        if (run->offset + run->len < prev_end)
+            sorted = 0;
+        prev_end = run->offset + run->len;
+        table->tail = run;
+        cnt++;
+    }
+    table->tail_end = prev_end;
+
+    // the binary search needs the ends to be in order
+    if ((cnt < TSK_FS_ATTR_RUN_TABLE_MIN) || (sorted == 0))
+        return table;
+
+    if ((table->ends = (TSK_DADDR_T *) tsk_malloc(cnt *
+                (sizeof(TSK_DADDR_T) + sizeof(TSK_FS_ATTR_RUN *)))) ==
+        NULL) {
+        free(table);
+        return NULL;
+    }
+    table->runs = (TSK_FS_ATTR_RUN **) & table->ends[cnt];
+    for (run = a_fs_attr->nrd.run, i = 0; run; run = run->next, i++) {
+        table->ends[i] = run->offset + run->len;
+        table->runs[i] = run;
+    }
+    table->count = cnt;
+    return table;
+}
+
+/* @returns 1 if a run table matches the run list of an attribute */
+static uint8_t
+fs_attr_run_table_valid(const TSK_FS_ATTR * a_fs_attr,
+    const TSK_FS_ATTR_RUN_TABLE * a_table)
+{
+    if ((a_table == NULL) || (a_table->head != a_fs_attr->nrd.run)
+        || (a_table->run_end != a_fs_attr->nrd.run_end))
+        return 0;
+    if (a_table->tail == NULL)
+        return 1;
+    return ((a_table->tail->next == NULL)
+        && (a_table->tail->offset + a_table->tail->len ==
+            a_table->tail_end));
+}
+
+/**
+ * \internal
+ * Find the first run of a non-resident attribute that ends after a block
+ * offset.  This is the run that has the offset if the attribute has it.
+ * Long run lists are searched with the run table of the attribute (which
+ * is made here the first time).  The table is made with the run_table_lock
+ * of the file system held and is then only read, so reads that find a
+ * valid table do not take the lock.
+ *
+ * @param a_fs_attr Non-resident attribute
+ * @param a_blk Offset (in blocks) in the attribute
+ * @returns NULL if no run ends after the offset
+ */
+TSK_FS_ATTR_RUN *
+tsk_fs_attr_run_find(const TSK_FS_ATTR * a_fs_attr, TSK_DADDR_T a_blk)
+{
+    TSK_FS_INFO *fs = a_fs_attr->fs_file->fs_info;
+    TSK_FS_ATTR_RUN_TABLE *table;
+    TSK_FS_ATTR_RUN *run;
+    size_t lo, hi;
+
+    table = (TSK_FS_ATTR_RUN_TABLE *)
+        tsk_atomic_load_ptr(&a_fs_attr->run_table);
+    if (fs_attr_run_table_valid(a_fs_attr, table) == 0) {
+        // reads only have a const attribute, but the table is a cache of its run list
+        TSK_FS_ATTR *fs_attr = (TSK_FS_ATTR *) a_fs_attr;
+
+        tsk_take_lock(&fs->run_table_lock);
+        table = fs_attr->run_table;
+        if (fs_attr_run_table_valid(fs_attr, table) == 0) {
+            tsk_fs_attr_run_table_free(fs_attr);
+            if ((table = fs_attr_run_table_make(fs_attr)) == NULL)
+                tsk_error_reset();      // search the list instead
+            tsk_atomic_store_ptr(&fs_attr->run_table, table);
+        }
+        tsk_release_lock(&fs->run_table_lock);
+    }
+
+    if ((table == NULL) || (table->count == 0)) {
+        for (run = a_fs_attr->nrd.run; run; run = run->next) {
+            if (run->offset + run->len > a_blk)
+                return run;
+        }
+        return NULL;
+    }
+
+    lo = 0;
+    hi = table->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table->ends[mid] <= a_blk)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < table->count) ? table->runs[lo] : NULL;
+}
+
+
 
 
 /** 
@@ -132,6 +286,7 @@ tsk_fs_attr_free(TSK_FS_ATTR * a_fs_attr)
     if (a_fs_attr->nrd.run)
         tsk_fs_attr_run_free(a_fs_attr->nrd.run);
     a_fs_attr->nrd.run = NULL;
+    tsk_fs_attr_run_table_free(a_fs_attr);
 
     free(a_fs_attr->rd.buf);
     a_fs_attr->rd.buf = NULL;
@@ -154,6 +309,7 @@ tsk_fs_attr_clear(TSK_FS_ATTR * a_fs_attr)
 {
     a_fs_attr->size = a_fs_attr->type =
         a_fs_attr->id = a_fs_attr->flags = 0;
+    tsk_fs_attr_run_table_free(a_fs_attr);
     if (a_fs_attr->nrd.run) {
         tsk_fs_attr_run_free(a_fs_attr->nrd.run);
         a_fs_attr->nrd.run = NULL;
@@ -297,6 +453,7 @@ tsk_fs_attr_set_run(TSK_FS_FILE * a_fs_file, TSK_FS_ATTR * a_fs_attr,
         return 1;
     }
 
+    tsk_fs_attr_run_table_free(a_fs_attr);
     a_fs_attr->fs_file = a_fs_file;
     a_fs_attr->flags = (TSK_FS_ATTR_INUSE | TSK_FS_ATTR_NONRES | flags);
     a_fs_attr->type = type;
@@ -500,6 +657,8 @@ tsk_fs_attr_add_run(TSK_FS_INFO * a_fs, TSK_FS_ATTR * a_fs_attr,
         return 1;
     }
 
+    tsk_fs_attr_run_table_free(a_fs_attr);
+
     run_len = 0;
     data_run_cur = a_data_run_new;
     while (data_run_cur) {
@@ -715,6 +874,7 @@ tsk_fs_attr_append_run(TSK_FS_INFO * a_fs, TSK_FS_ATTR * a_fs_attr,
     if ((a_fs_attr == NULL) || (a_data_run == NULL)) {
         return;
     }
+    tsk_fs_attr_run_table_free(a_fs_attr);
 
     if (a_fs_attr->nrd.run == NULL) {
         a_fs_attr->nrd.run = a_data_run;
@@ -826,6 +986,290 @@ tsk_fs_attr_walk_res(const TSK_FS_ATTR * fs_attr,
 }
 
 
+/** \internal
+ * Give the runs of a non-resident attribute that will be read to the image
+ * prefetch worker, so that it can load them while we process earlier data.
+ * Does nothing if the image does not have a prefetch worker.
+ *
+ * @param fs_attr Non-resident attribute that is about to be walked
+ * @param a_len Number of bytes of the attribute that will be read
+ * @returns ID to give to tsk_img_prefetch_cancel() (0 if nothing was given)
+ */
+static uint64_t
+tsk_fs_attr_prefetch_runs(const TSK_FS_ATTR * fs_attr, TSK_OFF_T a_len)
+{
+    TSK_FS_INFO *fs = fs_attr->fs_file->fs_info;
+    TSK_FS_ATTR_RUN *fs_attr_run;
+    TSK_IMG_RANGE *ranges;
+    size_t num_ranges = 0, max_ranges = 0;
+    TSK_OFF_T off = 0;
+    uint64_t id;
+
+    if (fs->img_info->prefetch == NULL)
+        return 0;
+
+    for (fs_attr_run = fs_attr->nrd.run; fs_attr_run;
+        fs_attr_run = fs_attr_run->next)
+        max_ranges++;
+    if (max_ranges == 0)
+        return 0;
+
+    if ((ranges =
+            (TSK_IMG_RANGE *) tsk_malloc(max_ranges *
+                sizeof(TSK_IMG_RANGE))) == NULL) {
+        // it is only a hint
+        tsk_error_reset();
+        return 0;
+    }
+
+    for (fs_attr_run = fs_attr->nrd.run; fs_attr_run && (off < a_len);
+        fs_attr_run = fs_attr_run->next) {
+        TSK_OFF_T run_len = (TSK_OFF_T) fs_attr_run->len * fs->block_size;
+
+        // sparse and filler runs are not read and bad runs are errors later
+        if (((fs_attr_run->flags & (TSK_FS_ATTR_RUN_FLAG_SPARSE |
+                        TSK_FS_ATTR_RUN_FLAG_FILLER)) == 0)
+            && (fs_attr_run->addr + fs_attr_run->len - 1 <= fs->last_block)) {
+            ranges[num_ranges].off =
+                fs->offset + (TSK_OFF_T) fs_attr_run->addr * fs->block_size;
+            ranges[num_ranges].len = (size_t) ((run_len < a_len - off) ?
+                run_len : roundup(a_len - off, fs->block_size));
+            num_ranges++;
+        }
+        off += run_len;
+    }
+
+    id = tsk_img_prefetch(fs->img_info, ranges, num_ranges);
+    free(ranges);
+    return id;
+}
+
+
+/** \internal
+ * Processes a non-resident TSK_FS_ATTR structure for a walk with
+ * TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS.  Each run is read in pieces of up to
+ * fs->walk_chunk_len bytes and the callback is called once per piece with
+ * the address of the first block in the piece.
+ *
+ * @param fs_attr Non-resident data structure to be walked
+ * @param a_flags Flags for walking
+ * @param a_action Callback action
+ * @param a_ptr Pointer to data that is passed to callback
+ * @returns 1 on error or 0 on success
+ */
+static uint8_t
+tsk_fs_attr_walk_nonres_chunks(const TSK_FS_ATTR * fs_attr,
+    TSK_FS_FILE_WALK_FLAG_ENUM a_flags, TSK_FS_FILE_WALK_CB a_action,
+    void *a_ptr)
+{
+    char *buf;
+    size_t buf_len;
+    TSK_DADDR_T buf_blocks;
+    TSK_OFF_T tot_size;
+    TSK_OFF_T read_len;
+    TSK_OFF_T off = 0;
+    TSK_FS_ATTR_RUN *fs_attr_run;
+    int retval;
+    uint32_t skip_remain;
+    TSK_FS_INFO *fs = fs_attr->fs_file->fs_info;
+    uint8_t stop_loop = 0;
+    uint64_t prefetch_id = 0;
+
+    /* if we want the slack space too, then use the allocsize  */
+    if (a_flags & TSK_FS_FILE_WALK_FLAG_SLACK)
+        tot_size = fs_attr->nrd.allocsize;
+    else
+        tot_size = fs_attr->size;
+
+    skip_remain = fs_attr->nrd.skiplen;
+
+    /* The buffer holds a whole number of blocks and is no bigger than the
+     * attribute needs */
+    buf_len = fs->walk_chunk_len;
+    if (buf_len == 0)
+        buf_len = TSK_FS_WALK_CHUNK_LEN_DEFAULT;
+    if ((TSK_OFF_T) buf_len > tot_size + skip_remain)
+        buf_len = (size_t) (tot_size + skip_remain);
+    buf_blocks = buf_len / fs->block_size;
+    if (buf_blocks == 0)
+        buf_blocks = 1;
+    if ((buf =
+            (char *) tsk_malloc((size_t) buf_blocks * fs->block_size)) ==
+        NULL) {
+        return 1;
+    }
+
+    /* data past the initsize is not read unless the slack is wanted */
+    read_len = tot_size;
+    if (((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)
+        && (fs_attr->nrd.initsize < read_len))
+        read_len = fs_attr->nrd.initsize;
+    prefetch_id =
+        tsk_fs_attr_prefetch_runs(fs_attr, read_len + fs_attr->nrd.skiplen);
+
+    /* cycle through the number of runs we have */
+    retval = TSK_WALK_CONT;
+    for (fs_attr_run = fs_attr->nrd.run; fs_attr_run;
+        fs_attr_run = fs_attr_run->next) {
+        TSK_DADDR_T addr, len_idx;
+        uint8_t is_sparse;
+
+        addr = fs_attr_run->addr;
+        is_sparse = (fs_attr_run->flags & (TSK_FS_ATTR_RUN_FLAG_SPARSE |
+                TSK_FS_ATTR_RUN_FLAG_FILLER)) ? 1 : 0;
+
+        if ((fs_attr_run->flags & TSK_FS_ATTR_RUN_FLAG_FILLER)
+            && (tsk_verbose))
+            fprintf(stderr,
+                "tsk_fs_attr_walk_nonres_chunks: File %" PRIuINUM
+                " has FILLER entry, using 0s\n",
+                fs_attr->fs_file->meta->addr);
+
+        /* cycle through the run a piece at a time */
+        for (len_idx = 0; len_idx < fs_attr_run->len;) {
+            TSK_FS_BLOCK_FLAG_ENUM myflags;
+            TSK_DADDR_T num_blocks;
+            size_t piece_len;
+            size_t ret_len;
+            uint8_t past_init;
+
+            /* If the address is too large then give an error */
+            if (addr + len_idx > fs->last_block) {
+                if (fs_attr->fs_file->
+                    meta->flags & TSK_FS_META_FLAG_UNALLOC)
+                    tsk_error_set_errno(TSK_ERR_FS_RECOVER);
+                else
+                    tsk_error_set_errno(TSK_ERR_FS_BLK_NUM);
+                tsk_error_set_errstr
+                    ("Invalid address in run (too large): %" PRIuDADDR "",
+                    addr + len_idx);
+                tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
+                free(buf);
+                return 1;
+            }
+
+            /* Blocks that are all in the skip length are not read */
+            if (skip_remain >= fs->block_size) {
+                num_blocks = skip_remain / fs->block_size;
+                if (num_blocks > fs_attr_run->len - len_idx)
+                    num_blocks = fs_attr_run->len - len_idx;
+                skip_remain -= (uint32_t) (num_blocks * fs->block_size);
+                len_idx += num_blocks;
+                continue;
+            }
+
+            num_blocks = fs_attr_run->len - len_idx;
+            if (num_blocks > buf_blocks)
+                num_blocks = buf_blocks;
+
+            // stop before the first address that is too large so that it gets its own error
+            if (addr + len_idx + num_blocks - 1 > fs->last_block)
+                num_blocks = fs->last_block - (addr + len_idx) + 1;
+
+            /* The blocks that start past the initsize are returned as
+             * sparse, so they go in a piece of their own */
+            past_init = (off > fs_attr->nrd.initsize) ? 1 : 0;
+            if ((past_init == 0)
+                && (off + (TSK_OFF_T) (num_blocks * fs->block_size) -
+                    skip_remain > fs_attr->nrd.initsize)) {
+                TSK_DADDR_T init_blocks =
+                    (TSK_DADDR_T) ((fs_attr->nrd.initsize - off +
+                        skip_remain) / fs->block_size) + 1;
+                if (init_blocks < num_blocks)
+                    num_blocks = init_blocks;
+            }
+            piece_len = (size_t) (num_blocks * fs->block_size);
+
+            // load the buffer
+            if ((is_sparse)
+                || ((off >= fs_attr->nrd.initsize)
+                    && ((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0))) {
+                memset(buf, 0, piece_len);
+            }
+            else {
+                ssize_t cnt;
+
+                // stop at the end of a partial image so that the data before it is returned
+                if ((addr + len_idx <= fs->last_block_act)
+                    && (addr + len_idx + num_blocks - 1 >
+                        fs->last_block_act)) {
+                    num_blocks = fs->last_block_act - (addr + len_idx) + 1;
+                    piece_len = (size_t) (num_blocks * fs->block_size);
+                }
+
+                cnt = tsk_fs_read_block
+                    (fs, addr + len_idx, buf, piece_len);
+                if (cnt != (ssize_t) piece_len) {
+                    if (cnt >= 0) {
+                        tsk_error_reset();
+                        tsk_error_set_errno(TSK_ERR_FS_READ);
+                    }
+                    tsk_error_set_errstr2
+                        ("tsk_fs_file_walk: Error reading %" PRIuDADDR
+                        " blocks at %" PRIuDADDR, num_blocks,
+                        addr + len_idx);
+                    tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
+                    free(buf);
+                    return 1;
+                }
+                if ((off + (TSK_OFF_T) piece_len - skip_remain >
+                        fs_attr->nrd.initsize)
+                    && ((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)) {
+                    size_t init_len =
+                        (size_t) (fs_attr->nrd.initsize - off) +
+                        skip_remain;
+                    memset(&buf[init_len], 0, piece_len - init_len);
+                }
+            }
+
+            /* Do we want to return the full piece, or just the start? */
+            if ((TSK_OFF_T) (piece_len - skip_remain) < tot_size - off)
+                ret_len = piece_len - skip_remain;
+            else
+                ret_len = (size_t) (tot_size - off);
+
+            /* Only do sparse or FILLER clusters if NOSPARSE is not set */
+            if ((is_sparse) || (past_init)) {
+                myflags = fs->block_getflags(fs, 0);
+                myflags |= TSK_FS_BLOCK_FLAG_SPARSE;
+                if ((a_flags & TSK_FS_FILE_WALK_FLAG_NOSPARSE) == 0) {
+                    retval =
+                        a_action(fs_attr->fs_file, off, 0,
+                        &buf[skip_remain], ret_len, myflags, a_ptr);
+                }
+            }
+            else {
+                myflags = fs->block_getflags(fs, addr + len_idx);
+                myflags |= TSK_FS_BLOCK_FLAG_RAW;
+
+                retval =
+                    a_action(fs_attr->fs_file, off, addr + len_idx,
+                    &buf[skip_remain], ret_len, myflags, a_ptr);
+            }
+            off += ret_len;
+            skip_remain = 0;
+            len_idx += num_blocks;
+
+            if ((retval != TSK_WALK_CONT) || (off >= tot_size)) {
+                stop_loop = 1;
+                break;
+            }
+        }
+        if (stop_loop)
+            break;
+    }
+
+    // drop the hints that were not used if the callback stopped early
+    tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
+    free(buf);
+
+    if (retval == TSK_WALK_ERROR)
+        return 1;
+    else
+        return 0;
+}
+
+
 /** \internal
  * Processes a non-resident TSK_FS_ATTR structure and calls the callback with the associated
  * data. 
@@ -843,12 +1287,14 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
 {
     char *buf = NULL;
     TSK_OFF_T tot_size;
+    TSK_OFF_T read_len;
     TSK_OFF_T off = 0;
     TSK_FS_ATTR_RUN *fs_attr_run;
     int retval;
     uint32_t skip_remain;
     TSK_FS_INFO *fs = fs_attr->fs_file->fs_info;
     uint8_t stop_loop = 0;
+    uint64_t prefetch_id = 0;
 
     if ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0) {
         tsk_error_set_errno(TSK_ERR_FS_ARG);
@@ -857,6 +1303,12 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
         return 1;
     }
 
+    /* the per-block loop below is only used if the addresses of each block are wanted */
+    if ((a_flags & TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS)
+        && ((a_flags & TSK_FS_FILE_WALK_FLAG_AONLY) == 0))
+        return tsk_fs_attr_walk_nonres_chunks(fs_attr, a_flags, a_action,
+            a_ptr);
+
     /* if we want the slack space too, then use the allocsize  */
     if (a_flags & TSK_FS_FILE_WALK_FLAG_SLACK)
         tot_size = fs_attr->nrd.allocsize;
@@ -869,6 +1321,15 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
         if ((buf = (char *) tsk_malloc(fs->block_size)) == NULL) {
             return 1;
         }
+
+        /* data past the initsize is not read unless the slack is wanted */
+        read_len = tot_size;
+        if (((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)
+            && (fs_attr->nrd.initsize < read_len))
+            read_len = fs_attr->nrd.initsize;
+        prefetch_id =
+            tsk_fs_attr_prefetch_runs(fs_attr,
+            read_len + fs_attr->nrd.skiplen);
     }
 
     /* cycle through the number of runs we have */
@@ -894,6 +1355,7 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                 tsk_error_set_errstr
                     ("Invalid address in run (too large): %" PRIuDADDR "",
                     addr + len_idx);
+                tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
                 free(buf);
                 return 1;
             }
@@ -935,6 +1397,7 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
                         tsk_error_set_errstr2
                             ("tsk_fs_file_walk: Error reading block at %"
                             PRIuDADDR, addr + len_idx);
+                        tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
                         free(buf);
                         return 1;
                     }
@@ -1003,6 +1466,8 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
             break;
     }
 
+    // drop the hints that were not used if the callback stopped early
+    tsk_img_prefetch_cancel(fs->img_info, prefetch_id);
     free(buf);
 
     if (retval == TSK_WALK_ERROR)
@@ -1015,7 +1480,8 @@ tsk_fs_attr_walk_nonres(const TSK_FS_ATTR * fs_attr,
 /**
  * \ingroup fslib
  * Process an attribute and call a callback function with its contents. The callback will be 
- * called with chunks of data that are fs->block_size or less.  The address given in the callback
+ * called with chunks of data that are fs->block_size or less (or fs->walk_chunk_len or less for
+ * non-resident data if TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS is given).  The address given in the callback
  * will be correct only for raw files (when the raw file contents were stored in the block).  For
  * compressed and sparse attributes, the address may be zero.
  *
@@ -1083,10 +1549,77 @@ tsk_fs_attr_walk(const TSK_FS_ATTR * a_fs_attr,
 
 
 
+#define FS_ATTR_READ_VECS   16  ///< Number of ranges that a read can have before the plan is allocated
+
+/* The ranges of the file system that a read of a non-resident attribute
+ * needs, in the order of the buffer. */
+typedef struct {
+    TSK_IMG_IOVEC *vecs;
+    size_t used;
+    size_t alloc;
+    TSK_IMG_IOVEC local[FS_ATTR_READ_VECS];
+} FS_ATTR_READ_PLAN;
+
+/* Add a range to a read plan.  It is merged with the last range if it
+ * follows it both on disk and in the buffer (such as when two runs of the
+ * attribute are next to each other).
+ * @returns 1 on error */
+static uint8_t
+fs_attr_read_plan_add(FS_ATTR_READ_PLAN * a_plan, TSK_OFF_T a_off,
+    char *a_buf, size_t a_len)
+{
+    TSK_IMG_IOVEC *vec;
+
+    if (a_plan->used) {
+        vec = &a_plan->vecs[a_plan->used - 1];
+        if ((vec->off + (TSK_OFF_T) vec->len == a_off)
+            && (vec->buf + vec->len == a_buf)) {
+            vec->len += a_len;
+            return 0;
+        }
+    }
+
+    if (a_plan->used == a_plan->alloc) {
+        size_t cnt = a_plan->alloc * 2;
+        TSK_IMG_IOVEC *vecs;
+
+        if (a_plan->vecs == a_plan->local) {
+            if ((vecs = (TSK_IMG_IOVEC *)
+                    tsk_malloc(cnt * sizeof(TSK_IMG_IOVEC))) == NULL)
+                return 1;
+            memcpy(vecs, a_plan->local,
+                a_plan->used * sizeof(TSK_IMG_IOVEC));
+        }
+        else if ((vecs = (TSK_IMG_IOVEC *) tsk_realloc(a_plan->vecs,
+                    cnt * sizeof(TSK_IMG_IOVEC))) == NULL)
+            return 1;
+        a_plan->vecs = vecs;
+        a_plan->alloc = cnt;
+    }
+
+    vec = &a_plan->vecs[a_plan->used++];
+    vec->off = a_off;
+    vec->buf = a_buf;
+    vec->len = a_len;
+    vec->cnt = 0;
+    return 0;
+}
+
+static void
+fs_attr_read_plan_free(FS_ATTR_READ_PLAN * a_plan)
+{
+    if (a_plan->vecs != a_plan->local)
+        free(a_plan->vecs);
+}
+
 /**
  * \ingroup fslib
  * Read the contents of a given attribute using a typical read() type interface.
  * 0s are returned for missing runs. 
+ * For non-resident attributes, the ranges of all of the runs that the read
+ * covers are found first and are read from the image with one vectored read
+ * (see tsk_img_readv()).  Runs that are next to each other on disk are
+ * merged into one range and sparse and uninitialized data is not read.
  * 
  * @param a_fs_attr The attribute to read.
  * @param a_offset The byte offset to start reading from.
@@ -1150,6 +1683,8 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
         size_t byteoffset_toread;       // byte offset in blkoffset_toread of where we want to start reading from
         ssize_t len_remain;      // length remaining to copy
         size_t len_toread;      // length total to copy
+        FS_ATTR_READ_PLAN plan;         // ranges of the file system to read
+        size_t i;
 
         if (((a_flags & TSK_FS_FILE_READ_FLAG_SLACK)
                 && (a_offset >= a_fs_attr->nrd.allocsize))
@@ -1182,9 +1717,14 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
             memset(&a_buf[len_toread], 0, a_len - len_toread);
 
         len_remain = len_toread;
-
-        // cycle through the runs until we find the one where our offset starts
-        for (data_run_cur = a_fs_attr->nrd.run; data_run_cur && len_remain > 0;
+        plan.vecs = plan.local;
+        plan.used = 0;
+        plan.alloc = FS_ATTR_READ_VECS;
+
+        // start at the run that has our offset and go through the runs after it
+        for (data_run_cur =
+            tsk_fs_attr_run_find(a_fs_attr, blkoffset_toread);
+            data_run_cur && len_remain > 0;
             data_run_cur = data_run_cur->next) {
 
             TSK_DADDR_T blkoffset_inrun;
@@ -1248,7 +1788,8 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
             // we are going to read some data
             else {
                 TSK_OFF_T fs_offset_b;
-                ssize_t cnt;
+                TSK_OFF_T data_off;
+                size_t len_data = len_inrun;
 
                 // calculate the byte offset in the file system that we want to read from
                 fs_offset_b =
@@ -1258,36 +1799,23 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
                 // add the byte offset in the block
                 fs_offset_b += byteoffset_toread;
 
-                cnt =
-                    tsk_fs_read(fs, fs_offset_b,
-                    &a_buf[len_toread - len_remain], len_inrun);
-                if (cnt != (ssize_t)len_inrun) {
-                    if (cnt >= 0) {
-                        tsk_error_reset();
-                        tsk_error_set_errno(TSK_ERR_FS_READ);
-                    }
-                    tsk_error_set_errstr2
-                        ("tsk_fs_attr_read_type: offset: %" PRIuOFF
-                        "  Len: %" PRIuSIZE "", fs_offset_b, len_inrun);
-                    return cnt;
-                }
-
-                // see if part of the data is in the non-initialized space
-                if (((TSK_OFF_T) ((data_run_cur->offset +
-                                blkoffset_inrun) * fs->block_size +
-                            byteoffset_toread + len_inrun) >
+                // the part of the data in the non-initialized space gets 0s and is not read
+                data_off = (TSK_OFF_T) ((data_run_cur->offset +
+                        blkoffset_inrun) * fs->block_size +
+                    byteoffset_toread);
+                if ((data_off + (TSK_OFF_T) len_inrun >
                         a_fs_attr->nrd.initsize)
                     && ((a_flags & TSK_FS_FILE_READ_FLAG_SLACK) == 0)) {
-
-                    size_t uninit_off = (size_t) (a_fs_attr->nrd.initsize -
-                        ((data_run_cur->offset +
-                                blkoffset_inrun) * fs->block_size +
-                            byteoffset_toread));
-
-                    memset(&a_buf[len_toread - len_remain + uninit_off], 0,
-                        len_inrun - uninit_off);
+                    len_data = (size_t) (a_fs_attr->nrd.initsize - data_off);
+                    memset(&a_buf[len_toread - len_remain + len_data], 0,
+                        len_inrun - len_data);
                 }
 
+                if (fs_attr_read_plan_add(&plan, fs_offset_b,
+                        &a_buf[len_toread - len_remain], len_data)) {
+                    fs_attr_read_plan_free(&plan);
+                    return -1;
+                }
             }
 
             len_remain -= len_inrun;
@@ -1295,6 +1823,33 @@ tsk_fs_attr_read(const TSK_FS_ATTR * a_fs_attr, TSK_OFF_T a_offset,
             // reset this in case we need to also read from the next run 
             byteoffset_toread = 0;
         }
+
+        // read the ranges (the image layer also merges the ones that are close together)
+        if (plan.used == 1)
+            plan.vecs[0].cnt =
+                tsk_fs_read(fs, plan.vecs[0].off, plan.vecs[0].buf,
+                plan.vecs[0].len);
+        else if (plan.used > 1)
+            tsk_fs_readv(fs, plan.vecs, plan.used);
+
+        for (i = 0; i < plan.used; i++) {
+            ssize_t cnt = plan.vecs[i].cnt;
+
+            if (cnt != (ssize_t) plan.vecs[i].len) {
+                if (cnt >= 0) {
+                    tsk_error_reset();
+                    tsk_error_set_errno(TSK_ERR_FS_READ);
+                }
+                tsk_error_set_errstr2
+                    ("tsk_fs_attr_read_type: offset: %" PRIuOFF
+                    "  Len: %" PRIuSIZE "", plan.vecs[i].off,
+                    plan.vecs[i].len);
+                fs_attr_read_plan_free(&plan);
+                return cnt;
+            }
+        }
+        fs_attr_read_plan_free(&plan);
+
         return (ssize_t) (len_toread - len_remain);
     }
 
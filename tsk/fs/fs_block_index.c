@@ -0,0 +1,747 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file fs_block_index.c
+ * Reverse index of which files own which blocks.  tsk_fs_ifind_data()
+ * answers "which inode has block X" by walking every inode and every block
+ * of every file, which takes minutes on large file systems for each query.
+ * The index is built with one metadata walk, can be saved to a file and
+ * loaded again, and answers the same question with a binary search.
+ *
+ * The index is an array of extents (a run of blocks in one attribute)
+ * sorted by their first block.  Extents of different files can overlap
+ * (unallocated inodes often still point to blocks that were reused), so
+ * the array is searched as an implicit interval tree: the middle of each
+ * range of the array is the root of the range and max_end has the largest
+ * end of any extent under it.
+ */
+
+#include "tsk_fs_i.h"
+
+#define TSK_FS_BLOCK_INDEX_MAGIC "TSKBIX01"     ///< First 8 bytes of a saved index
+#define TSK_FS_BLOCK_INDEX_HDR_LEN  48
+#define TSK_FS_BLOCK_INDEX_REC_LEN  48
+
+struct TSK_FS_BLOCK_INDEX {
+    TSK_FS_BLOCK_INDEX_EXTENT *extents; // Sorted by addr and then order
+    TSK_DADDR_T *max_end;       // Largest addr + len in the tree under each index
+    size_t count;
+    size_t alloc;
+
+    /* The file system that the index was made for */
+    TSK_FS_TYPE_ENUM ftype;
+    unsigned int block_size;
+    TSK_OFF_T offset;
+    TSK_DADDR_T last_block;
+    TSK_INUM_T last_inum;
+};
+
+typedef struct {
+    TSK_FS_BLOCK_INDEX *index;
+    TSK_FS_BLOCK_INDEX_EXTENT cur;      // Extent being grown (len is 0 if none)
+    uint64_t order;             // Order of the attribute being indexed
+    uint8_t failed;
+} BLOCK_INDEX_BUILD;
+
+
+/** \ingroup fslib
+ * Free a block index.
+ * @param a_index Index to free (can be NULL)
+ */
+void
+tsk_fs_block_index_free(TSK_FS_BLOCK_INDEX * a_index)
+{
+    if (a_index == NULL)
+        return;
+    free(a_index->extents);
+    free(a_index->max_end);
+    free(a_index);
+}
+
+static TSK_FS_BLOCK_INDEX *
+block_index_alloc(TSK_FS_INFO * a_fs)
+{
+    TSK_FS_BLOCK_INDEX *index;
+
+    if ((index = (TSK_FS_BLOCK_INDEX *)
+            tsk_malloc(sizeof(TSK_FS_BLOCK_INDEX))) == NULL)
+        return NULL;
+    index->ftype = a_fs->ftype;
+    index->block_size = a_fs->block_size;
+    index->offset = a_fs->offset;
+    index->last_block = a_fs->last_block;
+    index->last_inum = a_fs->last_inum;
+    return index;
+}
+
+/* Add the extent that is being grown to the index (if there is one).
+ * @returns 1 on error */
+static uint8_t
+block_index_flush(BLOCK_INDEX_BUILD * a_build)
+{
+    TSK_FS_BLOCK_INDEX *index = a_build->index;
+
+    if (a_build->cur.len == 0)
+        return 0;
+
+    if (index->count == index->alloc) {
+        size_t cnt = index->alloc ? index->alloc * 2 : 1024;
+        TSK_FS_BLOCK_INDEX_EXTENT *extents;
+
+        if ((extents = (TSK_FS_BLOCK_INDEX_EXTENT *)
+                tsk_realloc(index->extents,
+                    cnt * sizeof(TSK_FS_BLOCK_INDEX_EXTENT))) == NULL)
+            return 1;
+        index->extents = extents;
+        index->alloc = cnt;
+    }
+    index->extents[index->count++] = a_build->cur;
+    a_build->cur.len = 0;
+    return 0;
+}
+
+/* Add one block of the attribute that is being indexed.  It is added to
+ * the current extent if it follows it on disk and in the attribute.
+ * @returns 1 on error */
+static uint8_t
+block_index_add(BLOCK_INDEX_BUILD * a_build, TSK_DADDR_T a_addr,
+    TSK_OFF_T a_off)
+{
+    TSK_FS_BLOCK_INDEX_EXTENT *cur = &a_build->cur;
+
+    if ((cur->len) && (cur->addr + cur->len == a_addr)
+        && (cur->offset + (TSK_OFF_T) (cur->len *
+                a_build->index->block_size) == a_off)) {
+        cur->len++;
+        return 0;
+    }
+
+    if (block_index_flush(a_build))
+        return 1;
+    cur->addr = a_addr;
+    cur->len = 1;
+    cur->offset = a_off;
+    return 0;
+}
+
+/* file walk callback for the attributes that have their own walk function */
+static TSK_WALK_RET_ENUM
+block_index_walk_act(TSK_FS_FILE * a_fs_file, TSK_OFF_T a_off,
+    TSK_DADDR_T a_addr, char *a_buf, size_t a_size,
+    TSK_FS_BLOCK_FLAG_ENUM a_flags, void *a_ptr)
+{
+    BLOCK_INDEX_BUILD *build = (BLOCK_INDEX_BUILD *) a_ptr;
+
+    /* Ignore sparse blocks because they do not reside on disk */
+    if (a_flags & TSK_FS_BLOCK_FLAG_SPARSE)
+        return TSK_WALK_CONT;
+
+    if (block_index_add(build, a_addr, a_off)) {
+        build->failed = 1;
+        return TSK_WALK_ERROR;
+    }
+    return TSK_WALK_CONT;
+}
+
+/* Add the blocks of a non-resident attribute.  This goes through the runs
+ * the same way that tsk_fs_attr_walk() does with TSK_FS_FILE_WALK_FLAG_AONLY
+ * and TSK_FS_FILE_WALK_FLAG_SLACK so that the index gives the same answers
+ * as tsk_fs_ifind_data() without it, but it does not look up the flags of
+ * every block.
+ * @returns 1 on error */
+static uint8_t
+block_index_add_runs(BLOCK_INDEX_BUILD * a_build,
+    const TSK_FS_ATTR * a_fs_attr)
+{
+    TSK_FS_INFO *fs = a_fs_attr->fs_file->fs_info;
+    TSK_FS_ATTR_RUN *fs_attr_run;
+    TSK_OFF_T tot_size = a_fs_attr->nrd.allocsize;
+    TSK_OFF_T off = 0;
+    uint32_t skip_remain = a_fs_attr->nrd.skiplen;
+
+    for (fs_attr_run = a_fs_attr->nrd.run; fs_attr_run;
+        fs_attr_run = fs_attr_run->next) {
+        TSK_DADDR_T len_idx;
+
+        for (len_idx = 0; len_idx < fs_attr_run->len; len_idx++) {
+            TSK_DADDR_T addr = fs_attr_run->addr + len_idx;
+            TSK_OFF_T ret_len;
+
+            // the walk stops at an invalid address
+            if (addr > fs->last_block)
+                return 0;
+
+            if (skip_remain >= fs->block_size) {
+                skip_remain -= fs->block_size;
+                continue;
+            }
+
+            ret_len = fs->block_size - skip_remain;
+            if (ret_len > tot_size - off)
+                ret_len = tot_size - off;
+
+            if (((fs_attr_run->flags & (TSK_FS_ATTR_RUN_FLAG_SPARSE |
+                                TSK_FS_ATTR_RUN_FLAG_FILLER)) == 0)
+                && (off <= a_fs_attr->nrd.initsize)) {
+                if (block_index_add(a_build, addr, off))
+                    return 1;
+            }
+
+            off += ret_len;
+            skip_remain = 0;
+            if (off >= tot_size)
+                return 0;
+        }
+    }
+    return 0;
+}
+
+/* meta walk callback that adds the blocks of each file */
+static TSK_WALK_RET_ENUM
+block_index_build_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    BLOCK_INDEX_BUILD *build = (BLOCK_INDEX_BUILD *) a_ptr;
+    int i, cnt;
+
+    cnt = tsk_fs_file_attr_getsize(a_fs_file);
+    for (i = 0; i < cnt; i++) {
+        const TSK_FS_ATTR *fs_attr = tsk_fs_file_attr_get_idx(a_fs_file, i);
+        uint8_t retval;
+
+        if ((fs_attr == NULL) || ((fs_attr->flags & TSK_FS_ATTR_NONRES) == 0))
+            continue;
+
+        build->cur.len = 0;
+        build->cur.inum = a_fs_file->meta->addr;
+        build->cur.type = fs_attr->type;
+        build->cur.id = fs_attr->id;
+        build->cur.order = build->order++;
+
+        if (fs_attr->flags & TSK_FS_ATTR_COMP)
+            retval = tsk_fs_attr_walk(fs_attr,
+                (TSK_FS_FILE_WALK_FLAG_ENUM) (TSK_FS_FILE_WALK_FLAG_AONLY |
+                    TSK_FS_FILE_WALK_FLAG_SLACK), block_index_walk_act,
+                build);
+        else
+            retval = block_index_add_runs(build, fs_attr);
+
+        if (build->failed)
+            return TSK_WALK_ERROR;
+        if (retval) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_fs_block_index_build: Error walking file %"
+                    PRIuINUM " Attribute: %i", a_fs_file->meta->addr, i);
+            /* Ignore these errors (the blocks before the error are kept) */
+            tsk_error_reset();
+        }
+
+        if (block_index_flush(build)) {
+            build->failed = 1;
+            return TSK_WALK_ERROR;
+        }
+    }
+    return TSK_WALK_CONT;
+}
+
+static int
+block_index_extent_cmp(const void *a_a, const void *a_b)
+{
+    const TSK_FS_BLOCK_INDEX_EXTENT *a = (const TSK_FS_BLOCK_INDEX_EXTENT *) a_a;
+    const TSK_FS_BLOCK_INDEX_EXTENT *b = (const TSK_FS_BLOCK_INDEX_EXTENT *) a_b;
+
+    if (a->addr != b->addr)
+        return (a->addr < b->addr) ? -1 : 1;
+    if (a->order != b->order)
+        return (a->order < b->order) ? -1 : 1;
+    return 0;
+}
+
+/* Fill in max_end for the tree in [a_lo, a_hi).
+ * @returns The largest end in the tree (0 if it is empty) */
+static TSK_DADDR_T
+block_index_tree(TSK_FS_BLOCK_INDEX * a_index, size_t a_lo, size_t a_hi)
+{
+    size_t mid;
+    TSK_DADDR_T end, sub;
+
+    if (a_lo >= a_hi)
+        return 0;
+
+    mid = a_lo + (a_hi - a_lo) / 2;
+    end = a_index->extents[mid].addr + a_index->extents[mid].len;
+    if ((sub = block_index_tree(a_index, a_lo, mid)) > end)
+        end = sub;
+    if ((sub = block_index_tree(a_index, mid + 1, a_hi)) > end)
+        end = sub;
+    a_index->max_end[mid] = end;
+    return end;
+}
+
+/* Sort the extents and make the search tree.
+ * @returns 1 on error */
+static uint8_t
+block_index_finish(TSK_FS_BLOCK_INDEX * a_index)
+{
+    if (a_index->count == 0)
+        return 0;
+
+    qsort(a_index->extents, a_index->count,
+        sizeof(TSK_FS_BLOCK_INDEX_EXTENT), block_index_extent_cmp);
+
+    if ((a_index->max_end = (TSK_DADDR_T *)
+            tsk_malloc(a_index->count * sizeof(TSK_DADDR_T))) == NULL)
+        return 1;
+    block_index_tree(a_index, 0, a_index->count);
+    return 0;
+}
+
+/** \ingroup fslib
+ * Build the reverse index of the blocks of a file system with one walk
+ * of its metadata.  The index has the blocks of the non-resident
+ * attributes of allocated and unallocated files (including their slack
+ * space).  Use tsk_fs_block_index_save() to keep it for later.
+ * @param a_fs File system to index
+ * @returns NULL on error
+ */
+TSK_FS_BLOCK_INDEX *
+tsk_fs_block_index_build(TSK_FS_INFO * a_fs)
+{
+    BLOCK_INDEX_BUILD build;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_build: invalid file system");
+        return NULL;
+    }
+
+    memset(&build, 0, sizeof(build));
+    if ((build.index = block_index_alloc(a_fs)) == NULL)
+        return NULL;
+
+    if ((tsk_fs_meta_walk(a_fs, a_fs->first_inum, a_fs->last_inum,
+                (TSK_FS_META_FLAG_ENUM) (TSK_FS_META_FLAG_ALLOC |
+                    TSK_FS_META_FLAG_UNALLOC), block_index_build_act,
+                &build)) || (build.failed)
+        || (block_index_finish(build.index))) {
+        tsk_fs_block_index_free(build.index);
+        return NULL;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "tsk_fs_block_index_build: %" PRIuSIZE " extents\n",
+            build.index->count);
+    return build.index;
+}
+
+/* Collect the extents in the tree in [a_lo, a_hi) that have a_addr */
+static uint8_t
+block_index_search(const TSK_FS_BLOCK_INDEX * a_index, size_t a_lo,
+    size_t a_hi, TSK_DADDR_T a_addr, TSK_FS_BLOCK_INDEX_EXTENT ** a_hits,
+    size_t * a_hits_used, size_t * a_hits_alloc)
+{
+    while (a_lo < a_hi) {
+        size_t mid = a_lo + (a_hi - a_lo) / 2;
+        const TSK_FS_BLOCK_INDEX_EXTENT *ext = &a_index->extents[mid];
+
+        if (a_index->max_end[mid] <= a_addr)
+            return 0;
+
+        if (block_index_search(a_index, a_lo, mid, a_addr, a_hits,
+                a_hits_used, a_hits_alloc))
+            return 1;
+
+        // everything from here on starts after the address
+        if (ext->addr > a_addr)
+            return 0;
+
+        if (a_addr < ext->addr + ext->len) {
+            if (*a_hits_used == *a_hits_alloc) {
+                size_t cnt = *a_hits_alloc ? *a_hits_alloc * 2 : 8;
+                TSK_FS_BLOCK_INDEX_EXTENT *hits;
+
+                if ((hits = (TSK_FS_BLOCK_INDEX_EXTENT *)
+                        tsk_realloc(*a_hits,
+                            cnt * sizeof(TSK_FS_BLOCK_INDEX_EXTENT))) ==
+                    NULL)
+                    return 1;
+                *a_hits = hits;
+                *a_hits_alloc = cnt;
+            }
+            (*a_hits)[(*a_hits_used)++] = *ext;
+        }
+
+        a_lo = mid + 1;
+    }
+    return 0;
+}
+
+static int
+block_index_order_cmp(const void *a_a, const void *a_b)
+{
+    const TSK_FS_BLOCK_INDEX_EXTENT *a = (const TSK_FS_BLOCK_INDEX_EXTENT *) a_a;
+    const TSK_FS_BLOCK_INDEX_EXTENT *b = (const TSK_FS_BLOCK_INDEX_EXTENT *) a_b;
+
+    if (a->order != b->order)
+        return (a->order < b->order) ? -1 : 1;
+    return 0;
+}
+
+/** \ingroup fslib
+ * Find the files that own a block.  There is one result for each attribute
+ * that has the block, in the order that a walk of the metadata finds them
+ * (by metadata address).  The offset of each result is changed to be the
+ * offset of the block in the attribute and its address and length are set
+ * to the block.
+ *
+ * @param a_index Index to search
+ * @param a_addr Address of the block
+ * @param a_owners [out] Buffer for the results (can be NULL if a_len is 0)
+ * @param a_len Number of results that fit in a_owners
+ * @returns Number of owners (which can be more than a_len, in which case
+ * only the first a_len are copied) or -1 on error
+ */
+ssize_t
+tsk_fs_block_index_find(const TSK_FS_BLOCK_INDEX * a_index,
+    TSK_DADDR_T a_addr, TSK_FS_BLOCK_INDEX_EXTENT * a_owners, size_t a_len)
+{
+    TSK_FS_BLOCK_INDEX_EXTENT *hits = NULL;
+    size_t hits_used = 0, hits_alloc = 0;
+    size_t i, cnt;
+
+    if (a_index == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_find: NULL index");
+        return -1;
+    }
+
+    if (block_index_search(a_index, 0, a_index->count, a_addr, &hits,
+            &hits_used, &hits_alloc)) {
+        free(hits);
+        return -1;
+    }
+
+    // an attribute can have the same block more than once
+    if (hits_used > 1)
+        qsort(hits, hits_used, sizeof(TSK_FS_BLOCK_INDEX_EXTENT),
+            block_index_order_cmp);
+
+    for (i = 0, cnt = 0; i < hits_used; i++) {
+        if ((i > 0) && (hits[i].order == hits[i - 1].order))
+            continue;
+        if (cnt < a_len) {
+            a_owners[cnt] = hits[i];
+            a_owners[cnt].offset +=
+                (TSK_OFF_T) ((a_addr - hits[i].addr) * a_index->block_size);
+            a_owners[cnt].addr = a_addr;
+            a_owners[cnt].len = 1;
+        }
+        cnt++;
+    }
+    free(hits);
+    return (ssize_t) cnt;
+}
+
+/** \ingroup fslib
+ * @param a_index Index to count (can be NULL)
+ * @returns Number of extents in a block index
+ */
+size_t
+tsk_fs_block_index_count(const TSK_FS_BLOCK_INDEX * a_index)
+{
+    return a_index ? a_index->count : 0;
+}
+
+
+static void
+block_index_put64(uint8_t * a_buf, uint64_t a_val)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+        a_buf[i] = (uint8_t) (a_val >> (8 * i));
+}
+
+static void
+block_index_put32(uint8_t * a_buf, uint32_t a_val)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        a_buf[i] = (uint8_t) (a_val >> (8 * i));
+}
+
+static FILE *
+block_index_fopen(const TSK_TCHAR * a_path, int a_write)
+{
+#ifdef TSK_WIN32
+    return _wfopen(a_path, a_write ? L"wb" : L"rb");
+#else
+    return fopen(a_path, a_write ? "wb" : "rb");
+#endif
+}
+
+/** \ingroup fslib
+ * Save a block index to a file so that it can be loaded with
+ * tsk_fs_block_index_load() instead of being built again.  The file is
+ * little endian and can be moved between systems.
+ * @param a_index Index to save
+ * @param a_path Path of the file to create
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_block_index_save(const TSK_FS_BLOCK_INDEX * a_index,
+    const TSK_TCHAR * a_path)
+{
+    uint8_t buf[TSK_FS_BLOCK_INDEX_HDR_LEN];
+    FILE *hFile;
+    size_t i;
+
+    if ((a_index == NULL) || (a_path == NULL)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_save: NULL argument");
+        return 1;
+    }
+
+    if ((hFile = block_index_fopen(a_path, 1)) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WRITE);
+        tsk_error_set_errstr("tsk_fs_block_index_save: error creating %"
+            PRIttocTSK " (%s)", a_path, strerror(errno));
+        return 1;
+    }
+
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, TSK_FS_BLOCK_INDEX_MAGIC, 8);
+    block_index_put32(&buf[8], (uint32_t) a_index->ftype);
+    block_index_put32(&buf[12], a_index->block_size);
+    block_index_put64(&buf[16], (uint64_t) a_index->offset);
+    block_index_put64(&buf[24], a_index->last_block);
+    block_index_put64(&buf[32], a_index->last_inum);
+    block_index_put64(&buf[40], a_index->count);
+    if (fwrite(buf, TSK_FS_BLOCK_INDEX_HDR_LEN, 1, hFile) != 1)
+        goto on_error;
+
+    for (i = 0; i < a_index->count; i++) {
+        const TSK_FS_BLOCK_INDEX_EXTENT *ext = &a_index->extents[i];
+
+        memset(buf, 0, sizeof(buf));
+        block_index_put64(&buf[0], ext->addr);
+        block_index_put64(&buf[8], ext->len);
+        block_index_put64(&buf[16], (uint64_t) ext->offset);
+        block_index_put64(&buf[24], ext->inum);
+        block_index_put64(&buf[32], ext->order);
+        block_index_put32(&buf[40], (uint32_t) ext->type);
+        buf[44] = (uint8_t) ext->id;
+        buf[45] = (uint8_t) (ext->id >> 8);
+        if (fwrite(buf, TSK_FS_BLOCK_INDEX_REC_LEN, 1, hFile) != 1)
+            goto on_error;
+    }
+
+    if (fclose(hFile) == 0)
+        return 0;
+    hFile = NULL;
+
+  on_error:
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_FS_WRITE);
+    tsk_error_set_errstr("tsk_fs_block_index_save: error writing %"
+        PRIttocTSK " (%s)", a_path, strerror(errno));
+    if (hFile)
+        fclose(hFile);
+    return 1;
+}
+
+/** \ingroup fslib
+ * Load a block index that was saved with tsk_fs_block_index_save().  The
+ * index must have been made for the same file system.
+ * @param a_fs File system that the index is for
+ * @param a_path Path of the file to load
+ * @returns NULL on error
+ */
+TSK_FS_BLOCK_INDEX *
+tsk_fs_block_index_load(TSK_FS_INFO * a_fs, const TSK_TCHAR * a_path)
+{
+    uint8_t buf[TSK_FS_BLOCK_INDEX_HDR_LEN];
+    TSK_FS_BLOCK_INDEX *index;
+    FILE *hFile;
+    uint64_t cnt;
+    size_t i;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG) || (a_path == NULL)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_load: invalid argument");
+        return NULL;
+    }
+
+    if ((hFile = block_index_fopen(a_path, 0)) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_READ);
+        tsk_error_set_errstr("tsk_fs_block_index_load: error opening %"
+            PRIttocTSK " (%s)", a_path, strerror(errno));
+        return NULL;
+    }
+
+    if ((index = block_index_alloc(a_fs)) == NULL) {
+        fclose(hFile);
+        return NULL;
+    }
+
+    if (fread(buf, TSK_FS_BLOCK_INDEX_HDR_LEN, 1, hFile) != 1)
+        goto on_short;
+
+    if (memcmp(buf, TSK_FS_BLOCK_INDEX_MAGIC, 8)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_MAGIC);
+        tsk_error_set_errstr("tsk_fs_block_index_load: %" PRIttocTSK
+            " is not a block index", a_path);
+        goto on_error;
+    }
+
+    if ((tsk_getu32(TSK_LIT_ENDIAN, &buf[8]) != (uint32_t) index->ftype)
+        || (tsk_getu32(TSK_LIT_ENDIAN, &buf[12]) != index->block_size)
+        || (tsk_getu64(TSK_LIT_ENDIAN, &buf[16]) != (uint64_t) index->offset)
+        || (tsk_getu64(TSK_LIT_ENDIAN, &buf[24]) != index->last_block)
+        || (tsk_getu64(TSK_LIT_ENDIAN, &buf[32]) != index->last_inum)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_load: %" PRIttocTSK
+            " was made for a different file system", a_path);
+        goto on_error;
+    }
+
+    cnt = tsk_getu64(TSK_LIT_ENDIAN, &buf[40]);
+    if (cnt > SIZE_MAX / sizeof(TSK_FS_BLOCK_INDEX_EXTENT))
+        goto on_corrupt;
+    if (cnt) {
+        if ((index->extents = (TSK_FS_BLOCK_INDEX_EXTENT *)
+                tsk_malloc((size_t) cnt *
+                    sizeof(TSK_FS_BLOCK_INDEX_EXTENT))) == NULL)
+            goto on_error;
+        index->alloc = (size_t) cnt;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        TSK_FS_BLOCK_INDEX_EXTENT *ext = &index->extents[i];
+
+        if (fread(buf, TSK_FS_BLOCK_INDEX_REC_LEN, 1, hFile) != 1)
+            goto on_short;
+        ext->addr = tsk_getu64(TSK_LIT_ENDIAN, &buf[0]);
+        ext->len = tsk_getu64(TSK_LIT_ENDIAN, &buf[8]);
+        ext->offset = (TSK_OFF_T) tsk_getu64(TSK_LIT_ENDIAN, &buf[16]);
+        ext->inum = tsk_getu64(TSK_LIT_ENDIAN, &buf[24]);
+        ext->order = tsk_getu64(TSK_LIT_ENDIAN, &buf[32]);
+        ext->type =
+            (TSK_FS_ATTR_TYPE_ENUM) tsk_getu32(TSK_LIT_ENDIAN, &buf[40]);
+        ext->id = tsk_getu16(TSK_LIT_ENDIAN, &buf[44]);
+
+        // the search needs the extents to be sorted and in the file system
+        if ((ext->len == 0) || (ext->addr > index->last_block)
+            || (ext->len > index->last_block - ext->addr + 1)
+            || ((i > 0) && (block_index_extent_cmp(ext - 1, ext) > 0)))
+            goto on_corrupt;
+        index->count++;
+    }
+    fclose(hFile);
+    hFile = NULL;
+
+    if (index->count) {
+        if ((index->max_end = (TSK_DADDR_T *)
+                tsk_malloc(index->count * sizeof(TSK_DADDR_T))) == NULL)
+            goto on_error;
+        block_index_tree(index, 0, index->count);
+    }
+    return index;
+
+  on_short:
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_FS_READ);
+    tsk_error_set_errstr("tsk_fs_block_index_load: error reading %"
+        PRIttocTSK, a_path);
+    goto on_error;
+
+  on_corrupt:
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_FS_CORRUPT);
+    tsk_error_set_errstr("tsk_fs_block_index_load: invalid extent in %"
+        PRIttocTSK, a_path);
+
+  on_error:
+    if (hFile)
+        fclose(hFile);
+    tsk_fs_block_index_free(index);
+    return NULL;
+}
+
+/** \ingroup fslib
+ * Load the block index in a file or, if the file does not exist, build
+ * the index and save it to the file.  This is what the command line tools
+ * use so that the first query builds the index and the others reuse it.
+ * @param a_fs File system that the index is for
+ * @param a_path Path of the index file
+ * @returns NULL on error
+ */
+TSK_FS_BLOCK_INDEX *
+tsk_fs_block_index_open(TSK_FS_INFO * a_fs, const TSK_TCHAR * a_path)
+{
+    TSK_FS_BLOCK_INDEX *index;
+    FILE *hFile;
+
+    if ((hFile = block_index_fopen(a_path, 0)) != NULL) {
+        fclose(hFile);
+        return tsk_fs_block_index_load(a_fs, a_path);
+    }
+    if (errno != ENOENT)
+        return tsk_fs_block_index_load(a_fs, a_path);
+
+    if ((index = tsk_fs_block_index_build(a_fs)) == NULL)
+        return NULL;
+    if (tsk_fs_block_index_save(index, a_path)) {
+        tsk_fs_block_index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/** \ingroup fslib
+ * Give a block index to a file system so that tsk_fs_ifind_data() and
+ * tsk_fs_blkstat() use it.  The file system frees the index when it is
+ * closed.  Do this before the file system is used by other threads.
+ * @param a_fs File system
+ * @param a_index Index that was made for a_fs (or NULL to stop using one)
+ * @returns 1 on error (a_index is not taken) and 0 on success
+ */
+uint8_t
+tsk_fs_block_index_attach(TSK_FS_INFO * a_fs, TSK_FS_BLOCK_INDEX * a_index)
+{
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr("tsk_fs_block_index_attach: invalid file system");
+        return 1;
+    }
+
+    if ((a_index) && ((a_index->ftype != a_fs->ftype)
+            || (a_index->block_size != a_fs->block_size)
+            || (a_index->offset != a_fs->offset)
+            || (a_index->last_block != a_fs->last_block)
+            || (a_index->last_inum != a_fs->last_inum))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_block_index_attach: index was made for a different file system");
+        return 1;
+    }
+
+    if (a_fs->block_index != a_index)
+        tsk_fs_block_index_free(a_fs->block_index);
+    a_fs->block_index = a_index;
+    return 0;
+}
@@ -18,6 +18,283 @@
 #include "tsk_fatfs.h"
 
 
+/* Number of names that a directory needs before an index is built
+ * to find duplicates.  Smaller directories are scanned. */
+#define TSK_FS_DIR_INDEX_MIN   256
+
+typedef struct {
+    uint32_t hash;              // tsk_fs_dir_hash() of the name
+    size_t idx;                 // Index in names[] plus 1 (0 if the slot is empty)
+} TSK_FS_DIR_INDEX_SLOT;
+
+/** \internal
+ * Open addressing (linear probing) table of the names in a TSK_FS_DIR,
+ * keyed by the meta address and the hash of the name.  It stores indexes
+ * into names[] so that it stays valid when names[] is reallocated.
+ */
+struct TSK_FS_DIR_INDEX {
+    TSK_FS_DIR_INDEX_SLOT *slots;
+    size_t slots_alloc;         // Number of slots (a power of 2)
+    size_t slots_used;
+};
+
+static size_t
+tsk_fs_dir_index_pos(const TSK_FS_DIR_INDEX * a_index,
+    TSK_INUM_T a_addr, uint32_t a_hash)
+{
+    uint64_t key = ((uint64_t) a_addr ^ ((uint64_t) a_hash << 32) ^ a_hash)
+        * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (key ^ (key >> 29)) & (a_index->slots_alloc - 1);
+}
+
+/** \internal
+ * Free the name index of a directory.  This must be called when
+ * names[] is changed other than by tsk_fs_dir_add(); the index will
+ * be rebuilt when it is next needed.
+ */
+static void
+tsk_fs_dir_index_free(TSK_FS_DIR * a_fs_dir)
+{
+    if (a_fs_dir->name_index == NULL)
+        return;
+    free(a_fs_dir->name_index->slots);
+    free(a_fs_dir->name_index);
+    a_fs_dir->name_index = NULL;
+}
+
+/* Put an entry in the table, which must have a free slot. */
+static void
+tsk_fs_dir_index_put(TSK_FS_DIR_INDEX * a_index, TSK_INUM_T a_addr,
+    uint32_t a_hash, size_t a_idx)
+{
+    size_t pos = tsk_fs_dir_index_pos(a_index, a_addr, a_hash);
+
+    while (a_index->slots[pos].idx)
+        pos = (pos + 1) & (a_index->slots_alloc - 1);
+    a_index->slots[pos].hash = a_hash;
+    a_index->slots[pos].idx = a_idx + 1;
+    a_index->slots_used++;
+}
+
+/** \internal
+ * Add names[a_idx] to the index of a directory, growing the table
+ * so that it stays at most half full.
+ * @returns 1 on error (and the index is freed) and 0 on success
+ */
+static uint8_t
+tsk_fs_dir_index_add(TSK_FS_DIR * a_fs_dir, size_t a_idx, uint32_t a_hash)
+{
+    TSK_FS_DIR_INDEX *index = a_fs_dir->name_index;
+
+    if ((index->slots_used + 1) * 2 > index->slots_alloc) {
+        TSK_FS_DIR_INDEX_SLOT *old_slots = index->slots;
+        size_t old_alloc = index->slots_alloc;
+        size_t i;
+
+        if ((index->slots = (TSK_FS_DIR_INDEX_SLOT *)
+                tsk_malloc(old_alloc * 2 *
+                    sizeof(TSK_FS_DIR_INDEX_SLOT))) == NULL) {
+            index->slots = old_slots;
+            tsk_fs_dir_index_free(a_fs_dir);
+            return 1;
+        }
+        index->slots_alloc = old_alloc * 2;
+        index->slots_used = 0;
+        for (i = 0; i < old_alloc; i++) {
+            if (old_slots[i].idx == 0)
+                continue;
+            tsk_fs_dir_index_put(index,
+                a_fs_dir->names[old_slots[i].idx - 1].meta_addr,
+                old_slots[i].hash, old_slots[i].idx - 1);
+        }
+        free(old_slots);
+    }
+
+    tsk_fs_dir_index_put(index, a_fs_dir->names[a_idx].meta_addr, a_hash,
+        a_idx);
+    return 0;
+}
+
+/** \internal
+ * Build the name index of a directory from its current names.
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+tsk_fs_dir_index_build(TSK_FS_DIR * a_fs_dir)
+{
+    TSK_FS_DIR_INDEX *index;
+    size_t i;
+
+    if ((index = (TSK_FS_DIR_INDEX *)
+            tsk_malloc(sizeof(TSK_FS_DIR_INDEX))) == NULL)
+        return 1;
+
+    index->slots_alloc = 1024;
+    while (index->slots_alloc < a_fs_dir->names_used * 4)
+        index->slots_alloc *= 2;
+    if ((index->slots = (TSK_FS_DIR_INDEX_SLOT *)
+            tsk_malloc(index->slots_alloc *
+                sizeof(TSK_FS_DIR_INDEX_SLOT))) == NULL) {
+        free(index);
+        return 1;
+    }
+    a_fs_dir->name_index = index;
+
+    for (i = 0; i < a_fs_dir->names_used; i++) {
+        tsk_fs_dir_index_put(index, a_fs_dir->names[i].meta_addr,
+            tsk_fs_dir_hash(a_fs_dir->names[i].name), i);
+    }
+    return 0;
+}
+
+/** \internal
+ * Find the entry in a directory with the given meta address and name
+ * using its name index.
+ * @param a_hash tsk_fs_dir_hash() of a_name
+ * @returns Index in names[] or names_used if there is no such entry
+ */
+static size_t
+tsk_fs_dir_index_find(const TSK_FS_DIR * a_fs_dir, TSK_INUM_T a_addr,
+    const char *a_name, uint32_t a_hash)
+{
+    const TSK_FS_DIR_INDEX *index = a_fs_dir->name_index;
+    size_t pos = tsk_fs_dir_index_pos(index, a_addr, a_hash);
+
+    for (; index->slots[pos].idx;
+        pos = (pos + 1) & (index->slots_alloc - 1)) {
+        const TSK_FS_NAME *fs_name =
+            &a_fs_dir->names[index->slots[pos].idx - 1];
+
+        if ((index->slots[pos].hash == a_hash)
+            && (fs_name->meta_addr == a_addr)
+            && (strcmp(fs_name->name, a_name) == 0))
+            return index->slots[pos].idx - 1;
+    }
+    return a_fs_dir->names_used;
+}
+
+
+/* Size of the first block of a name arena.  Each new block is twice
+ * as big as the last, up to TSK_FS_DIR_ARENA_MAX. */
+#define TSK_FS_DIR_ARENA_MIN   1024
+#define TSK_FS_DIR_ARENA_MAX   (64 * 1024)
+
+/** \internal
+ * Block of the string arena that holds the names of a TSK_FS_DIR.
+ * The strings are allocated from the front block and are all freed
+ * at once when the directory is reset or closed.  The data follows
+ * the header.
+ */
+struct TSK_FS_DIR_ARENA {
+    TSK_FS_DIR_ARENA *next;     // Previous (full) block
+    size_t size;                // Bytes of data in this block
+    size_t used;                // Bytes of data that have been handed out
+};
+
+/** \internal
+ * Free the name arena of a directory.  The names in names[] must have
+ * been cleared first.
+ */
+static void
+tsk_fs_dir_arena_free(TSK_FS_DIR * a_fs_dir)
+{
+    while (a_fs_dir->name_arena) {
+        TSK_FS_DIR_ARENA *next = a_fs_dir->name_arena->next;
+        free(a_fs_dir->name_arena);
+        a_fs_dir->name_arena = next;
+    }
+}
+
+/** \internal
+ * Copy a string into the name arena of a directory.
+ * @returns NULL on error
+ */
+static char *
+tsk_fs_dir_arena_strdup(TSK_FS_DIR * a_fs_dir, const char *a_str,
+    size_t a_len)
+{
+    TSK_FS_DIR_ARENA *arena = a_fs_dir->name_arena;
+    char *str;
+
+    if ((arena == NULL) || (arena->size - arena->used < a_len)) {
+        size_t size = TSK_FS_DIR_ARENA_MIN;
+        if (arena) {
+            size = arena->size * 2;
+            if (size > TSK_FS_DIR_ARENA_MAX)
+                size = TSK_FS_DIR_ARENA_MAX;
+        }
+        if (size < a_len)
+            size = a_len;
+
+        if ((arena = (TSK_FS_DIR_ARENA *)
+                tsk_malloc(sizeof(TSK_FS_DIR_ARENA) + size)) == NULL)
+            return NULL;
+        arena->size = size;
+        arena->next = a_fs_dir->name_arena;
+        a_fs_dir->name_arena = arena;
+    }
+
+    str = (char *) (arena + 1) + arena->used;
+    arena->used += a_len;
+    memcpy(str, a_str, a_len);
+    return str;
+}
+
+/** \internal
+ * Clears the names in a name structure of a directory when we are reshuffling
+ * things around.  The strings are in the name arena of the directory, so
+ * they are not freed here.
+ */
+static void 
+tsk_fs_dir_free_name_internal(TSK_FS_NAME *fs_name) 
+{
+    fs_name->name = NULL;
+    fs_name->name_size = 0;
+    fs_name->shrt_name = NULL;
+    fs_name->shrt_name_size = 0;
+}
+
+/** \internal
+ * Copy a name into a directory.  This is tsk_fs_name_copy() except that the
+ * strings are put in the name arena of the directory.  Any strings that
+ * a_fs_name_to had are dropped (they stay in the arena until it is freed).
+ * @returns 1 on error
+ */
+static uint8_t
+tsk_fs_dir_name_copy(TSK_FS_DIR * a_fs_dir, TSK_FS_NAME * a_fs_name_to,
+    const TSK_FS_NAME * a_fs_name_from)
+{
+    tsk_fs_dir_free_name_internal(a_fs_name_to);
+
+    if (a_fs_name_from->name) {
+        size_t len = strlen(a_fs_name_from->name) + 1;
+        if ((a_fs_name_to->name =
+                tsk_fs_dir_arena_strdup(a_fs_dir, a_fs_name_from->name,
+                    len)) == NULL)
+            return 1;
+        a_fs_name_to->name_size = len;
+    }
+
+    if (a_fs_name_from->shrt_name) {
+        size_t len = strlen(a_fs_name_from->shrt_name) + 1;
+        if ((a_fs_name_to->shrt_name =
+                tsk_fs_dir_arena_strdup(a_fs_dir,
+                    a_fs_name_from->shrt_name, len)) == NULL)
+            return 1;
+        a_fs_name_to->shrt_name_size = len;
+    }
+
+    a_fs_name_to->meta_addr = a_fs_name_from->meta_addr;
+    a_fs_name_to->meta_seq = a_fs_name_from->meta_seq;
+    a_fs_name_to->par_addr = a_fs_name_from->par_addr;
+    a_fs_name_to->par_seq = a_fs_name_from->par_seq;
+    a_fs_name_to->type = a_fs_name_from->type;
+    a_fs_name_to->flags = a_fs_name_from->flags;
+
+    return 0;
+}
+
+
 /** \internal
 * Allocate a FS_DIR structure to load names into.
 *
@@ -95,6 +372,8 @@ tsk_fs_dir_realloc(TSK_FS_DIR * a_fs_dir, size_t a_cnt)
 void
 tsk_fs_dir_reset(TSK_FS_DIR * a_fs_dir)
 {
+    size_t i;
+
     if ((a_fs_dir == NULL) || (a_fs_dir->tag != TSK_FS_DIR_TAG))
         return;
 
@@ -102,6 +381,11 @@ tsk_fs_dir_reset(TSK_FS_DIR * a_fs_dir)
         tsk_fs_file_close(a_fs_dir->fs_file);
         a_fs_dir->fs_file = NULL;
     }
+    tsk_fs_dir_index_free(a_fs_dir);
+    for (i = 0; i < a_fs_dir->names_used; i++) {
+        tsk_fs_dir_free_name_internal(&a_fs_dir->names[i]);
+    }
+    tsk_fs_dir_arena_free(a_fs_dir);
     a_fs_dir->names_used = 0;
     a_fs_dir->addr = 0;
     a_fs_dir->seq = 0;
@@ -121,6 +405,11 @@ tsk_fs_dir_copy(const TSK_FS_DIR * a_src_dir, TSK_FS_DIR * a_dst_dir)
 {
     size_t i;
 
+    tsk_fs_dir_index_free(a_dst_dir);
+    for (i = 0; i < a_dst_dir->names_used; i++) {
+        tsk_fs_dir_free_name_internal(&a_dst_dir->names[i]);
+    }
+    tsk_fs_dir_arena_free(a_dst_dir);
     a_dst_dir->names_used = 0;
 
     // make sure we got the room
@@ -130,7 +419,8 @@ tsk_fs_dir_copy(const TSK_FS_DIR * a_src_dir, TSK_FS_DIR * a_dst_dir)
     }
 
     for (i = 0; i < a_src_dir->names_used; i++) {
-        if (tsk_fs_name_copy(&a_dst_dir->names[i], &a_src_dir->names[i]))
+        if (tsk_fs_dir_name_copy(a_dst_dir, &a_dst_dir->names[i],
+                &a_src_dir->names[i]))
             return 1;
     }
 
@@ -155,6 +445,32 @@ tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash)
     size_t i;
     uint8_t bestFound = 0;
 
+    if ((a_fs_dir->name_index == NULL)
+        && (a_fs_dir->names_used >= TSK_FS_DIR_INDEX_MIN)) {
+        // fall back to the scan if there is no memory for the index
+        if (tsk_fs_dir_index_build(a_fs_dir))
+            tsk_error_reset();
+    }
+
+    if (a_fs_dir->name_index) {
+        const TSK_FS_DIR_INDEX *index = a_fs_dir->name_index;
+        size_t pos = tsk_fs_dir_index_pos(index, meta_addr, hash);
+
+        for (; index->slots[pos].idx;
+            pos = (pos + 1) & (index->slots_alloc - 1)) {
+            const TSK_FS_NAME *fs_name =
+                &a_fs_dir->names[index->slots[pos].idx - 1];
+
+            if ((index->slots[pos].hash == hash)
+                && (fs_name->meta_addr == meta_addr)) {
+                bestFound = fs_name->flags;
+                if (bestFound == TSK_FS_NAME_FLAG_ALLOC)
+                    break;
+            }
+        }
+        return bestFound;
+    }
+
     for (i = 0; i < a_fs_dir->names_used; i++) {
         if (meta_addr == a_fs_dir->names[i].meta_addr) {
             if (hash == tsk_fs_dir_hash(a_fs_dir->names[i].name)) {
@@ -170,27 +486,6 @@ tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash)
     return bestFound;
 }
 
-/** \internal
- * Frees the allocated memory in a name structure when we are reshuffling
- * things around. Does not free the outer TSK_FS_NAME structure.  Just the names
- * inside of it.
- */
-static void 
-tsk_fs_dir_free_name_internal(TSK_FS_NAME *fs_name) 
-{
-    if (fs_name->name) {
-	    free(fs_name->name);
-	    fs_name->name = NULL;
-	    fs_name->name_size = 0;
-    }
-    if (fs_name->shrt_name) {
-        free(fs_name->shrt_name);
-        fs_name->shrt_name = NULL;
-        fs_name->shrt_name_size = 0;
-    }
-}
-
-
 /** \internal
  * Add a FS_DENT structure to a FS_DIR structure by copying its
  * contents into the internal buffer. Checks for
@@ -204,41 +499,55 @@ tsk_fs_dir_add(TSK_FS_DIR * a_fs_dir, const TSK_FS_NAME * a_fs_name)
 {
     TSK_FS_NAME *fs_name_dest = NULL;
     size_t i;
+    uint32_t hash = 0;
 
     /* see if we already have it in the buffer / queue
      * We skip this check for FAT because it will always fail because two entries
-     * never have the same meta address. */
+     * never have the same meta address.  Large directories use the name
+     * index instead of scanning all of the names. */
     // @@@ We could do something more efficient here too with orphan files because we do not 
     // need to check the contents of that directory either and this takes a lot of time on those
     // large images.
     if (TSK_FS_TYPE_ISFAT(a_fs_dir->fs_info->ftype) == 0) {
-        for (i = 0; i < a_fs_dir->names_used; i++) {
-            if ((a_fs_name->meta_addr == a_fs_dir->names[i].meta_addr) &&
-                (strcmp(a_fs_name->name, a_fs_dir->names[i].name) == 0)) {
+        if ((a_fs_dir->name_index == NULL)
+            && (a_fs_dir->names_used >= TSK_FS_DIR_INDEX_MIN)) {
+            if (tsk_fs_dir_index_build(a_fs_dir))
+                return 1;
+        }
 
-                if (tsk_verbose)
-                    tsk_fprintf(stderr,
-                        "tsk_fs_dir_add: removing duplicate entry: %s (%"
-                        PRIuINUM ")\n", a_fs_name->name,
-                        a_fs_name->meta_addr);
-
-                /* We do not check type because then we cannot detect NTFS orphan file
-                 * duplicates that are added as "-/r" while a similar entry exists as "r/r"
-                 (a_fs_name->type == a_fs_dir->names[i].type)) { */
-
-                // if the one in the list is unalloc and we have an alloc, replace it
-                if ((a_fs_dir->names[i].flags & TSK_FS_NAME_FLAG_UNALLOC)
-                    && (a_fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
-                    fs_name_dest = &a_fs_dir->names[i];
-
-                    // free the memory - not the most efficient, but prevents
-                    // duplicate code.
-                    tsk_fs_dir_free_name_internal(fs_name_dest);
+        if (a_fs_dir->name_index) {
+            hash = tsk_fs_dir_hash(a_fs_name->name);
+            i = tsk_fs_dir_index_find(a_fs_dir, a_fs_name->meta_addr,
+                a_fs_name->name, hash);
+        }
+        else {
+            for (i = 0; i < a_fs_dir->names_used; i++) {
+                if ((a_fs_name->meta_addr == a_fs_dir->names[i].meta_addr) &&
+                    (strcmp(a_fs_name->name, a_fs_dir->names[i].name) == 0))
                     break;
-                }
-                else {
-                    return 0;
-                }
+            }
+        }
+
+        if (i < a_fs_dir->names_used) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_fs_dir_add: removing duplicate entry: %s (%"
+                    PRIuINUM ")\n", a_fs_name->name,
+                    a_fs_name->meta_addr);
+
+            /* We do not check type because then we cannot detect NTFS orphan file
+             * duplicates that are added as "-/r" while a similar entry exists as "r/r"
+             (a_fs_name->type == a_fs_dir->names[i].type)) { */
+
+            // if the one in the list is unalloc and we have an alloc, replace it
+            if ((a_fs_dir->names[i].flags & TSK_FS_NAME_FLAG_UNALLOC)
+                && (a_fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
+                // The index entry stays valid because the address
+                // and name are the same.
+                fs_name_dest = &a_fs_dir->names[i];
+            }
+            else {
+                return 0;
             }
         }
     }
@@ -251,10 +560,20 @@ tsk_fs_dir_add(TSK_FS_DIR * a_fs_dir, const TSK_FS_NAME * a_fs_name)
         }
 
         fs_name_dest = &a_fs_dir->names[a_fs_dir->names_used++];
-    }
+        if (tsk_fs_dir_name_copy(a_fs_dir, fs_name_dest, a_fs_name))
+            return 1;
 
-    if (tsk_fs_name_copy(fs_name_dest, a_fs_name))
+        if (a_fs_dir->name_index) {
+            if (hash == 0)
+                hash = tsk_fs_dir_hash(a_fs_name->name);
+            if (tsk_fs_dir_index_add(a_fs_dir, a_fs_dir->names_used - 1,
+                    hash))
+                return 1;
+        }
+    }
+    else if (tsk_fs_dir_name_copy(a_fs_dir, fs_name_dest, a_fs_name)) {
         return 1;
+    }
 
     // add the parent address
     if (a_fs_dir->addr) {
@@ -352,15 +671,13 @@ tsk_fs_dir_open(TSK_FS_INFO * a_fs, const char *a_dir)
 void
 tsk_fs_dir_close(TSK_FS_DIR * a_fs_dir)
 {
-    size_t i;
     if ((a_fs_dir == NULL) || (a_fs_dir->tag != TSK_FS_DIR_TAG)) {
         return;
     }
 
-    for (i = 0; i < a_fs_dir->names_used; i++) {
-        tsk_fs_dir_free_name_internal(&a_fs_dir->names[i]);
-    }
     free(a_fs_dir->names);
+    tsk_fs_dir_arena_free(a_fs_dir);
+    tsk_fs_dir_index_free(a_fs_dir);
 
     if (a_fs_dir->fs_file) {
         tsk_fs_file_close(a_fs_dir->fs_file);
@@ -506,41 +823,159 @@ typedef struct {
     /* Set to one to collect inode info that can be used for orphan listing */
     uint8_t save_inum_named;
 
-    /* We keep list_inum_named inside DENT_DINFO so different threads
+    /* We keep inum_named inside DENT_DINFO so different threads
      * have their own copies.  On successful completion of the dir
      * walk we reassigned ownership of this pointer into the shared
-     * TSK_FS_INFO list_inum_named field.  We're trading off the extra
+     * TSK_FS_INFO inum_named field.  We're trading off the extra
      * work in each thread for cleaner locking code.
      */
-    TSK_LIST *list_inum_named;
+    TSK_FS_INUM_SET *inum_named;
 
 } DENT_DINFO;
 
 
 /**
- * Saves the list_inum_named from DENT_DINFO to FS_INFO.
+ * Saves an inum_named set that a walk collected (from DENT_DINFO or
+ * a parallel walk) to FS_INFO.
  * This can be called from a couple of places, so the logic
  * is here in a single method.
  */
 static void
-save_inum_named(TSK_FS_INFO *a_fs, DENT_DINFO *dinfo) {
+save_inum_named(TSK_FS_INFO *a_fs, TSK_FS_INUM_SET **a_inum_named) {
 
     /* We finished the dir walk successfully, so reassign
-     * ownership of the dinfo's list_inum_named to the shared
-     * list_inum_named in TSK_FS_INFO, under a lock, if
+     * ownership of the walk's inum_named to the shared
+     * inum_named in TSK_FS_INFO, under a lock, if
      * another thread hasn't already done so.
      */
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if (a_fs->list_inum_named == NULL) {
-        a_fs->list_inum_named = dinfo->list_inum_named;
+    if (a_fs->inum_named == NULL) {
+        a_fs->inum_named = *a_inum_named;
+    }
+    else {
+        tsk_fs_inum_set_free(*a_inum_named);
+    }
+    *a_inum_named = NULL;
+    tsk_release_lock(&a_fs->list_inum_named_lock);
+}
+
+
+/** \ingroup fslib
+ * Returns the list of unallocated inodes that are pointed to by a file
+ * name (the list_inum_named field of TSK_FS_INFO).  TSK itself keeps them
+ * in a set, so the list is only made the first time that it is asked for.
+ * It is available after a full directory walk from the root directory or
+ * after looking for orphan files.
+ * @param a_fs File system
+ * @returns The list, which is owned by a_fs (NULL if there is none yet or
+ * on error)
+ */
+TSK_LIST *
+tsk_fs_dir_get_list_inum_named(TSK_FS_INFO * a_fs)
+{
+    TSK_LIST *list_inum_named = NULL;
+    TSK_INUM_T inum;
+    uint8_t more;
+
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    if ((a_fs->list_inum_named != NULL) || (a_fs->inum_named == NULL)) {
+        list_inum_named = a_fs->list_inum_named;
+        tsk_release_lock(&a_fs->list_inum_named_lock);
+        return list_inum_named;
+    }
+
+    /* The set is walked in increasing order, which tsk_list_add()
+     * adds to the head of the list without searching it. */
+    more = tsk_fs_inum_set_next(a_fs->inum_named, 0, &inum);
+    while (more) {
+        if (tsk_list_add(&list_inum_named, inum)) {
+            tsk_release_lock(&a_fs->list_inum_named_lock);
+            tsk_list_free(list_inum_named);
+            return NULL;
+        }
+        more = (inum != ~((TSK_INUM_T) 0))
+            && tsk_fs_inum_set_next(a_fs->inum_named, inum + 1, &inum);
+    }
+    a_fs->list_inum_named = list_inum_named;
+    tsk_release_lock(&a_fs->list_inum_named_lock);
+    return list_inum_named;
+}
+
+
+/** \internal
+ * Saves the set of unallocated and used metadata addresses that a file
+ * system collected while it scanned all of its metadata, so that
+ * tsk_fs_dir_find_orphans() does not need to walk the metadata again.
+ * Takes ownership of the set.
+ * @param a_fs File system
+ * @param a_candidates Set to save (set to NULL on return)
+ */
+void
+tsk_fs_dir_save_orphan_candidates(TSK_FS_INFO * a_fs,
+    TSK_FS_INUM_SET ** a_candidates)
+{
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    if (a_fs->orphan_candidates == NULL) {
+        a_fs->orphan_candidates = *a_candidates;
     }
     else {
-        tsk_list_free(dinfo->list_inum_named);
+        tsk_fs_inum_set_free(*a_candidates);
     }
-    dinfo->list_inum_named = NULL;
+    *a_candidates = NULL;
     tsk_release_lock(&a_fs->list_inum_named_lock);
 }
 
+/* Returns 1 if a dir walk should recurse into the given file:
+ * - Both dir entry and inode have DIR type (or name is undefined)
+ * - Recurse flag is set
+ * - dir entry is allocated OR both are unallocated
+ * - not one of the '.' or '..' entries
+ * - A Non-Orphan Dir or the Orphan Dir with the NOORPHAN flag not set.
+ */
+static uint8_t
+dir_walk_should_recurse(TSK_FS_INFO * a_fs, TSK_FS_FILE * a_fs_file,
+    TSK_FS_DIR_WALK_FLAG_ENUM a_flags)
+{
+    if ((TSK_FS_IS_DIR_NAME(a_fs_file->name->type)
+            || (a_fs_file->name->type == TSK_FS_NAME_TYPE_UNDEF))
+        && (a_fs_file->meta)
+        && (TSK_FS_IS_DIR_META(a_fs_file->meta->type))
+        && (a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE)
+        && ((a_fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC)
+            || ((a_fs_file->name->flags & TSK_FS_NAME_FLAG_UNALLOC)
+                && (a_fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC))
+        )
+        && (!TSK_FS_ISDOT(a_fs_file->name->name))
+        && ((a_fs_file->name->meta_addr != TSK_FS_ORPHANDIR_INUM(a_fs))
+            || ((a_flags & TSK_FS_DIR_WALK_FLAG_NOORPHAN) == 0))
+        )
+        return 1;
+    return 0;
+}
+
+/* Load the metadata of a directory entry for a dir walk.  The
+ * TSK_FS_META structure is taken from the pool of the file system so
+ * that it (and its attributes) are reused from an earlier entry.
+ * Errors are printed if verbose and then cleared. */
+static void
+dir_walk_load_meta(TSK_FS_INFO * a_fs, TSK_FS_FILE * a_fs_file)
+{
+    a_fs_file->meta = tsk_fs_pool_get_meta(a_fs);
+
+    if (a_fs->file_add_meta(a_fs, a_fs_file, a_fs_file->name->meta_addr)) {
+        if (tsk_verbose)
+            tsk_error_print(stderr);
+        tsk_error_reset();
+    }
+    /* Some lookups (NTFS) close the structure that they allocated when
+     * the sequence does not match the name, but only reset one that was
+     * passed in.  Make the pooled case look like the former. */
+    else if ((a_fs_file->meta) && (a_fs_file->meta->flags == 0)) {
+        tsk_fs_pool_put_meta(a_fs, a_fs_file->meta);
+        a_fs_file->meta = NULL;
+    }
+}
+
 /* dir_walk local function that is used for recursive calls.  Callers
  * should initially call the non-local version. */
 static TSK_WALK_RET_ENUM
@@ -579,12 +1014,7 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
 
             /* Note that the NTFS code behind here has a slight hack to use the
              * correct sequence number based on the data in fs_file->name */
-            if (a_fs->file_add_meta(a_fs, fs_file,
-                    fs_file->name->meta_addr)) {
-                if (tsk_verbose)
-                    tsk_error_print(stderr);
-                tsk_error_reset();
-            }
+            dir_walk_load_meta(a_fs, fs_file);
         }
 
         // call the action if we have the right flags.
@@ -600,8 +1030,8 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
                  * of knowing that we stopped early w/out error.
                  */
                 if (a_dinfo->save_inum_named) {
-                    tsk_list_free(a_dinfo->list_inum_named);
-                    a_dinfo->list_inum_named = NULL;
+                    tsk_fs_inum_set_free(a_dinfo->inum_named);
+                    a_dinfo->inum_named = NULL;
                     a_dinfo->save_inum_named = 0;
                 }
                 return TSK_WALK_STOP;
@@ -618,12 +1048,12 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
         if ((a_dinfo->save_inum_named) && (fs_file->meta)
             && (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC)) {
 
-            if (tsk_list_add(&a_dinfo->list_inum_named,
+            if (tsk_fs_inum_set_add(a_dinfo->inum_named,
                     fs_file->meta->addr)) {
 
-                // if there is an error, then clear the list
-                tsk_list_free(a_dinfo->list_inum_named);
-                a_dinfo->list_inum_named = NULL;
+                // if there is an error, then clear the set
+                tsk_fs_inum_set_free(a_dinfo->inum_named);
+                a_dinfo->inum_named = NULL;
                 a_dinfo->save_inum_named = 0;
             }
         }
@@ -638,30 +1068,12 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
         if ((fs_file->name->meta_addr == TSK_FS_ORPHANDIR_INUM(a_fs)) && 
             (i == fs_dir->names_used-1) && 
             (a_dinfo->save_inum_named == 1)) {
-            save_inum_named(a_fs, a_dinfo);
+            save_inum_named(a_fs, &a_dinfo->inum_named);
             a_dinfo->save_inum_named = 0;
         }
 
-        /* Recurse into a directory if:
-         * - Both dir entry and inode have DIR type (or name is undefined)
-         * - Recurse flag is set
-         * - dir entry is allocated OR both are unallocated
-         * - not one of the '.' or '..' entries
-         * - A Non-Orphan Dir or the Orphan Dir with the NOORPHAN flag not set.
-         */
-        if ((TSK_FS_IS_DIR_NAME(fs_file->name->type)
-                || (fs_file->name->type == TSK_FS_NAME_TYPE_UNDEF))
-            && (fs_file->meta)
-            && (TSK_FS_IS_DIR_META(fs_file->meta->type))
-            && (a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE)
-            && ((fs_file->name->flags & TSK_FS_NAME_FLAG_ALLOC)
-                || ((fs_file->name->flags & TSK_FS_NAME_FLAG_UNALLOC)
-                    && (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC))
-            )
-            && (!TSK_FS_ISDOT(fs_file->name->name))
-            && ((fs_file->name->meta_addr != TSK_FS_ORPHANDIR_INUM(a_fs))
-                || ((a_flags & TSK_FS_DIR_WALK_FLAG_NOORPHAN) == 0))
-            ) {
+        /* Recurse into a directory if it is one that should be walked */
+        if (dir_walk_should_recurse(a_fs, fs_file, a_flags)) {
 
             /* Make sure we do not get into an infinite loop */
             if (0 == tsk_stack_find(a_dinfo->stack_seen,
@@ -753,9 +1165,9 @@ tsk_fs_dir_walk_lcl(TSK_FS_INFO * a_fs, DENT_DINFO * a_dinfo,
         // remove the pointer to name buffer
         fs_file->name = NULL;
 
-        // free the metadata if we allocated it
+        // give the metadata back for the next entry
         if (fs_file->meta) {
-            tsk_fs_meta_close(fs_file->meta);
+            tsk_fs_pool_put_meta(a_fs, fs_file->meta);
             fs_file->meta = NULL;
         }
     }
@@ -808,9 +1220,14 @@ tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
      * calls the action will clear this stuff.
      */
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if ((a_fs->list_inum_named == NULL) && (a_addr == a_fs->root_inum)
+    if ((a_fs->inum_named == NULL) && (a_addr == a_fs->root_inum)
         && (a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE)) {
-        dinfo.save_inum_named = 1;
+        // the set is saved even if it stays empty so that
+        // tsk_fs_dir_load_inum_named() knows the walk was done
+        if ((dinfo.inum_named = tsk_fs_inum_set_alloc()) != NULL)
+            dinfo.save_inum_named = 1;
+        else
+            tsk_error_reset();
     }
     tsk_release_lock(&a_fs->list_inum_named_lock);
 
@@ -824,11 +1241,11 @@ tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
             /* There was an error and we stopped early, so we should get
              * rid of the partial list we were making.
              */
-            tsk_list_free(dinfo.list_inum_named);
-            dinfo.list_inum_named = NULL;
+            tsk_fs_inum_set_free(dinfo.inum_named);
+            dinfo.inum_named = NULL;
         }
         else {
-            save_inum_named(a_fs, &dinfo);
+            save_inum_named(a_fs, &dinfo.inum_named);
         }
     }
 
@@ -841,57 +1258,916 @@ tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
 }
 
 
+/* Most names that an ordered parallel walk keeps loaded before the
+ * callback gets to them */
+#define DIR_WALK_PAR_MAX_LOADED 16384
+
 /** \internal
-* Create a dummy NAME entry for the Orphan file virtual directory.
-* @param a_fs File system directory is for
-* @param a_fs_name NAME structure to populate with data
-* @returns 1 on error
-*/
-uint8_t
-tsk_fs_dir_make_orphan_dir_name(TSK_FS_INFO * a_fs,
-    TSK_FS_NAME * a_fs_name)
-{
-    snprintf(a_fs_name->name, a_fs_name->name_size, "$OrphanFiles");
-    if (a_fs_name->shrt_name_size > 0)
-        a_fs_name->shrt_name[0] = '\0';
-    a_fs_name->meta_addr = TSK_FS_ORPHANDIR_INUM(a_fs);
-    a_fs_name->flags = TSK_FS_NAME_FLAG_ALLOC;
-    a_fs_name->type = TSK_FS_NAME_TYPE_VIRT_DIR;
-    return 0;
-}
+ * States of a directory in a parallel dir walk
+ */
+typedef enum {
+    DIR_WALK_NODE_PENDING = 0,  ///< Waiting to be loaded
+    DIR_WALK_NODE_RUNNING,      ///< Being loaded by a thread
+    DIR_WALK_NODE_DONE,         ///< Loaded
+} DIR_WALK_NODE_STATE_ENUM;
 
 /** \internal
- * Create a dummy META entry for the Orphan file virtual directory.
- * @param a_fs File system directory is for
- * @param a_fs_meta META structure to populate with data
-* @returns 1 on error
-*/
-uint8_t
-tsk_fs_dir_make_orphan_dir_meta(TSK_FS_INFO * a_fs,
-    TSK_FS_META * a_fs_meta)
-{
-    a_fs_meta->type = TSK_FS_META_TYPE_VIRT_DIR;
-    a_fs_meta->mode = 0;
-    a_fs_meta->nlink = 1;
+ * A directory in a parallel dir walk.  It takes the place of the recursion
+ * state that DENT_DINFO has in a serial walk.
+ */
+typedef struct DIR_WALK_NODE DIR_WALK_NODE;
+struct DIR_WALK_NODE {
+    TSK_INUM_T addr;            ///< Address of the directory
+    char *path;                 ///< Path that is given to the callback with the names in the directory
+    unsigned int depth;         ///< Number of directories that were recursed into to get here
+    TSK_INUM_T *seen;           ///< Addresses of those directories (to find loops)
+    uint8_t save_inum_named;    ///< 1 if the unallocated files that are named here are saved for orphan finding
+    uint8_t deferred;           ///< 1 for the orphan directory if it waits for the rest of the walk
+    uint8_t in_queue;           ///< 1 while the node is in a work queue
+    uint8_t abandoned;          ///< 1 if the node should be freed when it is taken from its queue
+    DIR_WALK_NODE_STATE_ENUM state;
+
+    // filled in when an ordered walk loads the directory
+    uint8_t failed;             ///< 1 if the directory could not be loaded
+    TSK_FS_DIR *fs_dir;
+    TSK_FS_FILE **files;        ///< File for each name (NULL if the walk stopped first)
+    DIR_WALK_NODE **children;   ///< Directory to recurse into after each name (or NULL)
+};
 
-    a_fs_meta->flags = (TSK_FS_META_FLAG_USED | TSK_FS_META_FLAG_ALLOC);
-    a_fs_meta->uid = a_fs_meta->gid = 0;
-    a_fs_meta->mtime = a_fs_meta->atime = a_fs_meta->ctime =
-        a_fs_meta->crtime = 0;
-    a_fs_meta->mtime_nano = a_fs_meta->atime_nano = a_fs_meta->ctime_nano =
-        a_fs_meta->crtime_nano = 0;
+/** \internal
+ * Work queue of a thread.  The thread takes the newest directory from its
+ * own queue and the oldest from the others when its own is empty.
+ */
+typedef struct {
+    tsk_lock_t lock;
+    DIR_WALK_NODE **nodes;
+    size_t head;                ///< Index of the oldest node
+    size_t tail;                ///< Index after the newest node
+    size_t size;                ///< Number of entries allocated in nodes
+} DIR_WALK_QUEUE;
 
-    if (a_fs_meta->name2 == NULL) {
-        if ((a_fs_meta->name2 = (TSK_FS_META_NAME_LIST *)
-                tsk_malloc(sizeof(TSK_FS_META_NAME_LIST))) == NULL)
-            return 1;
-        a_fs_meta->name2->next = NULL;
-    }
+typedef struct DIR_WALK_PAR DIR_WALK_PAR;
 
-    a_fs_meta->attr_state = TSK_FS_META_ATTR_EMPTY;
-    if (a_fs_meta->attr) {
-        tsk_fs_attrlist_markunused(a_fs_meta->attr);
-    }
+/* What each thread needs to know about itself */
+typedef struct {
+    DIR_WALK_PAR *walk;
+    int slot;
+} DIR_WALK_THREAD_ARG;
+
+/** \internal
+ * State of a parallel dir walk
+ */
+struct DIR_WALK_PAR {
+    TSK_FS_INFO *fs;
+    TSK_FS_DIR_WALK_FLAG_ENUM flags;
+    TSK_FS_DIR_WALK_CB action;
+    void *ptr;
+    uint8_t ordered;            ///< 1 if the callback is called by the caller in serial order
+
+    DIR_WALK_QUEUE *queues;     ///< One for each worker thread and one for the caller (the last)
+    int num_queues;
+    tsk_thread_t *threads;
+    DIR_WALK_THREAD_ARG *args;
+    int num_threads;
+
+    tsk_lock_t lock;            ///< Protects the fields below and the node states
+    tsk_cond_t work_cond;       ///< Signaled when a directory is queued, when the last one is done and when the walk ends
+    tsk_cond_t done_cond;       ///< Signaled when an ordered walk finishes loading a directory
+    tsk_cond_t space_cond;      ///< Signaled when an ordered walk frees loaded names and when the walk ends
+    int queued;                 ///< Nodes in the queues
+    size_t outstanding;         ///< Nodes that are queued or being loaded (not counting a deferred one)
+    size_t loaded_names;        ///< Names that an ordered walk loaded that the callback did not get to yet
+    uint8_t quit;               ///< 1 when the worker threads should exit
+    TSK_WALK_RET_ENUM retval;   ///< Changed from TSK_WALK_CONT when the walk should stop
+    uint8_t save_inum_named;    ///< 1 while inum_named is being collected
+    TSK_FS_INUM_SET *inum_named;
+    DIR_WALK_NODE *orphan_node; ///< Orphan directory that an unordered walk loads last
+};
+
+
+/* Free a node.  In ordered walks, the directories that it recurses
+ * into are freed too.  The node itself is kept until it is taken off of
+ * its queue, and a node that a worker thread is loading is waited for. */
+static void
+dir_walk_par_node_free(DIR_WALK_PAR * a_walk, DIR_WALK_NODE * a_node)
+{
+    size_t i;
+
+    /* When the callback of an ordered walk has an error, the walk goes
+     * on with the next directory and frees the rest of this one, which
+     * the workers can still be loading. */
+    tsk_take_lock(&a_walk->lock);
+    while (a_node->state == DIR_WALK_NODE_RUNNING)
+        tsk_cond_wait(&a_walk->done_cond, &a_walk->lock);
+    tsk_release_lock(&a_walk->lock);
+
+    if (a_node->fs_dir) {
+        for (i = 0; i < a_node->fs_dir->names_used; i++) {
+            if ((a_node->files) && (a_node->files[i])) {
+                a_node->files[i]->name = NULL;
+                tsk_fs_pool_put_meta(a_walk->fs, a_node->files[i]->meta);
+                a_node->files[i]->meta = NULL;
+                tsk_fs_file_close(a_node->files[i]);
+            }
+            if ((a_node->children) && (a_node->children[i]))
+                dir_walk_par_node_free(a_walk, a_node->children[i]);
+        }
+
+        tsk_take_lock(&a_walk->lock);
+        if ((a_walk->ordered) && (a_node->state == DIR_WALK_NODE_DONE)) {
+            a_walk->loaded_names -= a_node->fs_dir->names_used;
+            tsk_cond_broadcast(&a_walk->space_cond);
+        }
+        tsk_release_lock(&a_walk->lock);
+
+        tsk_fs_dir_close(a_node->fs_dir);
+        a_node->fs_dir = NULL;
+    }
+    free(a_node->files);
+    a_node->files = NULL;
+    free(a_node->children);
+    a_node->children = NULL;
+
+    tsk_take_lock(&a_walk->lock);
+    if (a_node->in_queue) {
+        a_node->abandoned = 1;
+        a_node = NULL;
+    }
+    tsk_release_lock(&a_walk->lock);
+
+    if (a_node) {
+        free(a_node->path);
+        free(a_node->seen);
+        free(a_node);
+    }
+}
+
+
+/* Make the node for a directory that a_fs_file in a_parent points to.
+ * @returns NULL if the directory should not be walked (or on error) */
+static DIR_WALK_NODE *
+dir_walk_par_node_child(TSK_FS_INFO * a_fs, DIR_WALK_NODE * a_parent,
+    TSK_FS_FILE * a_fs_file)
+{
+    DIR_WALK_NODE *node;
+    TSK_INUM_T addr = a_fs_file->name->meta_addr;
+    size_t path_len = strlen(a_parent->path);
+    size_t name_len = strlen(a_fs_file->name->name);
+    unsigned int i;
+
+    /* Make sure we do not get into an infinite loop */
+    for (i = 0; i < a_parent->depth; i++) {
+        if (a_parent->seen[i] == addr) {
+            if (tsk_verbose)
+                fprintf(stderr,
+                    "tsk_fs_dir_walk_parallel: Loop detected with address %"
+                    PRIuINUM, addr);
+            return NULL;
+        }
+    }
+
+    /* If we've exceeded the max depth or max length, don't
+     * recurse any further into this directory */
+    if ((a_parent->depth >= MAX_DEPTH)
+        || (DIR_STRSZ <= path_len + name_len)) {
+        if (tsk_verbose) {
+            tsk_fprintf(stdout,
+                "tsk_fs_dir_walk_parallel: directory : %"
+                PRIuINUM " exceeded max length / depth\n", addr);
+        }
+        return NULL;
+    }
+
+    if ((node =
+            (DIR_WALK_NODE *) tsk_malloc(sizeof(DIR_WALK_NODE))) == NULL)
+        return NULL;
+    if (((node->path = (char *) tsk_malloc(path_len + name_len + 2)) ==
+            NULL)
+        || ((node->seen =
+                (TSK_INUM_T *) tsk_malloc((a_parent->depth +
+                        1) * sizeof(TSK_INUM_T))) == NULL)) {
+        free(node->path);
+        free(node);
+        return NULL;
+    }
+
+    memcpy(node->path, a_parent->path, path_len);
+    memcpy(&node->path[path_len], a_fs_file->name->name, name_len);
+    node->path[path_len + name_len] = '/';
+    memcpy(node->seen, a_parent->seen,
+        a_parent->depth * sizeof(TSK_INUM_T));
+    node->seen[a_parent->depth] = addr;
+    node->depth = a_parent->depth + 1;
+    node->addr = addr;
+
+    /* We do not want to save info about named unalloc files
+     * when we go into the Orphan directory (because then we have
+     * no orphans).  The orphan directory is loaded after the rest
+     * of the walk so that it can use the saved info. */
+    if (addr == TSK_FS_ORPHANDIR_INUM(a_fs)) {
+        node->deferred = a_parent->save_inum_named;
+    }
+    else {
+        node->save_inum_named = a_parent->save_inum_named;
+    }
+    return node;
+}
+
+
+/* Add a node to the end of a queue */
+static uint8_t
+dir_walk_par_push(DIR_WALK_PAR * a_walk, int a_slot, DIR_WALK_NODE * a_node)
+{
+    DIR_WALK_QUEUE *queue = &a_walk->queues[a_slot];
+
+    tsk_take_lock(&queue->lock);
+    if (queue->tail == queue->size) {
+        if (queue->head > 0) {
+            memmove(queue->nodes, &queue->nodes[queue->head],
+                (queue->tail - queue->head) * sizeof(DIR_WALK_NODE *));
+            queue->tail -= queue->head;
+            queue->head = 0;
+        }
+        else {
+            size_t size = queue->size ? queue->size * 2 : 64;
+            DIR_WALK_NODE **nodes;
+            if ((nodes =
+                    (DIR_WALK_NODE **) tsk_realloc(queue->nodes,
+                        size * sizeof(DIR_WALK_NODE *))) == NULL) {
+                tsk_release_lock(&queue->lock);
+                return 1;
+            }
+            queue->nodes = nodes;
+            queue->size = size;
+        }
+    }
+    a_node->in_queue = 1;
+    queue->nodes[queue->tail++] = a_node;
+    tsk_release_lock(&queue->lock);
+
+    tsk_take_lock(&a_walk->lock);
+    a_walk->queued++;
+    a_walk->outstanding++;
+    tsk_cond_signal(&a_walk->work_cond);
+    tsk_release_lock(&a_walk->lock);
+    return 0;
+}
+
+
+/* Take a node to load: the newest one in the thread's own queue or the
+ * oldest one in another queue.
+ * @returns NULL if the queues are empty */
+static DIR_WALK_NODE *
+dir_walk_par_take(DIR_WALK_PAR * a_walk, int a_slot)
+{
+    while (1) {
+        DIR_WALK_NODE *node = NULL;
+        int i;
+
+        for (i = 0; (i < a_walk->num_queues) && (node == NULL); i++) {
+            DIR_WALK_QUEUE *queue =
+                &a_walk->queues[(a_slot + i) % a_walk->num_queues];
+
+            tsk_take_lock(&queue->lock);
+            if (queue->head < queue->tail) {
+                if (i == 0)
+                    node = queue->nodes[--queue->tail];
+                else
+                    node = queue->nodes[queue->head++];
+            }
+            tsk_release_lock(&queue->lock);
+        }
+        if (node == NULL)
+            return NULL;
+
+        tsk_take_lock(&a_walk->lock);
+        a_walk->queued--;
+        node->in_queue = 0;
+        if (node->abandoned) {
+            tsk_release_lock(&a_walk->lock);
+            free(node->path);
+            free(node->seen);
+            free(node);
+            continue;
+        }
+        // the caller of an ordered walk can load a node that it needs before its turn
+        else if (node->state != DIR_WALK_NODE_PENDING) {
+            tsk_release_lock(&a_walk->lock);
+            continue;
+        }
+        node->state = DIR_WALK_NODE_RUNNING;
+        tsk_release_lock(&a_walk->lock);
+        return node;
+    }
+}
+
+
+/* Load a directory.  Unordered walks call the callback with each name
+ * and free the node.  Ordered walks keep the names and files in the node
+ * for the caller.  The directories to recurse into are queued.
+ * @returns TSK_WALK_ERROR if the directory could not be loaded or the
+ * callback had an error, TSK_WALK_STOP if the callback wants to stop and
+ * TSK_WALK_CONT otherwise */
+static TSK_WALK_RET_ENUM
+dir_walk_par_load(DIR_WALK_PAR * a_walk, DIR_WALK_NODE * a_node, int a_slot)
+{
+    TSK_FS_INFO *fs = a_walk->fs;
+    TSK_FS_DIR *fs_dir = NULL;
+    TSK_FS_FILE *fs_file = NULL;
+    DIR_WALK_NODE **children = NULL;
+    TSK_WALK_RET_ENUM retval = TSK_WALK_CONT;
+    size_t i;
+
+    tsk_take_lock(&a_walk->lock);
+    if (a_walk->retval != TSK_WALK_CONT)
+        retval = TSK_WALK_STOP;
+    tsk_release_lock(&a_walk->lock);
+
+    // get the list of entries in the directory
+    if ((retval == TSK_WALK_CONT)
+        && (((fs_dir = tsk_fs_dir_open_meta(fs, a_node->addr)) == NULL)
+            || ((children =
+                    (DIR_WALK_NODE **) tsk_malloc(fs_dir->names_used *
+                        sizeof(DIR_WALK_NODE *))) == NULL)
+            || ((a_walk->ordered)
+                && ((a_node->files =
+                        (TSK_FS_FILE **) tsk_malloc(fs_dir->names_used *
+                            sizeof(TSK_FS_FILE *))) == NULL))
+            || ((a_walk->ordered == 0)
+                && ((fs_file = tsk_fs_file_alloc(fs)) == NULL)))) {
+        retval = TSK_WALK_ERROR;
+    }
+
+    for (i = 0; (retval == TSK_WALK_CONT) && (i < fs_dir->names_used);
+        i++) {
+        TSK_FS_NAME *fs_name = &fs_dir->names[i];
+
+        tsk_take_lock(&a_walk->lock);
+        if (a_walk->retval != TSK_WALK_CONT)
+            retval = TSK_WALK_STOP;
+        tsk_release_lock(&a_walk->lock);
+        if (retval != TSK_WALK_CONT)
+            break;
+
+        if (a_walk->ordered) {
+            if ((fs_file = tsk_fs_file_alloc(fs)) == NULL) {
+                retval = TSK_WALK_ERROR;
+                break;
+            }
+            a_node->files[i] = fs_file;
+        }
+        fs_file->name = fs_name;
+
+        /* load the fs_meta structure if possible.
+         * Must have non-zero inode addr or have allocated name (if inode is 0) */
+        if ((fs_name->meta_addr) || (fs_name->flags & TSK_FS_NAME_FLAG_ALLOC)) {
+            dir_walk_load_meta(fs, fs_file);
+        }
+
+        // call the action if we have the right flags.
+        if ((a_walk->ordered == 0)
+            && ((fs_name->flags & a_walk->flags) == fs_name->flags)) {
+            retval = a_walk->action(fs_file, a_node->path, a_walk->ptr);
+        }
+
+        // save the inode info for orphan finding - if requested
+        if ((retval != TSK_WALK_ERROR) && (a_node->save_inum_named)
+            && (fs_file->meta)
+            && (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC)) {
+            tsk_take_lock(&a_walk->lock);
+            if ((a_walk->save_inum_named)
+                && (tsk_fs_inum_set_add(a_walk->inum_named,
+                        fs_file->meta->addr))) {
+                // if there is an error, then clear the set
+                tsk_fs_inum_set_free(a_walk->inum_named);
+                a_walk->inum_named = NULL;
+                a_walk->save_inum_named = 0;
+                tsk_error_reset();
+            }
+            tsk_release_lock(&a_walk->lock);
+        }
+
+        if ((retval == TSK_WALK_CONT)
+            && (dir_walk_should_recurse(fs, fs_file, a_walk->flags))) {
+            children[i] = dir_walk_par_node_child(fs, a_node, fs_file);
+            tsk_error_reset();
+        }
+
+        if (a_walk->ordered == 0) {
+            fs_file->name = NULL;
+            if (fs_file->meta) {
+                tsk_fs_pool_put_meta(fs, fs_file->meta);
+                fs_file->meta = NULL;
+            }
+        }
+    }
+
+    /* Queue the directories to recurse into.  They are queued last to first
+     * so that this thread takes them in the order of a serial walk.  The
+     * rest of a directory is not walked after a callback error, but the
+     * directories before the error still are (as in a serial walk). */
+    if ((children) && ((retval == TSK_WALK_CONT)
+            || ((retval == TSK_WALK_ERROR) && (a_walk->ordered == 0)
+                && (a_node->depth > 0)))) {
+        for (i = fs_dir->names_used; i > 0; i--) {
+            DIR_WALK_NODE *child = children[i - 1];
+            if ((child == NULL) || (child->deferred))
+                continue;
+            if (dir_walk_par_push(a_walk, a_slot, child)) {
+                children[i - 1] = NULL;
+                dir_walk_par_node_free(a_walk, child);
+                tsk_error_reset();
+            }
+            // the nodes of unordered walks belong to the queue now
+            else if (a_walk->ordered == 0) {
+                children[i - 1] = NULL;
+            }
+        }
+    }
+
+    if (a_walk->ordered) {
+        a_node->fs_dir = fs_dir;
+        a_node->children = children;
+    }
+    else {
+        if (children) {
+            for (i = 0; i < fs_dir->names_used; i++) {
+                if (children[i] == NULL)
+                    continue;
+                if ((children[i]->deferred) && (retval == TSK_WALK_CONT)) {
+                    tsk_take_lock(&a_walk->lock);
+                    if (a_walk->orphan_node == NULL) {
+                        a_walk->orphan_node = children[i];
+                        children[i] = NULL;
+                    }
+                    tsk_release_lock(&a_walk->lock);
+                }
+                // free the ones that were not queued
+                if (children[i])
+                    dir_walk_par_node_free(a_walk, children[i]);
+            }
+            free(children);
+        }
+        if (fs_file) {
+            fs_file->name = NULL;
+            tsk_fs_file_close(fs_file);
+        }
+        if (fs_dir)
+            tsk_fs_dir_close(fs_dir);
+    }
+
+    tsk_take_lock(&a_walk->lock);
+    a_node->failed = ((retval == TSK_WALK_ERROR) || (fs_dir == NULL)) ? 1 : 0;
+    a_node->state = DIR_WALK_NODE_DONE;
+    if ((a_walk->ordered) && (fs_dir))
+        a_walk->loaded_names += fs_dir->names_used;
+    if (a_node->deferred == 0) {
+        if (--a_walk->outstanding == 0)
+            tsk_cond_broadcast(&a_walk->work_cond);
+    }
+    tsk_cond_broadcast(&a_walk->done_cond);
+    tsk_release_lock(&a_walk->lock);
+
+    if (a_walk->ordered == 0)
+        dir_walk_par_node_free(a_walk, a_node);
+    return retval;
+}
+
+
+/* Handle the result of loading a directory in a worker thread (or in
+ * the calling thread of an unordered walk) */
+static void
+dir_walk_par_loaded(DIR_WALK_PAR * a_walk, TSK_WALK_RET_ENUM a_retval,
+    TSK_INUM_T a_addr)
+{
+    if (a_retval == TSK_WALK_ERROR) {
+        /* If this fails because the directory could not be
+         * loaded, then we still continue */
+        if (tsk_verbose) {
+            tsk_fprintf(stderr,
+                "tsk_fs_dir_walk_parallel: error reading directory: %"
+                PRIuINUM "\n", a_addr);
+            tsk_error_print(stderr);
+        }
+        tsk_error_reset();
+    }
+    else if (a_retval == TSK_WALK_STOP) {
+        tsk_take_lock(&a_walk->lock);
+        if (a_walk->retval == TSK_WALK_CONT)
+            a_walk->retval = TSK_WALK_STOP;
+        tsk_cond_broadcast(&a_walk->work_cond);
+        tsk_release_lock(&a_walk->lock);
+    }
+}
+
+
+/* The main loop of a worker thread */
+static void
+dir_walk_par_main(void *a_ptr)
+{
+    DIR_WALK_THREAD_ARG *arg = (DIR_WALK_THREAD_ARG *) a_ptr;
+    DIR_WALK_PAR *walk = arg->walk;
+
+    tsk_take_lock(&walk->lock);
+    while (walk->quit == 0) {
+        DIR_WALK_NODE *node;
+        TSK_WALK_RET_ENUM retval;
+
+        // an ordered walk does not get too far ahead of the callback
+        if ((walk->ordered)
+            && (walk->loaded_names >= DIR_WALK_PAR_MAX_LOADED)) {
+            tsk_cond_wait(&walk->space_cond, &walk->lock);
+            continue;
+        }
+        if (walk->queued <= 0) {
+            tsk_cond_wait(&walk->work_cond, &walk->lock);
+            continue;
+        }
+        tsk_release_lock(&walk->lock);
+
+        if ((node = dir_walk_par_take(walk, arg->slot)) != NULL) {
+            TSK_INUM_T addr = node->addr;
+            retval = dir_walk_par_load(walk, node, arg->slot);
+            dir_walk_par_loaded(walk, retval, addr);
+        }
+        tsk_take_lock(&walk->lock);
+    }
+    tsk_release_lock(&walk->lock);
+}
+
+
+/* Call the callback with the names in a directory of an ordered walk and
+ * recurse into its subdirectories.  The directory is loaded here if no
+ * worker thread has started on it yet. */
+static TSK_WALK_RET_ENUM
+dir_walk_par_deliver(DIR_WALK_PAR * a_walk, DIR_WALK_NODE * a_node)
+{
+    uint8_t load = 0;
+    size_t i;
+
+    tsk_take_lock(&a_walk->lock);
+    if (a_node->state == DIR_WALK_NODE_PENDING) {
+        a_node->state = DIR_WALK_NODE_RUNNING;
+        load = 1;
+    }
+    else {
+        while (a_node->state != DIR_WALK_NODE_DONE)
+            tsk_cond_wait(&a_walk->done_cond, &a_walk->lock);
+    }
+    tsk_release_lock(&a_walk->lock);
+
+    if ((load) && (dir_walk_par_load(a_walk, a_node,
+                a_walk->num_queues - 1) == TSK_WALK_ERROR))
+        return TSK_WALK_ERROR;
+    if (a_node->failed)
+        return TSK_WALK_ERROR;
+
+    for (i = 0; i < a_node->fs_dir->names_used; i++) {
+        TSK_FS_FILE *fs_file = a_node->files[i];
+        DIR_WALK_NODE *child = a_node->children[i];
+
+        // call the action if we have the right flags.
+        if ((fs_file->name->flags & a_walk->flags) == fs_file->name->flags) {
+            TSK_WALK_RET_ENUM retval =
+                a_walk->action(fs_file, a_node->path, a_walk->ptr);
+            if (retval != TSK_WALK_CONT)
+                return retval;
+        }
+
+        // free what the callback is done with so the workers can load more
+        fs_file->name = NULL;
+        tsk_fs_file_close(fs_file);
+        a_node->files[i] = NULL;
+
+        if (child == NULL)
+            continue;
+
+        /* The orphan directory can use the info about named unalloc
+         * files if everything else has been walked */
+        if (child->deferred) {
+            tsk_take_lock(&a_walk->lock);
+            if ((a_walk->outstanding == 0) && (a_walk->save_inum_named)) {
+                save_inum_named(a_walk->fs, &a_walk->inum_named);
+                a_walk->save_inum_named = 0;
+            }
+            tsk_release_lock(&a_walk->lock);
+        }
+
+        switch (dir_walk_par_deliver(a_walk, child)) {
+        case TSK_WALK_ERROR:
+            /* If this fails because the directory could not be
+             * loaded, then we still continue */
+            if (tsk_verbose) {
+                tsk_fprintf(stderr,
+                    "tsk_fs_dir_walk_parallel: error reading directory: %"
+                    PRIuINUM "\n", child->addr);
+                tsk_error_print(stderr);
+            }
+            tsk_error_reset();
+            break;
+        case TSK_WALK_STOP:
+            return TSK_WALK_STOP;
+        default:
+            break;
+        }
+
+        a_node->children[i] = NULL;
+        dir_walk_par_node_free(a_walk, child);
+    }
+    return TSK_WALK_CONT;
+}
+
+
+/** \ingroup fslib
+* Walk the file names in a directory and obtain the details of the files via a callback,
+* loading the directories with a pool of threads.  Each thread works through the
+* subdirectories that it finds and takes directories from the other threads when it runs out.
+*
+* Without TSK_FS_DIR_WALK_FLAG_ORDERED, the callback is called from all of the threads at
+* the same time (so it must be thread safe) and the order of the names is not defined.
+* With TSK_FS_DIR_WALK_FLAG_ORDERED, the threads only load the directories and the
+* callback is called from the calling thread in the same order as tsk_fs_dir_walk().
+* In both cases, loops are detected and the info about named unallocated files that is
+* used to find orphan files is collected as in tsk_fs_dir_walk().
+*
+* @param a_fs File system to analyze
+* @param a_addr Metadata address of the directory to analyze
+* @param a_flags Flags used during analysis
+* @param a_action Callback function that is called for each file name
+* @param a_ptr Pointer to data that is passed to the callback function each time
+* @param a_num_threads Number of threads to use, including the calling thread (0 for TSK_FS_DIR_WALK_THREADS_DEFAULT)
+* @returns 1 on error and 0 on success
+*/
+uint8_t
+tsk_fs_dir_walk_parallel(TSK_FS_INFO * a_fs, TSK_INUM_T a_addr,
+    TSK_FS_DIR_WALK_FLAG_ENUM a_flags, TSK_FS_DIR_WALK_CB a_action,
+    void *a_ptr, int a_num_threads)
+{
+    DIR_WALK_PAR walk;
+    DIR_WALK_NODE *root;
+    TSK_WALK_RET_ENUM retval;
+    int i;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_dir_walk_parallel: called with NULL or unallocated structures");
+        return 1;
+    }
+
+    if (a_num_threads <= 0)
+        a_num_threads = TSK_FS_DIR_WALK_THREADS_DEFAULT;
+    else if (a_num_threads == 1)
+        return tsk_fs_dir_walk(a_fs, a_addr, a_flags, a_action, a_ptr);
+
+    /* Sanity check on flags -- make sure at least one ALLOC is set */
+    if (((a_flags & TSK_FS_DIR_WALK_FLAG_ALLOC) == 0) &&
+        ((a_flags & TSK_FS_DIR_WALK_FLAG_UNALLOC) == 0)) {
+        a_flags |=
+            (TSK_FS_DIR_WALK_FLAG_ALLOC | TSK_FS_DIR_WALK_FLAG_UNALLOC);
+    }
+
+    memset(&walk, 0, sizeof(DIR_WALK_PAR));
+    walk.fs = a_fs;
+    walk.flags = a_flags;
+    walk.action = a_action;
+    walk.ptr = a_ptr;
+    walk.ordered = (a_flags & TSK_FS_DIR_WALK_FLAG_ORDERED) ? 1 : 0;
+    walk.retval = TSK_WALK_CONT;
+
+    if ((root =
+            (DIR_WALK_NODE *) tsk_malloc(sizeof(DIR_WALK_NODE))) == NULL)
+        return 1;
+    if ((root->path = (char *) tsk_malloc(1)) == NULL) {
+        free(root);
+        return 1;
+    }
+    root->addr = a_addr;
+
+    /* if the flags are right, we can collect info that may be needed
+     * for an orphan walk.  If the walk fails or stops, this stuff is
+     * cleared at the end.
+     */
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    if ((a_fs->inum_named == NULL) && (a_addr == a_fs->root_inum)
+        && (a_flags & TSK_FS_DIR_WALK_FLAG_RECURSE)) {
+        if ((walk.inum_named = tsk_fs_inum_set_alloc()) != NULL) {
+            walk.save_inum_named = 1;
+            root->save_inum_named = 1;
+        }
+        else {
+            tsk_error_reset();
+        }
+    }
+    tsk_release_lock(&a_fs->list_inum_named_lock);
+
+    walk.num_queues = a_num_threads;
+    if (((walk.queues =
+                (DIR_WALK_QUEUE *) tsk_malloc(walk.num_queues *
+                    sizeof(DIR_WALK_QUEUE))) == NULL)
+        || ((walk.threads =
+                (tsk_thread_t *) tsk_malloc(walk.num_queues *
+                    sizeof(tsk_thread_t))) == NULL)
+        || ((walk.args =
+                (DIR_WALK_THREAD_ARG *) tsk_malloc(walk.num_queues *
+                    sizeof(DIR_WALK_THREAD_ARG))) == NULL)) {
+        free(walk.threads);
+        free(walk.queues);
+        free(root->path);
+        free(root);
+        return 1;
+    }
+    for (i = 0; i < walk.num_queues; i++)
+        tsk_init_lock(&walk.queues[i].lock);
+    tsk_init_lock(&walk.lock);
+    tsk_init_cond(&walk.work_cond);
+    tsk_init_cond(&walk.done_cond);
+    tsk_init_cond(&walk.space_cond);
+
+    // the calling thread is the last one (and uses the last queue)
+    for (i = 0; i < a_num_threads - 1; i++) {
+        walk.args[i].walk = &walk;
+        walk.args[i].slot = i;
+        if (tsk_thread_create(&walk.threads[i], dir_walk_par_main,
+                &walk.args[i])) {
+            // do the walk with the threads that did start
+            tsk_error_reset();
+            break;
+        }
+        walk.num_threads++;
+    }
+
+    if (walk.ordered) {
+        root->state = DIR_WALK_NODE_PENDING;
+        retval = dir_walk_par_deliver(&walk, root);
+    }
+    else {
+        // the calling thread loads the first directory so that errors there are returned
+        root->state = DIR_WALK_NODE_RUNNING;
+        tsk_take_lock(&walk.lock);
+        walk.outstanding++;
+        tsk_release_lock(&walk.lock);
+        retval = dir_walk_par_load(&walk, root, walk.num_queues - 1);
+        root = NULL;
+
+        if (retval == TSK_WALK_CONT) {
+            // help the worker threads until everything is done
+            tsk_take_lock(&walk.lock);
+            while (walk.retval == TSK_WALK_CONT) {
+                DIR_WALK_NODE *node;
+
+                if (walk.outstanding == 0) {
+                    if (walk.orphan_node == NULL)
+                        break;
+
+                    /* everything else has been walked, so save the info about
+                     * named unalloc files for the orphan directory */
+                    if (walk.save_inum_named) {
+                        save_inum_named(a_fs, &walk.inum_named);
+                        walk.save_inum_named = 0;
+                    }
+                    node = walk.orphan_node;
+                    walk.orphan_node = NULL;
+                    node->deferred = 0;
+                    tsk_release_lock(&walk.lock);
+                    if (dir_walk_par_push(&walk, walk.num_queues - 1, node)) {
+                        dir_walk_par_node_free(&walk, node);
+                        tsk_error_reset();
+                    }
+                    tsk_take_lock(&walk.lock);
+                    continue;
+                }
+
+                if (walk.queued <= 0) {
+                    tsk_cond_wait(&walk.work_cond, &walk.lock);
+                    continue;
+                }
+                tsk_release_lock(&walk.lock);
+
+                if ((node =
+                        dir_walk_par_take(&walk,
+                            walk.num_queues - 1)) != NULL) {
+                    TSK_INUM_T addr = node->addr;
+                    dir_walk_par_loaded(&walk, dir_walk_par_load(&walk,
+                            node, walk.num_queues - 1), addr);
+                }
+                tsk_take_lock(&walk.lock);
+            }
+            retval = walk.retval;
+            tsk_release_lock(&walk.lock);
+        }
+    }
+
+    // stop the threads
+    tsk_take_lock(&walk.lock);
+    if ((retval != TSK_WALK_CONT) && (walk.retval == TSK_WALK_CONT))
+        walk.retval = retval;
+    walk.quit = 1;
+    tsk_cond_broadcast(&walk.work_cond);
+    tsk_cond_broadcast(&walk.space_cond);
+    tsk_release_lock(&walk.lock);
+    for (i = 0; i < walk.num_threads; i++)
+        tsk_thread_join(&walk.threads[i]);
+
+    // free what is left if the walk stopped early
+    if (root)
+        dir_walk_par_node_free(&walk, root);
+    if (walk.orphan_node)
+        dir_walk_par_node_free(&walk, walk.orphan_node);
+    for (i = 0; i < walk.num_queues; i++) {
+        DIR_WALK_QUEUE *queue = &walk.queues[i];
+        for (; queue->head < queue->tail; queue->head++) {
+            DIR_WALK_NODE *node = queue->nodes[queue->head];
+            node->in_queue = 0;
+            if ((walk.ordered == 0) || (node->abandoned)) {
+                node->abandoned = 0;
+                dir_walk_par_node_free(&walk, node);
+            }
+        }
+        free(queue->nodes);
+        tsk_deinit_lock(&queue->lock);
+    }
+
+    // if we were collecting the list of named files, then now save them to FS_INFO
+    if (walk.save_inum_named) {
+        if (retval != TSK_WALK_CONT) {
+            /* There was an error and we stopped early, so we should get
+             * rid of the partial list we were making.
+             */
+            tsk_fs_inum_set_free(walk.inum_named);
+            walk.inum_named = NULL;
+        }
+        else {
+            save_inum_named(a_fs, &walk.inum_named);
+        }
+    }
+
+    tsk_deinit_cond(&walk.space_cond);
+    tsk_deinit_cond(&walk.done_cond);
+    tsk_deinit_cond(&walk.work_cond);
+    tsk_deinit_lock(&walk.lock);
+    free(walk.args);
+    free(walk.threads);
+    free(walk.queues);
+
+    if (retval == TSK_WALK_ERROR)
+        return 1;
+    else
+        return 0;
+}
+
+
+/** \internal
+* Create a dummy NAME entry for the Orphan file virtual directory.
+* @param a_fs File system directory is for
+* @param a_fs_name NAME structure to populate with data
+* @returns 1 on error
+*/
+uint8_t
+tsk_fs_dir_make_orphan_dir_name(TSK_FS_INFO * a_fs,
+    TSK_FS_NAME * a_fs_name)
+{
+    snprintf(a_fs_name->name, a_fs_name->name_size, "$OrphanFiles");
+    if (a_fs_name->shrt_name_size > 0)
+        a_fs_name->shrt_name[0] = '\0';
+    a_fs_name->meta_addr = TSK_FS_ORPHANDIR_INUM(a_fs);
+    a_fs_name->flags = TSK_FS_NAME_FLAG_ALLOC;
+    a_fs_name->type = TSK_FS_NAME_TYPE_VIRT_DIR;
+    return 0;
+}
+
+/** \internal
+ * Create a dummy META entry for the Orphan file virtual directory.
+ * @param a_fs File system directory is for
+ * @param a_fs_meta META structure to populate with data
+* @returns 1 on error
+*/
+uint8_t
+tsk_fs_dir_make_orphan_dir_meta(TSK_FS_INFO * a_fs,
+    TSK_FS_META * a_fs_meta)
+{
+    a_fs_meta->type = TSK_FS_META_TYPE_VIRT_DIR;
+    a_fs_meta->mode = 0;
+    a_fs_meta->nlink = 1;
+
+    a_fs_meta->flags = (TSK_FS_META_FLAG_USED | TSK_FS_META_FLAG_ALLOC);
+    a_fs_meta->uid = a_fs_meta->gid = 0;
+    a_fs_meta->mtime = a_fs_meta->atime = a_fs_meta->ctime =
+        a_fs_meta->crtime = 0;
+    a_fs_meta->mtime_nano = a_fs_meta->atime_nano = a_fs_meta->ctime_nano =
+        a_fs_meta->crtime_nano = 0;
+
+    if (a_fs_meta->name2 == NULL) {
+        if ((a_fs_meta->name2 = (TSK_FS_META_NAME_LIST *)
+                tsk_malloc(sizeof(TSK_FS_META_NAME_LIST))) == NULL)
+            return 1;
+        a_fs_meta->name2->next = NULL;
+    }
+
+    a_fs_meta->attr_state = TSK_FS_META_ATTR_EMPTY;
+    if (a_fs_meta->attr) {
+        tsk_fs_attrlist_markunused(a_fs_meta->attr);
+    }
 
     a_fs_meta->addr = TSK_FS_ORPHANDIR_INUM(a_fs);
     strncpy(a_fs_meta->name2->name, "$OrphanFiles",
@@ -915,13 +2191,16 @@ tsk_fs_dir_make_orphan_dir_meta(TSK_FS_INFO * a_fs,
 uint8_t
 tsk_fs_dir_find_inum_named(TSK_FS_INFO * a_fs, TSK_INUM_T a_inum)
 {
-    uint8_t retval = 0;
+    TSK_FS_INUM_SET *inum_named;
+
+    // the set is not changed once it is in FS_INFO, so it can be
+    // searched without the lock
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    // list can be null if no unallocated file names exist
-    if (a_fs->list_inum_named)
-        retval = tsk_list_find(a_fs->list_inum_named, a_inum);
+    inum_named = a_fs->inum_named;
     tsk_release_lock(&a_fs->list_inum_named_lock);
-    return retval;
+
+    // set can be null if the names have not been loaded
+    return tsk_fs_inum_set_find(inum_named, a_inum);
 }
 
 
@@ -944,11 +2223,11 @@ TSK_RETVAL_ENUM
 tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs)
 {
     tsk_take_lock(&a_fs->list_inum_named_lock);
-    if (a_fs->list_inum_named != NULL) {
+    if (a_fs->inum_named != NULL) {
         tsk_release_lock(&a_fs->list_inum_named_lock);
         if (tsk_verbose)
             fprintf(stderr,
-                "tsk_fs_dir_load_inum_named: List already populated.  Skipping walk.\n");
+                "tsk_fs_dir_load_inum_named: Set already populated.  Skipping walk.\n");
         return TSK_OK;
     }
     tsk_release_lock(&a_fs->list_inum_named_lock);
@@ -979,7 +2258,8 @@ tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs)
 typedef struct {
     TSK_FS_NAME *fs_name;       // temp name structure used when adding entries to fs_dir
     TSK_FS_DIR *fs_dir;         // unique names are added to this.  represents contents of OrphanFiles directory
-    TSK_LIST *orphan_subdir_list;       // keep track of files that can already be accessed via orphan directory
+    TSK_FS_INUM_SET *orphan_subdir_set; // keep track of files that can already be accessed via orphan directory
+    const TSK_FS_INUM_SET *inum_named;  // unallocated inodes that have names (from FS_INFO)
 } FIND_ORPHAN_DATA;
 
 /* Used to process orphan directories and make sure that their contents
@@ -1016,7 +2296,8 @@ load_orphan_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
         /* check if we have already added it as an orphan (in a subdirectory)
          * Not entirely sure how possible this is, but it was added while
          * debugging an infinite loop problem. */
-        if (tsk_list_find(data->orphan_subdir_list, a_fs_file->meta->addr)) {
+        if (tsk_fs_inum_set_find(data->orphan_subdir_set,
+                a_fs_file->meta->addr)) {
             if (tsk_verbose)
                 fprintf(stderr,
                     "load_orphan_dir_walk_cb: Detected loop with address %"
@@ -1024,7 +2305,9 @@ load_orphan_dir_walk_cb(TSK_FS_FILE * a_fs_file, const char *a_path,
             return TSK_WALK_STOP;
         }
 
-        tsk_list_add(&data->orphan_subdir_list, a_fs_file->meta->addr);
+        if (tsk_fs_inum_set_add(data->orphan_subdir_set,
+                a_fs_file->meta->addr))
+            return TSK_WALK_ERROR;
 
         /* FAT file systems spend a lot of time hunting for parent
          * directory addresses, so we put this code in here to save
@@ -1051,18 +2334,15 @@ find_orphan_meta_walk_cb(TSK_FS_FILE * a_fs_file, void *a_ptr)
     TSK_FS_INFO *fs = a_fs_file->fs_info;
 
     /* We want only orphans, then check if this
-     * inode is in the seen list
+     * inode is in the seen set
      */
-    tsk_take_lock(&fs->list_inum_named_lock);
-    if ((fs->list_inum_named)
-        && (tsk_list_find(fs->list_inum_named, a_fs_file->meta->addr))) {
-        tsk_release_lock(&fs->list_inum_named_lock);
+    if (tsk_fs_inum_set_find(data->inum_named, a_fs_file->meta->addr)) {
         return TSK_WALK_CONT;
     }
-    tsk_release_lock(&fs->list_inum_named_lock);
 
     // check if we have already added it as an orphan (in a subdirectory)
-    if (tsk_list_find(data->orphan_subdir_list, a_fs_file->meta->addr)) {
+    if (tsk_fs_inum_set_find(data->orphan_subdir_set,
+            a_fs_file->meta->addr)) {
         return TSK_WALK_CONT;
     }
 
@@ -1144,6 +2424,60 @@ tsk_fs_dir_add_orphan_dir_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
     return 0;
 }
 
+/* Calls find_orphan_meta_walk_cb() for each address in a set of
+ * unallocated and used metadata structures that is not named, in the
+ * same order as a meta walk would.  This is used instead of the meta
+ * walk when the file system already scanned all of its metadata.
+ * @returns 1 on error and 0 on success */
+static uint8_t
+find_orphan_candidates(TSK_FS_INFO * a_fs,
+    const TSK_FS_INUM_SET * a_candidates, FIND_ORPHAN_DATA * a_data)
+{
+    TSK_FS_FILE *fs_file = NULL;
+    TSK_INUM_T next = 0;
+    uint8_t more, retval = 0;
+
+    more = tsk_fs_inum_set_next(a_candidates, 0, &next);
+    while (more) {
+        TSK_WALK_RET_ENUM cb_ret;
+        TSK_FS_FILE *fs_file_tmp;
+        TSK_INUM_T inum = next;
+
+        more = (inum != (TSK_INUM_T) -1)
+            && tsk_fs_inum_set_next(a_candidates, inum + 1, &next);
+
+        if (tsk_fs_inum_set_find(a_data->inum_named, inum))
+            continue;
+
+        if ((fs_file_tmp =
+                tsk_fs_file_open_meta(a_fs, fs_file, inum)) == NULL) {
+            // skip corrupt entries like the meta walk does
+            if (tsk_verbose)
+                tsk_error_print(stderr);
+            tsk_error_reset();
+            continue;
+        }
+        fs_file = fs_file_tmp;
+
+        if ((fs_file->meta == NULL)
+            || ((fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC) == 0)
+            || ((fs_file->meta->flags & TSK_FS_META_FLAG_USED) == 0))
+            continue;
+
+        cb_ret = find_orphan_meta_walk_cb(fs_file, a_data);
+        if (cb_ret == TSK_WALK_STOP)
+            break;
+        else if (cb_ret == TSK_WALK_ERROR) {
+            retval = 1;
+            break;
+        }
+    }
+
+    tsk_fs_file_close(fs_file);
+    return retval;
+}
+
+
 /** \internal
  * Search the file system for orphan files and create the orphan file directory.
  * @param a_fs File system to search
@@ -1153,6 +2487,8 @@ TSK_RETVAL_ENUM
 tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
 {
     FIND_ORPHAN_DATA data;
+    const TSK_FS_INUM_SET *candidates;
+    uint8_t walk_ret;
     size_t i;
 
     tsk_take_lock(&a_fs->orphan_dir_lock);
@@ -1185,7 +2521,10 @@ tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
         tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_ERR;
     }
-    // note that list_inum_named could still be NULL if there are no deleted names.
+    tsk_take_lock(&a_fs->list_inum_named_lock);
+    data.inum_named = a_fs->inum_named;
+    candidates = a_fs->orphan_candidates;
+    tsk_release_lock(&a_fs->list_inum_named_lock);
 
     /* Now we walk the unallocated metadata structures and find ones that are
      * not named.  The callback will add the names to the FS_DIR structure.
@@ -1198,18 +2537,32 @@ tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
         return TSK_ERR;
     }
 
-    if (tsk_verbose)
-        fprintf(stderr,
-            "tsk_fs_dir_find_orphans: Performing inode_walk to find unnamed metadata structures\n");
+    if ((data.orphan_subdir_set = tsk_fs_inum_set_alloc()) == NULL) {
+        tsk_fs_name_free(data.fs_name);
+        tsk_release_lock(&a_fs->orphan_dir_lock);
+        return TSK_ERR;
+    }
 
-    if (tsk_fs_meta_walk(a_fs, a_fs->first_inum, a_fs->last_inum,
+    if (candidates) {
+        if (tsk_verbose)
+            fprintf(stderr,
+                "tsk_fs_dir_find_orphans: Loading %" PRIuINUM
+                " unallocated metadata structures from the file system scan\n",
+                tsk_fs_inum_set_count(candidates));
+        walk_ret = find_orphan_candidates(a_fs, candidates, &data);
+    }
+    else {
+        if (tsk_verbose)
+            fprintf(stderr,
+                "tsk_fs_dir_find_orphans: Performing inode_walk to find unnamed metadata structures\n");
+        walk_ret = tsk_fs_meta_walk(a_fs, a_fs->first_inum, a_fs->last_inum,
             TSK_FS_META_FLAG_UNALLOC | TSK_FS_META_FLAG_USED,
-            find_orphan_meta_walk_cb, &data)) {
+            find_orphan_meta_walk_cb, &data);
+    }
+
+    if (walk_ret) {
         tsk_fs_name_free(data.fs_name);
-        if (data.orphan_subdir_list) {
-            tsk_list_free(data.orphan_subdir_list);
-            data.orphan_subdir_list = NULL;
-        }
+        tsk_fs_inum_set_free(data.orphan_subdir_set);
         tsk_release_lock(&a_fs->orphan_dir_lock);
         return TSK_ERR;
     }
@@ -1227,21 +2580,21 @@ tsk_fs_dir_find_orphans(TSK_FS_INFO * a_fs, TSK_FS_DIR * a_fs_dir)
      * from subdirectories of the orphan directory.  These entries will exist if
      * they were added before their parent directory was added to the orphan directory. */
     for (i = 0; i < a_fs_dir->names_used; i++) {
-        if (tsk_list_find(data.orphan_subdir_list,
+        if (tsk_fs_inum_set_find(data.orphan_subdir_set,
                 a_fs_dir->names[i].meta_addr)) {
+            // the strings are in the same arena, so just move them
             if (a_fs_dir->names_used > 1) {
-                tsk_fs_name_copy(&a_fs_dir->names[i],
-                    &a_fs_dir->names[a_fs_dir->names_used - 1]);
+                a_fs_dir->names[i] =
+                    a_fs_dir->names[a_fs_dir->names_used - 1];
             }
             tsk_fs_dir_free_name_internal(&a_fs_dir->names[a_fs_dir->names_used-1]);
             a_fs_dir->names_used--;
+            tsk_fs_dir_index_free(a_fs_dir);
         }
     }
 
-    if (data.orphan_subdir_list) {
-        tsk_list_free(data.orphan_subdir_list);
-        data.orphan_subdir_list = NULL;
-    }
+    tsk_fs_inum_set_free(data.orphan_subdir_set);
+    data.orphan_subdir_set = NULL;
 
 
     // make copy of this so that we don't need to do it again.
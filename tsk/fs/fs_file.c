@@ -348,7 +348,8 @@ tsk_fs_file_attr_get_id(TSK_FS_FILE * a_fs_file, uint16_t a_id)
 /**
 * \ingroup fslib
  * Process a specific attribute in a file and call a callback function with the file contents. The callback will be 
- * called with chunks of data that are fs->block_size or less.  The address given in the callback
+ * called with chunks of data that are fs->block_size or less (see TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS
+ * for larger chunks).  The address given in the callback
  * will be correct only for raw files (when the raw file contents were stored in the block).  For
  * compressed and sparse files, the address may be zero. If the file system you are analyzing does
  * not have multiple attributes per file, then you can use tsk_fs_file_walk().  For incomplete or 
@@ -405,7 +406,8 @@ tsk_fs_file_walk_type(TSK_FS_FILE * a_fs_file,
 /**
 * \ingroup fslib
  * Process a file and call a callback function with the file contents. The callback will be 
- * called with chunks of data that are fs->block_size or less.  The address given in the callback
+ * called with chunks of data that are fs->block_size or less (see TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS
+ * for larger chunks).  The address given in the callback
  * will be correct only for raw files (when the raw file contents were stored in the block).  For
  * compressed and sparse files, the address may be zero.  If a file has multiple attributes,
  * such as NTFS files, this  function uses the default one ($DATA for files, $IDX_ROOT for directories).
@@ -18,6 +18,8 @@
  * structures
  */
 #include "tsk_fs_i.h"
+#include "tsk_ffs.h"
+#include "tsk_ext2fs.h"
 
 /**
  * Contains the short (1 character) name of the file type
@@ -196,3 +198,375 @@ tsk_fs_meta_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_start,
 
     return a_fs->inode_walk(a_fs, a_start, a_end, a_flags, a_cb, a_ptr);
 }
+
+
+/* State of a tsk_fs_meta_walk_batch() */
+typedef struct {
+    TSK_FS_META_BATCH batch;
+    TSK_FS_META_WALK_BATCH_CB cb;
+    void *ptr;
+    TSK_WALK_RET_ENUM cb_ret;   // Return value of the last batch callback
+} META_WALK_BATCH;
+
+/* inode walk callback for tsk_fs_meta_walk_batch().  Copies the fields
+ * of the file into the next record and calls the batch callback when the
+ * batch is full. */
+static TSK_WALK_RET_ENUM
+meta_walk_batch_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    META_WALK_BATCH *data = (META_WALK_BATCH *) a_ptr;
+    TSK_FS_META_BATCH *batch = &data->batch;
+    const TSK_FS_META *fs_meta = a_fs_file->meta;
+    size_t i = batch->count;
+
+    batch->addr[i] = fs_meta->addr;
+    batch->flags[i] = fs_meta->flags;
+    batch->type[i] = fs_meta->type;
+    batch->mode[i] = fs_meta->mode;
+    batch->size[i] = fs_meta->size;
+    batch->mtime[i] = fs_meta->mtime;
+    batch->atime[i] = fs_meta->atime;
+    batch->ctime[i] = fs_meta->ctime;
+    batch->crtime[i] = fs_meta->crtime;
+    batch->uid[i] = fs_meta->uid;
+    batch->gid[i] = fs_meta->gid;
+
+    if (++batch->count < TSK_FS_META_BATCH_SIZE)
+        return TSK_WALK_CONT;
+
+    data->cb_ret = data->cb(batch, data->ptr);
+    batch->count = 0;
+    return data->cb_ret;
+}
+
+/**
+ * \ingroup fslib
+ * Walk a range of metadata structures like tsk_fs_meta_walk(), but call
+ * the callback with batches of compact records instead of once per file.
+ * This saves the per-file call overhead for callers that only need the
+ * basic fields of each file (such as timeline generation).
+ *
+ * @param a_fs File system to process
+ * @param a_start Metadata address to start walking from
+ * @param a_end Metadata address to walk to
+ * @param a_flags Flags that specify the desired metadata features
+ * @param a_cb Callback function to call with each batch
+ * @param a_ptr Pointer to pass to the callback
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_meta_walk_batch(TSK_FS_INFO * a_fs, TSK_INUM_T a_start,
+    TSK_INUM_T a_end, TSK_FS_META_FLAG_ENUM a_flags,
+    TSK_FS_META_WALK_BATCH_CB a_cb, void *a_ptr)
+{
+    META_WALK_BATCH data;
+    TSK_FS_META_BATCH *batch = &data.batch;
+    const size_t n = TSK_FS_META_BATCH_SIZE;
+    char *buf;
+    uint8_t retval;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_meta_walk_batch: called with NULL or unallocated structures");
+        return 1;
+    }
+
+    /* Allocate all of the arrays in one buffer.  The 8-byte fields go
+     * first so that each array is aligned. */
+    if ((buf = (char *) tsk_malloc(n * (sizeof(TSK_INUM_T) +
+                    sizeof(TSK_OFF_T) + 4 * sizeof(time_t) +
+                    sizeof(TSK_FS_META_FLAG_ENUM) +
+                    sizeof(TSK_FS_META_TYPE_ENUM) +
+                    sizeof(TSK_FS_META_MODE_ENUM) + sizeof(TSK_UID_T) +
+                    sizeof(TSK_GID_T)))) == NULL)
+        return 1;
+
+    memset(&data, 0, sizeof(data));
+    batch->addr = (TSK_INUM_T *) buf;
+    batch->size = (TSK_OFF_T *) & batch->addr[n];
+    batch->mtime = (time_t *) & batch->size[n];
+    batch->atime = &batch->mtime[n];
+    batch->ctime = &batch->atime[n];
+    batch->crtime = &batch->ctime[n];
+    batch->flags = (TSK_FS_META_FLAG_ENUM *) & batch->crtime[n];
+    batch->type = (TSK_FS_META_TYPE_ENUM *) & batch->flags[n];
+    batch->mode = (TSK_FS_META_MODE_ENUM *) & batch->type[n];
+    batch->uid = (TSK_UID_T *) & batch->mode[n];
+    batch->gid = (TSK_GID_T *) & batch->uid[n];
+    data.cb = a_cb;
+    data.ptr = a_ptr;
+    data.cb_ret = TSK_WALK_CONT;
+
+    retval = a_fs->inode_walk(a_fs, a_start, a_end, a_flags,
+        meta_walk_batch_act, &data);
+
+    // give the callback the last partial batch
+    if ((retval == 0) && (data.cb_ret == TSK_WALK_CONT)
+        && (batch->count > 0)) {
+        if (a_cb(batch, a_ptr) == TSK_WALK_ERROR)
+            retval = 1;
+    }
+
+    free(buf);
+    return retval;
+}
+
+
+#define META_WALK_PAR_RANGE     8192    // Number of addresses that a thread walks at a time (rounded up to whole groups)
+#define META_WALK_PAR_CHECK     1024    // Number of callbacks between checks if the walk stopped
+
+typedef struct META_WALK_PAR META_WALK_PAR;
+
+/* Argument of a thread of a parallel meta walk */
+typedef struct {
+    META_WALK_PAR *walk;
+    int thread;                 // Index that is given to the callback
+    int calls;                  // Callbacks since the last check if the walk stopped
+    uint8_t stopped;            // 1 if the callback returned STOP
+} META_WALK_PAR_ARG;
+
+/* State of a parallel meta walk */
+struct META_WALK_PAR {
+    TSK_FS_INFO *fs;
+    TSK_FS_META_FLAG_ENUM flags;
+    TSK_FS_META_WALK_PAR_CB cb;
+    void *ptr;
+
+    TSK_INUM_T range;           // Number of addresses that a thread walks at a time
+    TSK_INUM_T group_len;       // Number of inodes in a block or cylinder group (0 if there are no groups)
+    TSK_INUM_T group_first;     // First address of the first group
+
+    tsk_lock_t lock;            // protects the fields below
+    TSK_INUM_T next;            // Next address to give to a thread
+    TSK_INUM_T end;             // Last address of the walk
+    uint8_t done;               // 1 when all addresses were given out or the walk stopped
+    uint8_t stopped;            // 1 if a thread stopped or had an error
+    uint8_t failed;             // 1 if a thread had an error
+    TSK_ERROR_INFO error;       // Error of the first thread that failed
+};
+
+/* inode_walk callback of a thread of a parallel meta walk */
+static TSK_WALK_RET_ENUM
+meta_walk_par_act(TSK_FS_FILE * a_fs_file, void *a_ptr)
+{
+    META_WALK_PAR_ARG *arg = (META_WALK_PAR_ARG *) a_ptr;
+    META_WALK_PAR *walk = arg->walk;
+    TSK_WALK_RET_ENUM retval;
+
+    // stop this range early if another thread stopped the walk
+    if (++arg->calls >= META_WALK_PAR_CHECK) {
+        uint8_t stopped;
+
+        arg->calls = 0;
+        tsk_take_lock(&walk->lock);
+        stopped = walk->stopped;
+        tsk_release_lock(&walk->lock);
+        if (stopped) {
+            arg->stopped = 1;
+            return TSK_WALK_STOP;
+        }
+    }
+
+    retval = walk->cb(a_fs_file, arg->thread, walk->ptr);
+    if (retval == TSK_WALK_STOP)
+        arg->stopped = 1;
+    return retval;
+}
+
+/* The main loop of a thread of a parallel meta walk.  Walks ranges of
+ * addresses until there are none left or the walk stops. */
+static void
+meta_walk_par_main(void *a_ptr)
+{
+    META_WALK_PAR_ARG *arg = (META_WALK_PAR_ARG *) a_ptr;
+    META_WALK_PAR *walk = arg->walk;
+
+    while (arg->stopped == 0) {
+        TSK_INUM_T start, end;
+
+        tsk_take_lock(&walk->lock);
+        if (walk->done) {
+            tsk_release_lock(&walk->lock);
+            break;
+        }
+        start = walk->next;
+        if (walk->end - start < walk->range) {
+            end = walk->end;
+        }
+        else {
+            end = start + walk->range - 1;
+
+            /* End at the end of a group so that two threads do not load
+             * the same group.  Only the first range is shorter (if the
+             * walk does not start at the start of a group). */
+            if (walk->group_len)
+                end -= (end + 1 - walk->group_first) % walk->group_len;
+        }
+        if (end == walk->end)
+            walk->done = 1;
+        walk->next = end + 1;
+        tsk_release_lock(&walk->lock);
+
+        if (walk->fs->inode_walk(walk->fs, start, end, walk->flags,
+                meta_walk_par_act, arg)) {
+            TSK_ERROR_INFO *error = tsk_error_get_info();
+
+            tsk_take_lock(&walk->lock);
+            if ((walk->failed == 0) && (error)) {
+                walk->error = *error;
+            }
+            walk->failed = 1;
+            walk->stopped = 1;
+            walk->done = 1;
+            tsk_release_lock(&walk->lock);
+            break;
+        }
+    }
+
+    // make the other threads stop early
+    if (arg->stopped) {
+        tsk_take_lock(&walk->lock);
+        walk->stopped = 1;
+        walk->done = 1;
+        tsk_release_lock(&walk->lock);
+    }
+}
+
+/**
+ * \ingroup fslib
+ * Walk a range of metadata structures like tsk_fs_meta_walk(), but split
+ * the range between a pool of threads.  Each thread walks a range of
+ * addresses at a time and the callback is called from all of the threads
+ * at the same time (so it must be thread safe), with the index of the
+ * thread so that the caller can keep per-thread state.  The order of the
+ * callbacks is not defined.  If the callback returns TSK_WALK_STOP, the
+ * other threads stop soon after.
+ *
+ * The ExtX, FFS, and NTFS walks are safe to run in parallel.  The other
+ * file systems are walked by the calling thread.  For ExtX and FFS, the
+ * ranges end at the end of a block or cylinder group.
+ *
+ * @param a_fs File system to process
+ * @param a_start Metadata address to start walking from
+ * @param a_end Metadata address to walk to
+ * @param a_flags Flags that specify the desired metadata features
+ * @param a_cb Callback function to call
+ * @param a_ptr Pointer to pass to the callback
+ * @param a_num_threads Number of threads to use, including the calling thread (0 for TSK_FS_META_WALK_THREADS_DEFAULT)
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_meta_walk_parallel(TSK_FS_INFO * a_fs, TSK_INUM_T a_start,
+    TSK_INUM_T a_end, TSK_FS_META_FLAG_ENUM a_flags,
+    TSK_FS_META_WALK_PAR_CB a_cb, void *a_ptr, int a_num_threads)
+{
+    META_WALK_PAR walk;
+    META_WALK_PAR_ARG *args;
+    tsk_thread_t *threads;
+    int num_started = 0;
+    int i;
+
+    if ((a_fs == NULL) || (a_fs->tag != TSK_FS_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_ARG);
+        tsk_error_set_errstr
+            ("tsk_fs_meta_walk_parallel: called with NULL or unallocated structures");
+        return 1;
+    }
+
+    if ((a_start < a_fs->first_inum) || (a_start > a_fs->last_inum)
+        || (a_end < a_start) || (a_end > a_fs->last_inum)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_WALK_RNG);
+        tsk_error_set_errstr("tsk_fs_meta_walk_parallel: range: %"
+            PRIuINUM " to %" PRIuINUM, a_start, a_end);
+        return 1;
+    }
+
+    if (a_num_threads <= 0)
+        a_num_threads = TSK_FS_META_WALK_THREADS_DEFAULT;
+    if ((TSK_FS_TYPE_ISEXT(a_fs->ftype) == 0)
+        && (TSK_FS_TYPE_ISFFS(a_fs->ftype) == 0)
+        && (TSK_FS_TYPE_ISNTFS(a_fs->ftype) == 0))
+        a_num_threads = 1;
+
+    /* Load the list of named files before the threads start so that
+     * they do not all do it. */
+    if (a_flags & TSK_FS_META_FLAG_ORPHAN) {
+        if (tsk_fs_dir_load_inum_named(a_fs) != TSK_OK) {
+            tsk_error_errstr2_concat
+                ("- tsk_fs_meta_walk_parallel: identifying inodes allocated by file names");
+            return 1;
+        }
+    }
+
+    if ((args = (META_WALK_PAR_ARG *) tsk_malloc(a_num_threads *
+                sizeof(META_WALK_PAR_ARG))) == NULL)
+        return 1;
+    if ((threads = (tsk_thread_t *) tsk_malloc(a_num_threads *
+                sizeof(tsk_thread_t))) == NULL) {
+        free(args);
+        return 1;
+    }
+
+    memset(&walk, 0, sizeof(META_WALK_PAR));
+    walk.fs = a_fs;
+    walk.flags = a_flags;
+    walk.cb = a_cb;
+    walk.ptr = a_ptr;
+    walk.next = a_start;
+    walk.end = a_end;
+    walk.range = META_WALK_PAR_RANGE;
+    if (TSK_FS_TYPE_ISEXT(a_fs->ftype)) {
+        EXT2FS_INFO *ext2fs = (EXT2FS_INFO *) a_fs;
+        walk.group_len =
+            tsk_getu32(a_fs->endian, ext2fs->fs->s_inodes_per_group);
+        walk.group_first = a_fs->first_inum;
+    }
+    else if (TSK_FS_TYPE_ISFFS(a_fs->ftype)) {
+        FFS_INFO *ffs = (FFS_INFO *) a_fs;
+        int32_t cg_inode_num =
+            tsk_gets32(a_fs->endian, ffs->fs.sb1->cg_inode_num);
+        if (cg_inode_num > 0)
+            walk.group_len = cg_inode_num;
+        walk.group_first = 0;
+    }
+    if (walk.group_len) {
+        walk.range += walk.group_len - 1;
+        walk.range -= walk.range % walk.group_len;
+    }
+    tsk_init_lock(&walk.lock);
+
+    for (i = 0; i < a_num_threads; i++) {
+        args[i].walk = &walk;
+        args[i].thread = i;
+    }
+
+    // the calling thread is the last one
+    for (i = 0; i < a_num_threads - 1; i++) {
+        if (tsk_thread_create(&threads[i], meta_walk_par_main, &args[i])) {
+            // do the walk with the threads that did start
+            tsk_error_reset();
+            break;
+        }
+        num_started++;
+    }
+    meta_walk_par_main(&args[a_num_threads - 1]);
+
+    for (i = 0; i < num_started; i++)
+        tsk_thread_join(&threads[i]);
+
+    tsk_deinit_lock(&walk.lock);
+    free(threads);
+    free(args);
+
+    if (walk.failed) {
+        TSK_ERROR_INFO *error = tsk_error_get_info();
+        if (error)
+            *error = walk.error;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file fs_inum_set.c
+ * Sets of metadata addresses.  These replace the TSK_LIST that was used to
+ * keep track of the addresses that are pointed to by names when looking
+ * for orphan files.  A TSK_LIST is searched linearly, which made the
+ * orphan search quadratic on large file systems.
+ *
+ * The set is split into chunks of 64K addresses (in the style of a
+ * roaring bitmap) and the chunks are kept in an array sorted by their high
+ * bits.  A chunk with few addresses keeps their low 16 bits in a sorted
+ * array and is changed to a bitmap once the array would be as big as the
+ * bitmap (8KB).  This keeps the set small for file systems with sparse or
+ * 64-bit addresses (such as XFS) while lookups stay a binary search over
+ * the chunks and then a binary search or a bit test inside the chunk.
+ */
+
+#include "tsk_fs_i.h"
+
+#define TSK_FS_INUM_SET_CHUNK_BITS  16
+#define TSK_FS_INUM_SET_CHUNK_WORDS \
+    ((1 << TSK_FS_INUM_SET_CHUNK_BITS) / 64)
+/* Most addresses that a chunk keeps in an array (the array is then the
+ * same size as the bitmap) */
+#define TSK_FS_INUM_SET_ARRAY_MAX   \
+    (TSK_FS_INUM_SET_CHUNK_WORDS * sizeof(uint64_t) / sizeof(uint16_t))
+
+typedef struct {
+    TSK_INUM_T key;             // Address >> TSK_FS_INUM_SET_CHUNK_BITS
+    uint16_t *vals;             // Sorted low bits of the addresses (NULL if bits is used)
+    uint64_t *bits;             // Bitmap of the addresses (NULL if vals is used)
+    size_t vals_used;           // Number of entries in vals
+    size_t vals_alloc;
+} TSK_FS_INUM_SET_CHUNK;
+
+struct TSK_FS_INUM_SET {
+    TSK_FS_INUM_SET_CHUNK *chunks;      // Sorted by key
+    size_t chunks_used;
+    size_t chunks_alloc;
+    TSK_INUM_T count;           // Number of addresses in the set
+};
+
+
+/** \internal
+ * Allocate an empty set of metadata addresses.
+ * @returns NULL on error
+ */
+TSK_FS_INUM_SET *
+tsk_fs_inum_set_alloc()
+{
+    return (TSK_FS_INUM_SET *) tsk_malloc(sizeof(TSK_FS_INUM_SET));
+}
+
+/** \internal
+ * Free a set of metadata addresses.
+ * @param a_set Set to free (can be NULL)
+ */
+void
+tsk_fs_inum_set_free(TSK_FS_INUM_SET * a_set)
+{
+    size_t i;
+
+    if (a_set == NULL)
+        return;
+
+    for (i = 0; i < a_set->chunks_used; i++) {
+        free(a_set->chunks[i].vals);
+        free(a_set->chunks[i].bits);
+    }
+    free(a_set->chunks);
+    free(a_set);
+}
+
+/* Find the chunk for a key or the index where it should be inserted.
+ * @returns 1 if the chunk exists */
+static uint8_t
+tsk_fs_inum_set_search(const TSK_FS_INUM_SET * a_set, TSK_INUM_T a_key,
+    size_t * a_idx)
+{
+    size_t lo = 0, hi = a_set->chunks_used;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_set->chunks[mid].key < a_key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *a_idx = lo;
+    return ((lo < a_set->chunks_used) && (a_set->chunks[lo].key == a_key));
+}
+
+/* Find the first entry in the array of a chunk that is at least a_val.
+ * @returns 1 if that entry is a_val */
+static uint8_t
+tsk_fs_inum_set_chunk_search(const TSK_FS_INUM_SET_CHUNK * a_chunk,
+    uint16_t a_val, size_t * a_idx)
+{
+    size_t lo = 0, hi = a_chunk->vals_used;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a_chunk->vals[mid] < a_val)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *a_idx = lo;
+    return ((lo < a_chunk->vals_used) && (a_chunk->vals[lo] == a_val));
+}
+
+/* Change a chunk from an array to a bitmap.
+ * @returns 1 on error */
+static uint8_t
+tsk_fs_inum_set_chunk_to_bits(TSK_FS_INUM_SET_CHUNK * a_chunk)
+{
+    size_t i;
+
+    if ((a_chunk->bits = (uint64_t *) tsk_malloc(TSK_FS_INUM_SET_CHUNK_WORDS
+                * sizeof(uint64_t))) == NULL)
+        return 1;
+
+    for (i = 0; i < a_chunk->vals_used; i++)
+        a_chunk->bits[a_chunk->vals[i] / 64] |=
+            ((uint64_t) 1 << (a_chunk->vals[i] % 64));
+    free(a_chunk->vals);
+    a_chunk->vals = NULL;
+    a_chunk->vals_used = 0;
+    a_chunk->vals_alloc = 0;
+    return 0;
+}
+
+/** \internal
+ * Add a metadata address to a set.
+ * @param a_set Set to add to
+ * @param a_inum Address to add
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_fs_inum_set_add(TSK_FS_INUM_SET * a_set, TSK_INUM_T a_inum)
+{
+    TSK_INUM_T key = a_inum >> TSK_FS_INUM_SET_CHUNK_BITS;
+    uint16_t val =
+        (uint16_t) (a_inum & ((1 << TSK_FS_INUM_SET_CHUNK_BITS) - 1));
+    TSK_FS_INUM_SET_CHUNK *chunk;
+    size_t idx;
+
+    if (tsk_fs_inum_set_search(a_set, key, &idx) == 0) {
+        if (a_set->chunks_used == a_set->chunks_alloc) {
+            size_t cnt = a_set->chunks_alloc ? a_set->chunks_alloc * 2 : 16;
+            TSK_FS_INUM_SET_CHUNK *chunks;
+
+            if ((chunks = (TSK_FS_INUM_SET_CHUNK *)
+                    tsk_realloc(a_set->chunks,
+                        cnt * sizeof(TSK_FS_INUM_SET_CHUNK))) == NULL)
+                return 1;
+            a_set->chunks = chunks;
+            a_set->chunks_alloc = cnt;
+        }
+
+        memmove(&a_set->chunks[idx + 1], &a_set->chunks[idx],
+            (a_set->chunks_used - idx) * sizeof(TSK_FS_INUM_SET_CHUNK));
+        memset(&a_set->chunks[idx], 0, sizeof(TSK_FS_INUM_SET_CHUNK));
+        a_set->chunks[idx].key = key;
+        a_set->chunks_used++;
+    }
+    chunk = &a_set->chunks[idx];
+
+    if (chunk->bits == NULL) {
+        size_t pos;
+
+        if (tsk_fs_inum_set_chunk_search(chunk, val, &pos))
+            return 0;
+
+        if (chunk->vals_used < TSK_FS_INUM_SET_ARRAY_MAX) {
+            if (chunk->vals_used == chunk->vals_alloc) {
+                size_t cnt = chunk->vals_alloc ? chunk->vals_alloc * 2 : 4;
+                uint16_t *vals;
+
+                if (cnt > TSK_FS_INUM_SET_ARRAY_MAX)
+                    cnt = TSK_FS_INUM_SET_ARRAY_MAX;
+                if ((vals = (uint16_t *) tsk_realloc(chunk->vals,
+                            cnt * sizeof(uint16_t))) == NULL)
+                    return 1;
+                chunk->vals = vals;
+                chunk->vals_alloc = cnt;
+            }
+            memmove(&chunk->vals[pos + 1], &chunk->vals[pos],
+                (chunk->vals_used - pos) * sizeof(uint16_t));
+            chunk->vals[pos] = val;
+            chunk->vals_used++;
+            a_set->count++;
+            return 0;
+        }
+
+        // the array is full, so the bitmap is now smaller
+        if (tsk_fs_inum_set_chunk_to_bits(chunk))
+            return 1;
+    }
+
+    if ((chunk->bits[val / 64] & ((uint64_t) 1 << (val % 64))) == 0) {
+        chunk->bits[val / 64] |= ((uint64_t) 1 << (val % 64));
+        a_set->count++;
+    }
+    return 0;
+}
+
+/** \internal
+ * Test if a metadata address is in a set.
+ * @param a_set Set to search (can be NULL)
+ * @param a_inum Address to look for
+ * @returns 1 if the address is in the set and 0 if not
+ */
+uint8_t
+tsk_fs_inum_set_find(const TSK_FS_INUM_SET * a_set, TSK_INUM_T a_inum)
+{
+    uint16_t val =
+        (uint16_t) (a_inum & ((1 << TSK_FS_INUM_SET_CHUNK_BITS) - 1));
+    const TSK_FS_INUM_SET_CHUNK *chunk;
+    size_t idx;
+
+    if ((a_set == NULL) || (a_set->count == 0))
+        return 0;
+
+    if (tsk_fs_inum_set_search(a_set,
+            a_inum >> TSK_FS_INUM_SET_CHUNK_BITS, &idx) == 0)
+        return 0;
+
+    chunk = &a_set->chunks[idx];
+    if (chunk->bits == NULL)
+        return tsk_fs_inum_set_chunk_search(chunk, val, &idx);
+    return (chunk->bits[val / 64] >> (val % 64)) & 1;
+}
+
+/** \internal
+ * @param a_set Set to count (can be NULL)
+ * @returns Number of metadata addresses in a set
+ */
+TSK_INUM_T
+tsk_fs_inum_set_count(const TSK_FS_INUM_SET * a_set)
+{
+    return a_set ? a_set->count : 0;
+}
+
+/** \internal
+ * Find the smallest metadata address in a set that is at least a_inum.
+ * Used to go through a set in order.
+ * @param a_set Set to search (can be NULL)
+ * @param a_inum Address to start at
+ * @param a_next [out] Address that was found
+ * @returns 1 if an address was found and 0 if not
+ */
+uint8_t
+tsk_fs_inum_set_next(const TSK_FS_INUM_SET * a_set, TSK_INUM_T a_inum,
+    TSK_INUM_T * a_next)
+{
+    size_t bit = (size_t) (a_inum & ((1 << TSK_FS_INUM_SET_CHUNK_BITS) - 1));
+    size_t idx;
+
+    if ((a_set == NULL) || (a_set->count == 0))
+        return 0;
+
+    // start at the beginning of the next chunk if a_inum's chunk is empty
+    if (tsk_fs_inum_set_search(a_set,
+            a_inum >> TSK_FS_INUM_SET_CHUNK_BITS, &idx) == 0)
+        bit = 0;
+
+    for (; idx < a_set->chunks_used; idx++, bit = 0) {
+        const TSK_FS_INUM_SET_CHUNK *chunk = &a_set->chunks[idx];
+        const uint64_t *bits = chunk->bits;
+        size_t w = bit / 64;
+        uint64_t word;
+
+        if (bits == NULL) {
+            size_t pos;
+
+            tsk_fs_inum_set_chunk_search(chunk, (uint16_t) bit, &pos);
+            if (pos == chunk->vals_used)
+                continue;
+            *a_next = (chunk->key << TSK_FS_INUM_SET_CHUNK_BITS) |
+                chunk->vals[pos];
+            return 1;
+        }
+
+        word = bits[w] & (~(uint64_t) 0 << (bit % 64));
+        while (1) {
+            if (word) {
+                size_t b = 0;
+                while ((word & 1) == 0) {
+                    word >>= 1;
+                    b++;
+                }
+                *a_next = (chunk->key << TSK_FS_INUM_SET_CHUNK_BITS) |
+                    (w * 64 + b);
+                return 1;
+            }
+            if (++w == TSK_FS_INUM_SET_CHUNK_WORDS)
+                break;
+            word = bits[w];
+        }
+    }
+    return 0;
+}
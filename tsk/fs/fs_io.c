@@ -119,6 +119,61 @@ tsk_fs_read(TSK_FS_INFO * a_fs, TSK_OFF_T a_off, char *a_buf, size_t a_len)
 }
 
 
+/**
+ * \ingroup fslib
+ * Read several ranges of data from inside of the file system.  The ranges
+ * are read with tsk_img_readv(), which sorts them and merges the ones that
+ * are close together into single reads of the image.
+ * @param a_fs The file system handle.
+ * @param a_vecs The ranges to read, with byte offsets relative to the start
+ * of the file system (their cnt values are set)
+ * @param a_num_vecs The number of entries in a_vecs
+ * @return The total number of bytes read or -1 on error.
+ */
+ssize_t
+tsk_fs_readv(TSK_FS_INFO * a_fs, TSK_IMG_IOVEC * a_vecs, size_t a_num_vecs)
+{
+    ssize_t retval;
+    size_t total = 0;
+    size_t i;
+    uint8_t each = 0;
+
+    /* Ranges past the end of the file system and images with pre and post
+     * bytes in each block are read one at a time by tsk_fs_read(), which
+     * reports the errors and maps the offsets. */
+    if (((a_fs->block_pre_size) || (a_fs->block_post_size))
+        && (a_fs->block_size))
+        each = 1;
+    for (i = 0; (i < a_num_vecs) && (each == 0); i++) {
+        if ((a_fs->last_block_act > 0)
+            && ((TSK_DADDR_T) a_vecs[i].off >=
+                ((a_fs->last_block_act + 1) * a_fs->block_size)))
+            each = 1;
+    }
+
+    if (each) {
+        uint8_t failed = 0;
+
+        for (i = 0; i < a_num_vecs; i++) {
+            a_vecs[i].cnt =
+                tsk_fs_read(a_fs, a_vecs[i].off, a_vecs[i].buf,
+                a_vecs[i].len);
+            if (a_vecs[i].cnt < 0)
+                failed = 1;
+            else
+                total += (size_t) a_vecs[i].cnt;
+        }
+        return failed ? -1 : (ssize_t) total;
+    }
+
+    // move the ranges into the image and back again afterwards
+    for (i = 0; i < a_num_vecs; i++)
+        a_vecs[i].off += a_fs->offset;
+    retval = tsk_img_readv(a_fs->img_info, a_vecs, a_num_vecs);
+    for (i = 0; i < a_num_vecs; i++)
+        a_vecs[i].off -= a_fs->offset;
+    return retval;
+}
 /**
  * \ingroup fslib
  * Read a file system block into a char* buffer.  
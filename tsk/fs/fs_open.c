@@ -228,8 +228,11 @@ tsk_fs_malloc(size_t a_len)
         return NULL;
     tsk_init_lock(&fs_info->list_inum_named_lock);
     tsk_init_lock(&fs_info->orphan_dir_lock);
+    tsk_init_lock(&fs_info->pool_lock);
+    tsk_init_lock(&fs_info->run_table_lock);
 
     fs_info->list_inum_named = NULL;
+    fs_info->inum_named = NULL;
 
     return fs_info;
 }
@@ -244,6 +247,14 @@ tsk_fs_free(TSK_FS_INFO * a_fs_info)
         tsk_list_free(a_fs_info->list_inum_named);
         a_fs_info->list_inum_named = NULL;
     }
+    if (a_fs_info->inum_named) {
+        tsk_fs_inum_set_free(a_fs_info->inum_named);
+        a_fs_info->inum_named = NULL;
+    }
+    if (a_fs_info->orphan_candidates) {
+        tsk_fs_inum_set_free(a_fs_info->orphan_candidates);
+        a_fs_info->orphan_candidates = NULL;
+    }
 
     /* we should probably get the lock, but we're 
      * about to kill the entire object so there are
@@ -253,10 +264,17 @@ tsk_fs_free(TSK_FS_INFO * a_fs_info)
         tsk_fs_dir_close(a_fs_info->orphan_dir);
         a_fs_info->orphan_dir = NULL;
     }
+    tsk_fs_pool_free(a_fs_info);
+    if (a_fs_info->block_index) {
+        tsk_fs_block_index_free(a_fs_info->block_index);
+        a_fs_info->block_index = NULL;
+    }
 
 
     tsk_deinit_lock(&a_fs_info->list_inum_named_lock);
     tsk_deinit_lock(&a_fs_info->orphan_dir_lock);
+    tsk_deinit_lock(&a_fs_info->pool_lock);
+    tsk_deinit_lock(&a_fs_info->run_table_lock);
 
     free(a_fs_info);
 }
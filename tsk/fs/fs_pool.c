@@ -0,0 +1,201 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file fs_pool.c
+ * Free lists of the structures that walks create for every file.  A walk
+ * over a large file system used to allocate and free a TSK_FS_META (with
+ * its content buffer, attribute list, attributes, and names) for each
+ * directory entry and a TSK_FS_ATTR_RUN for each run of each file.  The
+ * walks now give these structures back to a pool in the TSK_FS_INFO and
+ * the next file reuses them.
+ *
+ * A TSK_FS_META is kept whole so that the attribute list and attributes
+ * that hang off of it (and their name and resident data buffers) are
+ * recycled with it.  Its runs are moved to the run list of the pool
+ * because the run lists are built before the attributes they go into.
+ *
+ * Pooled structures are allocated one at a time with tsk_malloc(), so
+ * code that does not know about the pool can still free() them.
+ */
+
+#include "tsk_fs_i.h"
+
+#define TSK_FS_POOL_META_MAX    64      ///< Max number of TSK_FS_META structures to keep
+#define TSK_FS_POOL_RUN_MAX     4096    ///< Max number of TSK_FS_ATTR_RUN structures to keep
+
+struct TSK_FS_POOL {
+    TSK_FS_META *metas[TSK_FS_POOL_META_MAX];
+    size_t metas_used;
+    TSK_FS_ATTR_RUN *runs;      // Linked through next
+    size_t runs_used;
+};
+
+
+/* Get the pool of a file system, allocating it if needed.
+ * Caller must hold pool_lock.  Returns NULL on error (with no
+ * error set, the pool is only an optimization). */
+static TSK_FS_POOL *
+tsk_fs_pool_get(TSK_FS_INFO * a_fs)
+{
+    if (a_fs->pool == NULL)
+        a_fs->pool = (TSK_FS_POOL *) calloc(1, sizeof(TSK_FS_POOL));
+    return a_fs->pool;
+}
+
+/** \internal
+ * Free the pool of a file system and everything in it.  Called when the
+ * file system is closed.
+ * @param a_fs File system
+ */
+void
+tsk_fs_pool_free(TSK_FS_INFO * a_fs)
+{
+    TSK_FS_POOL *pool = a_fs->pool;
+    size_t i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < pool->metas_used; i++)
+        tsk_fs_meta_close(pool->metas[i]);
+    tsk_fs_attr_run_free(pool->runs);
+    free(pool);
+    a_fs->pool = NULL;
+}
+
+/** \internal
+ * Get a run from the pool of a file system.  Use in place of
+ * tsk_fs_attr_run_alloc() by code that has the file system.
+ * @param a_fs File system
+ * @returns Cleared run or NULL on error
+ */
+TSK_FS_ATTR_RUN *
+tsk_fs_pool_get_run(TSK_FS_INFO * a_fs)
+{
+    TSK_FS_ATTR_RUN *fs_attr_run = NULL;
+
+    tsk_take_lock(&a_fs->pool_lock);
+    if ((a_fs->pool) && (a_fs->pool->runs)) {
+        fs_attr_run = a_fs->pool->runs;
+        a_fs->pool->runs = fs_attr_run->next;
+        a_fs->pool->runs_used--;
+    }
+    tsk_release_lock(&a_fs->pool_lock);
+
+    if (fs_attr_run == NULL)
+        return tsk_fs_attr_run_alloc();
+
+    memset(fs_attr_run, 0, sizeof(TSK_FS_ATTR_RUN));
+    return fs_attr_run;
+}
+
+/** \internal
+ * Give a list of runs to the pool of a file system.  Use in place of
+ * tsk_fs_attr_run_free() by code that has the file system.
+ * @param a_fs File system
+ * @param a_fs_attr_run Head of the list (can be NULL)
+ */
+void
+tsk_fs_pool_put_runs(TSK_FS_INFO * a_fs, TSK_FS_ATTR_RUN * a_fs_attr_run)
+{
+    TSK_FS_POOL *pool;
+
+    if (a_fs_attr_run == NULL)
+        return;
+
+    tsk_take_lock(&a_fs->pool_lock);
+    pool = tsk_fs_pool_get(a_fs);
+    while ((pool) && (a_fs_attr_run)
+        && (pool->runs_used < TSK_FS_POOL_RUN_MAX)) {
+        TSK_FS_ATTR_RUN *next = a_fs_attr_run->next;
+        a_fs_attr_run->next = pool->runs;
+        pool->runs = a_fs_attr_run;
+        pool->runs_used++;
+        a_fs_attr_run = next;
+    }
+    tsk_release_lock(&a_fs->pool_lock);
+
+    // the pool is full
+    tsk_fs_attr_run_free(a_fs_attr_run);
+}
+
+/** \internal
+ * Move the runs of the attributes of a TSK_FS_META structure to the pool
+ * of a file system.  Walks that reuse one TSK_FS_META call this before
+ * they load the next file into it so that the runs are reused instead
+ * of being freed when the attributes are cleared.
+ * @param a_fs File system
+ * @param a_fs_meta Structure with the attributes (can be NULL)
+ */
+void
+tsk_fs_pool_put_meta_runs(TSK_FS_INFO * a_fs, TSK_FS_META * a_fs_meta)
+{
+    TSK_FS_ATTR *fs_attr;
+
+    if ((a_fs_meta == NULL) || (a_fs_meta->attr == NULL))
+        return;
+
+    for (fs_attr = a_fs_meta->attr->head; fs_attr; fs_attr = fs_attr->next) {
+        tsk_fs_attr_run_table_free(fs_attr);
+        if (fs_attr->nrd.run) {
+            tsk_fs_pool_put_runs(a_fs, fs_attr->nrd.run);
+            fs_attr->nrd.run = NULL;
+            fs_attr->nrd.run_end = NULL;
+        }
+    }
+}
+
+/** \internal
+ * Get a TSK_FS_META structure from the pool of a file system.  It has
+ * been reset and can be given to file_add_meta().
+ * @param a_fs File system
+ * @returns NULL if the pool is empty
+ */
+TSK_FS_META *
+tsk_fs_pool_get_meta(TSK_FS_INFO * a_fs)
+{
+    TSK_FS_META *fs_meta = NULL;
+
+    tsk_take_lock(&a_fs->pool_lock);
+    if ((a_fs->pool) && (a_fs->pool->metas_used > 0))
+        fs_meta = a_fs->pool->metas[--a_fs->pool->metas_used];
+    tsk_release_lock(&a_fs->pool_lock);
+
+    if (fs_meta)
+        tsk_fs_meta_reset(fs_meta);
+    return fs_meta;
+}
+
+/** \internal
+ * Give a TSK_FS_META structure to the pool of a file system.  Use in
+ * place of tsk_fs_meta_close() for structures that were loaded by
+ * file_add_meta() of the same file system.
+ * @param a_fs File system
+ * @param a_fs_meta Structure to give (can be NULL)
+ */
+void
+tsk_fs_pool_put_meta(TSK_FS_INFO * a_fs, TSK_FS_META * a_fs_meta)
+{
+    TSK_FS_POOL *pool;
+
+    if ((a_fs_meta == NULL) || (a_fs_meta->tag != TSK_FS_META_TAG))
+        return;
+
+    tsk_fs_pool_put_meta_runs(a_fs, a_fs_meta);
+
+    tsk_take_lock(&a_fs->pool_lock);
+    pool = tsk_fs_pool_get(a_fs);
+    if ((pool) && (pool->metas_used < TSK_FS_POOL_META_MAX)) {
+        pool->metas[pool->metas_used++] = a_fs_meta;
+        a_fs_meta = NULL;
+    }
+    tsk_release_lock(&a_fs->pool_lock);
+
+    // the pool is full
+    if (a_fs_meta)
+        tsk_fs_meta_close(a_fs_meta);
+}
@@ -75,6 +75,9 @@ tsk_fs_icat(TSK_FS_INFO * fs, TSK_INUM_T inum,
         return 1;
     }
 
+    // the content is only written out, so read it in large pieces
+    flags |= TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS;
+
     if (type_used) {
         if (id_used == 0) {
             flags |= TSK_FS_FILE_WALK_FLAG_NOID;
@@ -473,6 +473,17 @@ typedef struct {
 } IFIND_DATA_DATA;
 
 
+static void
+ifind_data_print(TSK_FS_INFO * fs, TSK_INUM_T inum, uint32_t type,
+    uint16_t id)
+{
+    if (TSK_FS_TYPE_ISNTFS(fs->ftype))
+        tsk_printf("%" PRIuINUM "-%" PRIu32 "-%" PRIu16 "\n", inum, type,
+            id);
+    else
+        tsk_printf("%" PRIuINUM "\n", inum);
+}
+
 /*
  * file_walk action for non-ntfs
  */
@@ -489,11 +500,7 @@ ifind_data_file_act(TSK_FS_FILE * fs_file, TSK_OFF_T a_off,
         return TSK_WALK_CONT;
 
     if (addr == data->block) {
-        if (TSK_FS_TYPE_ISNTFS(fs->ftype))
-            tsk_printf("%" PRIuINUM "-%" PRIu32 "-%" PRIu16 "\n",
-                data->curinode, data->curtype, data->curid);
-        else
-            tsk_printf("%" PRIuINUM "\n", data->curinode);
+        ifind_data_print(fs, data->curinode, data->curtype, data->curid);
         data->found = 1;
         return TSK_WALK_STOP;
     }
@@ -553,7 +560,41 @@ ifind_data_act(TSK_FS_FILE * fs_file, void *ptr)
 
 
 /*
- * Find the inode that has allocated block blk
+ * Print the owners of the block from the block index of the file system
+ * (the same owners, in the same order, that the inode walk finds).
+ * Return 1 on error, 0 if no error */
+static uint8_t
+ifind_data_index(TSK_FS_INFO * fs, IFIND_DATA_DATA * data)
+{
+    TSK_FS_BLOCK_INDEX_EXTENT owner;
+    TSK_FS_BLOCK_INDEX_EXTENT *owners;
+    ssize_t cnt, i;
+
+    if ((cnt = tsk_fs_block_index_find(fs->block_index, data->block,
+                &owner, 1)) <= 0)
+        return (cnt < 0);
+
+    data->found = 1;
+    if ((cnt == 1) || (!(data->flags & TSK_FS_IFIND_ALL))) {
+        ifind_data_print(fs, owner.inum, owner.type, owner.id);
+        return 0;
+    }
+
+    if ((owners = (TSK_FS_BLOCK_INDEX_EXTENT *)
+            tsk_malloc((size_t) cnt *
+                sizeof(TSK_FS_BLOCK_INDEX_EXTENT))) == NULL)
+        return 1;
+    cnt = tsk_fs_block_index_find(fs->block_index, data->block, owners,
+        (size_t) cnt);
+    for (i = 0; i < cnt; i++)
+        ifind_data_print(fs, owners[i].inum, owners[i].type, owners[i].id);
+    free(owners);
+    return 0;
+}
+
+/*
+ * Find the inode that has allocated block blk.  The block index of the
+ * file system is used if it has one.
  * Return 1 on error, 0 if no error */
 uint8_t
 tsk_fs_ifind_data(TSK_FS_INFO * fs, TSK_FS_IFIND_FLAG_ENUM lclflags,
@@ -565,7 +606,11 @@ tsk_fs_ifind_data(TSK_FS_INFO * fs, TSK_FS_IFIND_FLAG_ENUM lclflags,
     data.flags = lclflags;
     data.block = blk;
 
-    if (fs->inode_walk(fs, fs->first_inum, fs->last_inum,
+    if (fs->block_index) {
+        if (ifind_data_index(fs, &data))
+            return 1;
+    }
+    else if (fs->inode_walk(fs, fs->first_inum, fs->last_inum,
             TSK_FS_META_FLAG_ALLOC | TSK_FS_META_FLAG_UNALLOC,
             ifind_data_act, &data)) {
         return 1;
@@ -117,6 +117,127 @@ nt2nano(uint64_t ntdate)
 
 
 
+/**
+ * Check and remove the update sequence values of an MFT entry that has
+ * been read into a buffer.  This is done in place.
+ *
+ * @param a_ntfs File system that the entry is from
+ * @param a_buf Buffer with the raw entry.  Must be of size NTFS_INFO.mft_rsize_b
+ *
+ * @returns Error value
+ */
+static TSK_RETVAL_ENUM
+ntfs_dinode_fixup(NTFS_INFO * a_ntfs, char *a_buf)
+{
+    TSK_FS_INFO *fs = (TSK_FS_INFO *) & a_ntfs->fs_info;
+    ntfs_upd *upd;
+    uint16_t sig_seq;
+    ntfs_mft *mft;
+    int i;
+
+    /* Sanity Check */
+#if 0
+    /* This is no longer applied because it caused too many problems
+     * with images that had 0 and 1 etc. as values.  Testing shows that
+     * even Windows XP doesn't care if entries have an invalid entry, so
+     * this is no longer checked.  The update sequence check should find
+     * corrupt entries
+     * */
+    if ((tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC)
+        && (tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC_BAAD)
+        && (tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC_ZERO)) {
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr("entry %d has an invalid MFT magic: %x",
+            mftnum, tsk_getu32(fs->endian, mft->magic));
+        return 1;
+    }
+#endif
+    /* The MFT entries have error and integrity checks in them
+     * called update sequences.  They must be checked and removed
+     * so that later functions can process the data as normal.
+     * They are located in the last 2 bytes of each 512-bytes of data.
+     *
+     * We first verify that the the 2-byte value is a give value and
+     * then replace it with what should be there
+     */
+    /* sanity check so we don't run over in the next loop */
+    mft = (ntfs_mft *) a_buf;
+    if ((tsk_getu16(fs->endian, mft->upd_cnt) > 0) &&
+        (((uint32_t) (tsk_getu16(fs->endian,
+                        mft->upd_cnt) - 1) * NTFS_UPDATE_SEQ_STRIDE) >
+            a_ntfs->mft_rsize_b)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+            ("dinode_lookup: More Update Sequence Entries than MFT size");
+        return TSK_COR;
+    }
+    if (tsk_getu16(fs->endian, mft->upd_off) + sizeof(ntfs_upd) > a_ntfs->mft_rsize_b) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+        tsk_error_set_errstr
+            ("dinode_lookup: Update sequence would read past MFT size");
+        return TSK_COR;
+    }
+
+    /* Apply the update sequence structure template */
+    upd =
+        (ntfs_upd *) ((uintptr_t) a_buf + tsk_getu16(fs->endian,
+            mft->upd_off));
+    /* Get the sequence value that each 16-bit value should be */
+    sig_seq = tsk_getu16(fs->endian, upd->upd_val);
+    /* cycle through each sector */
+    for (i = 1; i < tsk_getu16(fs->endian, mft->upd_cnt); i++) {
+        uint8_t *new_val, *old_val;
+        /* The offset into the buffer of the value to analyze */
+        size_t offset = i * NTFS_UPDATE_SEQ_STRIDE - 2;
+
+        /* Check that there is room in the buffer to read the current sequence value */
+        if (offset + 2 > a_ntfs->mft_rsize_b) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
+            tsk_error_set_errstr
+            ("dinode_lookup: Ran out of data while parsing update sequence values");
+            return TSK_COR;
+        }
+
+        /* get the current sequence value */
+        uint16_t cur_seq =
+            tsk_getu16(fs->endian, (uintptr_t) a_buf + offset);
+        if (cur_seq != sig_seq) {
+            /* get the replacement value */
+            uint16_t cur_repl =
+                tsk_getu16(fs->endian, &upd->upd_seq + (i - 1) * 2);
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_FS_GENFS);
+
+            tsk_error_set_errstr
+                ("Incorrect update sequence value in MFT entry\nSignature Value: 0x%"
+                PRIx16 " Actual Value: 0x%" PRIx16
+                " Replacement Value: 0x%" PRIx16
+                "\nThis is typically because of a corrupted entry",
+                sig_seq, cur_seq, cur_repl);
+            return TSK_COR;
+        }
+
+        new_val = &upd->upd_seq + (i - 1) * 2;
+        old_val = (uint8_t *) ((uintptr_t) a_buf + offset);
+        /*
+           if (tsk_verbose)
+           tsk_fprintf(stderr,
+           "ntfs_dinode_lookup: upd_seq %i   Replacing: %.4"
+           PRIx16 "   With: %.4" PRIx16 "\n", i,
+           tsk_getu16(fs->endian, old_val), tsk_getu16(fs->endian,
+           new_val));
+         */
+        *old_val++ = *new_val++;
+        *old_val = *new_val;
+    }
+
+    return TSK_OK;
+}
+
+
 /**
  * Read an MFT entry and save it in raw form in the given buffer.
  * NOTE: This will remove the update sequence integrity checks in the
@@ -133,12 +254,8 @@ ntfs_dinode_lookup(NTFS_INFO * a_ntfs, char *a_buf, TSK_INUM_T a_mftnum)
 {
     TSK_OFF_T mftaddr_b, mftaddr2_b, offset;
     size_t mftaddr_len = 0;
-    int i;
     TSK_FS_INFO *fs = (TSK_FS_INFO *) & a_ntfs->fs_info;
     TSK_FS_ATTR_RUN *data_run;
-    ntfs_upd *upd;
-    uint16_t sig_seq;
-    ntfs_mft *mft;
 
 
     /* sanity checks */
@@ -338,106 +455,55 @@ ntfs_dinode_lookup(NTFS_INFO * a_ntfs, char *a_buf, TSK_INUM_T a_mftnum)
         }
     }
 
-    /* Sanity Check */
-#if 0
-    /* This is no longer applied because it caused too many problems
-     * with images that had 0 and 1 etc. as values.  Testing shows that
-     * even Windows XP doesn't care if entries have an invalid entry, so
-     * this is no longer checked.  The update sequence check should find
-     * corrupt entries
-     * */
-    if ((tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC)
-        && (tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC_BAAD)
-        && (tsk_getu32(fs->endian, mft->magic) != NTFS_MFT_MAGIC_ZERO)) {
-        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-        tsk_error_set_errstr("entry %d has an invalid MFT magic: %x",
-            mftnum, tsk_getu32(fs->endian, mft->magic));
-        return 1;
-    }
-#endif
-    /* The MFT entries have error and integrity checks in them
-     * called update sequences.  They must be checked and removed
-     * so that later functions can process the data as normal.
-     * They are located in the last 2 bytes of each 512-bytes of data.
-     *
-     * We first verify that the the 2-byte value is a give value and
-     * then replace it with what should be there
-     */
-    /* sanity check so we don't run over in the next loop */
-    mft = (ntfs_mft *) a_buf;
-    if ((tsk_getu16(fs->endian, mft->upd_cnt) > 0) &&
-        (((uint32_t) (tsk_getu16(fs->endian,
-                        mft->upd_cnt) - 1) * NTFS_UPDATE_SEQ_STRIDE) >
-            a_ntfs->mft_rsize_b)) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-        tsk_error_set_errstr
-            ("dinode_lookup: More Update Sequence Entries than MFT size");
-        return TSK_COR;
-    }
-    if (tsk_getu16(fs->endian, mft->upd_off) + sizeof(ntfs_upd) > a_ntfs->mft_rsize_b) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-        tsk_error_set_errstr
-            ("dinode_lookup: Update sequence would read past MFT size");
-        return TSK_COR;
-    }
-
-    /* Apply the update sequence structure template */
-    upd =
-        (ntfs_upd *) ((uintptr_t) a_buf + tsk_getu16(fs->endian,
-            mft->upd_off));
-    /* Get the sequence value that each 16-bit value should be */
-    sig_seq = tsk_getu16(fs->endian, upd->upd_val);
-    /* cycle through each sector */
-    for (i = 1; i < tsk_getu16(fs->endian, mft->upd_cnt); i++) {
-        uint8_t *new_val, *old_val;
-        /* The offset into the buffer of the value to analyze */
-        size_t offset = i * NTFS_UPDATE_SEQ_STRIDE - 2;
+    return ntfs_dinode_fixup(a_ntfs, a_buf);
+}
 
-        /* Check that there is room in the buffer to read the current sequence value */
-        if (offset + 2 > a_ntfs->mft_rsize_b) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
-            tsk_error_set_errstr
-            ("dinode_lookup: Ran out of data while parsing update sequence values");
-            return TSK_COR;
-        }
 
-        /* get the current sequence value */
-        uint16_t cur_seq =
-            tsk_getu16(fs->endian, (uintptr_t) a_buf + offset);
-        if (cur_seq != sig_seq) {
-            /* get the replacement value */
-            uint16_t cur_repl =
-                tsk_getu16(fs->endian, &upd->upd_seq + (i - 1) * 2);
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_FS_GENFS);
+/**
+ * Read a range of MFT entries with one read of the $Data attribute of
+ * $MFT, which goes to the image as one sequential (or vectored) read.
+ * The update sequence values are not removed, call ntfs_dinode_fixup()
+ * on each entry.  This is used by the inode walk in place of
+ * ntfs_dinode_lookup() so that it reads $MFT in large chunks instead of
+ * one entry at a time.
+ *
+ * @param a_ntfs File system to read from
+ * @param a_buf Buffer to save raw data to.  Must be of size a_count * NTFS_INFO.mft_rsize_b
+ * @param a_mftnum Address of the first MFT entry to read
+ * @param a_count Number of MFT entries to read
+ *
+ * @returns 1 if the range could not be read this way (with no error set,
+ * the caller should use ntfs_dinode_lookup() for each entry) and 0 on success
+ */
+static uint8_t
+ntfs_dinode_lookup_bulk(NTFS_INFO * a_ntfs, char *a_buf,
+    TSK_INUM_T a_mftnum, size_t a_count)
+{
+    TSK_OFF_T offset = (TSK_OFF_T) a_mftnum * a_ntfs->mft_rsize_b;
+    size_t len = a_count * a_ntfs->mft_rsize_b;
+    ssize_t cnt;
 
-            tsk_error_set_errstr
-                ("Incorrect update sequence value in MFT entry\nSignature Value: 0x%"
-                PRIx16 " Actual Value: 0x%" PRIx16
-                " Replacement Value: 0x%" PRIx16
-                "\nThis is typically because of a corrupted entry",
-                sig_seq, cur_seq, cur_repl);
-            return TSK_COR;
-        }
+    /* ntfs_dinode_lookup() reads entries past the initialized size of
+     * $MFT from disk, but tsk_fs_attr_read() would give back zeros */
+    if ((a_ntfs->mft_data == NULL)
+        || ((a_ntfs->mft_data->flags & TSK_FS_ATTR_NONRES) == 0)
+        || (a_ntfs->mft_data->flags & (TSK_FS_ATTR_COMP |
+                TSK_FS_ATTR_ENC | TSK_FS_ATTR_SPARSE))
+        || (offset + (TSK_OFF_T) len > a_ntfs->mft_data->nrd.initsize))
+        return 1;
 
-        new_val = &upd->upd_seq + (i - 1) * 2;
-        old_val = (uint8_t *) ((uintptr_t) a_buf + offset);
-        /*
-           if (tsk_verbose)
-           tsk_fprintf(stderr,
-           "ntfs_dinode_lookup: upd_seq %i   Replacing: %.4"
-           PRIx16 "   With: %.4" PRIx16 "\n", i,
-           tsk_getu16(fs->endian, old_val), tsk_getu16(fs->endian,
-           new_val));
-         */
-        *old_val++ = *new_val++;
-        *old_val = *new_val;
+    cnt = tsk_fs_attr_read(a_ntfs->mft_data, offset, a_buf, len,
+        TSK_FS_FILE_READ_FLAG_NONE);
+    if (cnt != (ssize_t) len) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "ntfs_dinode_lookup_bulk: Error reading MFT entries %"
+                PRIuINUM " to %" PRIuINUM "\n", a_mftnum,
+                a_mftnum + a_count - 1);
+        tsk_error_reset();
+        return 1;
     }
-
-    return TSK_OK;
+    return 0;
 }
 
 
@@ -592,8 +658,8 @@ ntfs_make_data_run(NTFS_INFO * ntfs, TSK_OFF_T start_vcn,
         int64_t addr_offset = 0;
 
         /* allocate a new tsk_fs_attr_run */
-        if ((data_run = tsk_fs_attr_run_alloc()) == NULL) {
-            tsk_fs_attr_run_free(*a_data_run_head);
+        if ((data_run = tsk_fs_pool_get_run(fs)) == NULL) {
+            tsk_fs_pool_put_runs(fs, *a_data_run_head);
             *a_data_run_head = NULL;
             return TSK_ERR;
         }
@@ -619,7 +685,7 @@ ntfs_make_data_run(NTFS_INFO * ntfs, TSK_OFF_T start_vcn,
             tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
             tsk_error_set_errstr
             ("ntfs_make_run: Run length is too large to process");
-            tsk_fs_attr_run_free(*a_data_run_head);
+            tsk_fs_pool_put_runs(fs, *a_data_run_head);
             *a_data_run_head = NULL;
             return TSK_COR;
         }
@@ -640,7 +706,7 @@ ntfs_make_data_run(NTFS_INFO * ntfs, TSK_OFF_T start_vcn,
             tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
             tsk_error_set_errstr
                 ("ntfs_make_run: Run length is larger than file system");
-            tsk_fs_attr_run_free(*a_data_run_head);
+            tsk_fs_pool_put_runs(fs, *a_data_run_head);
             *a_data_run_head = NULL;
             return TSK_COR;
         }
@@ -717,7 +783,7 @@ ntfs_make_data_run(NTFS_INFO * ntfs, TSK_OFF_T start_vcn,
                 tsk_error_set_errno(TSK_ERR_FS_INODE_COR);
                 tsk_error_set_errstr
                     ("ntfs_make_run: Run offset and length is larger than file system");
-                tsk_fs_attr_run_free(*a_data_run_head);
+                tsk_fs_pool_put_runs(fs, *a_data_run_head);
                 *a_data_run_head = NULL;
                 return TSK_COR;
             }
@@ -744,7 +810,7 @@ ntfs_make_data_run(NTFS_INFO * ntfs, TSK_OFF_T start_vcn,
         && ((*a_data_run_head)->next == NULL)
         && ((*a_data_run_head)->flags & TSK_FS_ATTR_RUN_FLAG_SPARSE)
         && ((*a_data_run_head)->len == fs->last_block + 1)) {
-        tsk_fs_attr_run_free(*a_data_run_head);
+        tsk_fs_pool_put_runs(fs, *a_data_run_head);
         *a_data_run_head = NULL;
     }
 
@@ -1566,7 +1632,8 @@ ntfs_file_read_special(const TSK_FS_ATTR * a_fs_attr,
         byteoffset = (size_t) (a_offset - cu_blkoffset * fs->block_size);
 
         // cycle through the run until we find where we can start to process the clusters
-        for (data_run_cur = a_fs_attr->nrd.run;
+        for (data_run_cur =
+            tsk_fs_attr_run_find(a_fs_attr, (TSK_DADDR_T) cu_blkoffset);
             (data_run_cur) && (buf_idx < a_len);
             data_run_cur = data_run_cur->next) {
 
@@ -2658,6 +2725,8 @@ ntfs_dinode_copy(NTFS_INFO * ntfs, TSK_FS_FILE * a_fs_file, char *a_buf,
      * flags are cleared
      */
     if (a_fs_file->meta->attr) {
+        // keep the runs of the previous entry for reuse
+        tsk_fs_pool_put_meta_runs(fs, a_fs_file->meta);
         tsk_fs_attrlist_markunused(a_fs_file->meta->attr);
     }
     else {
@@ -3895,6 +3964,11 @@ ntfs_block_walk(TSK_FS_INFO * fs,
  * Note that with ORPHAN, entries will be found that can also be
  * found by searching based on parent directories (if parent directory is
  * known)
+ *
+ * $MFT is read in chunks of NTFS_MFT_BULK_SIZE bytes and the update
+ * sequence fixups are done in the chunk buffer.  tsk_fs_meta_walk_parallel()
+ * runs this on ranges of entries in several threads, which parses the
+ * entries on a pool of threads while $MFT is still read in order.
  */
 static uint8_t
 ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
@@ -3907,6 +3981,11 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     TSK_FS_FILE *fs_file;
     TSK_INUM_T end_inum_tmp;
     ntfs_mft *mft;
+    char *mft_buf;
+    size_t mft_buf_cnt;
+    TSK_INUM_T chunk_start = 0;
+    size_t chunk_cnt = 0;
+    uint8_t chunk_bulk = 0;
     /*
      * Sanity checks.
      */
@@ -3989,10 +4068,6 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         return 1;
     }
 
-    if ((mft = (ntfs_mft *) tsk_malloc(ntfs->mft_rsize_b)) == NULL) {
-        tsk_fs_file_close(fs_file);
-        return 1;
-    }
     // we need to handle fs->last_inum specially because it is for the
     // virtual ORPHANS directory.  Handle it outside of the loop.
     if (end_inum == TSK_FS_ORPHANDIR_INUM(fs))
@@ -4000,15 +4075,52 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
     else
         end_inum_tmp = end_inum;
 
+    /* $MFT is read NTFS_MFT_BULK_SIZE bytes at a time and each entry is
+     * fixed up in the buffer.  No buffer is needed if only the orphan
+     * directory was asked for. */
+    mft_buf_cnt = NTFS_MFT_BULK_SIZE / ntfs->mft_rsize_b;
+    if (mft_buf_cnt == 0)
+        mft_buf_cnt = 1;
+    if (end_inum_tmp < start_inum)
+        mft_buf_cnt = 0;
+    else if (end_inum_tmp - start_inum + 1 < mft_buf_cnt)
+        mft_buf_cnt = (size_t) (end_inum_tmp - start_inum + 1);
+
+    mft_buf = NULL;
+    if ((mft_buf_cnt > 0) && ((mft_buf = (char *) tsk_malloc(mft_buf_cnt *
+                    ntfs->mft_rsize_b)) == NULL)) {
+        tsk_fs_file_close(fs_file);
+        return 1;
+    }
+    mft = (ntfs_mft *) mft_buf;
+
 
     for (mftnum = start_inum; mftnum <= end_inum_tmp; mftnum++) {
         int retval;
         TSK_RETVAL_ENUM retval2;
 
+        /* read the next chunk of $MFT.  If it cannot be read in one go,
+         * then read each entry in it on its own */
+        if (mftnum >= chunk_start + chunk_cnt) {
+            chunk_start = mftnum;
+            chunk_cnt = mft_buf_cnt;
+            if (end_inum_tmp - mftnum + 1 < chunk_cnt)
+                chunk_cnt = (size_t) (end_inum_tmp - mftnum + 1);
+            chunk_bulk = (ntfs_dinode_lookup_bulk(ntfs, mft_buf,
+                    chunk_start, chunk_cnt) == 0);
+        }
+
         /* read MFT entry in to NTFS_INFO */
-        if ((retval2 =
-                ntfs_dinode_lookup(ntfs, (char *) mft,
-                    mftnum)) != TSK_OK) {
+        if (chunk_bulk) {
+            mft = (ntfs_mft *) & mft_buf[(mftnum - chunk_start) *
+                ntfs->mft_rsize_b];
+            retval2 = ntfs_dinode_fixup(ntfs, (char *) mft);
+        }
+        else {
+            mft = (ntfs_mft *) mft_buf;
+            retval2 = ntfs_dinode_lookup(ntfs, (char *) mft, mftnum);
+        }
+        if (retval2 != TSK_OK) {
             // if the entry is corrupt, then skip to the next one
             if (retval2 == TSK_COR) {
                 if (tsk_verbose)
@@ -4017,7 +4129,7 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
                 continue;
             }
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 1;
         }
 
@@ -4057,7 +4169,7 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
                 continue;
             }
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 1;
         }
 
@@ -4071,12 +4183,12 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
         retval = a_action(fs_file, ptr);
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 1;
         }
     }
@@ -4089,25 +4201,25 @@ ntfs_inode_walk(TSK_FS_INFO * fs, TSK_INUM_T start_inum,
 
         if (tsk_fs_dir_make_orphan_dir_meta(fs, fs_file->meta)) {
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 1;
         }
         /* call action */
         retval = a_action(fs_file, ptr);
         if (retval == TSK_WALK_STOP) {
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 0;
         }
         else if (retval == TSK_WALK_ERROR) {
             tsk_fs_file_close(fs_file);
-            free(mft);
+            free(mft_buf);
             return 1;
         }
     }
 
     tsk_fs_file_close(fs_file);
-    free(mft);
+    free(mft_buf);
     return 0;
 }
 
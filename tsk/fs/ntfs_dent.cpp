@@ -209,13 +209,21 @@ ntfs_orphan_map_free(NTFS_INFO * a_ntfs)
 
 
 /* inode_walk callback that is used to populate the orphan_map
- * structure in NTFS_INFO */
+ * structure in NTFS_INFO.  ptr is a TSK_FS_INUM_SET (or NULL) that
+ * collects the unallocated entries that could be orphan files. */
 static TSK_WALK_RET_ENUM
-ntfs_parent_act(TSK_FS_FILE * fs_file, void * /*ptr*/)
+ntfs_parent_act(TSK_FS_FILE * fs_file, void *ptr)
 {
     NTFS_INFO *ntfs = (NTFS_INFO *) fs_file->fs_info;
+    TSK_FS_INUM_SET *candidates = (TSK_FS_INUM_SET *) ptr;
     TSK_FS_META_NAME_LIST *fs_name_list;
 
+    if ((candidates) && (fs_file->meta->flags & TSK_FS_META_FLAG_UNALLOC) &&
+        (fs_file->meta->flags & TSK_FS_META_FLAG_USED)) {
+        if (tsk_fs_inum_set_add(candidates, fs_file->meta->addr))
+            return TSK_WALK_ERROR;
+    }
+
     if ((fs_file->meta->flags & TSK_FS_META_FLAG_ALLOC) &&
         fs_file->meta->type == TSK_FS_META_TYPE_REG) {
         ++ntfs->alloc_file_count;
@@ -1229,11 +1237,21 @@ ntfs_dir_open_meta(TSK_FS_INFO * a_fs, TSK_FS_DIR ** a_fs_dir,
         // because orphan_map was always NULL
         getParentMap(ntfs);
 
+        // this walk sees every MFT entry, so also collect the orphan
+        // candidates for tsk_fs_dir_find_orphans() to save it another walk.
+        // The set is only an optimization, so go on without it on error.
+        TSK_FS_INUM_SET *candidates = tsk_fs_inum_set_alloc();
+        if (candidates == NULL)
+            tsk_error_reset();
+
         if (a_fs->inode_walk(a_fs, a_fs->first_inum, a_fs->last_inum,
-                (TSK_FS_META_FLAG_ENUM)(TSK_FS_META_FLAG_UNALLOC | TSK_FS_META_FLAG_ALLOC), ntfs_parent_act, NULL)) {
+                (TSK_FS_META_FLAG_ENUM)(TSK_FS_META_FLAG_UNALLOC | TSK_FS_META_FLAG_ALLOC), ntfs_parent_act, candidates)) {
+            tsk_fs_inum_set_free(candidates);
             tsk_release_lock(&ntfs->orphan_map_lock);
             return TSK_ERR;
         }
+        if (candidates)
+            tsk_fs_dir_save_orphan_candidates(a_fs, &candidates);
     }
 
     
@@ -1166,7 +1166,7 @@ btrfs_calc_phyAddr(TSK_FS_INFO * a_fs, BTRFS_INFO *btrfs, uint8_t *logical_addr,
 
 	btrfs_chunk *tmpbuf;
 	
-	if ((tmpbuf = (btrfs_chunk *)tsk_fs_malloc(sizeof(*tmpbuf))) == NULL)
+	if ((tmpbuf = (btrfs_chunk *)tsk_malloc(sizeof(*tmpbuf))) == NULL)
 		return TSK_ERR;
 
 
@@ -1461,17 +1461,17 @@ static inline TSK_RETVAL_ENUM btrfs_get_fs_leaf(BTRFS_INFO *btrfs) {
 	//	num_stripes = btrfs->num_stripes;
 	num_stripes = 1;
 
-	if ((btrfs->fs_leaf = (btrfs_leaf ***)tsk_fs_malloc(sizeof(btrfs_leaf **)*num_stripes)) == NULL){
+	if ((btrfs->fs_leaf = (btrfs_leaf ***)tsk_malloc(sizeof(btrfs_leaf **)*num_stripes)) == NULL){
 		printf("malloc err\n");
 		return TSK_ERR;
 	}
 
-	if ((btrfs->fs_leaf_num = (uint8_t *)tsk_fs_malloc(sizeof(uint8_t)*num_stripes)) == NULL) {
+	if ((btrfs->fs_leaf_num = (uint8_t *)tsk_malloc(sizeof(uint8_t)*num_stripes)) == NULL) {
 		printf("malloc err\n");
 		return TSK_ERR;
 	}
 
-	if ((btrfs->fs_leaf_phy_addr = (uint64_t **)tsk_fs_malloc(sizeof(uint64_t *)*num_stripes)) == NULL) {
+	if ((btrfs->fs_leaf_phy_addr = (uint64_t **)tsk_malloc(sizeof(uint64_t *)*num_stripes)) == NULL) {
 		printf("malloc err\n");
 		return TSK_ERR;
 	}
@@ -1482,11 +1482,11 @@ static inline TSK_RETVAL_ENUM btrfs_get_fs_leaf(BTRFS_INFO *btrfs) {
 		if (fs_tree->header.level == 0) {
 			btrfs->fs_leaf_num[i] = 1;
 			
-			if ((btrfs->fs_leaf[i] = (btrfs_leaf **)tsk_fs_malloc(sizeof(btrfs_leaf *)*btrfs->fs_leaf_num[i])) == NULL) {
+			if ((btrfs->fs_leaf[i] = (btrfs_leaf **)tsk_malloc(sizeof(btrfs_leaf *)*btrfs->fs_leaf_num[i])) == NULL) {
 				printf("malloc err\n");
 				return TSK_ERR;
 			}
-			if ((btrfs->fs_leaf_phy_addr[i] = (uint64_t *)tsk_fs_malloc(sizeof(uint64_t)*btrfs->fs_leaf_num[i])) == NULL) {
+			if ((btrfs->fs_leaf_phy_addr[i] = (uint64_t *)tsk_malloc(sizeof(uint64_t)*btrfs->fs_leaf_num[i])) == NULL) {
 				printf("malloc err\n");
 				return TSK_ERR;
 			}
@@ -1499,11 +1499,11 @@ static inline TSK_RETVAL_ENUM btrfs_get_fs_leaf(BTRFS_INFO *btrfs) {
 			}
 			tmp = j;
 			btrfs->fs_leaf_num[i] = tmp;
-			if ((btrfs->fs_leaf[i] = (btrfs_leaf **)tsk_fs_malloc(sizeof(btrfs_leaf *)*btrfs->fs_leaf_num[i])) == NULL) {
+			if ((btrfs->fs_leaf[i] = (btrfs_leaf **)tsk_malloc(sizeof(btrfs_leaf *)*btrfs->fs_leaf_num[i])) == NULL) {
 				printf("malloc err\n");
 				return TSK_ERR;
 			}
-			if ((btrfs->fs_leaf_phy_addr[i] = (uint64_t *)tsk_fs_malloc(sizeof(uint64_t)*btrfs->fs_leaf_num[i])) == NULL) {
+			if ((btrfs->fs_leaf_phy_addr[i] = (uint64_t *)tsk_malloc(sizeof(uint64_t)*btrfs->fs_leaf_num[i])) == NULL) {
 				printf("malloc err\n");
 				return TSK_ERR;
 			}
@@ -1513,7 +1513,7 @@ static inline TSK_RETVAL_ENUM btrfs_get_fs_leaf(BTRFS_INFO *btrfs) {
 					break;
 				}
 				len = 0x4000;
-				if ((btrfs->fs_leaf[i][j] = (btrfs_leaf *)tsk_fs_malloc(len)) == NULL) {
+				if ((btrfs->fs_leaf[i][j] = (btrfs_leaf *)tsk_malloc(len)) == NULL) {
 					printf("malloc err\n");
 					return TSK_ERR;
 				}
@@ -1563,9 +1563,9 @@ static inline TSK_RETVAL_ENUM btrfs_init_fs(BTRFS_INFO *btrfs) {
 	//	num_stripes = btrfs->num_stripes;
 	num_stripes = 1;
 
-	if ((root_item = (btrfs_root_item *)tsk_fs_malloc(sizeof(*root_item))) == NULL)
+	if ((root_item = (btrfs_root_item *)tsk_malloc(sizeof(*root_item))) == NULL)
 		return TSK_ERR;
-	if ((btrfs->fs_tree = (btrfs_node **)tsk_fs_malloc(sizeof(btrfs_node *)*num_stripes)) == NULL)
+	if ((btrfs->fs_tree = (btrfs_node **)tsk_malloc(sizeof(btrfs_node *)*num_stripes)) == NULL)
 		return TSK_ERR;
 
 	for (i = 0; i < num_stripes; i++) {
@@ -1593,7 +1593,7 @@ static inline TSK_RETVAL_ENUM btrfs_init_fs(BTRFS_INFO *btrfs) {
 					tsk_fs_free((TSK_FS_INFO *)btrfs);
 					return TSK_ERR;
 				}
-				if ((btrfs->fs_phy_addr = (uint64_t *)tsk_fs_malloc(sizeof(btrfs->fs_phy_addr))) == NULL)
+				if ((btrfs->fs_phy_addr = (uint64_t *)tsk_malloc(sizeof(btrfs->fs_phy_addr))) == NULL)
 					return TSK_ERR;
 
 				fs_phyAddr = btrfs_calc_phyAddr(fs, btrfs, root_item->bytenr, i);
@@ -1601,7 +1601,7 @@ static inline TSK_RETVAL_ENUM btrfs_init_fs(BTRFS_INFO *btrfs) {
 
 				len = tsk_getu32(fs->endian, btrfs->fs->nodesize);
 
-				if ((btrfs->fs_tree[i] = (btrfs_node *)tsk_fs_malloc(len)) == NULL)
+				if ((btrfs->fs_tree[i] = (btrfs_node *)tsk_malloc(len)) == NULL)
 					return TSK_ERR;
 
 				cnt = tsk_fs_read(fs, fs_phyAddr, (char *)btrfs->fs_tree[i], len);
@@ -1640,18 +1640,18 @@ static inline TSK_RETVAL_ENUM btrfs_init_root(BTRFS_INFO *btrfs) {
 	//	num_stripes = btrfs->num_stripes;
 	num_stripes = 1;
 
-	if ((btrfs->root_tree = (btrfs_leaf **)tsk_fs_malloc(sizeof(btrfs_leaf *)*num_stripes)) == NULL)
+	if ((btrfs->root_tree = (btrfs_leaf **)tsk_malloc(sizeof(btrfs_leaf *)*num_stripes)) == NULL)
 		return TSK_ERR;
 
 	for (i = 0; i < num_stripes; i++) {
 		root_phyAddr = btrfs_calc_phyAddr(fs, btrfs, btrfs->fs->root, i);
 
-		if ((btrfs->root_phy_addr = (uint64_t *)tsk_fs_malloc(sizeof(btrfs->root_phy_addr))) == NULL)
+		if ((btrfs->root_phy_addr = (uint64_t *)tsk_malloc(sizeof(btrfs->root_phy_addr))) == NULL)
 			return TSK_ERR;
 		btrfs->root_phy_addr[i] = root_phyAddr;
 
 		len = tsk_getu32(fs->endian, btrfs->fs->nodesize);
-		if ((btrfs->root_tree[i] = (btrfs_leaf *)tsk_fs_malloc(len)) == NULL)
+		if ((btrfs->root_tree[i] = (btrfs_leaf *)tsk_malloc(len)) == NULL)
 			return TSK_ERR;
 
 		cnt = tsk_fs_read(fs, btrfs->root_phy_addr[i], (char*)btrfs->root_tree[i], len);
@@ -1684,9 +1684,9 @@ static inline TSK_RETVAL_ENUM btrfs_init_chunk(BTRFS_INFO *btrfs) {
 	TSK_FS_INFO *fs = &(btrfs->fs_info);
 	btrfs_sb = btrfs->fs;
 
-	if ((sys_chunk_key = (btrfs_disk_key *)tsk_fs_malloc(sizeof(*sys_chunk_key))) == NULL)
+	if ((sys_chunk_key = (btrfs_disk_key *)tsk_malloc(sizeof(*sys_chunk_key))) == NULL)
 		return TSK_ERR;
-	if ((sys_chunk = (btrfs_chunk *)tsk_fs_malloc(sizeof(*sys_chunk))) == NULL)
+	if ((sys_chunk = (btrfs_chunk *)tsk_malloc(sizeof(*sys_chunk))) == NULL)
 		return TSK_ERR;
 	len = sizeof(btrfs_disk_key);
 
@@ -1724,9 +1724,9 @@ static inline TSK_RETVAL_ENUM btrfs_init_chunk(BTRFS_INFO *btrfs) {
 
 	btrfs->num_stripes = num_stripes;
 
-	if ((btrfs->chunk_tree = (btrfs_leaf **)tsk_fs_malloc(sizeof(btrfs_leaf *)*num_stripes)) == NULL)
+	if ((btrfs->chunk_tree = (btrfs_leaf **)tsk_malloc(sizeof(btrfs_leaf *)*num_stripes)) == NULL)
 		return TSK_ERR;
-	if ((btrfs->chunk_phy_addr = (uint64_t *)tsk_fs_malloc(sizeof(btrfs->chunk_phy_addr))) == NULL)
+	if ((btrfs->chunk_phy_addr = (uint64_t *)tsk_malloc(sizeof(btrfs->chunk_phy_addr))) == NULL)
 		return TSK_ERR;
 
 	for (i = 0; i < num_stripes; i++) {
@@ -1753,7 +1753,7 @@ static inline TSK_RETVAL_ENUM btrfs_init_chunk(BTRFS_INFO *btrfs) {
 
 		btrfs->chunk_phy_addr[i] = target_phyAddr;
 		len = tsk_getu32(fs->endian, btrfs->fs->nodesize);
-		if ((btrfs->chunk_tree[i] = (btrfs_leaf *)tsk_fs_malloc(sizeof(btrfs_leaf) * len)) == NULL)
+		if ((btrfs->chunk_tree[i] = (btrfs_leaf *)tsk_malloc(sizeof(btrfs_leaf) * len)) == NULL)
 			return TSK_ERR;
 
 		cnt = tsk_fs_read(fs, target_phyAddr, (char *)btrfs->chunk_tree[i], len);
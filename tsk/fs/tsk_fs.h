@@ -48,6 +48,9 @@ extern "C" {
 #endif
 
     typedef struct TSK_FS_INFO TSK_FS_INFO;
+    typedef struct TSK_FS_INUM_SET TSK_FS_INUM_SET;
+    typedef struct TSK_FS_POOL TSK_FS_POOL;
+    typedef struct TSK_FS_BLOCK_INDEX TSK_FS_BLOCK_INDEX;
     typedef struct TSK_FS_FILE TSK_FS_FILE;
 
 
@@ -152,6 +155,7 @@ extern "C" {
 
 
     typedef struct TSK_FS_ATTR_RUN TSK_FS_ATTR_RUN;
+    typedef struct TSK_FS_ATTR_RUN_TABLE TSK_FS_ATTR_RUN_TABLE;
 
     /**
     * Holds information about a single data run, which has a starting address and length.
@@ -207,8 +211,15 @@ extern "C" {
         TSK_FS_FILE_WALK_FLAG_NOID = 0x02,      ///< Ignore the Id argument given in the API (use only the type)
         TSK_FS_FILE_WALK_FLAG_AONLY = 0x04,     ///< Provide callback with only addresses and no file content.
         TSK_FS_FILE_WALK_FLAG_NOSPARSE = 0x08,  ///< Do not include sparse blocks in the callback.
+        TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS = 0x10,      ///< Read each run of non-resident data in pieces of up to TSK_FS_INFO::walk_chunk_len bytes and call the callback once per piece (with the address of its first block).  Ignored with TSK_FS_FILE_WALK_FLAG_AONLY.
     } TSK_FS_FILE_WALK_FLAG_ENUM;
 
+/**
+* Default number of bytes that are read at a time by walks with
+* TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS
+*/
+#define TSK_FS_WALK_CHUNK_LEN_DEFAULT (4 * 1024 * 1024)
+
 
     /**
     * These are based on the NTFS type values.
@@ -309,6 +320,8 @@ extern "C" {
             TSK_OFF_T a_offset, char *a_buf, size_t a_len);
          uint8_t(*w) (const TSK_FS_ATTR * fs_attr,
             int flags, TSK_FS_FILE_WALK_CB, void *);
+
+        TSK_FS_ATTR_RUN_TABLE *run_table;       ///< \internal Array of the runs of a non-resident attribute that reads binary search to find the run of an offset (NULL until the first read).  Made again if the run list changes.
     };
 
 
@@ -536,6 +549,67 @@ extern "C" {
         TSK_INUM_T a_end, TSK_FS_META_FLAG_ENUM a_flags,
         TSK_FS_META_WALK_CB a_cb, void *a_ptr);
 
+#define TSK_FS_META_BATCH_SIZE  4096    ///< Max number of records in a TSK_FS_META_BATCH
+
+    /**
+    * A batch of compact, read-only metadata records that is given to a
+    * TSK_FS_META_WALK_BATCH_CB callback.  The records are stored as one
+    * array per field, so index i in each array is the same file.  The
+    * arrays are only valid during the callback.
+    */
+    typedef struct {
+        size_t count;           ///< Number of records in the batch
+        TSK_INUM_T *addr;       ///< Metadata addresses
+        TSK_FS_META_FLAG_ENUM *flags;   ///< Allocation and usage flags
+        TSK_FS_META_TYPE_ENUM *type;    ///< File types
+        TSK_FS_META_MODE_ENUM *mode;    ///< Unix-style permissions
+        TSK_OFF_T *size;        ///< File sizes in bytes
+        time_t *mtime;          ///< Last file content modification times (stored in number of seconds since Jan 1, 1970 UTC)
+        time_t *atime;          ///< Last file content accessed times (stored in number of seconds since Jan 1, 1970 UTC)
+        time_t *ctime;          ///< Last file / metadata status change times (stored in number of seconds since Jan 1, 1970 UTC)
+        time_t *crtime;         ///< Created times (stored in number of seconds since Jan 1, 1970 UTC)
+        TSK_UID_T *uid;         ///< Owner ids
+        TSK_GID_T *gid;         ///< Group ids
+    } TSK_FS_META_BATCH;
+
+    /**
+    * Batched inode walk callback function definition.  This is called
+    * with batches of up to TSK_FS_META_BATCH_SIZE files that meet the
+    * criteria specified when tsk_fs_meta_walk_batch() was called.
+    * @param a_batch Records of the files in the batch
+    * @param a_ptr Pointer that was specified by caller to tsk_fs_meta_walk_batch()
+    * @returns Value that tells the walk to continue or stop
+    */
+    typedef TSK_WALK_RET_ENUM(*TSK_FS_META_WALK_BATCH_CB) (const
+        TSK_FS_META_BATCH * a_batch, void *a_ptr);
+
+    extern uint8_t tsk_fs_meta_walk_batch(TSK_FS_INFO * a_fs,
+        TSK_INUM_T a_start, TSK_INUM_T a_end,
+        TSK_FS_META_FLAG_ENUM a_flags, TSK_FS_META_WALK_BATCH_CB a_cb,
+        void *a_ptr);
+
+    /**
+    * Parallel inode walk callback function definition.  This is called
+    * from several threads at the same time for the files that meet the
+    * criteria specified when tsk_fs_meta_walk_parallel() was called.
+    * @param a_fs_file Pointer to the current file
+    * @param a_thread Index of the calling thread (0 to the number of threads - 1)
+    * @param a_ptr Pointer that was specified by caller to tsk_fs_meta_walk_parallel()
+    * @returns Value that tells the walk to continue or stop
+    */
+    typedef TSK_WALK_RET_ENUM(*TSK_FS_META_WALK_PAR_CB) (TSK_FS_FILE *
+        a_fs_file, int a_thread, void *a_ptr);
+
+/**
+* Number of threads that tsk_fs_meta_walk_parallel() uses if it is given 0
+*/
+#define TSK_FS_META_WALK_THREADS_DEFAULT 4
+
+    extern uint8_t tsk_fs_meta_walk_parallel(TSK_FS_INFO * a_fs,
+        TSK_INUM_T a_start, TSK_INUM_T a_end,
+        TSK_FS_META_FLAG_ENUM a_flags, TSK_FS_META_WALK_PAR_CB a_cb,
+        void *a_ptr, int a_num_threads);
+
     extern uint8_t tsk_fs_meta_make_ls(const TSK_FS_META * a_fs_meta,
         char *a_buf, size_t a_len);
 
@@ -621,6 +695,9 @@ extern "C" {
 
 
 #define TSK_FS_DIR_TAG  0x57531246
+    typedef struct TSK_FS_DIR_INDEX TSK_FS_DIR_INDEX;
+    typedef struct TSK_FS_DIR_ARENA TSK_FS_DIR_ARENA;
+
     /**
     * A handle to a directory so that its files can be individually accessed.
     */
@@ -637,6 +714,9 @@ extern "C" {
         uint32_t seq;           ///< Metadata address sequence (NTFS Only)
 
         TSK_FS_INFO *fs_info;   ///< Pointer to file system the directory is located in
+
+        TSK_FS_DIR_INDEX *name_index;   ///< \internal Index of the names by address and name hash (NULL until the directory is large)
+        TSK_FS_DIR_ARENA *name_arena;   ///< \internal Memory that the name and shrt_name strings of names are allocated from
     } TSK_FS_DIR;
 
     /**
@@ -649,8 +729,14 @@ extern "C" {
         TSK_FS_DIR_WALK_FLAG_UNALLOC = 0x02,    ///< Return unallocated names in callback
         TSK_FS_DIR_WALK_FLAG_RECURSE = 0x04,    ///< Recurse into sub-directories
         TSK_FS_DIR_WALK_FLAG_NOORPHAN = 0x08,   ///< Do not return (or recurse into) the special Orphan directory
+        TSK_FS_DIR_WALK_FLAG_ORDERED = 0x10,    ///< Call the callback from the calling thread in the order of tsk_fs_dir_walk() (only used by tsk_fs_dir_walk_parallel())
     } TSK_FS_DIR_WALK_FLAG_ENUM;
 
+/**
+* Number of threads that tsk_fs_dir_walk_parallel() uses if it is given 0
+*/
+#define TSK_FS_DIR_WALK_THREADS_DEFAULT 4
+
 
     extern TSK_FS_DIR *tsk_fs_dir_open_meta(TSK_FS_INFO * a_fs,
         TSK_INUM_T a_addr);
@@ -659,10 +745,14 @@ extern "C" {
     extern uint8_t tsk_fs_dir_walk(TSK_FS_INFO * a_fs, TSK_INUM_T a_inode,
         TSK_FS_DIR_WALK_FLAG_ENUM a_flags, TSK_FS_DIR_WALK_CB a_action,
         void *a_ptr);
+    extern uint8_t tsk_fs_dir_walk_parallel(TSK_FS_INFO * a_fs,
+        TSK_INUM_T a_inode, TSK_FS_DIR_WALK_FLAG_ENUM a_flags,
+        TSK_FS_DIR_WALK_CB a_action, void *a_ptr, int a_num_threads);
     extern size_t tsk_fs_dir_getsize(const TSK_FS_DIR *);
     extern TSK_FS_FILE *tsk_fs_dir_get(const TSK_FS_DIR *, size_t);
     extern const TSK_FS_NAME *tsk_fs_dir_get_name(const TSK_FS_DIR * a_fs_dir, size_t a_idx);
     extern void tsk_fs_dir_close(TSK_FS_DIR *);
+    extern TSK_LIST *tsk_fs_dir_get_list_inum_named(TSK_FS_INFO * a_fs);
 
     extern int8_t tsk_fs_path2inum(TSK_FS_INFO * a_fs, const char *a_path,
         TSK_INUM_T * a_result, TSK_FS_NAME * a_fs_name);
@@ -963,11 +1053,12 @@ extern "C" {
 
         TSK_ENDIAN_ENUM endian; ///< Endian order of data
 
-        /* list_inum_named_lock protects list_inum_named */
+        /* list_inum_named_lock protects list_inum_named, inum_named and orphan_candidates */
         tsk_lock_t list_inum_named_lock;        // taken when r/w the list_inum_named list
         TSK_LIST *list_inum_named;      /**< List of unallocated inodes that
                                         * are pointed to by a file name --
                                         * Used to find orphan files.  Is filled
+                                        * by tsk_fs_dir_get_list_inum_named()
                                         * after looking for orphans
                                         * or afer a full name_walk is performed.
                                         * (r/w shared - lock) */
@@ -1020,6 +1111,34 @@ extern "C" {
         void (*close) (TSK_FS_INFO * fs);       ///< FS-specific function: Call tsk_fs_close() instead.
 
          uint8_t(*fread_owner_sid) (TSK_FS_FILE *, char **);    // FS-specific function. Call tsk_fs_file_get_owner_sid() instead.
+
+        /* Newer fields are kept at the end so that the offsets of the
+         * fields above do not change. */
+
+        size_t walk_chunk_len;  ///< Number of bytes read at a time by walks with TSK_FS_FILE_WALK_FLAG_LARGE_CHUNKS (0 to use TSK_FS_WALK_CHUNK_LEN_DEFAULT).  Can be changed after the file system is opened.
+
+        TSK_FS_INUM_SET *inum_named;    /**< \internal Addresses of
+                                        * list_inum_named in a set that is
+                                        * faster to search and that the list
+                                        * is made from.  It is not changed
+                                        * once it is set.
+                                        * (r/w shared - list_inum_named_lock) */
+        TSK_FS_INUM_SET *orphan_candidates;     /**< \internal Set of unallocated and used
+                                        * inodes that a file system collected during
+                                        * a scan of all of its metadata (NULL if it
+                                        * did not).  Used to find orphan files without
+                                        * another metadata walk.
+                                        * It is not changed once it is set.
+                                        * (r/w shared - list_inum_named_lock) */
+
+        /* pool_lock protects pool */
+        tsk_lock_t pool_lock;   // taken when getting or giving structures
+        TSK_FS_POOL *pool;      ///< \internal Structures that walks recycle between files (see fs_pool.c).  NULL until first used. (r/w shared - lock)
+
+        /* run_table_lock protects the run tables of the attributes of open files */
+        tsk_lock_t run_table_lock;      // taken when a read gets or makes the run table of an attribute
+
+        TSK_FS_BLOCK_INDEX *block_index;        ///< Reverse index of block owners that tsk_fs_ifind_data() and tsk_fs_blkstat() use (NULL if none).  Set with tsk_fs_block_index_attach().
     };
 
 
@@ -1038,9 +1157,42 @@ extern "C" {
 
     extern ssize_t tsk_fs_read(TSK_FS_INFO * a_fs, TSK_OFF_T a_off,
         char *a_buf, size_t a_len);
+    extern ssize_t tsk_fs_readv(TSK_FS_INFO * a_fs, TSK_IMG_IOVEC * a_vecs,
+        size_t a_num_vecs);
     extern ssize_t tsk_fs_read_block(TSK_FS_INFO * a_fs,
         TSK_DADDR_T a_addr, char *a_buf, size_t a_len);
 
+    /**
+    * A run of blocks in an attribute of a file, as stored in a
+    * TSK_FS_BLOCK_INDEX.
+    */
+    typedef struct {
+        TSK_DADDR_T addr;       ///< Address of the first block
+        TSK_DADDR_T len;        ///< Number of blocks
+        TSK_OFF_T offset;       ///< Byte offset in the attribute of the data in the first block
+        TSK_INUM_T inum;        ///< Address of the file
+        TSK_FS_ATTR_TYPE_ENUM type;     ///< Type of the attribute
+        uint16_t id;            ///< Id of the attribute
+        uint64_t order;         ///< Position of the attribute in a walk of the metadata
+    } TSK_FS_BLOCK_INDEX_EXTENT;
+
+    extern TSK_FS_BLOCK_INDEX *tsk_fs_block_index_build(TSK_FS_INFO *
+        a_fs);
+    extern TSK_FS_BLOCK_INDEX *tsk_fs_block_index_load(TSK_FS_INFO * a_fs,
+        const TSK_TCHAR * a_path);
+    extern TSK_FS_BLOCK_INDEX *tsk_fs_block_index_open(TSK_FS_INFO * a_fs,
+        const TSK_TCHAR * a_path);
+    extern uint8_t tsk_fs_block_index_save(const TSK_FS_BLOCK_INDEX *
+        a_index, const TSK_TCHAR * a_path);
+    extern void tsk_fs_block_index_free(TSK_FS_BLOCK_INDEX * a_index);
+    extern ssize_t tsk_fs_block_index_find(const TSK_FS_BLOCK_INDEX *
+        a_index, TSK_DADDR_T a_addr, TSK_FS_BLOCK_INDEX_EXTENT * a_owners,
+        size_t a_len);
+    extern size_t tsk_fs_block_index_count(const TSK_FS_BLOCK_INDEX *
+        a_index);
+    extern uint8_t tsk_fs_block_index_attach(TSK_FS_INFO * a_fs,
+        TSK_FS_BLOCK_INDEX * a_index);
+
     //@}
 
 
@@ -1761,6 +1913,20 @@ class TskFsInfo {
             return -1;
     };
 
+    /**
+    * Read several ranges of data from inside of the file system.
+    * See tsk_fs_readv() for details
+    * @param a_vecs The ranges to read, relative to start of file system (their cnt values are set)
+    * @param a_num_vecs The number of entries in a_vecs
+    * @return The total number of bytes read or -1 on error.
+    */
+    ssize_t readv(TSK_IMG_IOVEC * a_vecs, size_t a_num_vecs) {
+        if (m_fsInfo)
+            return tsk_fs_readv(m_fsInfo, a_vecs, a_num_vecs);
+        else
+            return -1;
+    };
+
     /**
     * Read a file system block.
     * See tsk_fs_read_block() for details
@@ -1822,6 +1988,28 @@ class TskFsInfo {
             return 1;
     };
 
+    /*    * Walk the file names in a directory with a pool of threads and obtain the details of the files via a callback.
+     * See tsk_fs_dir_walk_parallel() for details
+     * @param a_addr Metadata address of the directory to analyze
+     * @param a_flags Flags used during analysis
+     * @param a_action Callback function that is called for each file name
+     * @param a_ptr Pointer to data that is passed to the callback function each time
+     * @param a_numThreads Number of threads to use (0 for the default)
+     * @returns 1 on error and 0 on success
+     */
+    uint8_t dirWalkParallel(TSK_INUM_T a_addr,
+        TSK_FS_DIR_WALK_FLAG_ENUM a_flags, TSK_FS_DIR_WALK_CPP_CB a_action,
+        void *a_ptr, int a_numThreads) {
+        TSK_FS_DIR_WALK_CPP_DATA dirData;
+        dirData.cppAction = a_action;
+        dirData.cPtr = a_ptr;
+        if (m_fsInfo != NULL)
+            return tsk_fs_dir_walk_parallel(m_fsInfo, a_addr,
+                a_flags, tsk_fs_dir_walk_cpp_c_cb, &dirData, a_numThreads);
+        else
+            return 1;
+    };
+
     /**
         *
     * Walk a range of file system blocks and call the callback function
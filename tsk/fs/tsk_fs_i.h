@@ -123,6 +123,9 @@ extern "C" {
     /* FS_DATA_RUN */
     extern TSK_FS_ATTR_RUN *tsk_fs_attr_run_alloc();
     extern void tsk_fs_attr_run_free(TSK_FS_ATTR_RUN *);
+    extern void tsk_fs_attr_run_table_free(TSK_FS_ATTR * a_fs_attr);
+    extern TSK_FS_ATTR_RUN *tsk_fs_attr_run_find(const TSK_FS_ATTR *
+        a_fs_attr, TSK_DADDR_T a_blk);
 
     /* FS_META */
     extern TSK_FS_META *tsk_fs_meta_alloc(size_t);
@@ -143,10 +146,34 @@ extern "C" {
     extern uint8_t tsk_fs_dir_contains(TSK_FS_DIR * a_fs_dir, TSK_INUM_T meta_addr, uint32_t hash);
     extern uint32_t tsk_fs_dir_hash(const char *str);
 
+    /* Sets of metadata addresses */
+    extern TSK_FS_INUM_SET *tsk_fs_inum_set_alloc();
+    extern void tsk_fs_inum_set_free(TSK_FS_INUM_SET * a_set);
+    extern uint8_t tsk_fs_inum_set_add(TSK_FS_INUM_SET * a_set,
+        TSK_INUM_T a_inum);
+    extern uint8_t tsk_fs_inum_set_find(const TSK_FS_INUM_SET * a_set,
+        TSK_INUM_T a_inum);
+    extern TSK_INUM_T tsk_fs_inum_set_count(const TSK_FS_INUM_SET * a_set);
+    extern uint8_t tsk_fs_inum_set_next(const TSK_FS_INUM_SET * a_set,
+        TSK_INUM_T a_inum, TSK_INUM_T * a_next);
+
+    /* Pools of recycled structures */
+    extern void tsk_fs_pool_free(TSK_FS_INFO * a_fs);
+    extern TSK_FS_ATTR_RUN *tsk_fs_pool_get_run(TSK_FS_INFO * a_fs);
+    extern void tsk_fs_pool_put_runs(TSK_FS_INFO * a_fs,
+        TSK_FS_ATTR_RUN * a_fs_attr_run);
+    extern void tsk_fs_pool_put_meta_runs(TSK_FS_INFO * a_fs,
+        TSK_FS_META * a_fs_meta);
+    extern TSK_FS_META *tsk_fs_pool_get_meta(TSK_FS_INFO * a_fs);
+    extern void tsk_fs_pool_put_meta(TSK_FS_INFO * a_fs,
+        TSK_FS_META * a_fs_meta);
+
     /* Orphan Directory Support */
     TSK_RETVAL_ENUM tsk_fs_dir_load_inum_named(TSK_FS_INFO * a_fs);
     uint8_t tsk_fs_dir_find_inum_named(TSK_FS_INFO * a_fs,
         TSK_INUM_T a_inum);
+    extern void tsk_fs_dir_save_orphan_candidates(TSK_FS_INFO * a_fs,
+        TSK_FS_INUM_SET ** a_candidates);
     extern uint8_t tsk_fs_dir_make_orphan_dir_meta(TSK_FS_INFO * a_fs,
         TSK_FS_META * a_fs_meta);
     extern uint8_t tsk_fs_dir_make_orphan_dir_name(TSK_FS_INFO * a_fs,
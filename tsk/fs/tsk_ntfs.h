@@ -49,6 +49,9 @@ extern "C" {
 
 #define NTFS_UPDATE_SEQ_STRIDE  512
 
+/* Number of bytes of $MFT that the inode walk reads at a time */
+#define NTFS_MFT_BULK_SIZE  (4 * 1024 * 1024)
+
 
 
 /************************************************************************
@@ -74,7 +74,7 @@ unix_make_data_run_direct(TSK_FS_INFO * fs, TSK_FS_ATTR * fs_attr,
             TSK_FS_ATTR_RUN *data_run;
 
             // make a non-resident run
-            data_run = tsk_fs_attr_run_alloc();
+            data_run = tsk_fs_pool_get_run(fs);
             if (data_run == NULL)
                 return -1;
 
@@ -154,7 +154,7 @@ unix_make_data_run_indirect(TSK_FS_INFO * fs, TSK_FS_ATTR * fs_attr,
     }
 
     // make a non-resident run
-    data_run = tsk_fs_attr_run_alloc();
+    data_run = tsk_fs_pool_get_run(fs);
     if (data_run == NULL)
         return -1;
 
@@ -271,6 +271,7 @@ tsk_fs_unix_make_data_run(TSK_FS_FILE * fs_file)
 
     // not sure why this would ever happen, but...
     if (fs_meta->attr != NULL) {
+        tsk_fs_pool_put_meta_runs(fs, fs_meta);
         tsk_fs_attrlist_markunused(fs_meta->attr);
     }
     else {
@@ -41,33 +41,24 @@ getError(libewf_error_t * ewf_error,
 }
 #endif
 
+/**
+ * \internal
+ * Read data from libewf.  read_lock must be held when the main handle of
+ * the image is used.
+ * @returns -1 on error or number of bytes read
+ */
 static ssize_t
-ewf_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
+ewf_read_random(libewf_handle_t * handle, TSK_OFF_T offset, char *buf,
     size_t len)
 {
 #if defined( HAVE_LIBEWF_V2_API )
     char error_string[TSK_EWF_ERROR_STRING_SIZE];
     libewf_error_t *ewf_error = NULL;
 #endif
-
     ssize_t cnt;
-    IMG_EWF_INFO *ewf_info = (IMG_EWF_INFO *) img_info;
-
-    if (tsk_verbose)
-        tsk_fprintf(stderr,
-            "ewf_image_read: byte offset: %" PRIuOFF " len: %" PRIuSIZE
-            "\n", offset, len);
 
-    if (offset > img_info->size) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_READ_OFF);
-        tsk_error_set_errstr("ewf_image_read - %" PRIuOFF, offset);
-        return -1;
-    }
-
-    tsk_take_lock(&(ewf_info->read_lock));
 #if defined( HAVE_LIBEWF_V2_API )
-    cnt = libewf_handle_read_random(ewf_info->handle,
+    cnt = libewf_handle_read_random(handle,
         buf, len, offset, &ewf_error);
     if (cnt < 0) {
         char *errmsg = NULL;
@@ -80,20 +71,173 @@ ewf_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
 
         tsk_error_set_errstr("ewf_image_read - offset: %" PRIuOFF
             " - len: %" PRIuSIZE " - %s", offset, len, errmsg);
-        tsk_release_lock(&(ewf_info->read_lock));
         return -1;
     }
 #else
-    cnt = libewf_read_random(ewf_info->handle, buf, len, offset);
+    cnt = libewf_read_random(handle, buf, len, offset);
     if (cnt < 0) {
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_IMG_READ);
         tsk_error_set_errstr("ewf_image_read - offset: %" PRIuOFF
             " - len: %" PRIuSIZE " - %s", offset, len, strerror(errno));
-        tsk_release_lock(&(ewf_info->read_lock));
         return -1;
     }
 #endif
+    return cnt;
+}
+
+/**
+ * \internal
+ * Get a decompressed chunk, from the chunk cache if it is there or else
+ * from libewf.  The least recently used entry is replaced on a miss.
+ * read_lock must be held.
+ *
+ * @param ewf_info Image to read from
+ * @param chunk_off Byte offset of the chunk (a multiple of the chunk size)
+ * @returns NULL on error
+ */
+static IMG_EWF_CHUNK *
+ewf_chunk_get(IMG_EWF_INFO * ewf_info, TSK_OFF_T chunk_off)
+{
+    size_t chunk_size = ewf_info->img_info.chunk_size;
+    IMG_EWF_CHUNK *chunk = NULL;
+    size_t len;
+    ssize_t cnt;
+    int i;
+
+    for (i = 0; i < ewf_info->num_chunks; i++) {
+        IMG_EWF_CHUNK *cur = &ewf_info->chunks[i];
+
+        if (cur->off == chunk_off) {
+            cur->last_use = ++ewf_info->chunk_clock;
+            return cur;
+        }
+        if ((chunk == NULL) || (cur->last_use < chunk->last_use))
+            chunk = cur;
+    }
+
+    if ((chunk->data == NULL)
+        && ((chunk->data = (char *) tsk_malloc(chunk_size)) == NULL))
+        return NULL;
+
+    len = chunk_size;
+    if (chunk_off + (TSK_OFF_T) len > ewf_info->img_info.size)
+        len = (size_t) (ewf_info->img_info.size - chunk_off);
+
+    chunk->off = -1;
+    if ((cnt = ewf_read_random(ewf_info->handle, chunk_off, chunk->data,
+                len)) < 0)
+        return NULL;
+
+    chunk->off = chunk_off;
+    chunk->len = (size_t) cnt;
+    chunk->last_use = ++ewf_info->chunk_clock;
+    return chunk;
+}
+
+/**
+ * \internal
+ * Read data one chunk at a time.  Whole chunks are read straight into the
+ * caller's buffer and the ends of partly read chunks go through the chunk
+ * cache, so that reads of the rest of the chunk do not decompress it
+ * again.  read_lock must be held.
+ * @returns -1 on error or number of bytes read
+ */
+static ssize_t
+ewf_read_chunked(IMG_EWF_INFO * ewf_info, TSK_OFF_T offset, char *buf,
+    size_t len)
+{
+    size_t chunk_size = ewf_info->img_info.chunk_size;
+    size_t total = 0;
+
+    while ((total < len)
+        && (offset + (TSK_OFF_T) total < ewf_info->img_info.size)) {
+        TSK_OFF_T cur_off = offset + (TSK_OFF_T) total;
+        size_t rel_off = (size_t) (cur_off % chunk_size);
+        size_t left = len - total;
+        IMG_EWF_CHUNK *chunk;
+        size_t copy_len;
+        ssize_t cnt;
+
+        if ((rel_off == 0) && (left >= chunk_size)) {
+            size_t read_len = left - (left % chunk_size);
+
+            if ((ewf_info->workers != NULL)
+                && (read_len >= EWF_WORKER_MIN_CHUNKS * chunk_size)) {
+                // give each worker a couple of pieces to even out the load
+                size_t piece_len = roundup(read_len /
+                    (2 * ewf_info->num_workers), chunk_size);
+                cnt = tsk_img_workers_read(ewf_info->workers, cur_off,
+                    &buf[total], read_len, piece_len);
+            }
+            else {
+                cnt = ewf_read_random(ewf_info->handle, cur_off,
+                    &buf[total], read_len);
+            }
+            if (cnt < 0)
+                return -1;
+            total += (size_t) cnt;
+            if ((size_t) cnt < read_len)
+                break;
+            continue;
+        }
+
+        if ((chunk = ewf_chunk_get(ewf_info, cur_off - rel_off)) == NULL)
+            return -1;
+        if (rel_off >= chunk->len)
+            break;
+
+        copy_len = chunk->len - rel_off;
+        if (copy_len > left)
+            copy_len = left;
+        memcpy(&buf[total], &chunk->data[rel_off], copy_len);
+        total += copy_len;
+
+        // the end of the image
+        if (chunk->len < chunk_size)
+            break;
+    }
+    return (ssize_t) total;
+}
+
+/**
+ * \internal
+ * Read data with the handle of a decode worker.
+ * @returns -1 on error or number of bytes read
+ */
+static ssize_t
+ewf_worker_read(TSK_IMG_INFO * img_info, int a_worker, TSK_OFF_T offset,
+    char *buf, size_t len)
+{
+    IMG_EWF_INFO *ewf_info = (IMG_EWF_INFO *) img_info;
+    return ewf_read_random(ewf_info->worker_handles[a_worker], offset, buf,
+        len);
+}
+
+static ssize_t
+ewf_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
+    size_t len)
+{
+    ssize_t cnt;
+    IMG_EWF_INFO *ewf_info = (IMG_EWF_INFO *) img_info;
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr,
+            "ewf_image_read: byte offset: %" PRIuOFF " len: %" PRIuSIZE
+            "\n", offset, len);
+
+    if (offset > img_info->size) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_READ_OFF);
+        tsk_error_set_errstr("ewf_image_read - %" PRIuOFF, offset);
+        return -1;
+    }
+
+    tsk_take_lock(&(ewf_info->read_lock));
+    if (ewf_info->chunks != NULL)
+        cnt = ewf_read_chunked(ewf_info, offset, buf, len);
+    else
+        cnt = ewf_read_random(ewf_info->handle, offset, buf, len);
     tsk_release_lock(&(ewf_info->read_lock));
 
     return cnt;
@@ -117,6 +261,96 @@ ewf_image_imgstat(TSK_IMG_INFO * img_info, FILE * hFile)
     return;
 }
 
+/**
+ * \internal
+ * Stop the decode workers of an image and close their handles.
+ */
+static void
+ewf_stop_workers(IMG_EWF_INFO * ewf_info)
+{
+    int i;
+
+    tsk_img_workers_free(ewf_info->workers);
+    ewf_info->workers = NULL;
+
+    for (i = 0; i < ewf_info->num_workers; i++) {
+#if defined ( HAVE_LIBEWF_V2_API)
+        libewf_handle_close(ewf_info->worker_handles[i], NULL);
+        libewf_handle_free(&(ewf_info->worker_handles[i]), NULL);
+#endif
+    }
+    free(ewf_info->worker_handles);
+    ewf_info->worker_handles = NULL;
+    ewf_info->num_workers = 0;
+}
+
+#if defined( HAVE_LIBEWF_V2_API )
+/**
+ * \internal
+ * Open a handle for each decode worker and start the workers.  The
+ * image can be read without them, so errors are only reported when
+ * verbose.
+ *
+ * @param ewf_info Image to start the workers for
+ * @param a_num_threads Number of workers to start
+ */
+static void
+ewf_start_workers(IMG_EWF_INFO * ewf_info, unsigned int a_num_threads)
+{
+    libewf_error_t *ewf_error = NULL;
+    unsigned int i;
+
+    if ((ewf_info->worker_handles = (libewf_handle_t **)
+            tsk_malloc(a_num_threads * sizeof(libewf_handle_t *))) == NULL) {
+        tsk_error_reset();
+        return;
+    }
+
+    for (i = 0; i < a_num_threads; i++) {
+        libewf_handle_t *handle = NULL;
+        int is_error;
+
+        if (libewf_handle_initialize(&handle, &ewf_error) != 1) {
+            libewf_error_free(&ewf_error);
+            break;
+        }
+#if defined( TSK_WIN32 )
+        is_error = (libewf_handle_open_wide(handle,
+                (wchar_t * const *) ewf_info->img_info.images,
+                ewf_info->img_info.num_img, LIBEWF_OPEN_READ,
+                &ewf_error) != 1);
+#else
+        is_error = (libewf_handle_open(handle,
+                (char *const *) ewf_info->img_info.images,
+                ewf_info->img_info.num_img, LIBEWF_OPEN_READ,
+                &ewf_error) != 1);
+#endif
+        if (is_error) {
+            libewf_error_free(&ewf_error);
+            libewf_handle_free(&handle, NULL);
+            break;
+        }
+        ewf_info->worker_handles[ewf_info->num_workers++] = handle;
+    }
+
+    if ((ewf_info->num_workers < (int) a_num_threads)
+        || ((ewf_info->workers =
+                tsk_img_workers_create(&(ewf_info->img_info),
+                    ewf_info->num_workers, ewf_worker_read)) == NULL)) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "ewf_open: decode workers not started\n");
+        ewf_stop_workers(ewf_info);
+        tsk_error_reset();
+        return;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr, "ewf_open: started %d decode workers\n",
+            ewf_info->num_workers);
+}
+#endif
+
 static void
 ewf_image_close(TSK_IMG_INFO * img_info)
 {
@@ -149,6 +383,16 @@ ewf_image_close(TSK_IMG_INFO * img_info)
 #endif
     }
 
+    ewf_stop_workers(ewf_info);
+
+    if (ewf_info->chunks != NULL) {
+        int i;
+        for (i = 0; i < ewf_info->num_chunks; i++) {
+            free(ewf_info->chunks[i].data);
+        }
+        free(ewf_info->chunks);
+    }
+
     tsk_deinit_lock(&(ewf_info->read_lock));
     tsk_img_free(ewf_info);
 }
@@ -200,7 +444,8 @@ img_file_header_signature_ncmp(const char *filename,
 
 TSK_IMG_INFO *
 ewf_open(int a_num_img,
-    const TSK_TCHAR * const a_images[], unsigned int a_ssize)
+    const TSK_TCHAR * const a_images[], unsigned int a_ssize,
+    const TSK_IMG_OPTIONS * a_opts)
 {
     int is_error;
 #if defined( HAVE_LIBEWF_V2_API )
@@ -557,6 +802,52 @@ ewf_open(int a_num_img,
             img_info->sector_size = bytes_per_sector;
         }
     }
+#if defined( HAVE_LIBEWF_V2_API )
+    /* Read whole chunks at a time and keep a few recent ones decompressed.
+     * The image can still be read without this, so errors are ignored. */
+    {
+        size32_t chunk_size = 0;
+
+        if (libewf_handle_get_chunk_size(ewf_info->handle, &chunk_size,
+                &ewf_error) != 1) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "ewf_open: error getting chunk size from E01\n");
+            libewf_error_free(&ewf_error);
+            chunk_size = 0;
+        }
+
+        if ((chunk_size > 0) && ((chunk_size % img_info->sector_size) == 0)) {
+            int num_chunks = EWF_CHUNK_CACHE_MEM / chunk_size;
+            int i;
+
+            if (num_chunks > EWF_CHUNK_CACHE_NUM)
+                num_chunks = EWF_CHUNK_CACHE_NUM;
+            else if (num_chunks < 1)
+                num_chunks = 1;
+
+            if ((ewf_info->chunks = (IMG_EWF_CHUNK *)
+                    tsk_malloc(num_chunks * sizeof(IMG_EWF_CHUNK))) == NULL) {
+                tsk_error_reset();
+            }
+            else {
+                for (i = 0; i < num_chunks; i++)
+                    ewf_info->chunks[i].off = -1;
+                ewf_info->num_chunks = num_chunks;
+                img_info->chunk_size = chunk_size;
+                if (tsk_verbose)
+                    tsk_fprintf(stderr,
+                        "ewf_open: chunk size %" PRIu32 ", caching %d chunks\n",
+                        (uint32_t) chunk_size, num_chunks);
+            }
+        }
+    }
+
+    // large reads are split on chunk boundaries, so the chunk size is needed
+    if ((ewf_info->chunks != NULL) && (a_opts->decode_threads > 0))
+        ewf_start_workers(ewf_info, a_opts->decode_threads);
+#endif
+
     img_info->itype = TSK_IMG_TYPE_EWF_EWF;
     img_info->read = &ewf_image_read;
     img_info->close = &ewf_image_close;
@@ -32,7 +32,21 @@ extern "C" {
 #endif
 
     extern TSK_IMG_INFO *ewf_open(int, const TSK_TCHAR * const images[],
-        unsigned int a_ssize);
+        unsigned int a_ssize, const TSK_IMG_OPTIONS * a_opts);
+
+/* Most chunks and most memory that are used to keep chunks decompressed */
+#define EWF_CHUNK_CACHE_NUM 8
+#define EWF_CHUNK_CACHE_MEM (16 * 1024 * 1024)
+
+/* Fewest whole chunks in a read before it is split over the decode workers */
+#define EWF_WORKER_MIN_CHUNKS 4
+
+    typedef struct {
+        TSK_OFF_T off;          ///< Byte offset of the chunk in the image (-1 if not used)
+        size_t len;             ///< Number of bytes in data (less than the chunk size at the end of the image)
+        char *data;             ///< Decompressed chunk
+        uint64_t last_use;      ///< Value of chunk_clock when the chunk was last used
+    } IMG_EWF_CHUNK;
 
     typedef struct {
         TSK_IMG_INFO img_info;
@@ -43,6 +57,15 @@ extern "C" {
         int sha1hash_isset;
         uint8_t used_ewf_glob;  // 1 if libewf_glob was used during open
         tsk_lock_t read_lock;   ///< Lock for reads since libewf is not thread safe -- only works if you have a single instance of EWF_INFO for all threads.
+
+        // the following are protected by read_lock
+        IMG_EWF_CHUNK *chunks;  ///< Recently read chunks (NULL if the chunk size is unknown)
+        int num_chunks;         ///< Number of entries in chunks
+        uint64_t chunk_clock;   ///< Counter for the LRU order of chunks
+
+        TSK_IMG_WORKERS *workers;       ///< Threads that decompress large reads in parallel (NULL if not used)
+        libewf_handle_t **worker_handles;       ///< Handle of each worker
+        int num_workers;        ///< Number of entries in worker_handles
     } IMG_EWF_INFO;
 
     
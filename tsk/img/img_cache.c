@@ -0,0 +1,802 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file img_cache.c
+ * Contains the read cache that sits between tsk_img_read() and the
+ * format-specific read callbacks.
+ *
+ * The cache is made of fixed-size lines that start on multiples of the
+ * line length.  Lines are spread over a power-of-two number of shards by
+ * their line number, so that a run of consecutive lines is split evenly over
+ * the shards, and each shard has its own lock, hash table and LRU list.
+ * A cache hit only takes the lock of the shard that holds the line.  The
+ * image-wide cache_lock in TSK_IMG_INFO is only taken when a miss has to
+ * call into the format-specific read callback, and not even then for
+ * formats that set read_unlocked (except to use the shared read-ahead
+ * buffer).
+ *
+ * Misses are also fed to a small sequential stream detector.  When a miss
+ * lands on the line right after the end of a previous read, the cache reads
+ * a window of several lines with one call to the read callback and doubles
+ * the window each time the stream continues (up to the read-ahead maximum).
+ * Several streams are tracked at once so that threads or files that are
+ * read at the same time do not reset each other.
+ */
+
+#include "tsk_img_i.h"
+
+/* Upper bound on the number of shards in a cache */
+#define TSK_IMG_CACHE_SHARD_MAX     64
+
+/* Minimum number of lines per shard before we add more shards */
+#define TSK_IMG_CACHE_SHARD_LINES   4
+
+/* Number of sequential streams that are tracked at the same time */
+#define TSK_IMG_CACHE_STREAMS       8
+
+/** \internal
+ * A single cache line.  Lines that are in use are linked into their shard's
+ * hash chain and LRU list.  A line that is being filled by a miss is in
+ * neither so that other threads can not see or reuse it.
+ */
+typedef struct {
+    TSK_OFF_T off;              ///< Byte offset of the line in the image (-1 if unused)
+    size_t len;                 ///< Number of valid bytes in data
+    char *data;                 ///< Line buffer (allocated when first filled)
+    int hnext;                  ///< Next line in the same hash bucket (-1 at end)
+    int prev;                   ///< Previous (more recently used) line in LRU list
+    int next;                   ///< Next (less recently used) line in LRU list
+} TSK_IMG_CACHE_LINE;
+
+/** \internal
+ * A shard of the cache.  All of the fields are protected by lock.
+ */
+typedef struct {
+    tsk_lock_t lock;
+    TSK_IMG_CACHE_LINE *lines;
+    unsigned int num_lines;
+    int *buckets;               ///< Head of each hash chain (-1 if empty)
+    unsigned int bucket_mask;
+    int lru_head;               ///< Most recently used line (-1 if none)
+    int lru_tail;               ///< Least recently used line (-1 if none)
+    char pad[64];               ///< Keep the locks of neighboring shards on different CPU cache lines
+} TSK_IMG_CACHE_SHARD;
+
+/** \internal
+ * A sequential read stream that has been seen by the read-ahead detector.
+ */
+typedef struct {
+    TSK_OFF_T next_off;         ///< Line offset that would continue the stream (-1 if unused)
+    size_t window;              ///< Size of the last read of the stream in bytes
+    uint64_t last_use;          ///< Value of ra_clock when the stream was last continued
+} TSK_IMG_CACHE_STREAM;
+
+struct TSK_IMG_CACHE {
+    size_t line_len;            ///< Size of each line in bytes
+    unsigned int num_lines;     ///< Total number of lines over all shards
+    unsigned int shard_mask;    ///< Number of shards - 1
+    TSK_IMG_CACHE_SHARD *shards;
+
+    size_t ra_max;              ///< Largest read-ahead in bytes (0 if read-ahead is off)
+    tsk_lock_t ra_lock;         ///< Protects streams and ra_clock
+    TSK_IMG_CACHE_STREAM streams[TSK_IMG_CACHE_STREAMS];
+    uint64_t ra_clock;
+    char *ra_buf;               ///< Buffer for loading several lines (protected by cache_lock in TSK_IMG_INFO)
+    size_t ra_buf_len;          ///< Size of ra_buf (the larger of ra_max and line_len)
+};
+
+
+/* Fibonacci hash of the line number, used to pick the hash bucket in a
+ * shard.  Lines in a shard are shard_mask + 1 lines apart, so the low bits
+ * of the line number can not be used directly. */
+static uint64_t
+cache_hash(const TSK_IMG_CACHE * a_cache, TSK_OFF_T a_line_off)
+{
+    return (uint64_t) (a_line_off / a_cache->line_len) *
+        0x9E3779B97F4A7C15ULL;
+}
+
+#define CACHE_HASH_BUCKET(h) ((unsigned int) ((h) >> 20))
+
+/* Shard that holds the line that starts at a_line_off */
+static TSK_IMG_CACHE_SHARD *
+cache_shard(const TSK_IMG_CACHE * a_cache, TSK_OFF_T a_line_off)
+{
+    return &a_cache->shards[(uint64_t) (a_line_off / a_cache->line_len) &
+        a_cache->shard_mask];
+}
+
+
+static void
+lru_unlink(TSK_IMG_CACHE_SHARD * a_shard, int a_idx)
+{
+    TSK_IMG_CACHE_LINE *line = &a_shard->lines[a_idx];
+
+    if (line->prev >= 0)
+        a_shard->lines[line->prev].next = line->next;
+    else
+        a_shard->lru_head = line->next;
+
+    if (line->next >= 0)
+        a_shard->lines[line->next].prev = line->prev;
+    else
+        a_shard->lru_tail = line->prev;
+
+    line->prev = line->next = -1;
+}
+
+static void
+lru_push_head(TSK_IMG_CACHE_SHARD * a_shard, int a_idx)
+{
+    TSK_IMG_CACHE_LINE *line = &a_shard->lines[a_idx];
+
+    line->prev = -1;
+    line->next = a_shard->lru_head;
+    if (a_shard->lru_head >= 0)
+        a_shard->lines[a_shard->lru_head].prev = a_idx;
+    else
+        a_shard->lru_tail = a_idx;
+    a_shard->lru_head = a_idx;
+}
+
+static void
+lru_push_tail(TSK_IMG_CACHE_SHARD * a_shard, int a_idx)
+{
+    TSK_IMG_CACHE_LINE *line = &a_shard->lines[a_idx];
+
+    line->next = -1;
+    line->prev = a_shard->lru_tail;
+    if (a_shard->lru_tail >= 0)
+        a_shard->lines[a_shard->lru_tail].next = a_idx;
+    else
+        a_shard->lru_head = a_idx;
+    a_shard->lru_tail = a_idx;
+}
+
+static int
+hash_find(TSK_IMG_CACHE_SHARD * a_shard, unsigned int a_bucket,
+    TSK_OFF_T a_off)
+{
+    int idx;
+
+    for (idx = a_shard->buckets[a_bucket]; idx >= 0;
+        idx = a_shard->lines[idx].hnext) {
+        if (a_shard->lines[idx].off == a_off)
+            return idx;
+    }
+    return -1;
+}
+
+static void
+hash_remove(TSK_IMG_CACHE_SHARD * a_shard, unsigned int a_bucket,
+    int a_idx)
+{
+    int *prev = &a_shard->buckets[a_bucket];
+
+    while (*prev >= 0) {
+        if (*prev == a_idx) {
+            *prev = a_shard->lines[a_idx].hnext;
+            break;
+        }
+        prev = &a_shard->lines[*prev].hnext;
+    }
+    a_shard->lines[a_idx].hnext = -1;
+}
+
+static void
+hash_insert(TSK_IMG_CACHE_SHARD * a_shard, unsigned int a_bucket,
+    int a_idx)
+{
+    a_shard->lines[a_idx].hnext = a_shard->buckets[a_bucket];
+    a_shard->buckets[a_bucket] = a_idx;
+}
+
+
+
+/**
+ * \internal
+ * Tell the stream detector about a miss and decide how much to read.  A miss
+ * on the line that follows the last read of a stream continues that stream
+ * and doubles its window.  Any other miss replaces the least recently used
+ * stream.
+ *
+ * @param a_cache Cache that had the miss
+ * @param a_line_off Byte offset of the line that was missed
+ * @returns Number of bytes to read starting at a_line_off
+ */
+static size_t
+cache_stream_miss(TSK_IMG_CACHE * a_cache, TSK_OFF_T a_line_off)
+{
+    TSK_IMG_CACHE_STREAM *stream = NULL;
+    size_t window;
+    int i;
+
+    tsk_take_lock(&(a_cache->ra_lock));
+    a_cache->ra_clock++;
+
+    for (i = 0; i < TSK_IMG_CACHE_STREAMS; i++) {
+        if (a_cache->streams[i].next_off == a_line_off) {
+            stream = &a_cache->streams[i];
+            break;
+        }
+    }
+
+    if (stream != NULL) {
+        window = stream->window * 2;
+        if (window > a_cache->ra_max)
+            window = a_cache->ra_max;
+    }
+    else {
+        stream = &a_cache->streams[0];
+        for (i = 1; i < TSK_IMG_CACHE_STREAMS; i++) {
+            if (a_cache->streams[i].last_use < stream->last_use)
+                stream = &a_cache->streams[i];
+        }
+        window = a_cache->line_len;
+    }
+
+    stream->next_off = a_line_off + (TSK_OFF_T) window;
+    stream->window = window;
+    stream->last_use = a_cache->ra_clock;
+
+    tsk_release_lock(&(a_cache->ra_lock));
+    return window;
+}
+
+/**
+ * \internal
+ * Copy data for a line into the cache as the most recently used line.
+ * Nothing is done if the line is already loaded or no line is free.
+ */
+static void
+cache_store_line(TSK_IMG_CACHE * a_cache, TSK_OFF_T a_line_off,
+    const char *a_data, size_t a_len)
+{
+    TSK_IMG_CACHE_SHARD *shard;
+    TSK_IMG_CACHE_LINE *line;
+    uint64_t hash;
+    unsigned int bucket;
+    int idx;
+
+    hash = cache_hash(a_cache, a_line_off);
+    shard = cache_shard(a_cache, a_line_off);
+    bucket = CACHE_HASH_BUCKET(hash) & shard->bucket_mask;
+
+    tsk_take_lock(&(shard->lock));
+    if ((hash_find(shard, bucket, a_line_off) >= 0)
+        || ((idx = shard->lru_tail) < 0)) {
+        tsk_release_lock(&(shard->lock));
+        return;
+    }
+
+    line = &shard->lines[idx];
+    if ((line->data == NULL)
+        && ((line->data =
+                (char *) tsk_malloc(a_cache->line_len)) == NULL)) {
+        tsk_release_lock(&(shard->lock));
+        tsk_error_reset();
+        return;
+    }
+
+    lru_unlink(shard, idx);
+    if (line->off != -1) {
+        hash_remove(shard,
+            CACHE_HASH_BUCKET(cache_hash(a_cache,
+                    line->off)) & shard->bucket_mask, idx);
+    }
+    memcpy(line->data, a_data, a_len);
+    line->off = a_line_off;
+    line->len = a_len;
+    hash_insert(shard, bucket, idx);
+    lru_push_head(shard, idx);
+    tsk_release_lock(&(shard->lock));
+}
+
+/**
+ * \internal
+ * Load several lines with one call to the format-specific read callback.
+ *
+ * @param a_img_info Disk image to read from
+ * @param a_line_off Byte offset of the first line to load
+ * @param a_len Number of bytes to read (no more than ra_buf_len)
+ * @returns 1 on error and 0 on success
+ */
+static uint8_t
+cache_load_lines(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_line_off,
+    size_t a_len)
+{
+    TSK_IMG_CACHE *cache = a_img_info->cache;
+    ssize_t cnt;
+    size_t i;
+
+    if (a_line_off + (TSK_OFF_T) a_len > a_img_info->size)
+        a_len = (size_t) (a_img_info->size - a_line_off);
+
+    tsk_take_lock(&(a_img_info->cache_lock));
+    if ((cache->ra_buf == NULL)
+        && ((cache->ra_buf =
+                (char *) tsk_malloc(cache->ra_buf_len)) == NULL)) {
+        tsk_release_lock(&(a_img_info->cache_lock));
+        tsk_error_reset();
+        return 1;
+    }
+
+    cnt = tsk_img_read_backend(a_img_info, a_line_off, cache->ra_buf,
+        a_len);
+    if (cnt <= 0) {
+        tsk_release_lock(&(a_img_info->cache_lock));
+        tsk_error_reset();
+        return 1;
+    }
+
+    /* Store the last line first so that the lines that will be needed
+     * next end up as the most recently used. */
+    i = (((size_t) cnt - 1) / cache->line_len) * cache->line_len;
+    while (1) {
+        size_t len = (size_t) cnt - i;
+
+        if (len > cache->line_len)
+            len = cache->line_len;
+        cache_store_line(cache, a_line_off + (TSK_OFF_T) i,
+            &cache->ra_buf[i], len);
+
+        if (i == 0)
+            break;
+        i -= cache->line_len;
+    }
+    tsk_release_lock(&(a_img_info->cache_lock));
+    return 0;
+}
+
+/**
+ * \internal
+ * @returns 1 if the line that starts at a_line_off is in the cache
+ */
+static uint8_t
+cache_line_loaded(TSK_IMG_CACHE * a_cache, TSK_OFF_T a_line_off)
+{
+    TSK_IMG_CACHE_SHARD *shard;
+    uint64_t hash;
+    int idx;
+
+    hash = cache_hash(a_cache, a_line_off);
+    shard = cache_shard(a_cache, a_line_off);
+
+    tsk_take_lock(&(shard->lock));
+    idx = hash_find(shard, CACHE_HASH_BUCKET(hash) & shard->bucket_mask,
+        a_line_off);
+    tsk_release_lock(&(shard->lock));
+    return (idx >= 0);
+}
+
+/**
+ * \internal
+ * Read data from a single cache line, loading it if needed.
+ *
+ * @param a_img_info Disk image to read from
+ * @param a_line_off Byte offset of the start of the line
+ * @param a_rel_off Offset of the requested data relative to a_line_off
+ * @param a_buf Buffer to read into
+ * @param a_len Number of bytes to read (must not go past the end of the line)
+ * @returns -1 on error or number of bytes read
+ */
+static ssize_t
+cache_read_line(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_line_off,
+    size_t a_rel_off, char *a_buf, size_t a_len)
+{
+    TSK_IMG_CACHE *cache = a_img_info->cache;
+    TSK_IMG_CACHE_SHARD *shard;
+    TSK_IMG_CACHE_LINE *line;
+    uint64_t hash;
+    unsigned int bucket;
+    size_t read_size;
+    ssize_t cnt;
+    int idx;
+    uint8_t ra_done = 0;
+
+    hash = cache_hash(cache, a_line_off);
+    shard = cache_shard(cache, a_line_off);
+    bucket = CACHE_HASH_BUCKET(hash) & shard->bucket_mask;
+
+  retry:
+    tsk_take_lock(&(shard->lock));
+
+    // see if it is already in the cache
+    if ((idx = hash_find(shard, bucket, a_line_off)) >= 0) {
+        line = &shard->lines[idx];
+
+        if (a_rel_off >= line->len)
+            a_len = 0;
+        else if (a_rel_off + a_len > line->len)
+            a_len = line->len - a_rel_off;
+
+        if (a_len > 0)
+            memcpy(a_buf, &line->data[a_rel_off], a_len);
+
+        // it was useful, so make it the most recently used
+        if (shard->lru_head != idx) {
+            lru_unlink(shard, idx);
+            lru_push_head(shard, idx);
+        }
+        tsk_release_lock(&(shard->lock));
+
+        // a hit after read-ahead was counted as a miss below
+        if (ra_done == 0)
+            tsk_img_stats_note_cache(a_img_info, 1);
+        return (ssize_t) a_len;
+    }
+
+    if (ra_done == 0)
+        tsk_img_stats_note_cache(a_img_info, 0);
+
+    /* If this miss continues a sequential stream, then load it and the
+     * lines after it with one large read and look again. */
+    if ((cache->ra_max > 0) && (ra_done == 0)) {
+        size_t window;
+
+        tsk_release_lock(&(shard->lock));
+        ra_done = 1;
+        window = cache_stream_miss(cache, a_line_off);
+        if (window > cache->line_len)
+            cache_load_lines(a_img_info, a_line_off, window);
+        goto retry;
+    }
+
+    /* Take the least recently used line out of the shard so that we can
+     * fill it without holding the shard lock.  If every line is being
+     * filled by another thread, then skip the cache. */
+    if ((idx = shard->lru_tail) < 0) {
+        tsk_release_lock(&(shard->lock));
+        return tsk_img_read_direct(a_img_info, a_line_off + a_rel_off,
+            a_buf, a_len);
+    }
+    line = &shard->lines[idx];
+    lru_unlink(shard, idx);
+    if (line->off != -1) {
+        hash_remove(shard,
+            CACHE_HASH_BUCKET(cache_hash(cache,
+                    line->off)) & shard->bucket_mask, idx);
+        line->off = -1;
+    }
+    line->len = 0;
+    tsk_release_lock(&(shard->lock));
+
+    // Read a full line or the remaining data.
+    read_size = cache->line_len;
+    if (a_line_off + (TSK_OFF_T) read_size > a_img_info->size)
+        read_size = (size_t) (a_img_info->size - a_line_off);
+
+    cnt = -1;
+    if ((line->data != NULL)
+        || ((line->data = (char *) tsk_malloc(cache->line_len)) != NULL)) {
+        if (a_img_info->read_unlocked == 0)
+            tsk_take_lock(&(a_img_info->cache_lock));
+        cnt = tsk_img_read_backend(a_img_info, a_line_off, line->data,
+            read_size);
+        if (a_img_info->read_unlocked == 0)
+            tsk_release_lock(&(a_img_info->cache_lock));
+    }
+
+    // copy the data out while the line is still private to us
+    if (cnt > 0) {
+        if (a_rel_off >= (size_t) cnt)
+            a_len = 0;
+        else if (a_rel_off + a_len > (size_t) cnt)
+            a_len = (size_t) cnt - a_rel_off;
+
+        if (a_len > 0)
+            memcpy(a_buf, &line->data[a_rel_off], a_len);
+    }
+
+    /* Put the line back.  Another thread may have loaded the same data while
+     * we were reading, in which case we keep theirs and recycle ours. */
+    tsk_take_lock(&(shard->lock));
+    if ((cnt > 0) && (hash_find(shard, bucket, a_line_off) < 0)) {
+        line->off = a_line_off;
+        line->len = (size_t) cnt;
+        hash_insert(shard, bucket, idx);
+        lru_push_head(shard, idx);
+    }
+    else {
+        lru_push_tail(shard, idx);
+    }
+    tsk_release_lock(&(shard->lock));
+
+    if (cnt <= 0) {
+        // Something went wrong so let's try skipping the cache
+        return tsk_img_read_direct(a_img_info, a_line_off + a_rel_off,
+            a_buf, a_len);
+    }
+    return (ssize_t) a_len;
+}
+
+
+/**
+ * \internal
+ * Read data from the image through the cache.  Requests that are larger
+ * than a cache line bypass the cache.
+ *
+ * @param a_img_info Disk image to read from (must have a cache)
+ * @param a_off Byte offset to start reading from
+ * @param a_buf Buffer to read into
+ * @param a_len Number of bytes to read into buffer
+ * @returns -1 on error or number of bytes read
+ */
+ssize_t
+tsk_img_cache_read(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    char *a_buf, size_t a_len)
+{
+    TSK_IMG_CACHE *cache = a_img_info->cache;
+    size_t total = 0;
+
+    // if they ask for more than the line length, skip the cache
+    if (a_len > cache->line_len) {
+        return tsk_img_read_direct(a_img_info, a_off, a_buf, a_len);
+    }
+
+    // TODO: why not just return 0 here (and be POSIX compliant)?
+    if (a_off >= a_img_info->size) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_READ_OFF);
+        tsk_error_set_errstr("tsk_img_read - %" PRIuOFF, a_off);
+        return -1;
+    }
+
+    // Protect against INT64_MAX + INT64_MAX > value
+    if (((TSK_OFF_T) a_len > a_img_info->size)
+        || (a_off >= (a_img_info->size - (TSK_OFF_T) a_len))) {
+        a_len = (size_t) (a_img_info->size - a_off);
+    }
+
+    // the request can span the end of one line and the start of the next
+    while (total < a_len) {
+        TSK_OFF_T cur_off = a_off + (TSK_OFF_T) total;
+        TSK_OFF_T line_off = cur_off - (cur_off % cache->line_len);
+        size_t rel_off = (size_t) (cur_off - line_off);
+        size_t len = cache->line_len - rel_off;
+        ssize_t cnt;
+
+        if (len > a_len - total)
+            len = a_len - total;
+
+        cnt = cache_read_line(a_img_info, line_off, rel_off,
+            &a_buf[total], len);
+        if (cnt < 0)
+            return -1;
+
+        total += (size_t) cnt;
+        if ((size_t) cnt < len)
+            break;
+    }
+
+    return (ssize_t) total;
+}
+
+
+/**
+ * \internal
+ * Load a range of the image into the cache without copying it anywhere.
+ * Lines that are already loaded are skipped and the others are read in
+ * groups of up to the read-ahead size.  Errors are ignored because the data
+ * will be read again (and the error reported) if it is needed.
+ *
+ * @param a_img_info Disk image to load data from
+ * @param a_off Byte offset of the start of the range
+ * @param a_len Length of the range in bytes
+ */
+void
+tsk_img_cache_fill(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    size_t a_len)
+{
+    TSK_IMG_CACHE *cache = a_img_info->cache;
+    TSK_OFF_T line_off, end;
+
+    if ((cache == NULL) || (a_off >= a_img_info->size))
+        return;
+
+    end = a_off + (TSK_OFF_T) a_len;
+    if (end > a_img_info->size)
+        end = a_img_info->size;
+
+    line_off = a_off - (a_off % cache->line_len);
+    while (line_off < end) {
+        size_t len;
+
+        if (cache_line_loaded(cache, line_off)) {
+            line_off += cache->line_len;
+            continue;
+        }
+
+        len = cache->ra_buf_len;
+        if (line_off + (TSK_OFF_T) len > end)
+            len = (size_t) roundup(end - line_off, cache->line_len);
+        cache_load_lines(a_img_info, line_off, len);
+        line_off += len;
+    }
+}
+
+
+/**
+ * \internal
+ * @returns The number of bytes that the cache of an image can hold
+ */
+size_t
+tsk_img_cache_size(TSK_IMG_INFO * a_img_info)
+{
+    if (a_img_info->cache == NULL)
+        return 0;
+    return a_img_info->cache->num_lines * a_img_info->cache->line_len;
+}
+
+
+/**
+ * \internal
+ * Create the read cache for an image.  The number of shards is picked from
+ * the number of lines so that each shard has a handful of lines to evict
+ * from.  The line size is rounded up to a multiple of the sector size and
+ * read-ahead is limited to half of the cache so that one stream can not
+ * flush everything else.
+ *
+ * @param a_img_info Disk image to create the cache for
+ * @param a_opts Cache geometry and read-ahead options
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_img_cache_init(TSK_IMG_INFO * a_img_info,
+    const TSK_IMG_OPTIONS * a_opts)
+{
+    TSK_IMG_CACHE *cache;
+    unsigned int a_num_lines = a_opts->cache_num;
+    size_t a_line_len = a_opts->cache_len;
+    unsigned int num_shards = 1;
+    unsigned int s;
+
+    a_img_info->cache = NULL;
+    if ((a_num_lines == 0) || (a_line_len == 0))
+        return 0;
+
+    if ((a_img_info->sector_size > 0)
+        && ((a_line_len % a_img_info->sector_size) != 0))
+        a_line_len += a_img_info->sector_size -
+            (a_line_len % a_img_info->sector_size);
+
+    /* Line up the lines with the units that the format decompresses, so
+     * that a unit is not split over two lines and decompressed for each.
+     * Lines that are smaller than a unit must divide it evenly. */
+    if (a_img_info->chunk_size > 0) {
+        size_t chunk = a_img_info->chunk_size;
+
+        if (a_line_len >= chunk) {
+            if (a_line_len % chunk)
+                a_line_len += chunk - (a_line_len % chunk);
+        }
+        else if (chunk % a_line_len) {
+            size_t a = chunk;
+            size_t b = a_line_len;
+            while (b != 0) {
+                size_t t = a % b;
+                a = b;
+                b = t;
+            }
+            a_line_len = a;
+        }
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "tsk_img_cache_init: line length %" PRIuSIZE
+                " for chunks of %" PRIuSIZE " bytes\n", a_line_len, chunk);
+    }
+
+    while ((num_shards < TSK_IMG_CACHE_SHARD_MAX)
+        && (num_shards * 2 * TSK_IMG_CACHE_SHARD_LINES <= a_num_lines)) {
+        num_shards *= 2;
+    }
+
+    if ((cache =
+            (TSK_IMG_CACHE *) tsk_malloc(sizeof(TSK_IMG_CACHE))) == NULL)
+        return 1;
+    cache->line_len = a_line_len;
+    cache->num_lines = a_num_lines;
+    cache->shard_mask = num_shards - 1;
+
+    cache->ra_max = a_opts->readahead_max;
+    if (cache->ra_max > (a_num_lines / 2) * a_line_len)
+        cache->ra_max = (a_num_lines / 2) * a_line_len;
+    cache->ra_max -= cache->ra_max % a_line_len;
+    if (cache->ra_max < 2 * a_line_len)
+        cache->ra_max = 0;
+    cache->ra_buf_len = (cache->ra_max > 0) ? cache->ra_max : a_line_len;
+    for (s = 0; s < TSK_IMG_CACHE_STREAMS; s++)
+        cache->streams[s].next_off = -1;
+    tsk_init_lock(&(cache->ra_lock));
+
+    if ((cache->shards =
+            (TSK_IMG_CACHE_SHARD *) tsk_malloc(num_shards *
+                sizeof(TSK_IMG_CACHE_SHARD))) == NULL) {
+        tsk_deinit_lock(&(cache->ra_lock));
+        free(cache);
+        return 1;
+    }
+    a_img_info->cache = cache;
+
+    for (s = 0; s < num_shards; s++) {
+        TSK_IMG_CACHE_SHARD *shard = &cache->shards[s];
+        unsigned int num_buckets = 1;
+        unsigned int i;
+
+        tsk_init_lock(&(shard->lock));
+
+        // spread the remainder over the first shards
+        shard->num_lines = a_num_lines / num_shards;
+        if (s < a_num_lines % num_shards)
+            shard->num_lines++;
+
+        // keep the hash chains short
+        while (num_buckets < 2 * shard->num_lines)
+            num_buckets *= 2;
+        shard->bucket_mask = num_buckets - 1;
+
+        shard->lru_head = shard->lru_tail = -1;
+        if (((shard->lines =
+                    (TSK_IMG_CACHE_LINE *) tsk_malloc(shard->num_lines *
+                        sizeof(TSK_IMG_CACHE_LINE))) == NULL)
+            || ((shard->buckets =
+                    (int *) tsk_malloc(num_buckets * sizeof(int))) ==
+                NULL)) {
+            // only free the shards that have been set up so far
+            shard->num_lines = 0;
+            cache->shard_mask = s;
+            tsk_img_cache_free(a_img_info);
+            return 1;
+        }
+
+        for (i = 0; i < num_buckets; i++)
+            shard->buckets[i] = -1;
+
+        for (i = 0; i < shard->num_lines; i++) {
+            shard->lines[i].off = -1;
+            shard->lines[i].hnext = -1;
+            lru_push_tail(shard, i);
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * \internal
+ * Free the read cache of an image (if it has one).
+ *
+ * @param a_img_info Disk image to free the cache of
+ */
+void
+tsk_img_cache_free(TSK_IMG_INFO * a_img_info)
+{
+    TSK_IMG_CACHE *cache = a_img_info->cache;
+    unsigned int s;
+
+    if (cache == NULL)
+        return;
+
+    for (s = 0; s <= cache->shard_mask; s++) {
+        TSK_IMG_CACHE_SHARD *shard = &cache->shards[s];
+        unsigned int i;
+
+        if (shard->lines != NULL) {
+            for (i = 0; i < shard->num_lines; i++)
+                free(shard->lines[i].data);
+            free(shard->lines);
+        }
+        free(shard->buckets);
+        tsk_deinit_lock(&(shard->lock));
+    }
+    free(cache->shards);
+    free(cache->ra_buf);
+    tsk_deinit_lock(&(cache->ra_lock));
+    free(cache);
+    a_img_info->cache = NULL;
+}
@@ -12,9 +12,34 @@
 
 #include "tsk_img_i.h"
 
+/**
+ * \internal
+ * Call the format-specific read callback and count it if the image is
+ * collecting statistics.  The caller must hold cache_lock unless the format
+ * sets read_unlocked.
+ */
+ssize_t
+tsk_img_read_backend(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    char *a_buf, size_t a_len)
+{
+    uint64_t start;
+    ssize_t cnt;
+
+    if (a_img_info->iostats == NULL)
+        return a_img_info->read(a_img_info, a_off, a_buf, a_len);
+
+    start = tsk_img_stats_time();
+    cnt = a_img_info->read(a_img_info, a_off, a_buf, a_len);
+    tsk_img_stats_note_backend(a_img_info, a_off, a_len, cnt,
+        tsk_img_stats_time() - start);
+    return cnt;
+}
+
 // This function assumes that we hold the cache_lock even though we're not modyfying
-// the cache.  This is because the lower-level read callbacks make the same assumption.
-static ssize_t tsk_img_read_no_cache(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+// the cache.  This is because the lower-level read callbacks make the same assumption
+// (unless read_unlocked is set).
+ssize_t
+tsk_img_read_no_cache(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
     char *a_buf, size_t a_len)
 {
     ssize_t nbytes;
@@ -29,7 +54,7 @@ static ssize_t tsk_img_read_no_cache(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
         if ((buf2 = (char *) tsk_malloc(len_tmp)) == NULL) {
             return -1;
         }
-        nbytes = a_img_info->read(a_img_info, a_off, buf2, len_tmp);
+        nbytes = tsk_img_read_backend(a_img_info, a_off, buf2, len_tmp);
         if ((nbytes > 0) && (nbytes < (ssize_t) a_len)) {
             memcpy(a_buf, buf2, nbytes);
         }
@@ -40,11 +65,31 @@ static ssize_t tsk_img_read_no_cache(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
         free(buf2);
     }
     else {
-        nbytes = a_img_info->read(a_img_info, a_off, a_buf, a_len);
+        nbytes = tsk_img_read_backend(a_img_info, a_off, a_buf, a_len);
     }
     return nbytes;
 }
 
+/**
+ * \internal
+ * Read data without the cache.  Takes cache_lock while the format-specific
+ * read callback runs, unless the format does not need it.
+ */
+ssize_t
+tsk_img_read_direct(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    char *a_buf, size_t a_len)
+{
+    ssize_t cnt;
+
+    if (a_img_info->read_unlocked)
+        return tsk_img_read_no_cache(a_img_info, a_off, a_buf, a_len);
+
+    tsk_take_lock(&(a_img_info->cache_lock));
+    cnt = tsk_img_read_no_cache(a_img_info, a_off, a_buf, a_len);
+    tsk_release_lock(&(a_img_info->cache_lock));
+    return cnt;
+}
+
 /**
  * \ingroup imglib
  * Reads data from an open disk image
@@ -58,12 +103,6 @@ ssize_t
 tsk_img_read(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
     char *a_buf, size_t a_len)
 {
-#define CACHE_AGE   1000
-    ssize_t read_count = 0;
-    int cache_index = 0;
-    int cache_next = 0;         // index to lowest age cache (to use next)
-    size_t len2 = 0;
-
     if (a_img_info == NULL) {
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_IMG_ARG);
@@ -98,151 +137,233 @@ tsk_img_read(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
         return -1;
     }
 
-    /* cache_lock is used for both the cache in IMG_INFO and 
-     * the shared variables in the img type specific INFO structs.
-     * grab it now so that it is held before any reads.
-     */
-    tsk_take_lock(&(a_img_info->cache_lock));
+    if (a_img_info->iostats != NULL)
+        tsk_img_stats_note_read(a_img_info, a_off, a_len);
+
+    // mapped images are copied from the mapping without any lock
+    if (a_img_info->read_ptr != NULL) {
+        const char *ptr = a_img_info->read_ptr(a_img_info, a_off, a_len);
+        if (ptr != NULL) {
+            memcpy(a_buf, ptr, a_len);
+            return (ssize_t) a_len;
+        }
+    }
+
+    // let the prefetch worker know where we are
+    if (a_img_info->prefetch != NULL)
+        tsk_img_prefetch_note_read(a_img_info, a_off, a_len);
 
-    // if they ask for more than the cache length, skip the cache
-    if ((a_len + (a_off % 512)) > TSK_IMG_INFO_CACHE_LEN) {
-        read_count = tsk_img_read_no_cache(a_img_info, a_off, a_buf, a_len);
-        tsk_release_lock(&(a_img_info->cache_lock));
-        return read_count;
+    // the cache has its own locks and only takes cache_lock on a miss
+    if (a_img_info->cache != NULL) {
+        return tsk_img_cache_read(a_img_info, a_off, a_buf, a_len);
     }
 
-    // TODO: why not just return 0 here (and be POSIX compliant)?
-    // and why not check earlier for this condition?
+    // same checks that the cache does on its reads
     if (a_off >= a_img_info->size) {
-        tsk_release_lock(&(a_img_info->cache_lock));
         tsk_error_reset();
         tsk_error_set_errno(TSK_ERR_IMG_READ_OFF);
         tsk_error_set_errstr("tsk_img_read - %" PRIuOFF, a_off);
         return -1;
     }
+    if (((TSK_OFF_T) a_len > a_img_info->size)
+        || (a_off >= (a_img_info->size - (TSK_OFF_T) a_len))) {
+        a_len = (size_t) (a_img_info->size - a_off);
+    }
 
-    /* See if the requested length is going to be too long.
-     * we'll use this length when checking the cache. */
-    len2 = a_len;
+    return tsk_img_read_direct(a_img_info, a_off, a_buf, a_len);
+}
 
-    // Protect against INT64_MAX + INT64_MAX > value
-    if (((TSK_OFF_T) len2 > a_img_info->size)
-        || (a_off >= (a_img_info->size - (TSK_OFF_T)len2))) {
-        len2 = (size_t) (a_img_info->size - a_off);
-    }
+/**
+ * \ingroup imglib
+ * Returns a read-only pointer to data in an open disk image so that it can
+ * be used without copying it.  This works only for raw images that were
+ * opened with the mmap option and for data that is in a single image file.
+ * The pointer is valid until the image is closed.
+ * @param a_img_info Disk image to read from
+ * @param a_off Byte offset to start reading from
+ * @param a_len Number of bytes that will be read
+ * @returns pointer to the data or NULL if it can not be accessed in place
+ * (use tsk_img_read() in that case, which will also report any error)
+ */
+const char *
+tsk_img_read_ptr(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off, size_t a_len)
+{
+    if ((a_img_info == NULL) || (a_img_info->read_ptr == NULL)
+        || (a_off < 0) || ((TSK_OFF_T) a_len < 0)
+        || (a_off + (TSK_OFF_T) a_len > a_img_info->size))
+        return NULL;
 
-    // check if it is in the cache
-    for (cache_index = 0;
-        cache_index < TSK_IMG_INFO_CACHE_NUM; cache_index++) {
+    return a_img_info->read_ptr(a_img_info, a_off, a_len);
+}
 
-        // Look into the in-use cache entries
-        if (a_img_info->cache_len[cache_index] > 0) {
 
-            // the read_count check makes sure we don't go back in after data was read
-            if ((read_count == 0)
-                && (a_img_info->cache_off[cache_index] <= a_off)
-                && (a_img_info->cache_off[cache_index] +
-                    a_img_info->cache_len[cache_index] >= a_off + len2)) {
+/* Ranges of a vectored read that are less than this many bytes apart are
+ * read with one call, since reading the gap costs less than a seek */
+#define TSK_IMG_READV_GAP_MAX   (32 * 1024)
 
-                /*
-                   if (tsk_verbose)
-                   fprintf(stderr,
-                   "tsk_img_read: Read found in cache %d\n",  cache_index );
-                 */
+/* Largest span of the image that is read with one call for a vectored read */
+#define TSK_IMG_READV_SPAN_MAX  TSK_IMG_INFO_READAHEAD_MAX
 
-                // We found it...
-                memcpy(a_buf,
-                    &a_img_info->cache[cache_index][a_off -
-                        a_img_info->cache_off[cache_index]], len2);
-                read_count = (ssize_t) len2;
+/* Entry of a vectored read in offset order */
+typedef struct {
+    TSK_OFF_T off;
+    size_t idx;                 ///< Index of the range in the caller's array
+} TSK_IMG_READV_ORDER;
 
-                // reset its "age" since it was useful
-                a_img_info->cache_age[cache_index] = CACHE_AGE;
+static int
+readv_order_cmp(const void *a_a, const void *a_b)
+{
+    const TSK_IMG_READV_ORDER *a = (const TSK_IMG_READV_ORDER *) a_a;
+    const TSK_IMG_READV_ORDER *b = (const TSK_IMG_READV_ORDER *) a_b;
 
-                // we don't break out of the loop so that we update all ages
-            }
-            else {
-                /* decrease its "age" since it was not useful.
-                 * We don't let used ones go below 1 so that they are not
-                 * confused with entries that have never been used. */
-                a_img_info->cache_age[cache_index]--;
-
-                // see if this is the most eligible replacement
-                if ((a_img_info->cache_len[cache_next] > 0)
-                    && (a_img_info->cache_age[cache_index] <
-                        a_img_info->cache_age[cache_next]))
-                    cache_next = cache_index;
-            }
-        }
-        else {
-            cache_next = cache_index;
+    if (a->off < b->off)
+        return -1;
+    if (a->off > b->off)
+        return 1;
+    return (a->idx < b->idx) ? -1 : (a->idx > b->idx);
+}
+
+/**
+ * \ingroup imglib
+ * Reads several ranges of an open disk image with as few reads as possible.
+ * The ranges are sorted by offset and ranges that overlap or are close
+ * together are read with a single call into a temporary buffer and copied
+ * out, so that a fragmented file can be read in one pass over the image.
+ * If such a combined read fails, its ranges are read again one at a time
+ * so that only the ranges that cannot be read fail.
+ * The cnt value of each range is set to the number of bytes read into it.
+ *
+ * @param a_img_info Disk image to read from
+ * @param a_vecs Ranges to read (the order does not matter)
+ * @param a_num_vecs Number of entries in a_vecs
+ * @returns -1 on error (the cnt of the ranges that failed is -1) or the
+ * total number of bytes read
+ */
+ssize_t
+tsk_img_readv(TSK_IMG_INFO * a_img_info, TSK_IMG_IOVEC * a_vecs,
+    size_t a_num_vecs)
+{
+    TSK_IMG_READV_ORDER *order;
+    char *span_buf = NULL;
+    size_t span_buf_len = 0;
+    size_t total = 0;
+    size_t i, j;
+    uint8_t failed = 0;
+
+    if ((a_img_info == NULL) || ((a_vecs == NULL) && (a_num_vecs > 0))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("tsk_img_readv: NULL argument");
+        return -1;
+    }
+
+    for (i = 0; i < a_num_vecs; i++) {
+        if ((a_vecs[i].buf == NULL) || (a_vecs[i].off < 0)
+            || ((TSK_OFF_T) a_vecs[i].len < 0)) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_ARG);
+            tsk_error_set_errstr("tsk_img_readv: range %" PRIuSIZE
+                ": offset %" PRIuOFF " length %" PRIuSIZE, i,
+                a_vecs[i].off, a_vecs[i].len);
+            return -1;
         }
+        a_vecs[i].cnt = 0;
     }
 
-    // if we didn't find it, then load it into the cache_next entry
-    if (read_count == 0) {
-        size_t read_size = 0;
+    if (a_num_vecs == 1) {
+        a_vecs[0].cnt = tsk_img_read(a_img_info, a_vecs[0].off,
+            a_vecs[0].buf, a_vecs[0].len);
+        return a_vecs[0].cnt;
+    }
 
-        // round the offset down to a sector boundary
-        a_img_info->cache_off[cache_next] = (a_off / 512) * 512;
+    if ((order =
+            (TSK_IMG_READV_ORDER *) tsk_malloc(a_num_vecs *
+                sizeof(TSK_IMG_READV_ORDER))) == NULL)
+        return -1;
+    for (i = 0; i < a_num_vecs; i++) {
+        order[i].off = a_vecs[i].off;
+        order[i].idx = i;
+    }
+    qsort(order, a_num_vecs, sizeof(TSK_IMG_READV_ORDER), readv_order_cmp);
 
-        /*
-           if (tsk_verbose)
-           fprintf(stderr,
-           "tsk_img_read: Loading data into cache %d (%" PRIuOFF
-           ")\n", cache_next, a_img_info->cache_off[cache_next]);
-         */
+    for (i = 0; i < a_num_vecs; i = j) {
+        TSK_IMG_IOVEC *vec = &a_vecs[order[i].idx];
+        TSK_OFF_T start = vec->off;
+        TSK_OFF_T end = vec->off + (TSK_OFF_T) vec->len;
+        ssize_t cnt;
 
-        // Read a full cache block or the remaining data.
-        read_size = TSK_IMG_INFO_CACHE_LEN;
+        if (vec->len == 0) {
+            j = i + 1;
+            continue;
+        }
 
-        if ((a_img_info->cache_off[cache_next] + (TSK_OFF_T)read_size) >
-            a_img_info->size) {
-            read_size =
-                (size_t) (a_img_info->size -
-                a_img_info->cache_off[cache_next]);
+        // find the ranges that will be read along with this one
+        for (j = i + 1; (vec->len <= TSK_IMG_READV_SPAN_MAX)
+            && (j < a_num_vecs); j++) {
+            TSK_IMG_IOVEC *next = &a_vecs[order[j].idx];
+            TSK_OFF_T next_end = next->off + (TSK_OFF_T) next->len;
+
+            if (next->off > end + TSK_IMG_READV_GAP_MAX)
+                break;
+            if ((next_end > end)
+                && (next_end - start > TSK_IMG_READV_SPAN_MAX))
+                break;
+            if (next_end > end)
+                end = next_end;
         }
 
-        read_count = a_img_info->read(a_img_info,
-            a_img_info->cache_off[cache_next],
-            a_img_info->cache[cache_next], read_size);
-
-        // if no error, then set the variables and copy the data
-        // Although a read_count of -1 indicates an error,
-        // since read_count is used in the calculation it may not be negative.
-        // Also it does not make sense to copy data when the read_count is 0.
-        if (read_count > 0) {
-            TSK_OFF_T rel_off = 0;
-            a_img_info->cache_age[cache_next] = CACHE_AGE;
-            a_img_info->cache_len[cache_next] = read_count;
-
-            // Determine the offset relative to the start of the cached data.
-            rel_off = a_off - a_img_info->cache_off[cache_next];
-
-            // Make sure we were able to read sufficient data into the cache.
-            if (rel_off > (TSK_OFF_T) read_count) {
-                len2 = 0;
-            }
-            // Make sure not to copy more than is available in the cache.
-            else if ((rel_off + (TSK_OFF_T) len2) > (TSK_OFF_T) read_count) {
-                len2 = (size_t) (read_count - rel_off);
-            }
-            // Only copy data when we have something to copy.
-            if (len2 > 0) {
-                memcpy(a_buf, &(a_img_info->cache[cache_next][rel_off]), len2);
+        // a range on its own is read straight into its buffer
+        if (j == i + 1) {
+            if ((vec->cnt = tsk_img_read(a_img_info, vec->off, vec->buf,
+                        vec->len)) < 0)
+                failed = 1;
+            else
+                total += (size_t) vec->cnt;
+            continue;
+        }
+
+        if ((size_t) (end - start) > span_buf_len) {
+            free(span_buf);
+            span_buf_len = (size_t) (end - start);
+            if ((span_buf = (char *) tsk_malloc(span_buf_len)) == NULL) {
+                free(order);
+                return -1;
             }
-            read_count = (ssize_t) len2;
         }
-        else {
-            a_img_info->cache_len[cache_next] = 0;
-            a_img_info->cache_age[cache_next] = 0;
-            a_img_info->cache_off[cache_next] = 0;
 
-            // Something went wrong so let's try skipping the cache
-            read_count = tsk_img_read_no_cache(a_img_info, a_off, a_buf, a_len);
+        cnt = tsk_img_read(a_img_info, start, span_buf,
+            (size_t) (end - start));
+        // a bad sector in a gap or in one range should not fail the others
+        if (cnt < 0)
+            tsk_error_reset();
+        for (; i < j; i++) {
+            size_t rel_off;
+
+            vec = &a_vecs[order[i].idx];
+            if (cnt < 0) {
+                if ((vec->cnt = tsk_img_read(a_img_info, vec->off,
+                            vec->buf, vec->len)) < 0)
+                    failed = 1;
+                else
+                    total += (size_t) vec->cnt;
+                continue;
+            }
+
+            rel_off = (size_t) (vec->off - start);
+            if (rel_off >= (size_t) cnt)
+                vec->cnt = 0;
+            else if (rel_off + vec->len > (size_t) cnt)
+                vec->cnt = (ssize_t) ((size_t) cnt - rel_off);
+            else
+                vec->cnt = (ssize_t) vec->len;
+
+            if (vec->cnt > 0)
+                memcpy(vec->buf, &span_buf[rel_off], vec->cnt);
+            total += (size_t) vec->cnt;
         }
     }
 
-    tsk_release_lock(&(a_img_info->cache_lock));
-    return read_count;
+    free(span_buf);
+    free(order);
+    return failed ? -1 : (ssize_t) total;
 }
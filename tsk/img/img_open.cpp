@@ -56,6 +56,112 @@ tsk_img_open_sing(const TSK_TCHAR * a_image, TSK_IMG_TYPE_ENUM type,
 }
 
 
+/**
+ * \ingroup imglib
+ * Sets the fields of a TSK_IMG_OPTIONS structure to their default values.
+ * Call this before changing individual options and passing the structure
+ * to tsk_img_open_ex().
+ *
+ * @param a_opts Options structure to initialize
+ */
+void
+tsk_img_options_init(TSK_IMG_OPTIONS * a_opts)
+{
+    memset(a_opts, 0, sizeof(TSK_IMG_OPTIONS));
+    a_opts->cache_num = TSK_IMG_INFO_CACHE_NUM;
+    a_opts->cache_len = TSK_IMG_INFO_CACHE_LEN;
+    a_opts->readahead_max = TSK_IMG_INFO_READAHEAD_MAX;
+}
+
+/* Parse an unsigned size with an optional K, M, or G suffix.
+ * @returns 1 on error */
+static uint8_t
+parse_cache_size(const TSK_TCHAR * a_str, TSK_TCHAR ** a_end,
+    uint64_t * a_val)
+{
+    TSK_TCHAR *cp;
+    uint64_t val;
+
+    if ((*a_str < _TSK_T('0')) || (*a_str > _TSK_T('9')))
+        return 1;
+
+    val = TSTRTOULL(a_str, &cp, 10);
+    switch (*cp) {
+    case _TSK_T('k'):
+    case _TSK_T('K'):
+        val <<= 10;
+        cp++;
+        break;
+    case _TSK_T('m'):
+    case _TSK_T('M'):
+        val <<= 20;
+        cp++;
+        break;
+    case _TSK_T('g'):
+    case _TSK_T('G'):
+        val <<= 30;
+        cp++;
+        break;
+    }
+    *a_end = cp;
+    *a_val = val;
+    return 0;
+}
+
+/**
+ * \ingroup imglib
+ * Parses the cache geometry argument used by the command line tools
+ * and stores it in an options structure.  The format is
+ * "lines[:line_size]", where line_size can have a K, M, or G suffix.
+ * A value of 0 lines disables the cache.
+ *
+ * @param a_str String to parse
+ * @param a_opts Options structure to update
+ * @returns 1 on error (tsk_error is set) and 0 on success
+ */
+uint8_t
+tsk_img_parse_cache_opt(const TSK_TCHAR * a_str, TSK_IMG_OPTIONS * a_opts)
+{
+    TSK_TCHAR *cp;
+    uint64_t num, len;
+
+    len = a_opts->cache_len;
+    if (parse_cache_size(a_str, &cp, &num))
+        goto bad_arg;
+    if (*cp == _TSK_T(':')) {
+        if (parse_cache_size(cp + 1, &cp, &len))
+            goto bad_arg;
+    }
+    if (*cp != _TSK_T('\0'))
+        goto bad_arg;
+
+    if ((num > 1048576) || (len == 0) || (len > (1 << 30))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("cache geometry out of range: %" PRIu64
+            " lines of %" PRIu64 " bytes", num, len);
+        return 1;
+    }
+    if ((len % 512) != 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("cache line size is not a multiple of 512 (%"
+            PRIu64 ")", len);
+        return 1;
+    }
+
+    a_opts->cache_num = (unsigned int) num;
+    a_opts->cache_len = (size_t) len;
+    return 0;
+
+  bad_arg:
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_IMG_ARG);
+    tsk_error_set_errstr("invalid cache argument (expected lines[:line_size])");
+    return 1;
+}
+
+
 /**
  * \ingroup imglib
  * Opens one or more disk image files so that they can be read.  If a file format
@@ -78,8 +184,33 @@ TSK_IMG_INFO *
 tsk_img_open(int num_img,
     const TSK_TCHAR * const images[], TSK_IMG_TYPE_ENUM type,
     unsigned int a_ssize)
+{
+    return tsk_img_open_ex(num_img, images, type, a_ssize, NULL);
+}
+
+
+/**
+ * \ingroup imglib
+ * Opens one or more disk image files so that they can be read.  This is the
+ * same as tsk_img_open(), but it allows the read cache geometry and other
+ * options to be specified.
+ *
+ * @param num_img The number of images to open (will be > 1 for split images).
+ * @param images The path to the image files (the number of files must
+ * be equal to num_img and they must be in a sorted order)
+ * @param type The disk image type (can be autodetection)
+ * @param a_ssize Size of device sector in bytes (or 0 for default)
+ * @param a_opts Options to use (or NULL for the defaults)
+ *
+ * @return Pointer to TSK_IMG_INFO or NULL on error
+ */
+TSK_IMG_INFO *
+tsk_img_open_ex(int num_img,
+    const TSK_TCHAR * const images[], TSK_IMG_TYPE_ENUM type,
+    unsigned int a_ssize, const TSK_IMG_OPTIONS * a_opts)
 {
     TSK_IMG_INFO *img_info = NULL;
+    TSK_IMG_OPTIONS def_opts, map_opts;
 
     // Get rid of any old error messages laying around
     tsk_error_reset();
@@ -107,6 +238,20 @@ tsk_img_open(int num_img,
         return NULL;
     }
 
+    if (a_opts == NULL) {
+        tsk_img_options_init(&def_opts);
+        a_opts = &def_opts;
+    }
+
+    if ((a_opts->cache_num > 0) && ((a_opts->cache_len == 0)
+            || ((a_opts->cache_len % 512) != 0))) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("cache line size is not a multiple of 512 (%"
+            PRIuSIZE ")", a_opts->cache_len);
+        return NULL;
+    }
+
     if (tsk_verbose)
         TFPRINTF(stderr,
             _TSK_T("tsk_img_open: Type: %d   NumImg: %d  Img1: %s\n"),
@@ -152,7 +297,7 @@ tsk_img_open(int num_img,
 #endif
 
 #if HAVE_LIBEWF
-        if ((img_info = ewf_open(num_img, images, a_ssize)) != NULL) {
+        if ((img_info = ewf_open(num_img, images, a_ssize, a_opts)) != NULL) {
             if (set == NULL) {
                 set = "EWF";
                 img_set = img_info;
@@ -172,7 +317,7 @@ tsk_img_open(int num_img,
 #endif
 
 #if HAVE_LIBVMDK
-        if ((img_info = vmdk_open(num_img, images, a_ssize)) != NULL) {
+        if ((img_info = vmdk_open(num_img, images, a_ssize, a_opts)) != NULL) {
             if (set == NULL) {
                 set = "VMDK";
                 img_set = img_info;
@@ -218,7 +363,7 @@ tsk_img_open(int num_img,
         }
 
         // otherwise, try raw
-        if ((img_info = raw_open(num_img, images, a_ssize)) != NULL) {
+        if ((img_info = raw_open(num_img, images, a_ssize, a_opts)) != NULL) {
             break;
         }
         else if (tsk_error_get_errno() != 0) {
@@ -231,7 +376,7 @@ tsk_img_open(int num_img,
     }
 
     case TSK_IMG_TYPE_RAW:
-        img_info = raw_open(num_img, images, a_ssize);
+        img_info = raw_open(num_img, images, a_ssize, a_opts);
         break;
 
 #if HAVE_LIBAFFLIB
@@ -245,7 +390,7 @@ tsk_img_open(int num_img,
 
 #if HAVE_LIBEWF
     case TSK_IMG_TYPE_EWF_EWF:
-        img_info = ewf_open(num_img, images, a_ssize);
+        img_info = ewf_open(num_img, images, a_ssize, a_opts);
         break;
 #endif
 
@@ -256,8 +401,49 @@ tsk_img_open(int num_img,
         return NULL;
     }
 
-    /* we have a good img_info, set up the cache lock */
+    /* A mapped image does not use the read cache, because copying from
+     * the mapping is as cheap as copying from the cache.  The image is
+     * still usable with normal reads if it can not be mapped. */
+    if ((a_opts->mmap) && (img_info->itype == TSK_IMG_TYPE_RAW)) {
+        if (raw_map(img_info)) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_img_open: image not memory-mapped: %s\n",
+                    tsk_error_get());
+            tsk_error_reset();
+        }
+        else {
+            map_opts = *a_opts;
+            map_opts.cache_num = 0;
+            a_opts = &map_opts;
+        }
+    }
+
+    /* we have a good img_info, set up the cache lock and the cache */
     tsk_init_lock(&(img_info->cache_lock));
+
+    /* Counting starts here rather than after the open returns, so that no
+     * read, including those of the prefetch worker, is missed. */
+    if ((a_opts->stats) && (tsk_img_stats_start(img_info, NULL))) {
+        tsk_img_close(img_info);
+        return NULL;
+    }
+
+    if (tsk_img_cache_init(img_info, a_opts)) {
+        tsk_img_close(img_info);
+        return NULL;
+    }
+
+    /* The prefetch worker only acts on hints, so the image is still
+     * usable without it. */
+    img_info->prefetch = NULL;
+    if ((a_opts->prefetch) && (tsk_img_prefetch_init(img_info))) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "tsk_img_open: prefetch worker not started: %s\n",
+                tsk_error_get());
+        tsk_error_reset();
+    }
     return img_info;
 }
 
@@ -396,6 +582,7 @@ tsk_img_open_external(
 )
 {
     TSK_IMG_INFO *img_info;
+    TSK_IMG_OPTIONS def_opts;
     // sanity checks
     if (!ext_img_info) {
         tsk_error_reset();
@@ -451,8 +638,18 @@ tsk_img_open_external(
     img_info->read = read;
     img_info->close = close;
     img_info->imgstat = imgstat;
+    img_info->read_ptr = NULL;
+    img_info->read_unlocked = 0;
+    img_info->chunk_size = 0;
 
+    tsk_img_options_init(&def_opts);
     tsk_init_lock(&(img_info->cache_lock));
+    if (tsk_img_cache_init(img_info, &def_opts)) {
+        tsk_deinit_lock(&(img_info->cache_lock));
+        return NULL;
+    }
+    img_info->prefetch = NULL;
+    img_info->iostats = NULL;
     return img_info;
 }
 
@@ -552,6 +749,10 @@ tsk_img_close(TSK_IMG_INFO * a_img_info)
     if (a_img_info == NULL) {
         return;
     }
+    // the prefetch worker uses the cache, so stop it first
+    tsk_img_prefetch_free(a_img_info);
+    tsk_img_cache_free(a_img_info);
+    tsk_img_stats_free(a_img_info);
     tsk_deinit_lock(&(a_img_info->cache_lock));
     a_img_info->close(a_img_info);
 }
@@ -0,0 +1,491 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file img_prefetch.c
+ * Contains the optional background worker that loads ranges of an image
+ * into the read cache before they are read.
+ *
+ * Callers that know which data they are about to read (such as the runs
+ * of a non-resident attribute) pass the ranges to tsk_img_prefetch().  The
+ * worker thread loads them into the cache in order while the caller is busy
+ * with the data it already has, so that a slow read callback (for example
+ * one that decompresses EWF chunks) overlaps with the caller's processing.
+ *
+ * The worker does not run more than a quarter of the cache ahead of the
+ * callers, otherwise it would evict the data before it is used.  The rest of
+ * the cache is left for the callers' own read-ahead and metadata.  The
+ * worker follows the callers through calls to tsk_img_read() and waits when
+ * it is far enough ahead.
+ *
+ * Each call to tsk_img_prefetch() starts its own stream of ranges, so that
+ * threads that walk different files at the same time do not replace each
+ * other's hints, and tsk_img_prefetch_cancel() only drops the stream of the
+ * caller.  The worker takes turns between the streams.  Reads that are not
+ * inside any stream are common (metadata, other files), so they are filtered
+ * out without the lock.
+ */
+
+#include "tsk_img_i.h"
+
+/* Number of ranges after the caller's current one that a read is matched
+ * against when following the caller */
+#define TSK_IMG_PREFETCH_SCAN   32
+
+/* Number of streams that are kept.  If more are started, the oldest one is
+ * dropped. */
+#define TSK_IMG_PREFETCH_STREAMS    8
+
+/** \internal
+ * A hinted range and where it starts in the concatenation of all ranges.
+ */
+typedef struct {
+    TSK_OFF_T off;              ///< Byte offset of the range in the image
+    size_t len;                 ///< Length of the range in bytes
+    uint64_t pos;               ///< Sum of the lengths of the ranges before this one
+} TSK_IMG_PREFETCH_RANGE;
+
+/** \internal
+ * The ranges that were given in one call to tsk_img_prefetch().
+ */
+typedef struct {
+    uint64_t id;                ///< Value returned by tsk_img_prefetch() (0 if not used)
+    TSK_IMG_PREFETCH_RANGE *ranges;
+    size_t num_ranges;
+    size_t max_ranges;          ///< Allocated size of ranges
+
+    size_t load_idx;            ///< Range the worker is loading
+    TSK_OFF_T load_off;         ///< Next byte offset the worker will load
+    size_t read_idx;            ///< Range the caller last read from
+    uint64_t read_pos;          ///< How far the caller has read, as a position in all ranges
+} TSK_IMG_PREFETCH_STREAM;
+
+struct TSK_IMG_PREFETCH {
+    tsk_lock_t lock;            ///< Protects the fields below, except where noted
+    tsk_cond_t cond;            ///< Signaled when there is new work for the worker
+    tsk_thread_t thread;
+    void (*close) (TSK_IMG_INFO *);     ///< Close function of the image format
+
+    TSK_IMG_PREFETCH_STREAM streams[TSK_IMG_PREFETCH_STREAMS];
+    size_t num_streams;         ///< Number of streams that are used
+    size_t next_stream;         ///< Stream the worker looks at first
+    uint64_t next_id;           ///< ID of the next stream
+
+    /* Lowest start and highest end of the ranges of all streams (both 0
+     * if there are none).  They are written with the lock held and read
+     * without it by tsk_img_prefetch_note_read(). */
+    uint64_t span_start;
+    uint64_t span_end;
+
+    uint64_t ahead;             ///< How far ahead of the callers the worker can go
+    size_t step;                ///< Most data to load at a time
+    uint8_t stop;
+};
+
+
+/* Update the span of all streams.  Caller must hold the lock. */
+static void
+prefetch_set_span(TSK_IMG_PREFETCH * pf)
+{
+    uint64_t start = 0, end = 0;
+    size_t i, j;
+
+    for (i = 0; i < TSK_IMG_PREFETCH_STREAMS; i++) {
+        TSK_IMG_PREFETCH_STREAM *stream = &pf->streams[i];
+
+        if (stream->id == 0)
+            continue;
+        for (j = 0; j < stream->num_ranges; j++) {
+            uint64_t r_start = (uint64_t) stream->ranges[j].off;
+            uint64_t r_end = r_start + stream->ranges[j].len;
+
+            if ((end == 0) || (r_start < start))
+                start = r_start;
+            if (r_end > end)
+                end = r_end;
+        }
+    }
+
+    // a reader may see a mix of the old and new values, which only
+    // costs a missed or extra check because the ranges are only hints
+    tsk_atomic_store_u64(&pf->span_start, start);
+    tsk_atomic_store_u64(&pf->span_end, end);
+}
+
+
+/* Find the next piece for the worker to load.  Caller must hold the lock.
+ * @returns 1 if a piece was found and 0 if there is nothing to do now */
+static uint8_t
+prefetch_next_piece(TSK_IMG_PREFETCH * pf, TSK_OFF_T * a_off,
+    size_t * a_len)
+{
+    uint64_t ahead;
+    size_t n;
+
+    if (pf->num_streams == 0)
+        return 0;
+
+    // the streams share the part of the cache that the worker can use
+    ahead = pf->ahead / pf->num_streams;
+    if (ahead == 0)
+        ahead = 1;
+
+    for (n = 0; n < TSK_IMG_PREFETCH_STREAMS; n++) {
+        size_t i = (pf->next_stream + n) % TSK_IMG_PREFETCH_STREAMS;
+        TSK_IMG_PREFETCH_STREAM *stream = &pf->streams[i];
+        TSK_IMG_PREFETCH_RANGE *range;
+        uint64_t load_pos;
+        size_t len;
+
+        if (stream->id == 0)
+            continue;
+
+        // skip the ranges that are done
+        while ((stream->load_idx < stream->num_ranges)
+            && (stream->load_off >=
+                stream->ranges[stream->load_idx].off +
+                (TSK_OFF_T) stream->ranges[stream->load_idx].len)) {
+            if (++stream->load_idx < stream->num_ranges)
+                stream->load_off = stream->ranges[stream->load_idx].off;
+        }
+        if (stream->load_idx >= stream->num_ranges)
+            continue;
+
+        // wait for the caller to catch up
+        range = &stream->ranges[stream->load_idx];
+        load_pos = range->pos + (uint64_t) (stream->load_off - range->off);
+        if (load_pos >= stream->read_pos + ahead)
+            continue;
+
+        len = pf->step;
+        if (len > stream->read_pos + ahead - load_pos)
+            len = (size_t) (stream->read_pos + ahead - load_pos);
+        if (stream->load_off + (TSK_OFF_T) len >
+            range->off + (TSK_OFF_T) range->len)
+            len = (size_t) (range->off + (TSK_OFF_T) range->len -
+                stream->load_off);
+
+        *a_off = stream->load_off;
+        *a_len = len;
+        stream->load_off += len;
+
+        // take turns between the streams
+        pf->next_stream = (i + 1) % TSK_IMG_PREFETCH_STREAMS;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* The main loop of the worker thread */
+static void
+prefetch_worker(void *a_ptr)
+{
+    TSK_IMG_INFO *img_info = (TSK_IMG_INFO *) a_ptr;
+    TSK_IMG_PREFETCH *pf = img_info->prefetch;
+
+    tsk_take_lock(&(pf->lock));
+    while (pf->stop == 0) {
+        TSK_OFF_T off;
+        size_t len;
+
+        if (prefetch_next_piece(pf, &off, &len) == 0) {
+            tsk_cond_wait(&(pf->cond), &(pf->lock));
+            continue;
+        }
+
+        tsk_release_lock(&(pf->lock));
+        tsk_img_cache_fill(img_info, off, len);
+        tsk_take_lock(&(pf->lock));
+    }
+    tsk_release_lock(&(pf->lock));
+}
+
+
+/* Close function that is used for images with a prefetch worker.  The
+ * worker must be stopped before the format's close function frees the
+ * state that the read callback uses. */
+static void
+prefetch_close(TSK_IMG_INFO * a_img_info)
+{
+    void (*close) (TSK_IMG_INFO *) = a_img_info->prefetch->close;
+
+    tsk_img_prefetch_free(a_img_info);
+    close(a_img_info);
+}
+
+
+/**
+ * \internal
+ * Start the prefetch worker for an image.  The image must have a cache.
+ *
+ * @param a_img_info Disk image to start the worker for
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_img_prefetch_init(TSK_IMG_INFO * a_img_info)
+{
+    TSK_IMG_PREFETCH *pf;
+
+    a_img_info->prefetch = NULL;
+    if (a_img_info->cache == NULL)
+        return 0;
+
+    if ((pf =
+            (TSK_IMG_PREFETCH *) tsk_malloc(sizeof(TSK_IMG_PREFETCH))) ==
+        NULL)
+        return 1;
+
+    pf->ahead = tsk_img_cache_size(a_img_info) / 4;
+    pf->step = (size_t) (pf->ahead / 4);
+    if (pf->step == 0)
+        pf->step = 1;
+    tsk_init_lock(&(pf->lock));
+    tsk_init_cond(&(pf->cond));
+
+    a_img_info->prefetch = pf;
+    if (tsk_thread_create(&(pf->thread), prefetch_worker, a_img_info)) {
+        a_img_info->prefetch = NULL;
+        tsk_deinit_cond(&(pf->cond));
+        tsk_deinit_lock(&(pf->lock));
+        free(pf);
+        return 1;
+    }
+
+    pf->close = a_img_info->close;
+    a_img_info->close = prefetch_close;
+    return 0;
+}
+
+
+/**
+ * \internal
+ * Stop the prefetch worker of an image (if it has one) and free it.
+ *
+ * @param a_img_info Disk image to stop the worker for
+ */
+void
+tsk_img_prefetch_free(TSK_IMG_INFO * a_img_info)
+{
+    TSK_IMG_PREFETCH *pf = a_img_info->prefetch;
+    size_t i;
+
+    if (pf == NULL)
+        return;
+
+    tsk_take_lock(&(pf->lock));
+    pf->stop = 1;
+    tsk_cond_broadcast(&(pf->cond));
+    tsk_release_lock(&(pf->lock));
+    tsk_thread_join(&(pf->thread));
+
+    a_img_info->close = pf->close;
+    a_img_info->prefetch = NULL;
+    for (i = 0; i < TSK_IMG_PREFETCH_STREAMS; i++)
+        free(pf->streams[i].ranges);
+    tsk_deinit_cond(&(pf->cond));
+    tsk_deinit_lock(&(pf->lock));
+    free(pf);
+}
+
+
+/**
+ * \internal
+ * Tell the prefetch worker that a caller read data.  If the data is in
+ * one of the next hinted ranges of a stream, then the worker will keep
+ * loading that stream from that point on.  Reads outside of all of the
+ * streams return without taking the lock.
+ *
+ * @param a_img_info Disk image that was read from (must have a worker)
+ * @param a_off Byte offset that was read
+ * @param a_len Number of bytes that were read
+ */
+void
+tsk_img_prefetch_note_read(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    size_t a_len)
+{
+    TSK_IMG_PREFETCH *pf = a_img_info->prefetch;
+    size_t s, i, last;
+
+    if (((uint64_t) a_off < tsk_atomic_load_u64(&pf->span_start))
+        || ((uint64_t) a_off >= tsk_atomic_load_u64(&pf->span_end)))
+        return;
+
+    tsk_take_lock(&(pf->lock));
+    for (s = 0; s < TSK_IMG_PREFETCH_STREAMS; s++) {
+        TSK_IMG_PREFETCH_STREAM *stream = &pf->streams[s];
+
+        if (stream->id == 0)
+            continue;
+
+        last = stream->read_idx + TSK_IMG_PREFETCH_SCAN;
+        if (last > stream->num_ranges)
+            last = stream->num_ranges;
+
+        for (i = stream->read_idx; i < last; i++) {
+            TSK_IMG_PREFETCH_RANGE *range = &stream->ranges[i];
+            TSK_OFF_T end;
+
+            if ((a_off < range->off)
+                || (a_off >= range->off + (TSK_OFF_T) range->len))
+                continue;
+
+            end = a_off + (TSK_OFF_T) a_len;
+            if (end > range->off + (TSK_OFF_T) range->len)
+                end = range->off + (TSK_OFF_T) range->len;
+
+            stream->read_idx = i;
+            stream->read_pos = range->pos + (uint64_t) (end - range->off);
+
+            // there is no point loading what the caller is already reading
+            if ((stream->load_idx < i)
+                || ((stream->load_idx == i) && (stream->load_off < end))) {
+                stream->load_idx = i;
+                stream->load_off = end;
+            }
+            tsk_cond_signal(&(pf->cond));
+            tsk_release_lock(&(pf->lock));
+            return;
+        }
+    }
+    tsk_release_lock(&(pf->lock));
+}
+
+
+/**
+ * \ingroup imglib
+ * Give a list of ranges that will soon be read from an image.  If the
+ * image was opened with the prefetch option, a background thread loads them
+ * into the read cache in order while the caller processes earlier data.
+ * Otherwise this does nothing.  Each call starts a new stream of ranges
+ * that is kept until the caller cancels it with tsk_img_prefetch_cancel()
+ * or the image has more streams than the worker keeps track of, so several
+ * threads can give hints at the same time.
+ *
+ * @param a_img_info Disk image that will be read from
+ * @param a_ranges Ranges in the order they will be read
+ * @param a_num_ranges Number of entries in a_ranges
+ * @returns ID to give to tsk_img_prefetch_cancel() (0 if no stream was started)
+ */
+uint64_t
+tsk_img_prefetch(TSK_IMG_INFO * a_img_info, const TSK_IMG_RANGE * a_ranges,
+    size_t a_num_ranges)
+{
+    TSK_IMG_PREFETCH *pf;
+    TSK_IMG_PREFETCH_STREAM *stream = NULL;
+    uint64_t pos = 0;
+    uint64_t id;
+    size_t i;
+
+    if ((a_img_info == NULL) || ((pf = a_img_info->prefetch) == NULL)
+        || (a_num_ranges == 0))
+        return 0;
+
+    tsk_take_lock(&(pf->lock));
+
+    // use a free stream or replace the oldest one
+    for (i = 0; i < TSK_IMG_PREFETCH_STREAMS; i++) {
+        if (pf->streams[i].id == 0) {
+            stream = &pf->streams[i];
+            pf->num_streams++;
+            break;
+        }
+        if ((stream == NULL) || (pf->streams[i].id < stream->id))
+            stream = &pf->streams[i];
+    }
+
+    if (a_num_ranges > stream->max_ranges) {
+        TSK_IMG_PREFETCH_RANGE *ranges;
+
+        if ((ranges =
+                (TSK_IMG_PREFETCH_RANGE *) tsk_realloc(stream->ranges,
+                    a_num_ranges * sizeof(TSK_IMG_PREFETCH_RANGE))) ==
+            NULL) {
+            // they are only hints, so just drop them
+            tsk_error_reset();
+            a_num_ranges = 0;
+        }
+        else {
+            stream->ranges = ranges;
+            stream->max_ranges = a_num_ranges;
+        }
+    }
+
+    // merge ranges that follow each other, which is common for runs
+    stream->num_ranges = 0;
+    for (i = 0; i < a_num_ranges; i++) {
+        TSK_IMG_PREFETCH_RANGE *prev;
+
+        if ((a_ranges[i].len == 0) || (a_ranges[i].off < 0)
+            || (a_ranges[i].off >= a_img_info->size))
+            continue;
+
+        prev = (stream->num_ranges > 0) ?
+            &stream->ranges[stream->num_ranges - 1] : NULL;
+        if ((prev != NULL)
+            && (prev->off + (TSK_OFF_T) prev->len == a_ranges[i].off)) {
+            prev->len += a_ranges[i].len;
+        }
+        else {
+            stream->ranges[stream->num_ranges].off = a_ranges[i].off;
+            stream->ranges[stream->num_ranges].len = a_ranges[i].len;
+            stream->ranges[stream->num_ranges].pos = pos;
+            stream->num_ranges++;
+        }
+        pos += a_ranges[i].len;
+    }
+
+    if (stream->num_ranges == 0) {
+        stream->id = 0;
+        pf->num_streams--;
+        id = 0;
+    }
+    else {
+        stream->id = id = ++pf->next_id;
+        stream->load_idx = 0;
+        stream->load_off = stream->ranges[0].off;
+        stream->read_idx = 0;
+        stream->read_pos = 0;
+    }
+
+    prefetch_set_span(pf);
+    tsk_cond_signal(&(pf->cond));
+    tsk_release_lock(&(pf->lock));
+    return id;
+}
+
+
+/**
+ * \ingroup imglib
+ * Drop the ranges of a stream that was started with tsk_img_prefetch(),
+ * for example because the caller stopped reading early.  The streams of
+ * other callers are not changed.
+ *
+ * @param a_img_info Disk image that the ranges were given for
+ * @param a_id ID that tsk_img_prefetch() returned (0 does nothing)
+ */
+void
+tsk_img_prefetch_cancel(TSK_IMG_INFO * a_img_info, uint64_t a_id)
+{
+    TSK_IMG_PREFETCH *pf;
+    size_t i;
+
+    if ((a_img_info == NULL) || ((pf = a_img_info->prefetch) == NULL)
+        || (a_id == 0))
+        return;
+
+    tsk_take_lock(&(pf->lock));
+    for (i = 0; i < TSK_IMG_PREFETCH_STREAMS; i++) {
+        if (pf->streams[i].id == a_id) {
+            pf->streams[i].id = 0;
+            pf->streams[i].num_ranges = 0;
+            pf->num_streams--;
+            prefetch_set_span(pf);
+            break;
+        }
+    }
+    tsk_release_lock(&(pf->lock));
+}
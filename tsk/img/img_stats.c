@@ -0,0 +1,366 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file img_stats.c
+ * Contains the optional I/O counters and read trace of an image.
+ *
+ * Nothing is counted until tsk_img_stats_start() is called on the image or
+ * it is opened with the stats option of TSK_IMG_OPTIONS.
+ * After that, each call to tsk_img_read(), each cache line lookup and each
+ * call to the format-specific read callback (a "backend" read) is counted
+ * under a lock of its own, so collecting the statistics adds a lock to
+ * every read.
+ *
+ * The trace file starts with the 8 bytes of TSK_IMG_TRACE_MAGIC and then has
+ * a 12-byte record for each call to tsk_img_read(): the offset as a 64-bit
+ * and the length as a 32-bit little-endian integer (lengths larger than
+ * 0xffffffff are stored as 0xffffffff).  The records are in the order that
+ * the reads were made, so the file can be replayed to try other cache
+ * settings against the same workload.
+ */
+
+#include "tsk_img_i.h"
+
+#ifndef TSK_WIN32
+#include <sys/time.h>
+#endif
+
+/* Size of a record in the trace file */
+#define TSK_IMG_TRACE_REC_LEN   12
+
+struct TSK_IMG_IOSTATS {
+    tsk_lock_t lock;            ///< Protects the fields below
+    TSK_IMG_STATS stats;
+    TSK_OFF_T last_end;         ///< Offset after the last backend read
+    FILE *trace;                ///< Trace file (NULL if not used)
+};
+
+
+/**
+ * \internal
+ * @returns A time in microseconds for measuring how long a read takes
+ */
+uint64_t
+tsk_img_stats_time()
+{
+#ifdef TSK_WIN32
+    LARGE_INTEGER freq, now;
+
+    if ((QueryPerformanceFrequency(&freq) == 0) || (freq.QuadPart == 0)
+        || (QueryPerformanceCounter(&now) == 0))
+        return 0;
+    return (uint64_t) (now.QuadPart / freq.QuadPart) * 1000000 +
+        (uint64_t) (now.QuadPart % freq.QuadPart) * 1000000 /
+        freq.QuadPart;
+#else
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL))
+        return 0;
+    return (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+#endif
+}
+
+/* Histogram entry for a value (see TSK_IMG_STATS) */
+static int
+stats_hist_idx(uint64_t a_val)
+{
+    int idx = 0;
+
+    while ((a_val != 0) && (idx < TSK_IMG_STATS_HIST_NUM - 1)) {
+        a_val >>= 1;
+        idx++;
+    }
+    return idx;
+}
+
+
+/**
+ * \internal
+ * Count a call to tsk_img_read() and add it to the trace.
+ */
+void
+tsk_img_stats_note_read(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    size_t a_len)
+{
+    TSK_IMG_IOSTATS *iostats = a_img_info->iostats;
+
+    if (iostats == NULL)
+        return;
+
+    tsk_take_lock(&(iostats->lock));
+    iostats->stats.reads++;
+    iostats->stats.read_bytes += a_len;
+    iostats->stats.read_size_hist[stats_hist_idx(a_len)]++;
+
+    if (iostats->trace != NULL) {
+        uint8_t rec[TSK_IMG_TRACE_REC_LEN];
+        uint64_t off = (uint64_t) a_off;
+        uint32_t len = (uint32_t) a_len;
+        int i;
+
+        if ((uint64_t) a_len > 0xffffffffULL)
+            len = 0xffffffff;
+        for (i = 0; i < 8; i++)
+            rec[i] = (uint8_t) (off >> (8 * i));
+        for (i = 0; i < 4; i++)
+            rec[8 + i] = (uint8_t) (len >> (8 * i));
+
+        // stop tracing rather than leave a file with holes in it
+        if (fwrite(rec, TSK_IMG_TRACE_REC_LEN, 1, iostats->trace) != 1) {
+            if (tsk_verbose)
+                tsk_fprintf(stderr,
+                    "tsk_img_stats_note_read: error writing trace file\n");
+            fclose(iostats->trace);
+            iostats->trace = NULL;
+        }
+    }
+    tsk_release_lock(&(iostats->lock));
+}
+
+/**
+ * \internal
+ * Count a cache line that was found in the cache (a_hit is 1) or that had
+ * to be loaded (a_hit is 0).
+ */
+void
+tsk_img_stats_note_cache(TSK_IMG_INFO * a_img_info, uint8_t a_hit)
+{
+    TSK_IMG_IOSTATS *iostats = a_img_info->iostats;
+
+    if (iostats == NULL)
+        return;
+
+    tsk_take_lock(&(iostats->lock));
+    if (a_hit)
+        iostats->stats.cache_hits++;
+    else
+        iostats->stats.cache_misses++;
+    tsk_release_lock(&(iostats->lock));
+}
+
+/**
+ * \internal
+ * Count a call to the format-specific read callback.
+ *
+ * @param a_img_info Disk image that was read
+ * @param a_off Byte offset that was read from
+ * @param a_len Number of bytes that were asked for
+ * @param a_cnt Return value of the callback
+ * @param a_usec Time that the callback took in microseconds
+ */
+void
+tsk_img_stats_note_backend(TSK_IMG_INFO * a_img_info, TSK_OFF_T a_off,
+    size_t a_len, ssize_t a_cnt, uint64_t a_usec)
+{
+    TSK_IMG_IOSTATS *iostats = a_img_info->iostats;
+    uint64_t dist;
+
+    if (iostats == NULL)
+        return;
+
+    tsk_take_lock(&(iostats->lock));
+    if (a_off >= iostats->last_end)
+        dist = (uint64_t) (a_off - iostats->last_end);
+    else
+        dist = (uint64_t) (iostats->last_end - a_off);
+    iostats->stats.seek_dist_hist[stats_hist_idx(dist)]++;
+    iostats->last_end = a_off + (TSK_OFF_T) a_len;
+
+    iostats->stats.backend_reads++;
+    if (a_cnt > 0)
+        iostats->stats.backend_bytes += (uint64_t) a_cnt;
+    iostats->stats.backend_usec += a_usec;
+    tsk_release_lock(&(iostats->lock));
+}
+
+/**
+ * \internal
+ * Close the trace and free the counters of an image (if it has them).
+ */
+void
+tsk_img_stats_free(TSK_IMG_INFO * a_img_info)
+{
+    TSK_IMG_IOSTATS *iostats = a_img_info->iostats;
+
+    if (iostats == NULL)
+        return;
+
+    if (iostats->trace != NULL)
+        fclose(iostats->trace);
+    tsk_deinit_lock(&(iostats->lock));
+    free(iostats);
+    a_img_info->iostats = NULL;
+}
+
+
+/**
+ * \ingroup imglib
+ * Start counting the reads of an open disk image and optionally write a
+ * trace of them to a file (see img_stats.c for its format).  This should be
+ * called before the image is used by other threads.  Calling it again
+ * resets the counters and closes any earlier trace.
+ *
+ * @param a_img_info Disk image to collect statistics for
+ * @param a_trace_file Path of the trace file to create (or NULL for no trace)
+ * @returns 1 on error and 0 on success
+ */
+uint8_t
+tsk_img_stats_start(TSK_IMG_INFO * a_img_info,
+    const TSK_TCHAR * a_trace_file)
+{
+    TSK_IMG_IOSTATS *iostats;
+
+    if ((a_img_info == NULL) || (a_img_info->tag != TSK_IMG_INFO_TAG)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("tsk_img_stats_start: invalid image");
+        return 1;
+    }
+
+    if ((iostats =
+            (TSK_IMG_IOSTATS *) tsk_malloc(sizeof(TSK_IMG_IOSTATS))) ==
+        NULL)
+        return 1;
+
+    if (a_trace_file != NULL) {
+#ifdef TSK_WIN32
+        iostats->trace = _wfopen(a_trace_file, L"wb");
+#else
+        iostats->trace = fopen(a_trace_file, "wb");
+#endif
+        if (iostats->trace == NULL) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_WRITE);
+            tsk_error_set_errstr("tsk_img_stats_start: error creating %"
+                PRIttocTSK " (%s)", a_trace_file, strerror(errno));
+            free(iostats);
+            return 1;
+        }
+        if (fwrite(TSK_IMG_TRACE_MAGIC, 8, 1, iostats->trace) != 1) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_WRITE);
+            tsk_error_set_errstr("tsk_img_stats_start: error writing %"
+                PRIttocTSK, a_trace_file);
+            fclose(iostats->trace);
+            free(iostats);
+            return 1;
+        }
+    }
+    tsk_init_lock(&(iostats->lock));
+
+    tsk_img_stats_free(a_img_info);
+    a_img_info->iostats = iostats;
+    return 0;
+}
+
+/**
+ * \ingroup imglib
+ * Get the I/O counters of a disk image.
+ *
+ * @param a_img_info Disk image to get the counters of
+ * @param a_stats [out] Counters since tsk_img_stats_start() was called
+ * @returns 1 on error (such as when tsk_img_stats_start() was not called)
+ * and 0 on success
+ */
+uint8_t
+tsk_img_get_stats(TSK_IMG_INFO * a_img_info, TSK_IMG_STATS * a_stats)
+{
+    TSK_IMG_IOSTATS *iostats;
+
+    if ((a_img_info == NULL) || (a_stats == NULL)) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("tsk_img_get_stats: NULL argument");
+        return 1;
+    }
+
+    if ((iostats = a_img_info->iostats) == NULL) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr
+            ("tsk_img_get_stats: statistics are not being collected");
+        return 1;
+    }
+
+    tsk_take_lock(&(iostats->lock));
+    *a_stats = iostats->stats;
+    tsk_release_lock(&(iostats->lock));
+    return 0;
+}
+
+/* Print the entries of a histogram that are not 0 */
+static void
+stats_print_hist(FILE * hFile, const uint64_t * a_hist)
+{
+    int i;
+
+    for (i = 0; i < TSK_IMG_STATS_HIST_NUM; i++) {
+        uint64_t low, high;
+
+        if (a_hist[i] == 0)
+            continue;
+
+        low = (i == 0) ? 0 : ((uint64_t) 1 << (i - 1));
+        high = (i == 0) ? 0 : ((uint64_t) 1 << i) - 1;
+        if (i == 0)
+            tsk_fprintf(hFile, "  0: %" PRIu64 "\n", a_hist[i]);
+        else if (i == TSK_IMG_STATS_HIST_NUM - 1)
+            tsk_fprintf(hFile, "  %" PRIu64 "+: %" PRIu64 "\n", low,
+                a_hist[i]);
+        else
+            tsk_fprintf(hFile, "  %" PRIu64 "-%" PRIu64 ": %" PRIu64 "\n",
+                low, high, a_hist[i]);
+    }
+}
+
+/**
+ * \ingroup imglib
+ * Print the I/O counters of a disk image.  Nothing is printed if
+ * tsk_img_stats_start() was not called.
+ *
+ * @param a_img_info Disk image to print the counters of
+ * @param hFile Handle to print to
+ */
+void
+tsk_img_stats_print(TSK_IMG_INFO * a_img_info, FILE * hFile)
+{
+    TSK_IMG_STATS stats;
+    uint64_t lookups;
+
+    if ((a_img_info == NULL) || (a_img_info->iostats == NULL))
+        return;
+    tsk_img_get_stats(a_img_info, &stats);
+
+    tsk_fprintf(hFile, "\n--------------------------------------------\n");
+    tsk_fprintf(hFile, "I/O Statistics:\n");
+    tsk_fprintf(hFile, "Reads: %" PRIu64 " (%" PRIu64 " bytes)\n",
+        stats.reads, stats.read_bytes);
+
+    lookups = stats.cache_hits + stats.cache_misses;
+    tsk_fprintf(hFile, "Cache hits: %" PRIu64 "  misses: %" PRIu64,
+        stats.cache_hits, stats.cache_misses);
+    if (lookups > 0)
+        tsk_fprintf(hFile, " (%.1f%% hits)",
+            100.0 * (double) stats.cache_hits / (double) lookups);
+    tsk_fprintf(hFile, "\n");
+
+    tsk_fprintf(hFile,
+        "Backend reads: %" PRIu64 " (%" PRIu64 " bytes in %" PRIu64
+        ".%06" PRIu64 " seconds)\n", stats.backend_reads,
+        stats.backend_bytes, stats.backend_usec / 1000000,
+        stats.backend_usec % 1000000);
+
+    if (stats.reads > 0) {
+        tsk_fprintf(hFile, "Read sizes (bytes: reads):\n");
+        stats_print_hist(hFile, stats.read_size_hist);
+    }
+    if (stats.backend_reads > 0) {
+        tsk_fprintf(hFile, "Backend seek distances (bytes: reads):\n");
+        stats_print_hist(hFile, stats.seek_dist_hist);
+    }
+}
@@ -0,0 +1,252 @@
+/*
+ * The Sleuth Kit
+ *
+ * This software is distributed under the Common Public License 1.0
+ */
+
+/**
+ * \file img_workers.c
+ * Contains a small pool of threads that formats with compressed data use
+ * to decompress the pieces of a large read in parallel.
+ *
+ * The libraries for these formats are not thread safe, so each worker
+ * reads with its own handle to the image, which the format opens when it
+ * creates the pool.  The format splits a large read into pieces that
+ * start on its compression unit boundaries and the workers take the pieces
+ * in order.  Each worker writes its piece straight into the caller's buffer,
+ * so the data is handed back in order once all pieces are done.  A pool
+ * only runs one read at a time, which the format's read lock guarantees.
+ */
+
+#include "tsk_img_i.h"
+
+/* What each thread needs to know about itself */
+typedef struct {
+    TSK_IMG_WORKERS *workers;
+    int index;
+} TSK_IMG_WORKER_ARG;
+
+struct TSK_IMG_WORKERS {
+    TSK_IMG_INFO *img_info;
+    TSK_IMG_WORKER_READ read;   ///< Format callback that reads with a worker's handle
+    tsk_lock_t lock;            ///< Protects the fields below
+    tsk_cond_t work_cond;       ///< Signaled when there are new pieces or the pool stops
+    tsk_cond_t done_cond;       ///< Signaled when the last piece of a read is done
+    tsk_thread_t *threads;
+    TSK_IMG_WORKER_ARG *args;
+    int num_threads;
+    uint8_t stop;
+
+    // the read that is in progress
+    TSK_OFF_T off;
+    char *buf;
+    size_t len;
+    size_t piece_len;
+    size_t num_pieces;
+    size_t next_piece;          ///< Next piece that a worker will take
+    size_t pieces_done;
+    ssize_t *piece_cnt;         ///< Result of the read of each piece
+    uint8_t err_set;            ///< 1 if err_errno and err_str hold the first error
+    uint32_t err_errno;
+    char err_str[TSK_ERROR_STRING_MAX_LENGTH + 1];
+};
+
+
+/* The main loop of a worker thread */
+static void
+workers_main(void *a_ptr)
+{
+    TSK_IMG_WORKER_ARG *arg = (TSK_IMG_WORKER_ARG *) a_ptr;
+    TSK_IMG_WORKERS *workers = arg->workers;
+
+    tsk_take_lock(&(workers->lock));
+    while (workers->stop == 0) {
+        size_t piece;
+        size_t rel_off;
+        size_t len;
+        ssize_t cnt;
+
+        if (workers->next_piece >= workers->num_pieces) {
+            tsk_cond_wait(&(workers->work_cond), &(workers->lock));
+            continue;
+        }
+
+        piece = workers->next_piece++;
+        rel_off = piece * workers->piece_len;
+        len = workers->len - rel_off;
+        if (len > workers->piece_len)
+            len = workers->piece_len;
+        tsk_release_lock(&(workers->lock));
+
+        cnt = workers->read(workers->img_info, arg->index,
+            workers->off + (TSK_OFF_T) rel_off, &workers->buf[rel_off], len);
+
+        tsk_take_lock(&(workers->lock));
+        workers->piece_cnt[piece] = cnt;
+
+        // errors are kept per thread, so save it for the caller
+        if ((cnt < 0) && (workers->err_set == 0)) {
+            workers->err_set = 1;
+            workers->err_errno = tsk_error_get_errno();
+            strncpy(workers->err_str, tsk_error_get_errstr(),
+                TSK_ERROR_STRING_MAX_LENGTH);
+        }
+
+        if (++workers->pieces_done == workers->num_pieces)
+            tsk_cond_signal(&(workers->done_cond));
+    }
+    tsk_release_lock(&(workers->lock));
+}
+
+
+/**
+ * \internal
+ * Start a pool of worker threads for an image.
+ *
+ * @param a_img_info Image that the workers read from
+ * @param a_num_threads Number of threads to start
+ * @param a_read Format callback that reads data with the handle of a given worker
+ * @returns NULL on error (such as when threads are not supported)
+ */
+TSK_IMG_WORKERS *
+tsk_img_workers_create(TSK_IMG_INFO * a_img_info, int a_num_threads,
+    TSK_IMG_WORKER_READ a_read)
+{
+    TSK_IMG_WORKERS *workers;
+    int i;
+
+    if ((workers =
+            (TSK_IMG_WORKERS *) tsk_malloc(sizeof(TSK_IMG_WORKERS))) == NULL)
+        return NULL;
+
+    workers->img_info = a_img_info;
+    workers->read = a_read;
+    if (((workers->threads =
+                (tsk_thread_t *) tsk_malloc(a_num_threads *
+                    sizeof(tsk_thread_t))) == NULL)
+        || ((workers->args =
+                (TSK_IMG_WORKER_ARG *) tsk_malloc(a_num_threads *
+                    sizeof(TSK_IMG_WORKER_ARG))) == NULL)) {
+        free(workers->threads);
+        free(workers);
+        return NULL;
+    }
+    tsk_init_lock(&(workers->lock));
+    tsk_init_cond(&(workers->work_cond));
+    tsk_init_cond(&(workers->done_cond));
+
+    for (i = 0; i < a_num_threads; i++) {
+        workers->args[i].workers = workers;
+        workers->args[i].index = i;
+        if (tsk_thread_create(&(workers->threads[i]), workers_main,
+                &(workers->args[i]))) {
+            // stop the ones that did start
+            tsk_img_workers_free(workers);
+            return NULL;
+        }
+        workers->num_threads++;
+    }
+    return workers;
+}
+
+
+/**
+ * \internal
+ * Stop the threads of a pool and free it.
+ *
+ * @param a_workers Pool to free (can be NULL)
+ */
+void
+tsk_img_workers_free(TSK_IMG_WORKERS * a_workers)
+{
+    int i;
+
+    if (a_workers == NULL)
+        return;
+
+    tsk_take_lock(&(a_workers->lock));
+    a_workers->stop = 1;
+    tsk_cond_broadcast(&(a_workers->work_cond));
+    tsk_release_lock(&(a_workers->lock));
+    for (i = 0; i < a_workers->num_threads; i++)
+        tsk_thread_join(&(a_workers->threads[i]));
+
+    tsk_deinit_cond(&(a_workers->done_cond));
+    tsk_deinit_cond(&(a_workers->work_cond));
+    tsk_deinit_lock(&(a_workers->lock));
+    free(a_workers->args);
+    free(a_workers->threads);
+    free(a_workers);
+}
+
+
+/**
+ * \internal
+ * Read data with the workers of a pool.  The read is split into pieces of
+ * a_piece_len bytes (the last one can be shorter) that the workers read at
+ * the same time.  Only one read can use a pool at a time.
+ *
+ * @param a_workers Pool to read with
+ * @param a_off Byte offset to start reading from
+ * @param a_buf [out] Buffer to read into
+ * @param a_len Number of bytes to read
+ * @param a_piece_len Number of bytes that each worker reads at a time
+ * @returns -1 on error or number of bytes read (which stops at the first
+ * short piece)
+ */
+ssize_t
+tsk_img_workers_read(TSK_IMG_WORKERS * a_workers, TSK_OFF_T a_off,
+    char *a_buf, size_t a_len, size_t a_piece_len)
+{
+    size_t num_pieces = (a_len + a_piece_len - 1) / a_piece_len;
+    ssize_t *piece_cnt;
+    size_t total = 0;
+    size_t i;
+
+    if (a_len == 0)
+        return 0;
+
+    if ((piece_cnt =
+            (ssize_t *) tsk_malloc(num_pieces * sizeof(ssize_t))) == NULL)
+        return -1;
+
+    tsk_take_lock(&(a_workers->lock));
+    a_workers->off = a_off;
+    a_workers->buf = a_buf;
+    a_workers->len = a_len;
+    a_workers->piece_len = a_piece_len;
+    a_workers->piece_cnt = piece_cnt;
+    a_workers->err_set = 0;
+    a_workers->pieces_done = 0;
+    a_workers->next_piece = 0;
+    a_workers->num_pieces = num_pieces;
+    tsk_cond_broadcast(&(a_workers->work_cond));
+
+    while (a_workers->pieces_done < num_pieces)
+        tsk_cond_wait(&(a_workers->done_cond), &(a_workers->lock));
+
+    a_workers->num_pieces = 0;
+    a_workers->next_piece = 0;
+    a_workers->piece_cnt = NULL;
+    tsk_release_lock(&(a_workers->lock));
+
+    // the data is only good up to the first piece that failed or was short
+    for (i = 0; i < num_pieces; i++) {
+        size_t len = a_len - i * a_piece_len;
+        if (len > a_piece_len)
+            len = a_piece_len;
+
+        if (piece_cnt[i] < 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(a_workers->err_errno);
+            tsk_error_set_errstr("%s", a_workers->err_str);
+            free(piece_cnt);
+            return -1;
+        }
+        total += (size_t) piece_cnt[i];
+        if ((size_t) piece_cnt[i] < len)
+            break;
+    }
+    free(piece_cnt);
+    return (ssize_t) total;
+}
@@ -33,6 +33,47 @@
 #define VHD_FOOTER_LENGTH 0x200
 #define VHD_DISK_HEADER_LENGTH 0x400
 
+#define IMG_WRITER_QUEUE_MAX (64 * 1024 * 1024) /* Most bytes of data that can wait for the writer thread */
+#define IMG_WRITER_PENDING_MAX 16   /* Most blocks that are collected in memory before they are written */
+
+/*
+ * Data that is waiting for the writer thread
+ */
+typedef struct IMG_WRITER_ITEM IMG_WRITER_ITEM;
+struct IMG_WRITER_ITEM {
+    TSK_OFF_T addr;
+    size_t len;
+    char *data;
+    IMG_WRITER_ITEM *next;
+};
+
+/*
+ * A block that is not in the VHD yet and whose data is being collected in memory
+ */
+typedef struct {
+    TSK_OFF_T blockNum;     // -1 if the entry is not used
+    char *data;             // Contents of the block (sectors that were not added are zero)
+    bool hasData;           // true if a sector that is not all zeros was added
+    uint64_t lastUse;       // Value of pendingClock when the block was last added to (0 if not used)
+} IMG_WRITER_PENDING;
+
+struct IMG_WRITER_QUEUE {
+    tsk_lock_t lock;        // Protects the fields up to pending
+    tsk_cond_t workCond;    // Signaled when data is queued or the thread should stop
+    tsk_cond_t spaceCond;   // Signaled when the thread is done with queued data
+    tsk_thread_t thread;
+    bool threadRunning;
+    bool stop;
+    bool busy;              // true while the thread is adding data that it took off the queue
+    IMG_WRITER_ITEM *head;
+    IMG_WRITER_ITEM *tail;
+    size_t queuedBytes;
+
+    // only used by the thread that adds the data
+    IMG_WRITER_PENDING pending[IMG_WRITER_PENDING_MAX];
+    uint64_t pendingClock;
+};
+
 static TSK_RETVAL_ENUM writeFooter(TSK_IMG_WRITER* writer);
 
 /*
@@ -79,49 +120,70 @@ static TSK_RETVAL_ENUM seekToOffset(TSK_IMG_WRITER * writer, TSK_OFF_T offset) {
 }
 
 /*
- * Move the file pointer from the current location
+ * Write a buffer at the given offset (relative the beginning of the file)
  */
-static TSK_RETVAL_ENUM seekAhead(TSK_IMG_WRITER * writer, TSK_OFF_T dist) {
-    LARGE_INTEGER li;
-    li.QuadPart = dist;
+static TSK_RETVAL_ENUM writeAt(TSK_IMG_WRITER * writer, TSK_OFF_T offset, const void * buffer,
+    size_t len, const char * what) {
 
-    li.LowPart = SetFilePointer(writer->outputFileHandle, li.LowPart,
-        &li.HighPart, FILE_CURRENT);
+    if (TSK_OK != seekToOffset(writer, offset)) {
+        return TSK_ERR;
+    }
 
-    if ((li.LowPart == INVALID_SET_FILE_POINTER) &&
-        (GetLastError() != NO_ERROR)) {
-        int lastError = (int)GetLastError();
+    DWORD bytesWritten;
+    if ((FALSE == WriteFile(writer->outputFileHandle, buffer, (DWORD)len, &bytesWritten, NULL))
+        || (bytesWritten != len)) {
+        int lastError = GetLastError();
         tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_SEEK);
-        tsk_error_set_errstr("img_writer::seekAhead: offset %" PRIuOFF " seek - %d",
-            dist,
-            lastError);
+        tsk_error_set_errno(TSK_ERR_IMG_WRITE);
+        tsk_error_set_errstr("img_writer: error writing %s at offset %" PRIuOFF " - %d",
+            what, offset, lastError);
         return TSK_ERR;
     }
     return TSK_OK;
 }
 
 /*
- * Use the sector bitmap to determine whether we're done writing data to a given block 
+ * Returns true if the buffer (at most one sector long) is all zeros
  */
-static void checkIfBlockIsFinished(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
+static bool isZeroSector(const char * buffer, size_t len) {
+    static const char zeroSector[VHD_SECTOR_SIZE] = { 0 };
+    return memcmp(buffer, zeroSector, len) == 0;
+}
 
-    /* The final block may not contain the full number of sectors */
-    unsigned int nSectors;
+/*
+ * Number of sectors in a block. The final block may not contain the full number of sectors.
+ */
+static uint32_t getSectorsInBlock(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
     if ((blockNum == writer->totalBlocks - 1) && (writer->imageSize % writer->blockSize != 0)) {
-        nSectors = (writer->imageSize % writer->blockSize) / VHD_SECTOR_SIZE;
-    }
-    else {
-        nSectors = writer->sectorsPerBlock;
+        return uint32_t((writer->imageSize % writer->blockSize) / VHD_SECTOR_SIZE);
     }
+    return writer->sectorsPerBlock;
+}
 
+/*
+ * Use the sector bitmap to determine whether all of the sectors of a block have been added
+ */
+static bool isBlockComplete(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
     unsigned char * sectBitmap = writer->blockToSectorBitmap[blockNum];
-    for (unsigned int i = 0; i < nSectors; i++) {
+    uint32_t nSectors = getSectorsInBlock(writer, blockNum);
+
+    for (uint32_t i = 0; i < nSectors; i++) {
         if (false == getBit(sectBitmap, i)) {
             /* At least one sector has not been written */
-            return;
+            return false;
         }
     }
+    return true;
+}
+
+/*
+ * Use the sector bitmap to determine whether we're done writing data to a given block 
+ */
+static void checkIfBlockIsFinished(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
+
+    if (false == isBlockComplete(writer, blockNum)) {
+        return;
+    }
 
     /* Mark the block as finished and free the memory for its sector bitmap */
     writer->blockStatus[blockNum] = IMG_WRITER_BLOCK_STATUS_FINISHED;
@@ -130,9 +192,29 @@ static void checkIfBlockIsFinished(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
 }
 
 /*
- * Add a buffer of data to a previously started block in the VHD 
+ * Write a run of sectors to a block that is already in the VHD and mark them in its sector bitmap
+ */
+static TSK_RETVAL_ENUM writeSectorRun(TSK_IMG_WRITER* writer, TSK_OFF_T addr, const char *buffer,
+    size_t len, TSK_OFF_T blockNum) {
+
+    TSK_OFF_T blockOffset = addr % writer->blockSize;
+    if (TSK_OK != writeAt(writer, VHD_SECTOR_SIZE * TSK_OFF_T(writer->blockToSectorNumber[blockNum]) +
+            writer->sectorBitmapLength + blockOffset, buffer, len, "sectors")) {
+        return TSK_ERR;
+    }
+
+    for (size_t i = 0; i < len; i += VHD_SECTOR_SIZE) {
+        setBit(writer->blockToSectorBitmap[blockNum], (blockOffset + i) / VHD_SECTOR_SIZE, true);
+    }
+    return TSK_OK;
+}
+
+/*
+ * Add a buffer of data to a block that is already in the VHD. Each run of new sectors
+ * is written with one call. The block was written with zeros in every sector that it did
+ * not have yet, so new sectors of zeros only need their bit set.
  */
-static TSK_RETVAL_ENUM addToExistingBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, char *buffer,
+static TSK_RETVAL_ENUM addToExistingBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, const char *buffer,
     size_t len, TSK_OFF_T blockNum) {
 
     if (tsk_verbose) {
@@ -140,89 +222,71 @@ static TSK_RETVAL_ENUM addToExistingBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr
         fflush(stderr);
     }
 
-    /* Seek to where this buffer should start in the image */
-    if (TSK_OK != seekToOffset(writer, VHD_SECTOR_SIZE * TSK_OFF_T(writer->blockToSectorNumber[blockNum]) + writer->sectorBitmapLength +
-            (addr % writer->blockSize))) {
-        return TSK_ERR;
-    }
+    unsigned char * sectBitmap = writer->blockToSectorBitmap[blockNum];
+    bool bitmapChanged = false;
+    size_t runStart = 0;
+    size_t runLen = 0;
 
-    /* Copy each sector that isn't already there */
     for (size_t inputOffset = 0; inputOffset < len; inputOffset += VHD_SECTOR_SIZE) {
         uint32_t currentSector = uint32_t((addr % writer->blockSize + inputOffset) / VHD_SECTOR_SIZE);
+        size_t sectorLen = VHD_SECTOR_SIZE;
+        if (sectorLen > len - inputOffset) {
+            sectorLen = len - inputOffset;
+        }
 
-        if (getBit(writer->blockToSectorBitmap[blockNum], currentSector)) {
-            if (TSK_OK != seekAhead(writer, VHD_SECTOR_SIZE)) {
-                return TSK_ERR;
+        bool newData = false;
+        if (false == getBit(sectBitmap, currentSector)) {
+            bitmapChanged = true;
+            if (isZeroSector(&(buffer[inputOffset]), sectorLen)) {
+                setBit(sectBitmap, currentSector, true);
+            }
+            else {
+                newData = true;
             }
         }
-        else {
-            
-            DWORD bytesWritten;
-            if (FALSE == WriteFile(writer->outputFileHandle, &(buffer[inputOffset]), VHD_SECTOR_SIZE, 
-                    &bytesWritten, NULL)) {
-                int lastError = GetLastError();
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_IMG_WRITE);
-                tsk_error_set_errstr("addToExistingBlock: error writing sector",
-                    lastError);
+
+        if (newData) {
+            if (runLen == 0) {
+                runStart = inputOffset;
+            }
+            runLen += sectorLen;
+        }
+        else if (runLen > 0) {
+            if (TSK_OK != writeSectorRun(writer, addr + runStart, &(buffer[runStart]), runLen, blockNum)) {
                 return TSK_ERR;
             }
-            setBit(writer->blockToSectorBitmap[blockNum], currentSector, true);
+            runLen = 0;
         }
     }
-
-    /* Update the sector bitmap */
-    if (TSK_OK != seekToOffset(writer, VHD_SECTOR_SIZE * TSK_OFF_T(writer->blockToSectorNumber[blockNum]))) {
-        return TSK_ERR;
-    }
-    
-    DWORD bytesWritten;
-    if (FALSE == WriteFile(writer->outputFileHandle, writer->blockToSectorBitmap[blockNum], 
-            writer->sectorBitmapArrayLength, &bytesWritten, NULL)) {
-        int lastError = GetLastError();
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_WRITE);
-        tsk_error_set_errstr("addToExistingBlock: error writing sector",
-            lastError);
+    if ((runLen > 0) &&
+        (TSK_OK != writeSectorRun(writer, addr + runStart, &(buffer[runStart]), runLen, blockNum))) {
         return TSK_ERR;
     }
 
+    /* Update the sector bitmap */
+    if (bitmapChanged) {
+        return writeAt(writer, VHD_SECTOR_SIZE * TSK_OFF_T(writer->blockToSectorNumber[blockNum]),
+            sectBitmap, writer->sectorBitmapArrayLength, "sector bitmap");
+    }
     return TSK_OK;
 }
 
 /* 
- * Add a new block to the VHD and copy in the buffer
+ * Add a new block to the VHD with the given contents and the sectors in its sector bitmap
  */
-static TSK_RETVAL_ENUM addNewBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, char *buffer, size_t len, TSK_OFF_T blockNum) {
+static TSK_RETVAL_ENUM addNewBlock(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum, const char *blockData) {
 
     if (tsk_verbose) {
         tsk_fprintf(stderr, "addNewBlock: Adding new block 0x%x\n", blockNum);
         fflush(stderr);
     }
 
-    writer->blockStatus[blockNum] = IMG_WRITER_BLOCK_STATUS_ALLOC;
-
-    /* Given the max size of the VHD, the sector number will always fit in four bytes */
-    writer->blockToSectorNumber[blockNum] = uint32_t(writer->nextDataOffset / VHD_SECTOR_SIZE);
-
-    char * fullBuffer = (char *)tsk_malloc(writer->blockSize * sizeof(char));
-    char * sectorBitmap = (char *)tsk_malloc(writer->sectorBitmapLength * sizeof(char));
-    unsigned char * completedSectors = (unsigned char *)tsk_malloc(((writer->sectorBitmapArrayLength) * sizeof(char)));
-
-    /* Create the full new block and record the sectors written */
-    TSK_OFF_T startingOffset = addr % writer->blockSize;
-    for (size_t i = 0; i < len; i++) {
-
-        /* Update the sector bitmap */
-        if (((startingOffset + i) % VHD_SECTOR_SIZE) == 0) {
-            TSK_OFF_T currentSector = (startingOffset + i) / VHD_SECTOR_SIZE;
-            setBit(completedSectors, currentSector, true);
-            sectorBitmap[currentSector / 8] = completedSectors[currentSector / 8];
-        }
-
-        fullBuffer[startingOffset + i] = buffer[i];
+    /* The sector bitmap is padded out to a full sector in the VHD */
+    unsigned char * sectorBitmap = (unsigned char *)tsk_malloc(writer->sectorBitmapLength * sizeof(char));
+    if (sectorBitmap == NULL) {
+        return TSK_ERR;
     }
-    writer->blockToSectorBitmap[blockNum] = completedSectors;
+    memcpy(sectorBitmap, writer->blockToSectorBitmap[blockNum], writer->sectorBitmapArrayLength);
 
     /* Prepare the new block offset - this is stored in big-endian order */
     TSK_OFF_T nextDataOffsetSector = writer->nextDataOffset / VHD_SECTOR_SIZE;
@@ -232,57 +296,136 @@ static TSK_RETVAL_ENUM addNewBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, char
     newBlockOffset[2] = (nextDataOffsetSector >> 8) & 0xff;
     newBlockOffset[3] = nextDataOffsetSector & 0xff;
 
-    /* Write the new offset to the BAT */
-    if (TSK_OK != seekToOffset(writer, writer->batOffset + 4 * blockNum)) {
-        return TSK_ERR;
-    }
-    DWORD bytesWritten;
-    if (FALSE == WriteFile(writer->outputFileHandle, newBlockOffset, 4, &bytesWritten, NULL)) {
-        int lastError = GetLastError();
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_WRITE);
-        tsk_error_set_errstr("addNewBlock: error writing BAT entry",
-            lastError);
+    /* Write the sector bitmap and the data, then the new offset to the BAT */
+    if ((TSK_OK != writeAt(writer, writer->nextDataOffset, sectorBitmap, writer->sectorBitmapLength, "sector bitmap"))
+        || (TSK_OK != writeAt(writer, writer->nextDataOffset + writer->sectorBitmapLength, blockData,
+            writer->blockSize, "block data"))
+        || (TSK_OK != writeAt(writer, writer->batOffset + 4 * blockNum, newBlockOffset, 4, "BAT entry"))) {
+        free(sectorBitmap);
         return TSK_ERR;
     }
+    free(sectorBitmap);
+
+    /* Given the max size of the VHD, the sector number will always fit in four bytes */
+    writer->blockStatus[blockNum] = IMG_WRITER_BLOCK_STATUS_ALLOC;
+    writer->blockToSectorNumber[blockNum] = uint32_t(nextDataOffsetSector);
+
+    /* Update the offset where the next block will start */
+    writer->nextDataOffset += writer->sectorBitmapLength + writer->blockSize;
 
-    /* Write the sector bitmap and the data */
+    /* Always add the footer on to make it a valid VHD */
     if (TSK_OK != seekToOffset(writer, writer->nextDataOffset)) {
         return TSK_ERR;
     }
-    if (FALSE == WriteFile(writer->outputFileHandle, sectorBitmap, writer->sectorBitmapLength, &bytesWritten, NULL)) {
-        int lastError = GetLastError();
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_WRITE);
-        tsk_error_set_errstr("addNewBlock: error writing sector bitmap",
-            lastError);
-        return TSK_ERR;
+    return writeFooter(writer);
+}
+
+/*
+ * Write a block that was collected in memory to the VHD and stop collecting it.
+ * A block that only had zeros added is left out of the VHD, which reads it as zeros.
+ */
+static TSK_RETVAL_ENUM flushPendingBlock(TSK_IMG_WRITER* writer, IMG_WRITER_PENDING * pending) {
+    TSK_OFF_T blockNum = pending->blockNum;
+    TSK_RETVAL_ENUM retval = TSK_OK;
+
+    if (pending->hasData) {
+        retval = addNewBlock(writer, blockNum, pending->data);
     }
-    if (FALSE == WriteFile(writer->outputFileHandle, fullBuffer, writer->blockSize, &bytesWritten, NULL)) {
-        int lastError = GetLastError();
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_WRITE);
-        tsk_error_set_errstr("addNewBlock: error writing block data",
-            lastError);
-        return TSK_ERR;
+    if ((retval != TSK_OK) && (writer->blockStatus[blockNum] != IMG_WRITER_BLOCK_STATUS_ALLOC)) {
+        /* The data is lost, so start the block over and let finish_image read it again */
+        memset(writer->blockToSectorBitmap[blockNum], 0, writer->sectorBitmapArrayLength);
     }
+    pending->blockNum = -1;
+    pending->lastUse = 0;
 
-    /* Update the offset where the next block will start */
-    writer->nextDataOffset += writer->sectorBitmapLength + writer->blockSize;
+    checkIfBlockIsFinished(writer, blockNum);
+    return retval;
+}
 
-    /* Always add the footer on to make it a valid VHD */
-    writeFooter(writer);
+/*
+ * Find the block in memory that collects the data for a block that is not in the VHD yet.
+ * If there is none, the least recently used one is written out and reused.
+ */
+static IMG_WRITER_PENDING * getPendingBlock(TSK_IMG_WRITER* writer, TSK_OFF_T blockNum) {
+    IMG_WRITER_QUEUE * queue = writer->queue;
+    IMG_WRITER_PENDING * pending = &(queue->pending[0]);
+
+    queue->pendingClock++;
+    for (int i = 0; i < IMG_WRITER_PENDING_MAX; i++) {
+        if (queue->pending[i].blockNum == blockNum) {
+            queue->pending[i].lastUse = queue->pendingClock;
+            return &(queue->pending[i]);
+        }
+        /* Unused entries have a lastUse of 0 */
+        if (queue->pending[i].lastUse < pending->lastUse) {
+            pending = &(queue->pending[i]);
+        }
+    }
 
-    free(fullBuffer);
-    free(sectorBitmap);
+    if ((pending->blockNum != -1) && (TSK_OK != flushPendingBlock(writer, pending))) {
+        return NULL;
+    }
+
+    if ((pending->data == NULL) &&
+        ((pending->data = (char *)tsk_malloc(writer->blockSize * sizeof(char))) == NULL)) {
+        return NULL;
+    }
+    memset(pending->data, 0, writer->blockSize);
+
+    if ((writer->blockToSectorBitmap[blockNum] == NULL) &&
+        ((writer->blockToSectorBitmap[blockNum] =
+            (unsigned char *)tsk_malloc(writer->sectorBitmapArrayLength * sizeof(char))) == NULL)) {
+        return NULL;
+    }
+
+    pending->blockNum = blockNum;
+    pending->hasData = false;
+    pending->lastUse = queue->pendingClock;
+    return pending;
+}
+
+/*
+ * Add a buffer of data to a block that is not in the VHD yet. The data is collected in
+ * memory and the block is written with one call once all of its sectors are in.
+ * Sectors of zeros are only marked in the sector bitmap.
+ */
+static TSK_RETVAL_ENUM addToPendingBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, const char *buffer,
+    size_t len, TSK_OFF_T blockNum) {
 
+    IMG_WRITER_PENDING * pending = getPendingBlock(writer, blockNum);
+    if (pending == NULL) {
+        return TSK_ERR;
+    }
+
+    unsigned char * sectBitmap = writer->blockToSectorBitmap[blockNum];
+    size_t blockOffset = size_t(addr % writer->blockSize);
+    for (size_t inputOffset = 0; inputOffset < len; inputOffset += VHD_SECTOR_SIZE) {
+        uint32_t currentSector = uint32_t((blockOffset + inputOffset) / VHD_SECTOR_SIZE);
+        size_t sectorLen = VHD_SECTOR_SIZE;
+        if (sectorLen > len - inputOffset) {
+            sectorLen = len - inputOffset;
+        }
+
+        if (getBit(sectBitmap, currentSector)) {
+            continue;
+        }
+        setBit(sectBitmap, currentSector, true);
+        if (false == isZeroSector(&(buffer[inputOffset]), sectorLen)) {
+            memcpy(&(pending->data[blockOffset + inputOffset]), &(buffer[inputOffset]), sectorLen);
+            pending->hasData = true;
+        }
+    }
+
+    if (isBlockComplete(writer, blockNum)) {
+        return flushPendingBlock(writer, pending);
+    }
     return TSK_OK;
 }
 
 /*
  * Add a buffer that fits in a single block of the VHD 
  */
-static TSK_RETVAL_ENUM addBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, char *buffer, size_t len) {
+static TSK_RETVAL_ENUM addBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, const char *buffer, size_t len) {
     TSK_OFF_T blockNum = addr / writer->blockSize;
 
     if (writer->blockStatus[blockNum] == IMG_WRITER_BLOCK_STATUS_FINISHED){
@@ -290,16 +433,34 @@ static TSK_RETVAL_ENUM addBlock(TSK_IMG_WRITER* writer, TSK_OFF_T addr, char *bu
     }
 
     if (writer->blockStatus[blockNum] == IMG_WRITER_BLOCK_STATUS_ALLOC) {
-        addToExistingBlock(writer, addr, buffer, len, blockNum);
-    }
-    else {
-        addNewBlock(writer, addr, buffer, len, blockNum);
+        TSK_RETVAL_ENUM retval = addToExistingBlock(writer, addr, buffer, len, blockNum);
+
+        /* Check whether the block is now done */
+        checkIfBlockIsFinished(writer, blockNum);
+        return retval;
     }
+    return addToPendingBlock(writer, addr, buffer, len, blockNum);
+}
 
-    /* Check whether the block is now done */
-    checkIfBlockIsFinished(writer, blockNum);
+/*
+ * Add a buffer to the VHD. The buffer can span any number of blocks.
+ */
+static TSK_RETVAL_ENUM addData(TSK_IMG_WRITER* writer, TSK_OFF_T addr, const char *buffer, size_t len) {
+    TSK_RETVAL_ENUM retval = TSK_OK;
 
-    return TSK_OK;
+    while ((len > 0) && (addr < writer->imageSize)) {
+        size_t partLength = size_t(writer->blockSize - (addr % writer->blockSize));
+        if (partLength > len) {
+            partLength = len;
+        }
+        if (TSK_OK != addBlock(writer, addr, buffer, partLength)) {
+            retval = TSK_ERR;
+        }
+        addr += partLength;
+        buffer += partLength;
+        len -= partLength;
+    }
+    return retval;
 }
 
 
@@ -448,8 +609,71 @@ static TSK_RETVAL_ENUM writeDynamicDiskHeader(TSK_IMG_WRITER * writer) {
 }
 
 
+/*
+ * Main loop of the thread that adds queued data to the VHD
+ */
+static void writerThreadMain(void * ptr) {
+    TSK_IMG_WRITER * writer = (TSK_IMG_WRITER *)ptr;
+    IMG_WRITER_QUEUE * queue = writer->queue;
+
+    tsk_take_lock(&(queue->lock));
+    while (true) {
+        IMG_WRITER_ITEM * item = queue->head;
+        if (item == NULL) {
+            if (queue->stop) {
+                break;
+            }
+            tsk_cond_wait(&(queue->workCond), &(queue->lock));
+            continue;
+        }
+
+        queue->head = item->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        queue->busy = true;
+        tsk_release_lock(&(queue->lock));
+
+        /* There is nobody to return an error to. The block stays unfinished, so
+         * finish_image will read it again. */
+        if (TSK_OK != addData(writer, item->addr, item->data, item->len)) {
+            if (tsk_verbose) {
+                tsk_fprintf(stderr, "writerThreadMain: Error adding data at offset %" PRIuOFF ": %s\n",
+                    item->addr, tsk_error_get());
+            }
+            tsk_error_reset();
+        }
+
+        tsk_take_lock(&(queue->lock));
+        queue->queuedBytes -= item->len;
+        queue->busy = false;
+        free(item);
+        tsk_cond_broadcast(&(queue->spaceCond));
+    }
+    tsk_release_lock(&(queue->lock));
+}
+
+/*
+ * Wait until the writer thread has added all of the queued data
+ */
+static void waitForQueue(TSK_IMG_WRITER* writer) {
+    IMG_WRITER_QUEUE * queue = writer->queue;
+    if ((queue == NULL) || (false == queue->threadRunning)) {
+        return;
+    }
+
+    tsk_take_lock(&(queue->lock));
+    while ((queue->head != NULL) || queue->busy) {
+        tsk_cond_wait(&(queue->spaceCond), &(queue->lock));
+    }
+    tsk_release_lock(&(queue->lock));
+}
+
 /*
  * Add a buffer to the VHD. The buffer can span multiple blocks.
+ * The data is copied and handed to the writer thread so that the caller does not wait
+ * for the disk. If the queue is full, the caller waits until the writer thread has made
+ * room so that no data is lost.
  * @param writer Image writer object
  * @param addr   Offset in the original image where the data starts
  * @param buffer The data to copy
@@ -473,18 +697,37 @@ static TSK_RETVAL_ENUM tsk_img_writer_add(TSK_IMG_WRITER* writer, TSK_OFF_T addr
         return TSK_ERR;
     }
 
-    if ((addr / writer->blockSize) == ((addr + len) / writer->blockSize)) {
-        /* The buffer is contained in a single block */
-        return addBlock(writer, addr, buffer, len);
+    IMG_WRITER_QUEUE * queue = writer->queue;
+    if ((queue == NULL) || (false == queue->threadRunning)) {
+        return addData(writer, addr, buffer, len);
+    }
+
+    tsk_take_lock(&(queue->lock));
+    while ((queue->queuedBytes > 0) && (queue->queuedBytes + len > IMG_WRITER_QUEUE_MAX)) {
+        tsk_cond_wait(&(queue->spaceCond), &(queue->lock));
+    }
+    tsk_release_lock(&(queue->lock));
+
+    IMG_WRITER_ITEM * item = (IMG_WRITER_ITEM *)tsk_malloc(sizeof(IMG_WRITER_ITEM) + len);
+    if (item == NULL) {
+        return TSK_ERR;
+    }
+    item->addr = addr;
+    item->len = len;
+    item->data = (char *)(item + 1);
+    memcpy(item->data, buffer, len);
+
+    tsk_take_lock(&(queue->lock));
+    if (queue->tail == NULL) {
+        queue->head = item;
     }
     else {
-        /* The buffer spans two blocks */
-        TSK_OFF_T firstPartLength = writer->blockSize - (addr % writer->blockSize);
-        addBlock(writer, addr, buffer, firstPartLength);
-        if (addr + firstPartLength < writer->imageSize) {
-            addBlock(writer, addr + firstPartLength, buffer + firstPartLength, (addr + len) % writer->blockSize);
-        }
+        queue->tail->next = item;
     }
+    queue->tail = item;
+    queue->queuedBytes += len;
+    tsk_cond_signal(&(queue->workCond));
+    tsk_release_lock(&(queue->lock));
 
     return TSK_OK;
 }
@@ -499,6 +742,32 @@ static TSK_RETVAL_ENUM tsk_img_writer_close(TSK_IMG_WRITER* img_writer) {
         tsk_fprintf(stderr,
             "tsk_img_writer_close: Closing image writer");
     }
+
+    /* Let the writer thread add what is queued and write the blocks that are
+     * collected in memory */
+    IMG_WRITER_QUEUE * queue = img_writer->queue;
+    if (queue != NULL) {
+        if (queue->threadRunning) {
+            tsk_take_lock(&(queue->lock));
+            queue->stop = true;
+            tsk_cond_broadcast(&(queue->workCond));
+            tsk_release_lock(&(queue->lock));
+            tsk_thread_join(&(queue->thread));
+            queue->threadRunning = false;
+        }
+
+        for (int i = 0; i < IMG_WRITER_PENDING_MAX; i++) {
+            if ((queue->pending[i].blockNum != -1) && (img_writer->outputFileHandle != 0)) {
+                flushPendingBlock(img_writer, &(queue->pending[i]));
+            }
+            free(queue->pending[i].data);
+        }
+        tsk_deinit_cond(&(queue->spaceCond));
+        tsk_deinit_cond(&(queue->workCond));
+        tsk_deinit_lock(&(queue->lock));
+        free(queue);
+        img_writer->queue = NULL;
+    }
     
     if (img_writer->outputFileHandle != 0) {
         CloseHandle(img_writer->outputFileHandle);
@@ -548,13 +817,14 @@ static TSK_RETVAL_ENUM tsk_img_writer_finish_image(TSK_IMG_WRITER* img_writer) {
         return TSK_ERR;
     }
 
-    IMG_RAW_INFO * raw_info = (IMG_RAW_INFO *)(img_writer->img_info);
-    TSK_OFF_T offset;
-    TSK_OFF_T startOfBlock;
+    char * buffer = (char*)tsk_malloc(img_writer->blockSize * sizeof(char));
+    if (buffer == NULL) {
+        return TSK_ERR;
+    }
 
-    char * buffer = (char*)tsk_malloc(TSK_IMG_INFO_CACHE_LEN * sizeof(char));
     for (TSK_OFF_T i = 0; i < img_writer->totalBlocks; i++) {
         if (img_writer->cancelFinish) {
+            free(buffer);
             return TSK_ERR;
         }
 
@@ -564,21 +834,21 @@ static TSK_RETVAL_ENUM tsk_img_writer_finish_image(TSK_IMG_WRITER* img_writer) {
 
         if (img_writer->blockStatus[i] != IMG_WRITER_BLOCK_STATUS_FINISHED) {
 
-            /* Read in the entire block in cache-length chunks. Each read will lead to a call to
-             * tsk_img_writer_add with the new data.
+            /* Read in the entire block at once. The read will lead to a call to
+             * tsk_img_writer_add with the new data, so it goes around the cache (which
+             * could return the data without reading it).
              * We don't use the sector bitmap here because there is a chance the memory will get freed by
-             * another thread running tsk_img_writer_add.
+             * the writer thread.
             */
-            startOfBlock = i * img_writer->blockSize;
-            for(offset = startOfBlock; offset < startOfBlock + img_writer->blockSize;offset += TSK_IMG_INFO_CACHE_LEN){
-                if (img_writer->cancelFinish) {
-                    return TSK_ERR;
-                }
-                /* Using tsk_img_read here to make sure we get the lock */
-                if (tsk_img_read(img_writer->img_info, offset, buffer, TSK_IMG_INFO_CACHE_LEN) < 0) {
-                    // this usually happens when the device has been unplugged
-                    return TSK_ERR;
-                }
+            TSK_OFF_T startOfBlock = i * img_writer->blockSize;
+            size_t len = img_writer->blockSize;
+            if (startOfBlock + (TSK_OFF_T)len > img_writer->imageSize) {
+                len = (size_t)(img_writer->imageSize - startOfBlock);
+            }
+            if (tsk_img_read_direct(img_writer->img_info, startOfBlock, buffer, len) < 0) {
+                // this usually happens when the device has been unplugged
+                free(buffer);
+                return TSK_ERR;
             }
             /* In Autopsy, tsk_img_writer_finish_image() was starving other threads that were trying to do
              * basic reads and made the app impossible to use. Add the short sleep to give
@@ -586,6 +856,9 @@ static TSK_RETVAL_ENUM tsk_img_writer_finish_image(TSK_IMG_WRITER* img_writer) {
             Sleep(1);
         }
     }
+    free(buffer);
+
+    waitForQueue(img_writer);
 
     img_writer->is_finished = 1;
     return TSK_OK;
@@ -611,15 +884,6 @@ TSK_RETVAL_ENUM tsk_img_writer_create(TSK_IMG_INFO * img_info, const TSK_TCHAR *
             outputFileName);
     }
 
-    /* Everything will break if the buffers coming in are larger than the block 
-       size (i.e., they could span three blocks instead of just two)*/
-    if (TSK_IMG_INFO_CACHE_LEN > VHD_DEFAULT_BLOCK_SIZE) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_OPEN);
-        tsk_error_set_errstr("tsk_img_writer_create: tsk cache length is larger than the block size");
-        return TSK_ERR;
-    }
-
     IMG_RAW_INFO* raw_info = (IMG_RAW_INFO *)img_info;
 
     /* This should not be run on split images*/
@@ -730,8 +994,24 @@ TSK_RETVAL_ENUM tsk_img_writer_create(TSK_IMG_INFO * img_info, const TSK_TCHAR *
     writer->blockToSectorNumber = (uint32_t*)tsk_malloc(writer->totalBlocks * sizeof(uint32_t));
     writer->blockToSectorBitmap = (unsigned char **)tsk_malloc(writer->totalBlocks * sizeof(unsigned char *));
 
+    /* Start the thread that writes the data. If it can't be started, the data is
+     * written as it is added. */
+    if ((writer->queue = (IMG_WRITER_QUEUE *)tsk_malloc(sizeof(IMG_WRITER_QUEUE))) == NULL) {
+        return TSK_ERR;
+    }
+    for (int i = 0; i < IMG_WRITER_PENDING_MAX; i++) {
+        writer->queue->pending[i].blockNum = -1;
+    }
+    tsk_init_lock(&(writer->queue->lock));
+    tsk_init_cond(&(writer->queue->workCond));
+    tsk_init_cond(&(writer->queue->spaceCond));
+    if (tsk_thread_create(&(writer->queue->thread), writerThreadMain, writer) == 0) {
+        writer->queue->threadRunning = true;
+    }
+    else {
+        tsk_error_reset();
+    }
+
     return TSK_OK;
 #endif
 }
-
-
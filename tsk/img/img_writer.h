@@ -28,6 +28,8 @@ extern "C" {
     };
     typedef enum IMG_WRITER_BLOCK_STATUS_ENUM IMG_WRITER_BLOCK_STATUS_ENUM;
 
+    typedef struct IMG_WRITER_QUEUE IMG_WRITER_QUEUE;
+
     typedef struct TSK_IMG_WRITER TSK_IMG_WRITER;
     struct TSK_IMG_WRITER {
         TSK_IMG_INFO * img_info;
@@ -55,7 +57,9 @@ extern "C" {
 
         IMG_WRITER_BLOCK_STATUS_ENUM* blockStatus;
         uint32_t* blockToSectorNumber;
-        unsigned char ** blockToSectorBitmap;
+        unsigned char ** blockToSectorBitmap;   // Sectors of each unfinished block that have been added (NULL if none)
+
+        IMG_WRITER_QUEUE *queue;    // Data waiting for the writer thread and blocks that are collected in memory
 
         TSK_RETVAL_ENUM(*add)(TSK_IMG_WRITER* img_writer, TSK_OFF_T addr, char *buffer, size_t len);
         TSK_RETVAL_ENUM(*close)(TSK_IMG_WRITER* img_writer);
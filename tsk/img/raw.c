@@ -29,6 +29,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 #endif
 
 #ifndef S_IFMT
@@ -40,9 +44,178 @@
 #endif
 
 
+/**
+ * \internal
+ * Open one of the files in a split set of disk images.
+ *
+ * @param raw_info Disk image info
+ * @param idx Index of the disk image in the set to open
+ * @param fd [out] Handle of the opened file
+ *
+ * @return 1 on error and 0 on success
+ */
+static uint8_t
+raw_open_segment(IMG_RAW_INFO * raw_info, int idx, RAW_FD * fd)
+{
+#ifdef TSK_WIN32
+    *fd = CreateFile(raw_info->img_info.images[idx], FILE_READ_DATA,
+                     FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0,
+                     NULL);
+    if ( *fd == INVALID_HANDLE_VALUE ) {
+        int lastError = (int)GetLastError();
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_OPEN);
+        tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
+                            "\" - %d", raw_info->img_info.images[idx], lastError);
+        return 1;
+    }
+#else
+    if ((*fd =
+            open(raw_info->img_info.images[idx], O_RDONLY | O_BINARY)) < 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_OPEN);
+        tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
+            "\" - %s", raw_info->img_info.images[idx], strerror(errno));
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+
+/* Close a handle that raw_open_segment() opened */
+static void
+raw_close_segment(RAW_FD fd)
+{
+#ifdef TSK_WIN32
+    CloseHandle(fd);
+#else
+    close(fd);
+#endif
+}
+
+
+/**
+ * \internal
+ * Read from an open file of a split set at a given offset.  The read does
+ * not use or change the file position, so several threads can read from
+ * the same handle at once.
+ *
+ * @param raw_info Disk image info
+ * @param idx Index of the disk image in the set that fd is for
+ * @param fd Handle to read from
+ * @param buf [out] Buffer to write data to
+ * @param len Number of bytes to read
+ * @param rel_offset Byte offset in the disk image to read from
+ *
+ * @return -1 on error or number of bytes read
+ */
+static ssize_t
+raw_pread(IMG_RAW_INFO * raw_info, int idx, RAW_FD fd, char *buf,
+    size_t len, TSK_OFF_T rel_offset)
+{
+#ifdef TSK_WIN32
+    OVERLAPPED ov;
+    DWORD nread;
+
+    //For physical drive when the buffer is larger than remaining data,
+    // WinAPI ReadFile call returns -1
+    //in this case buffer of exact length must be passed to ReadFile
+    if ((raw_info->is_winobj) && (rel_offset + (TSK_OFF_T)len > raw_info->img_info.size ))
+        len = (size_t)(raw_info->img_info.size - rel_offset);
+
+    // the offset in the OVERLAPPED struct makes this a positional read,
+    // even though the handle was not opened for overlapped I/O
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD) (rel_offset & 0xffffffff);
+    ov.OffsetHigh = (DWORD) (rel_offset >> 32);
+
+    if (FALSE == ReadFile(fd, buf, (DWORD) len, &nread, &ov)) {
+        int lastError = GetLastError();
+        if (lastError != ERROR_HANDLE_EOF) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_READ);
+            tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
+                "\" offset: %" PRIuOFF " read len: %" PRIuSIZE " - %d",
+                raw_info->img_info.images[idx], rel_offset, len,
+                lastError);
+            return -1;
+        }
+        nread = 0;
+    }
+    // When the read operation reaches the end of a file,
+    // ReadFile returns TRUE and sets nread to zero.
+    // We need to check if we've reached the end of a file and set nread to
+    // the number of bytes read.
+    if ((raw_info->is_winobj) && (nread == 0) && (rel_offset + len == raw_info->img_info.size)) {
+        nread = (DWORD)len;
+    }
+
+    if (raw_info->img_writer != NULL) {
+        /* img_writer is not used with split images, so rel_offset is just the normal offset*/
+        tsk_take_lock(&(raw_info->fd_lock));
+        raw_info->img_writer->add(raw_info->img_writer, rel_offset, buf, nread);
+        tsk_release_lock(&(raw_info->fd_lock));
+    }
+    return (ssize_t) nread;
+#else
+    ssize_t cnt;
+
+    cnt = pread(fd, buf, len, rel_offset);
+    if (cnt < 0) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_READ);
+        tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK "\" offset: %"
+            PRIuOFF " read len: %" PRIuSIZE " - %s", raw_info->img_info.images[idx],
+            rel_offset, len, strerror(errno));
+        return -1;
+    }
+    return cnt;
+#endif
+}
+
+
+/* Remove an entry of the file pool from the LRU list */
+static void
+raw_lru_unlink(IMG_RAW_INFO * raw_info, int slot)
+{
+    IMG_SPLIT_CACHE *cimg = &raw_info->cache[slot];
+
+    if (cimg->lru_prev != -1)
+        raw_info->cache[cimg->lru_prev].lru_next = cimg->lru_next;
+    else
+        raw_info->lru_head = cimg->lru_next;
+
+    if (cimg->lru_next != -1)
+        raw_info->cache[cimg->lru_next].lru_prev = cimg->lru_prev;
+    else
+        raw_info->lru_tail = cimg->lru_prev;
+}
+
+
+/* Add an entry of the file pool to the front of the LRU list */
+static void
+raw_lru_push(IMG_RAW_INFO * raw_info, int slot)
+{
+    IMG_SPLIT_CACHE *cimg = &raw_info->cache[slot];
+
+    cimg->lru_prev = -1;
+    cimg->lru_next = raw_info->lru_head;
+    if (raw_info->lru_head != -1)
+        raw_info->cache[raw_info->lru_head].lru_prev = slot;
+    else
+        raw_info->lru_tail = slot;
+    raw_info->lru_head = slot;
+}
+
+
 /** 
  * \internal
  * Read from one of the multiple files in a split set of disk images.
+ * This can be called by several threads at once.  fd_lock is only held
+ * while a handle is looked up in (or added to) the pool of open files.
+ * When the pool is full, the least recently used file is closed, but a
+ * handle is not closed while a read is using it.
  *
  * @param split_info Disk image info to read from
  * @param idx Index of the disk image in the set to read from
@@ -56,19 +229,51 @@ static ssize_t
 raw_read_segment(IMG_RAW_INFO * raw_info, int idx, char *buf,
     size_t len, TSK_OFF_T rel_offset)
 {
-    IMG_SPLIT_CACHE *cimg;
+    IMG_SPLIT_CACHE *cimg = NULL;
     ssize_t cnt;
+    RAW_FD fd;
+
+    /* Memory-mapped segments are simply copied.  The caller has already
+     * limited len to the end of the segment. */
+    if ((raw_info->seg_map != NULL) && (raw_info->seg_map[idx] != NULL)) {
+        memcpy(buf, &raw_info->seg_map[idx][rel_offset], len);
+        return (ssize_t) len;
+    }
+
+    tsk_take_lock(&(raw_info->fd_lock));
 
     /* Is the image already open? */
     if (raw_info->cptr[idx] == -1) {
-        if (tsk_verbose) {
-            tsk_fprintf(stderr,
-                "raw_read_segment: opening file into slot %d: %" PRIttocTSK
-                "\n", raw_info->next_slot, raw_info->img_info.images[idx]);
+        int slot;
+
+        raw_info->seg_stats[idx].opens++;
+
+        /* Use an entry of the pool that has never been used, or else the
+         * least recently used one that no other read is using */
+        if (raw_info->cache_used < raw_info->cache_size) {
+            slot = raw_info->cache_used++;
         }
+        else {
+            for (slot = raw_info->lru_tail; slot != -1;
+                slot = raw_info->cache[slot].lru_prev) {
+                if (raw_info->cache[slot].in_use == 0)
+                    break;
+            }
 
-        /* Grab the next cache slot */
-        cimg = &raw_info->cache[raw_info->next_slot];
+            /* All of the entries are busy, so this read gets its own handle */
+            if (slot == -1) {
+                tsk_release_lock(&(raw_info->fd_lock));
+                if (raw_open_segment(raw_info, idx, &fd)) {
+                    return -1;
+                }
+                cnt = raw_pread(raw_info, idx, fd, buf, len, rel_offset);
+                raw_close_segment(fd);
+                return cnt;
+            }
+            raw_lru_unlink(raw_info, slot);
+        }
+        cimg = &raw_info->cache[slot];
+        raw_lru_push(raw_info, slot);
 
         /* Free it if being used */
         if (cimg->fd != 0) {
@@ -77,131 +282,76 @@ raw_read_segment(IMG_RAW_INFO * raw_info, int idx, char *buf,
                     "raw_read_segment: closing file %" PRIttocTSK "\n",
                     raw_info->img_info.images[cimg->image]);
             }
-#ifdef TSK_WIN32
-            CloseHandle(cimg->fd);
-#else
-            close(cimg->fd);
-#endif
+            raw_close_segment(cimg->fd);
+            cimg->fd = 0;
             raw_info->cptr[cimg->image] = -1;
+            raw_info->seg_stats[cimg->image].evictions++;
         }
 
-#ifdef TSK_WIN32
-        cimg->fd = CreateFile(raw_info->img_info.images[idx], FILE_READ_DATA,
-                              FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0,
-                              NULL);
-        if ( cimg->fd == INVALID_HANDLE_VALUE ) {
-            int lastError = (int)GetLastError();
-            cimg->fd = 0; /* so we don't close it next time */
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_IMG_OPEN);
-            tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
-                                "\" - %d", raw_info->img_info.images[idx], lastError);
-            return -1;
+        if (tsk_verbose) {
+            tsk_fprintf(stderr,
+                "raw_read_segment: opening file into slot %d: %" PRIttocTSK
+                "\n", slot, raw_info->img_info.images[idx]);
         }
-
-#else
-        if ((cimg->fd =
-                open(raw_info->img_info.images[idx], O_RDONLY | O_BINARY)) < 0) {
+        if (raw_open_segment(raw_info, idx, &cimg->fd)) {
             cimg->fd = 0; /* so we don't close it next time */
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_IMG_OPEN);
-            tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
-                "\" - %s", raw_info->img_info.images[idx], strerror(errno));
+            tsk_release_lock(&(raw_info->fd_lock));
             return -1;
         }
-#endif
         cimg->image = idx;
-        cimg->seek_pos = 0;
-        raw_info->cptr[idx] = raw_info->next_slot;
-        if (++raw_info->next_slot == SPLIT_CACHE) {
-            raw_info->next_slot = 0;
-        }
+        raw_info->cptr[idx] = slot;
     }
     else {
         /* image already open */
-        cimg = &raw_info->cache[raw_info->cptr[idx]];
-    }
+        int slot = raw_info->cptr[idx];
 
-#ifdef TSK_WIN32
-    {
-        DWORD nread;
-        if (cimg->seek_pos != rel_offset) {
-            LARGE_INTEGER li;
-            li.QuadPart = rel_offset;
+        raw_info->seg_stats[idx].hits++;
+        cimg = &raw_info->cache[slot];
+        if (raw_info->lru_head != slot) {
+            raw_lru_unlink(raw_info, slot);
+            raw_lru_push(raw_info, slot);
+        }
+    }
 
-            li.LowPart = SetFilePointer(cimg->fd, li.LowPart,
-                &li.HighPart, FILE_BEGIN);
+    /* keep the handle open while we read from it without the lock */
+    cimg->in_use++;
+    fd = cimg->fd;
+    tsk_release_lock(&(raw_info->fd_lock));
 
-            if ((li.LowPart == INVALID_SET_FILE_POINTER) &&
-                (GetLastError() != NO_ERROR)) {
-                int lastError = (int)GetLastError();
-                tsk_error_reset();
-                tsk_error_set_errno(TSK_ERR_IMG_SEEK);
-                tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
-                    "\" offset %" PRIuOFF " seek - %d",
-                    raw_info->img_info.images[idx], rel_offset,
-                    lastError);
-                return -1;
-            }
-            cimg->seek_pos = rel_offset;
-        }
+    cnt = raw_pread(raw_info, idx, fd, buf, len, rel_offset);
 
-        //For physical drive when the buffer is larger than remaining data,
-        // WinAPI ReadFile call returns -1
-        //in this case buffer of exact length must be passed to ReadFile
-        if ((raw_info->is_winobj) && (rel_offset + (TSK_OFF_T)len > raw_info->img_info.size ))
-            len = (size_t)(raw_info->img_info.size - rel_offset);
+    tsk_take_lock(&(raw_info->fd_lock));
+    cimg->in_use--;
+    tsk_release_lock(&(raw_info->fd_lock));
 
-        if (FALSE == ReadFile(cimg->fd, buf, (DWORD) len, &nread, NULL)) {
-            int lastError = GetLastError();
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_IMG_READ);
-            tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
-                "\" offset: %" PRIuOFF " read len: %" PRIuSIZE " - %d",
-                raw_info->img_info.images[idx], rel_offset, len,
-                lastError);
-            return -1;
-        }
-        // When the read operation reaches the end of a file,
-        // ReadFile returns TRUE and sets nread to zero.
-        // We need to check if we've reached the end of a file and set nread to
-        // the number of bytes read.
-        if ((raw_info->is_winobj) && (nread == 0) && (rel_offset + len == raw_info->img_info.size)) {
-            nread = (DWORD)len;
-        }
-        cnt = (ssize_t) nread;
+    return cnt;
+}
 
-        if (raw_info->img_writer != NULL) {
-            /* img_writer is not used with split images, so rel_offset is just the normal offset*/
-            raw_info->img_writer->add(raw_info->img_writer, rel_offset, buf, cnt);
-        }
-    }
-#else
-    if (cimg->seek_pos != rel_offset) {
-        if (lseek(cimg->fd, rel_offset, SEEK_SET) != rel_offset) {
-            tsk_error_reset();
-            tsk_error_set_errno(TSK_ERR_IMG_SEEK);
-            tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK
-                "\" offset %" PRIuOFF " seek - %s", raw_info->img_info.images[idx],
-                rel_offset, strerror(errno));
-            return -1;
-        }
-        cimg->seek_pos = rel_offset;
-    }
 
-    cnt = read(cimg->fd, buf, len);
-    if (cnt < 0) {
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_READ);
-        tsk_error_set_errstr("raw_read: file \"%" PRIttocTSK "\" offset: %"
-            PRIuOFF " read len: %" PRIuSIZE " - %s", raw_info->img_info.images[idx],
-            rel_offset, len, strerror(errno));
-        return -1;
+/**
+ * \internal
+ * Find the segment that contains an offset with a binary search over the
+ * end offsets of the segments.
+ *
+ * @param raw_info Disk image info
+ * @param offset Byte offset in the image
+ *
+ * @return index of the segment, or num_img if the offset is past the end
+ */
+static int
+raw_find_segment(IMG_RAW_INFO * raw_info, TSK_OFF_T offset)
+{
+    int lo = 0;
+    int hi = raw_info->img_info.num_img;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (offset < raw_info->max_off[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
     }
-#endif
-    cimg->seek_pos += cnt;
-
-    return cnt;
+    return lo;
 }
 
 
@@ -210,7 +360,7 @@ raw_read_segment(IMG_RAW_INFO * raw_info, int idx, char *buf,
  * Read data from a (potentially split) raw disk image.  The offset to
  * start reading from is equal to the volume offset plus the read offset.
  *
- * Note: The routine -assumes- we are under a lock on &(img_info->cache_lock))
+ * This does not need cache_lock.  The table of open files has its own lock.
  *
  * @param img_info Disk image to read from
  * @param offset Byte offset in image to start reading from
@@ -240,83 +390,80 @@ raw_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf, size_t len)
     }
 
     // Find the location of the offset
-    for (i = 0; i < raw_info->img_info.num_img; i++) {
-
-        /* Does the data start in this image? */
-        if (offset < raw_info->max_off[i]) {
-            TSK_OFF_T rel_offset;
-            size_t read_len;
-            ssize_t cnt;
-
-            /* Get the offset relative to this image segment */
-            if (i > 0) {
-                rel_offset = offset - raw_info->max_off[i - 1];
-            }
-            else {
-                rel_offset = offset;
-            }
-
-            /* Get the length to read */
-            // NOTE: max_off - offset can be a very large number.  Do not cast to size_t
-            if (raw_info->max_off[i] - offset >= (TSK_OFF_T)len)
-                read_len = len;
-            else
-                read_len = (size_t) (raw_info->max_off[i] - offset);
+    i = raw_find_segment(raw_info, offset);
+    if (i < raw_info->img_info.num_img) {
+        TSK_OFF_T rel_offset;
+        size_t read_len;
+        ssize_t cnt;
+
+        /* Get the offset relative to this image segment */
+        if (i > 0) {
+            rel_offset = offset - raw_info->max_off[i - 1];
+        }
+        else {
+            rel_offset = offset;
+        }
 
+        /* Get the length to read */
+        // NOTE: max_off - offset can be a very large number.  Do not cast to size_t
+        if (raw_info->max_off[i] - offset >= (TSK_OFF_T)len)
+            read_len = len;
+        else
+            read_len = (size_t) (raw_info->max_off[i] - offset);
 
-            if (tsk_verbose) {
-                tsk_fprintf(stderr,
-                    "raw_read: found in image %d relative offset: %"
-                    PRIuOFF " len: %" PRIuOFF "\n", i, rel_offset,
-                    (TSK_OFF_T) read_len);
-            }
 
-            cnt = raw_read_segment(raw_info, i, buf, read_len, rel_offset);
-            if (cnt < 0) {
-                return -1;
-            }
-            if ((size_t) cnt != read_len) {
-                return cnt;
-            }
+        if (tsk_verbose) {
+            tsk_fprintf(stderr,
+                "raw_read: found in image %d relative offset: %"
+                PRIuOFF " len: %" PRIuOFF "\n", i, rel_offset,
+                (TSK_OFF_T) read_len);
+        }
 
-            /* read from the next image segment(s) if needed */
-            if (((size_t) cnt == read_len) && (read_len != len)) {
+        cnt = raw_read_segment(raw_info, i, buf, read_len, rel_offset);
+        if (cnt < 0) {
+            return -1;
+        }
+        if ((size_t) cnt != read_len) {
+            return cnt;
+        }
 
-                len -= read_len;
+        /* read from the next image segment(s) if needed */
+        if (((size_t) cnt == read_len) && (read_len != len)) {
 
-                /* go to the next image segment */
-                while ((len > 0) && (i+1 < raw_info->img_info.num_img)) {
-                    ssize_t cnt2;
-                    
-                    i++;
+            len -= read_len;
 
-                    if ((raw_info->max_off[i] - raw_info->max_off[i - 1]) >= (TSK_OFF_T)len)
-                        read_len = len;
-                    else
-                        read_len = (size_t) (raw_info->max_off[i] - raw_info->max_off[i - 1]);
+            /* go to the next image segment */
+            while ((len > 0) && (i+1 < raw_info->img_info.num_img)) {
+                ssize_t cnt2;
+                
+                i++;
 
-                    if (tsk_verbose) {
-                        tsk_fprintf(stderr,
-                            "raw_read: additional image reads: image %d len: %"
-                            PRIuOFF "\n", i, read_len);
-                    }
+                if ((raw_info->max_off[i] - raw_info->max_off[i - 1]) >= (TSK_OFF_T)len)
+                    read_len = len;
+                else
+                    read_len = (size_t) (raw_info->max_off[i] - raw_info->max_off[i - 1]);
 
-                    cnt2 = raw_read_segment(raw_info, i, &buf[cnt],
-                        read_len, 0);
-                    if (cnt2 < 0) {
-                        return -1;
-                    }
-                    cnt += cnt2;
+                if (tsk_verbose) {
+                    tsk_fprintf(stderr,
+                        "raw_read: additional image reads: image %d len: %"
+                        PRIuOFF "\n", i, read_len);
+                }
 
-                    if ((size_t) cnt2 != read_len) {
-                        return cnt;
-                    }
+                cnt2 = raw_read_segment(raw_info, i, &buf[cnt],
+                    read_len, 0);
+                if (cnt2 < 0) {
+                    return -1;
+                }
+                cnt += cnt2;
 
-                    len -= cnt2;
+                if ((size_t) cnt2 != read_len) {
+                    return cnt;
                 }
+
+                len -= cnt2;
             }
-            return cnt;
         }
+        return cnt;
     }
 
     tsk_error_reset();
@@ -328,6 +475,150 @@ raw_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf, size_t len)
 }
 
 
+/**
+ * \internal
+ * Return a pointer to data in a memory-mapped image.  The data must be
+ * in a single segment.  The mapping does not change after it is made, so
+ * this does not need cache_lock.
+ *
+ * @param img_info Disk image to read from
+ * @param offset Byte offset in image to start reading from
+ * @param len Number of bytes that will be read
+ *
+ * @return pointer to the data or NULL if it is not in a single mapped segment
+ */
+static const char *
+raw_read_ptr(TSK_IMG_INFO * img_info, TSK_OFF_T offset, size_t len)
+{
+    IMG_RAW_INFO *raw_info = (IMG_RAW_INFO *) img_info;
+    int i = raw_find_segment(raw_info, offset);
+
+    if ((i >= raw_info->img_info.num_img) || (raw_info->seg_map[i] == NULL)
+        || (raw_info->max_off[i] - offset < (TSK_OFF_T) len))
+        return NULL;
+
+    if (i > 0)
+        offset -= raw_info->max_off[i - 1];
+    return &raw_info->seg_map[i][offset];
+}
+
+
+/* Unmap the segments of an image that raw_map() mapped */
+static void
+raw_unmap(IMG_RAW_INFO * raw_info)
+{
+#ifndef TSK_WIN32
+    TSK_OFF_T seg_start = 0;
+    int i;
+
+    if (raw_info->seg_map == NULL)
+        return;
+
+    for (i = 0; i < raw_info->img_info.num_img; i++) {
+        if (raw_info->seg_map[i] != NULL)
+            munmap(raw_info->seg_map[i],
+                (size_t) (raw_info->max_off[i] - seg_start));
+        seg_start = raw_info->max_off[i];
+    }
+    free(raw_info->seg_map);
+    raw_info->seg_map = NULL;
+    raw_info->img_info.read_ptr = NULL;
+#endif
+}
+
+
+/**
+ * \internal
+ * Memory-map all of the segments of a raw image so that reads are copies
+ * from the mapping and tsk_img_read_ptr() can return pointers into it.
+ * The files must not shrink while they are mapped, because accessing a
+ * page that is no longer backed by the file raises SIGBUS.  Devices
+ * and segments that do not fit in the address space can not be mapped.
+ *
+ * @param a_img_info Raw disk image to map
+ *
+ * @return 1 on error (and the image is left unmapped) and 0 on success
+ */
+uint8_t
+raw_map(TSK_IMG_INFO * a_img_info)
+{
+    IMG_RAW_INFO *raw_info = (IMG_RAW_INFO *) a_img_info;
+#ifdef TSK_WIN32
+    tsk_error_reset();
+    tsk_error_set_errno(TSK_ERR_IMG_ARG);
+    tsk_error_set_errstr
+        ("raw_map: memory-mapped images are not supported on this platform");
+    return 1;
+#else
+    TSK_OFF_T seg_start = 0;
+    int i;
+
+    if (raw_info->is_winobj) {
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_ARG);
+        tsk_error_set_errstr("raw_map: device objects can not be mapped");
+        return 1;
+    }
+
+    if ((raw_info->seg_map =
+            (char **) tsk_malloc(raw_info->img_info.num_img *
+                sizeof(char *))) == NULL)
+        return 1;
+
+    for (i = 0; i < raw_info->img_info.num_img; i++) {
+        TSK_OFF_T seg_len = raw_info->max_off[i] - seg_start;
+        void *ptr;
+        int fd;
+
+        seg_start = raw_info->max_off[i];
+        if (seg_len == 0)
+            continue;
+
+        if ((TSK_OFF_T) (size_t) seg_len != seg_len) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_ARG);
+            tsk_error_set_errstr("raw_map: file \"%" PRIttocTSK
+                "\" is too large to map", raw_info->img_info.images[i]);
+            raw_unmap(raw_info);
+            return 1;
+        }
+
+        if ((fd =
+                open(raw_info->img_info.images[i], O_RDONLY | O_BINARY)) < 0) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_OPEN);
+            tsk_error_set_errstr("raw_map: file \"%" PRIttocTSK "\" - %s",
+                raw_info->img_info.images[i], strerror(errno));
+            raw_unmap(raw_info);
+            return 1;
+        }
+
+        ptr = mmap(NULL, (size_t) seg_len, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            tsk_error_reset();
+            tsk_error_set_errno(TSK_ERR_IMG_READ);
+            tsk_error_set_errstr("raw_map: file \"%" PRIttocTSK
+                "\" mmap - %s", raw_info->img_info.images[i],
+                strerror(errno));
+            raw_unmap(raw_info);
+            return 1;
+        }
+        raw_info->seg_map[i] = (char *) ptr;
+
+        if (tsk_verbose) {
+            tsk_fprintf(stderr,
+                "raw_map: segment: %d  size: %" PRIuOFF "  mapped\n", i,
+                seg_len);
+        }
+    }
+
+    a_img_info->read_ptr = raw_read_ptr;
+    return 0;
+#endif
+}
+
+
 /** 
  * \internal
  * Display information about the disk image set.
@@ -345,6 +636,8 @@ raw_imgstat(TSK_IMG_INFO * img_info, FILE * hFile)
     tsk_fprintf(hFile, "Image Type: raw\n");
     tsk_fprintf(hFile, "\nSize in bytes: %" PRIuOFF "\n", img_info->size);
     tsk_fprintf(hFile, "Sector size:\t%d\n", img_info->sector_size);
+    if (raw_info->seg_map != NULL)
+        tsk_fprintf(hFile, "Access: memory-mapped\n");
 
     if (raw_info->img_info.num_img > 1) {
         int i;
@@ -362,6 +655,27 @@ raw_imgstat(TSK_IMG_INFO * img_info, FILE * hFile)
         }
     }
 
+    /* Show how well the pool of open files worked.  The counts are 0 when
+     * nothing was read yet, as with img_stat, but are still shown so that
+     * the table is always there for split images. */
+    if ((raw_info->seg_map == NULL) && (raw_info->img_info.num_img > 1)) {
+        int i;
+
+        tsk_fprintf(hFile, "\n--------------------------------------------\n");
+        tsk_fprintf(hFile, "Open File Statistics:\n");
+        tsk_fprintf(hFile, "Files kept open: %d\n", raw_info->cache_size);
+
+        tsk_take_lock(&(raw_info->fd_lock));
+        for (i = 0; i < raw_info->img_info.num_img; i++) {
+            tsk_fprintf(hFile,
+                "%" PRIttocTSK "  opens: %" PRIu64 "  hits: %" PRIu64
+                "  evictions: %" PRIu64 "\n", raw_info->img_info.images[i],
+                raw_info->seg_stats[i].opens, raw_info->seg_stats[i].hits,
+                raw_info->seg_stats[i].evictions);
+        }
+        tsk_release_lock(&(raw_info->fd_lock));
+    }
+
     return;
 }
 
@@ -386,13 +700,10 @@ raw_close(TSK_IMG_INFO * img_info)
     }
 #endif
 
-    for (i = 0; i < SPLIT_CACHE; i++) {
+    raw_unmap(raw_info);
+    for (i = 0; i < raw_info->cache_used; i++) {
         if (raw_info->cache[i].fd != 0)
-#ifdef TSK_WIN32
-            CloseHandle(raw_info->cache[i].fd);
-#else
-            close(raw_info->cache[i].fd);
-#endif
+            raw_close_segment(raw_info->cache[i].fd);
     }
     for (i = 0; i < raw_info->img_info.num_img; i++) {
         free(raw_info->img_info.images[i]);
@@ -400,6 +711,9 @@ raw_close(TSK_IMG_INFO * img_info)
     free(raw_info->max_off);
     free(raw_info->img_info.images);
     free(raw_info->cptr);
+    free(raw_info->seg_stats);
+    free(raw_info->cache);
+    tsk_deinit_lock(&(raw_info->fd_lock));
 
     tsk_img_free(raw_info);
 }
@@ -574,6 +888,49 @@ get_size(const TSK_TCHAR * a_file, uint8_t a_is_winobj)
 }
 
 
+/**
+ * \internal
+ * Decide how many segment files to keep open at once.  Unless the options
+ * give a number, this is a quarter of the process's open file limit, so
+ * that the rest of the process still has descriptors to use.
+ *
+ * @param a_opts Options the image is opened with
+ * @param a_num_img Number of images in set
+ *
+ * @return the size of the pool of open files
+ */
+static int
+raw_max_open(const TSK_IMG_OPTIONS * a_opts, int a_num_img)
+{
+    int max_open = SPLIT_CACHE_MAX;
+
+    if (a_opts->max_open_files > 0) {
+        if (a_opts->max_open_files < (unsigned int) a_num_img)
+            max_open = (int) a_opts->max_open_files;
+        else
+            max_open = a_num_img;
+        return max_open;
+    }
+
+#if defined(HAVE_SYS_RESOURCE_H) && !defined(TSK_WIN32)
+    {
+        struct rlimit rl;
+
+        if ((getrlimit(RLIMIT_NOFILE, &rl) == 0)
+            && (rl.rlim_cur != RLIM_INFINITY)
+            && (rl.rlim_cur / 4 < SPLIT_CACHE_MAX)) {
+            max_open = (int) (rl.rlim_cur / 4);
+        }
+    }
+#endif
+    if (max_open < SPLIT_CACHE_MIN)
+        max_open = SPLIT_CACHE_MIN;
+    if (max_open > a_num_img)
+        max_open = a_num_img;
+    return max_open;
+}
+
+
 /** 
  * \internal
  * Open the set of disk images as a set of split raw images
@@ -581,12 +938,13 @@ get_size(const TSK_TCHAR * a_file, uint8_t a_is_winobj)
  * @param a_num_img Number of images in set
  * @param a_images List of disk image paths (in sorted order)
  * @param a_ssize Size of device sector in bytes (or 0 for default)
+ * @param a_opts Options to open the image with
  *
  * @return NULL on error
  */
 TSK_IMG_INFO *
 raw_open(int a_num_img, const TSK_TCHAR * const a_images[],
-    unsigned int a_ssize)
+    unsigned int a_ssize, const TSK_IMG_OPTIONS * a_opts)
 {
     IMG_RAW_INFO *raw_info;
     TSK_IMG_INFO *img_info;
@@ -692,9 +1050,6 @@ raw_open(int a_num_img, const TSK_TCHAR * const a_images[],
         tsk_img_free(raw_info);
         return NULL;
     }
-    memset((void *) &raw_info->cache, 0,
-        SPLIT_CACHE * sizeof(IMG_SPLIT_CACHE));
-    raw_info->next_slot = 0;
 
     /* initialize the offset table and re-use the first segment
      * size gathered above */
@@ -754,6 +1109,37 @@ raw_open(int a_num_img, const TSK_TCHAR * const a_images[],
         }
     }
 
+    /* set up the pool of open files and the per-file statistics */
+    raw_info->cache_size = raw_max_open(a_opts, raw_info->img_info.num_img);
+    raw_info->cache_used = 0;
+    raw_info->lru_head = -1;
+    raw_info->lru_tail = -1;
+    raw_info->cache = (IMG_SPLIT_CACHE *) tsk_malloc(raw_info->cache_size *
+        sizeof(IMG_SPLIT_CACHE));
+    raw_info->seg_stats = (IMG_SPLIT_STATS *)
+        tsk_malloc(raw_info->img_info.num_img * sizeof(IMG_SPLIT_STATS));
+    if ((raw_info->cache == NULL) || (raw_info->seg_stats == NULL)) {
+        free(raw_info->cache);
+        free(raw_info->seg_stats);
+        free(raw_info->cptr);
+        free(raw_info->max_off);
+        for (i = 0; i < raw_info->img_info.num_img; i++) {
+            free(raw_info->img_info.images[i]);
+        }
+        free(raw_info->img_info.images);
+        tsk_img_free(raw_info);
+        return NULL;
+    }
+    if (tsk_verbose) {
+        tsk_fprintf(stderr,
+            "raw_open: keeping up to %d segment files open\n",
+            raw_info->cache_size);
+    }
+
+    /* reads only share the pool of open files, which has its own lock */
+    tsk_init_lock(&(raw_info->fd_lock));
+    img_info->read_unlocked = 1;
+
     return img_info;
 }
 
@@ -772,13 +1158,16 @@ tsk_img_malloc(size_t a_len)
 }
 
 
-/* tsk_img_free - unset image tag, then free memory
+/* tsk_img_free - unset image tag, stop the prefetch worker, free the read
+ * cache, then free memory
  * This is for img module and all its inheritances
  */
 void
 tsk_img_free(void *a_ptr)
 {
     TSK_IMG_INFO *imgInfo = (TSK_IMG_INFO *) a_ptr;
+    tsk_img_prefetch_free(imgInfo);
+    tsk_img_cache_free(imgInfo);
     imgInfo->tag = 0;
     free(imgInfo);
 }
@@ -21,30 +21,52 @@ extern "C" {
 #endif
 
     extern TSK_IMG_INFO *raw_open(int a_num_img,
-        const TSK_TCHAR * const a_images[], unsigned int a_ssize);
+        const TSK_TCHAR * const a_images[], unsigned int a_ssize,
+        const TSK_IMG_OPTIONS * a_opts);
+    extern uint8_t raw_map(TSK_IMG_INFO * a_img_info);
 
-#define SPLIT_CACHE	15
+/* Bounds on the number of segment files that are kept open at once when
+ * the size is based on the process's open file limit */
+#define SPLIT_CACHE_MIN	15
+#define SPLIT_CACHE_MAX	4096
 
-    typedef struct {
 #ifdef TSK_WIN32
-        HANDLE fd;
+    typedef HANDLE RAW_FD;
 #else
-        int fd;
+    typedef int RAW_FD;
 #endif
+
+    typedef struct {
+        RAW_FD fd;
         int image;
-        TSK_OFF_T seek_pos;
+        int in_use;             /* number of reads that are using fd */
+        int lru_prev;           /* more recently used entry (-1 if none) */
+        int lru_next;           /* less recently used entry (-1 if none) */
     } IMG_SPLIT_CACHE;
 
+    typedef struct {
+        uint64_t opens;         /* number of times the file was opened */
+        uint64_t hits;          /* number of reads that found the file open */
+        uint64_t evictions;     /* number of times the file was closed to make room for another */
+    } IMG_SPLIT_STATS;
+
     typedef struct {
         TSK_IMG_INFO img_info;
         uint8_t is_winobj;
         TSK_IMG_WRITER *img_writer;
+        char **seg_map;         /* read-only mapping of each segment (NULL if the image is not mapped) */
 
-        // the following are protected by cache_lock in IMG_INFO
         TSK_OFF_T *max_off;
+
+        // the following are protected by fd_lock
+        tsk_lock_t fd_lock;
         int *cptr;              /* exists for each image - points to entry in cache */
-        IMG_SPLIT_CACHE cache[SPLIT_CACHE];     /* small number of fds for open images */
-        int next_slot;
+        IMG_SPLIT_STATS *seg_stats;     /* exists for each image */
+        IMG_SPLIT_CACHE *cache; /* pool of fds for open images */
+        int cache_size;         /* number of entries in cache */
+        int cache_used;         /* number of entries in cache that have been used */
+        int lru_head;           /* most recently used entry in cache (-1 if none) */
+        int lru_tail;           /* least recently used entry in cache (-1 if none) */
     } IMG_RAW_INFO;
 
 #ifdef __cplusplus
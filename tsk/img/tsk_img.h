@@ -72,10 +72,14 @@ extern "C" {
         TSK_IMG_TYPE_UNSUPP = 0xffff   ///< Unsupported disk image type
     } TSK_IMG_TYPE_ENUM;
 
-#define TSK_IMG_INFO_CACHE_NUM  32
-#define TSK_IMG_INFO_CACHE_LEN  65536
+#define TSK_IMG_INFO_CACHE_NUM  32     ///< Default number of lines in the read cache
+#define TSK_IMG_INFO_CACHE_LEN  65536  ///< Default size in bytes of each read cache line
+#define TSK_IMG_INFO_READAHEAD_MAX  (4 * 1024 * 1024)   ///< Default largest sequential read-ahead in bytes
 
     typedef struct TSK_IMG_INFO TSK_IMG_INFO;
+    typedef struct TSK_IMG_CACHE TSK_IMG_CACHE;
+    typedef struct TSK_IMG_PREFETCH TSK_IMG_PREFETCH;
+    typedef struct TSK_IMG_IOSTATS TSK_IMG_IOSTATS;
 #define TSK_IMG_INFO_TAG 0x39204231
 
     /**
@@ -89,27 +93,90 @@ extern "C" {
         unsigned int sector_size;       ///< sector size of device in bytes (typically 512)
         unsigned int page_size;         ///< page size of NAND page in bytes (defaults to 2048)
         unsigned int spare_size;        ///< spare or OOB size of NAND in bytes (defaults to 64)
+        unsigned int chunk_size;        ///< \internal Size of the units that the format compresses data in (0 if none)
 
         // the following are protected by cache_lock in IMG_INFO
         TSK_TCHAR **images;    ///< Image names
 
-        tsk_lock_t cache_lock;  ///< Lock for cache and associated values
-        char cache[TSK_IMG_INFO_CACHE_NUM][TSK_IMG_INFO_CACHE_LEN];     ///< read cache (r/w shared - lock) 
-        TSK_OFF_T cache_off[TSK_IMG_INFO_CACHE_NUM];    ///< starting byte offset of corresponding cache entry (r/w shared - lock) 
-        int cache_age[TSK_IMG_INFO_CACHE_NUM];  ///< "Age" of corresponding cache entry, higher means more recently used (r/w shared - lock) 
-        size_t cache_len[TSK_IMG_INFO_CACHE_NUM];       ///< Length of cache entry used (0 if never used) (r/w shared - lock) 
+        tsk_lock_t cache_lock;  ///< Lock for calls to read and the values they share in the format-specific structs
+        uint8_t read_unlocked;  ///< \internal 1 if the format's read can be called by several threads without cache_lock
+        TSK_IMG_CACHE *cache;   ///< \internal Sharded read cache (has its own locks, NULL if not used)
+        TSK_IMG_PREFETCH *prefetch;     ///< \internal Background prefetch worker (NULL if not used)
+        TSK_IMG_IOSTATS *iostats;       ///< \internal I/O counters and trace (NULL if tsk_img_stats_start() was not called)
 
         ssize_t(*read) (TSK_IMG_INFO * img, TSK_OFF_T off, char *buf, size_t len);     ///< \internal External progs should call tsk_img_read()
+        const char *(*read_ptr) (TSK_IMG_INFO * img, TSK_OFF_T off, size_t len);       ///< \internal External progs should call tsk_img_read_ptr() (NULL if not supported)
         void (*close) (TSK_IMG_INFO *); ///< \internal Progs should call tsk_img_close()
         void (*imgstat) (TSK_IMG_INFO *, FILE *);       ///< Pointer to file type specific function
     };
 
+    /**
+     * Options that can be given to tsk_img_open_ex().  Use
+     * tsk_img_options_init() to set the defaults before changing
+     * individual values.
+     */
+    typedef struct {
+        unsigned int cache_num; ///< Number of lines in the read cache (0 to disable the cache)
+        size_t cache_len;       ///< Size of each read cache line in bytes (multiple of 512)
+        size_t readahead_max;   ///< Largest read-ahead for sequential reads in bytes (0 to disable read-ahead)
+        uint8_t prefetch;       ///< 1 to start a background thread that loads the ranges given to tsk_img_prefetch()
+        uint8_t mmap;           ///< 1 to memory-map raw image files instead of reading them (if the platform allows it)
+        unsigned int max_open_files;    ///< Most raw image segment files to keep open at once (0 to base it on the process's open file limit)
+        unsigned int decode_threads;    ///< Number of threads that decompress the pieces of large E01 and VMDK reads in parallel (0 to not use any)
+        uint8_t stats;          ///< 1 to start counting the reads (see tsk_img_get_stats()) while the image is opened, before any read or worker thread can use it
+    } TSK_IMG_OPTIONS;
+
+    /**
+     * A range of bytes in a disk image.
+     */
+    typedef struct {
+        TSK_OFF_T off;          ///< Byte offset of the start of the range
+        size_t len;             ///< Length of the range in bytes
+    } TSK_IMG_RANGE;
+
+    /**
+     * One of the ranges of a vectored read (see tsk_img_readv()).
+     */
+    typedef struct {
+        TSK_OFF_T off;          ///< Byte offset to start reading from
+        char *buf;              ///< Buffer to read into
+        size_t len;             ///< Number of bytes to read into buf
+        ssize_t cnt;            ///< [out] Number of bytes read (less than len at the end of the image) or -1 on error
+    } TSK_IMG_IOVEC;
+
+#define TSK_IMG_STATS_HIST_NUM  48      ///< Number of entries in the histograms of TSK_IMG_STATS
+
+    /**
+     * I/O counters of an open disk image, returned by tsk_img_get_stats().
+     * Entry 0 of a histogram counts values of 0 and entry n counts values
+     * from 2^(n-1) up to 2^n - 1 (the last entry also counts larger values).
+     */
+    typedef struct {
+        uint64_t reads;         ///< Number of calls to tsk_img_read()
+        uint64_t read_bytes;    ///< Number of bytes asked for by those calls
+        uint64_t cache_hits;    ///< Number of cache lines that were found in the read cache
+        uint64_t cache_misses;  ///< Number of cache lines that had to be loaded
+        uint64_t backend_reads; ///< Number of calls to the format-specific read function
+        uint64_t backend_bytes; ///< Number of bytes returned by those calls
+        uint64_t backend_usec;  ///< Time spent in those calls in microseconds
+        uint64_t read_size_hist[TSK_IMG_STATS_HIST_NUM];        ///< Sizes in bytes of the calls to tsk_img_read()
+        uint64_t seek_dist_hist[TSK_IMG_STATS_HIST_NUM];        ///< Distance in bytes from the end of each backend read to the start of the next
+    } TSK_IMG_STATS;
+
+#define TSK_IMG_TRACE_MAGIC "TSKTRC01"  ///< First 8 bytes of a trace file made by tsk_img_stats_start()
+
     // open and close functions
+    extern void tsk_img_options_init(TSK_IMG_OPTIONS * a_opts);
+    extern uint8_t tsk_img_parse_cache_opt(const TSK_TCHAR * a_str,
+        TSK_IMG_OPTIONS * a_opts);
     extern TSK_IMG_INFO *tsk_img_open_sing(const TSK_TCHAR * a_image,
         TSK_IMG_TYPE_ENUM type, unsigned int a_ssize);
     extern TSK_IMG_INFO *tsk_img_open(int,
         const TSK_TCHAR * const images[], TSK_IMG_TYPE_ENUM,
         unsigned int a_ssize);
+    extern TSK_IMG_INFO *tsk_img_open_ex(int,
+        const TSK_TCHAR * const images[], TSK_IMG_TYPE_ENUM,
+        unsigned int a_ssize, const TSK_IMG_OPTIONS * a_opts);
     extern TSK_IMG_INFO *tsk_img_open_utf8_sing(const char *a_image,
         TSK_IMG_TYPE_ENUM type, unsigned int a_ssize);
     extern TSK_IMG_INFO *tsk_img_open_utf8(int num_img,
@@ -125,6 +192,20 @@ extern "C" {
     // read functions
     extern ssize_t tsk_img_read(TSK_IMG_INFO * img, TSK_OFF_T off,
         char *buf, size_t len);
+    extern const char *tsk_img_read_ptr(TSK_IMG_INFO * img, TSK_OFF_T off,
+        size_t len);
+    extern ssize_t tsk_img_readv(TSK_IMG_INFO * img, TSK_IMG_IOVEC * vecs,
+        size_t num_vecs);
+    extern uint64_t tsk_img_prefetch(TSK_IMG_INFO * img,
+        const TSK_IMG_RANGE * ranges, size_t num_ranges);
+    extern void tsk_img_prefetch_cancel(TSK_IMG_INFO * img, uint64_t id);
+
+    // I/O statistics
+    extern uint8_t tsk_img_stats_start(TSK_IMG_INFO * img,
+        const TSK_TCHAR * trace_file);
+    extern uint8_t tsk_img_get_stats(TSK_IMG_INFO * img,
+        TSK_IMG_STATS * stats);
+    extern void tsk_img_stats_print(TSK_IMG_INFO * img, FILE * hFile);
 
     // type conversion functions
     extern TSK_IMG_TYPE_ENUM tsk_img_type_toid_utf8(const char *);
@@ -163,7 +244,7 @@ extern "C" {
         if (m_imgInfo == NULL) {
             return;
         }
-        m_imgInfo->close(m_imgInfo);
+        tsk_img_close(m_imgInfo);
     };
 
     TskImgInfo(TSK_IMG_INFO * a_imgInfo) {
@@ -284,6 +365,39 @@ extern "C" {
         return tsk_img_read(m_imgInfo, a_off, a_buf, a_len);
     };
 
+    /**
+    * Reads several ranges of an open disk image.  See tsk_img_readv() for details.
+    *
+    * @param a_vecs Ranges to read (their cnt values are set)
+    * @param a_num_vecs Number of entries in a_vecs
+    * @returns total number of bytes read or -1 on error
+    */
+    ssize_t readv(TSK_IMG_IOVEC * a_vecs, size_t a_num_vecs) {
+        return tsk_img_readv(m_imgInfo, a_vecs, a_num_vecs);
+    };
+
+    /**
+    * Returns a read-only pointer to data in a memory-mapped disk image.
+    * See tsk_img_read_ptr() for details.
+    *
+    * @param a_off Byte offset to start reading from
+    * @param a_len Number of bytes that will be read
+    * @returns pointer to the data or NULL if it can not be accessed in place
+    */
+    const char *readPtr(TSK_OFF_T a_off, size_t a_len) {
+        return tsk_img_read_ptr(m_imgInfo, a_off, a_len);
+    };
+
+    /**
+    * Gets the I/O counters of the image.  See tsk_img_get_stats() for details.
+    *
+    * @param a_stats [out] Counters since tsk_img_stats_start() was called
+    * @returns 1 on error and 0 on success
+    */
+    uint8_t getStats(TSK_IMG_STATS * a_stats) const {
+        return tsk_img_get_stats(m_imgInfo, a_stats);
+    };
+
 
    /**
     * returns the image format type.
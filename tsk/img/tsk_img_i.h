@@ -40,6 +40,49 @@ extern void tsk_img_free(void *);
 extern TSK_TCHAR **tsk_img_findFiles(const TSK_TCHAR * a_startingName,
     int *a_numFound);
 
+extern ssize_t tsk_img_read_no_cache(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, char *a_buf, size_t a_len);
+extern ssize_t tsk_img_read_backend(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, char *a_buf, size_t a_len);
+extern ssize_t tsk_img_read_direct(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, char *a_buf, size_t a_len);
+
+// read cache (img_cache.c)
+extern uint8_t tsk_img_cache_init(TSK_IMG_INFO * a_img_info,
+    const TSK_IMG_OPTIONS * a_opts);
+extern void tsk_img_cache_free(TSK_IMG_INFO * a_img_info);
+extern ssize_t tsk_img_cache_read(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, char *a_buf, size_t a_len);
+extern void tsk_img_cache_fill(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, size_t a_len);
+extern size_t tsk_img_cache_size(TSK_IMG_INFO * a_img_info);
+
+// background prefetch (img_prefetch.c)
+extern uint8_t tsk_img_prefetch_init(TSK_IMG_INFO * a_img_info);
+extern void tsk_img_prefetch_free(TSK_IMG_INFO * a_img_info);
+extern void tsk_img_prefetch_note_read(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, size_t a_len);
+
+// I/O statistics (img_stats.c)
+extern uint64_t tsk_img_stats_time();
+extern void tsk_img_stats_note_read(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, size_t a_len);
+extern void tsk_img_stats_note_cache(TSK_IMG_INFO * a_img_info,
+    uint8_t a_hit);
+extern void tsk_img_stats_note_backend(TSK_IMG_INFO * a_img_info,
+    TSK_OFF_T a_off, size_t a_len, ssize_t a_cnt, uint64_t a_usec);
+extern void tsk_img_stats_free(TSK_IMG_INFO * a_img_info);
+
+// parallel reads of compressed formats (img_workers.c)
+typedef struct TSK_IMG_WORKERS TSK_IMG_WORKERS;
+typedef ssize_t(*TSK_IMG_WORKER_READ) (TSK_IMG_INFO * a_img_info,
+    int a_worker, TSK_OFF_T a_off, char *a_buf, size_t a_len);
+extern TSK_IMG_WORKERS *tsk_img_workers_create(TSK_IMG_INFO * a_img_info,
+    int a_num_threads, TSK_IMG_WORKER_READ a_read);
+extern void tsk_img_workers_free(TSK_IMG_WORKERS * a_workers);
+extern ssize_t tsk_img_workers_read(TSK_IMG_WORKERS * a_workers,
+    TSK_OFF_T a_off, char *a_buf, size_t a_len, size_t a_piece_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,13 +37,58 @@ getError(libvmdk_error_t * vmdk_error,
 } 
 
 
+/**
+ * \internal
+ * Read data from libvmdk.  read_lock must be held when the main handle of
+ * the image is used.
+ * @returns -1 on error or number of bytes read
+ */
 static ssize_t
-vmdk_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
+vmdk_read_handle(libvmdk_handle_t * handle, TSK_OFF_T offset, char *buf,
     size_t len)
 {
     char error_string[TSK_VMDK_ERROR_STRING_SIZE];
     libvmdk_error_t *vmdk_error = NULL;
+    ssize_t cnt;
+
+    cnt = libvmdk_handle_read_buffer_at_offset(handle,
+        buf, len, offset, &vmdk_error);
+    if (cnt < 0) {
+        char *errmsg = NULL;
+        tsk_error_reset();
+        tsk_error_set_errno(TSK_ERR_IMG_READ);
+        if (getError(vmdk_error, error_string))
+            errmsg = strerror(errno);
+        else
+            errmsg = error_string;
+
+        tsk_error_set_errstr("vmdk_image_read - offset: %" PRIuOFF
+            " - len: %" PRIuSIZE " - %s", offset, len, errmsg);
+        return -1;
+    }
+    return cnt;
+}
+
 
+/**
+ * \internal
+ * Read data with the handle of a decode worker.
+ * @returns -1 on error or number of bytes read
+ */
+static ssize_t
+vmdk_worker_read(TSK_IMG_INFO * img_info, int a_worker, TSK_OFF_T offset,
+    char *buf, size_t len)
+{
+    IMG_VMDK_INFO *vmdk_info = (IMG_VMDK_INFO *) img_info;
+    return vmdk_read_handle(vmdk_info->worker_handles[a_worker], offset,
+        buf, len);
+}
+
+
+static ssize_t
+vmdk_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
+    size_t len)
+{
     ssize_t cnt;
     IMG_VMDK_INFO *vmdk_info = (IMG_VMDK_INFO *) img_info;
 
@@ -61,21 +106,15 @@ vmdk_image_read(TSK_IMG_INFO * img_info, TSK_OFF_T offset, char *buf,
 
     tsk_take_lock(&(vmdk_info->read_lock));
 
-    cnt = libvmdk_handle_read_buffer_at_offset(vmdk_info->handle,
-        buf, len, offset, &vmdk_error);
-    if (cnt < 0) {
-        char *errmsg = NULL;
-        tsk_error_reset();
-        tsk_error_set_errno(TSK_ERR_IMG_READ);
-        if (getError(vmdk_error, error_string))
-            errmsg = strerror(errno);
-        else
-            errmsg = error_string;
-
-        tsk_error_set_errstr("vmdk_image_read - offset: %" PRIuOFF
-            " - len: %" PRIuSIZE " - %s", offset, len, errmsg);
-        tsk_release_lock(&(vmdk_info->read_lock));
-        return -1;
+    if ((vmdk_info->workers != NULL) && (len >= VMDK_WORKER_MIN_READ)) {
+        // give each worker a couple of pieces to even out the load
+        size_t piece_len = roundup(len / (2 * vmdk_info->num_workers),
+            VMDK_WORKER_PIECE_UNIT);
+        cnt = tsk_img_workers_read(vmdk_info->workers, offset, buf, len,
+            piece_len);
+    }
+    else {
+        cnt = vmdk_read_handle(vmdk_info->handle, offset, buf, len);
     }
 
     tsk_release_lock(&(vmdk_info->read_lock));
@@ -97,6 +136,94 @@ vmdk_image_imgstat(TSK_IMG_INFO * img_info, FILE * hFile)
 }
 
 
+/**
+ * \internal
+ * Stop the decode workers of an image and close their handles.
+ */
+static void
+vmdk_stop_workers(IMG_VMDK_INFO * vmdk_info)
+{
+    int i;
+
+    tsk_img_workers_free(vmdk_info->workers);
+    vmdk_info->workers = NULL;
+
+    for (i = 0; i < vmdk_info->num_workers; i++) {
+        libvmdk_handle_close(vmdk_info->worker_handles[i], NULL);
+        libvmdk_handle_free(&(vmdk_info->worker_handles[i]), NULL);
+    }
+    free(vmdk_info->worker_handles);
+    vmdk_info->worker_handles = NULL;
+    vmdk_info->num_workers = 0;
+}
+
+
+/**
+ * \internal
+ * Open a handle for each decode worker and start the workers.  The
+ * image can be read without them, so errors are only reported when
+ * verbose.
+ *
+ * @param vmdk_info Image to start the workers for
+ * @param a_num_threads Number of workers to start
+ */
+static void
+vmdk_start_workers(IMG_VMDK_INFO * vmdk_info, unsigned int a_num_threads)
+{
+    libvmdk_error_t *vmdk_error = NULL;
+    unsigned int i;
+
+    if ((vmdk_info->worker_handles = (libvmdk_handle_t **)
+            tsk_malloc(a_num_threads * sizeof(libvmdk_handle_t *))) ==
+        NULL) {
+        tsk_error_reset();
+        return;
+    }
+
+    for (i = 0; i < a_num_threads; i++) {
+        libvmdk_handle_t *handle = NULL;
+
+        if (libvmdk_handle_initialize(&handle, &vmdk_error) != 1) {
+            libvmdk_error_free(&vmdk_error);
+            break;
+        }
+#if defined( TSK_WIN32 )
+        if ((libvmdk_handle_open_wide(handle,
+                    (const wchar_t *) vmdk_info->img_info.images[0],
+                    LIBVMDK_OPEN_READ, &vmdk_error) != 1)
+#else
+        if ((libvmdk_handle_open(handle,
+                    (const char *) vmdk_info->img_info.images[0],
+                    LIBVMDK_OPEN_READ, &vmdk_error) != 1)
+#endif
+            || (libvmdk_handle_open_extent_data_files(handle,
+                    &vmdk_error) != 1)) {
+            libvmdk_error_free(&vmdk_error);
+            libvmdk_handle_close(handle, NULL);
+            libvmdk_handle_free(&handle, NULL);
+            break;
+        }
+        vmdk_info->worker_handles[vmdk_info->num_workers++] = handle;
+    }
+
+    if ((vmdk_info->num_workers < (int) a_num_threads)
+        || ((vmdk_info->workers =
+                tsk_img_workers_create(&(vmdk_info->img_info),
+                    vmdk_info->num_workers, vmdk_worker_read)) == NULL)) {
+        if (tsk_verbose)
+            tsk_fprintf(stderr,
+                "vmdk_open: decode workers not started\n");
+        vmdk_stop_workers(vmdk_info);
+        tsk_error_reset();
+        return;
+    }
+
+    if (tsk_verbose)
+        tsk_fprintf(stderr, "vmdk_open: started %d decode workers\n",
+            vmdk_info->num_workers);
+}
+
+
 static void
     vmdk_image_close(TSK_IMG_INFO * img_info)
 {
@@ -106,6 +233,8 @@ static void
     char *errmsg = NULL;
     IMG_VMDK_INFO *vmdk_info = (IMG_VMDK_INFO *) img_info;
 
+    vmdk_stop_workers(vmdk_info);
+
     if( libvmdk_handle_close(vmdk_info->handle, &vmdk_error ) != 0 )
     {
         tsk_error_reset();
@@ -142,7 +271,8 @@ static void
 
 TSK_IMG_INFO *
 vmdk_open(int a_num_img,
-    const TSK_TCHAR * const a_images[], unsigned int a_ssize)
+    const TSK_TCHAR * const a_images[], unsigned int a_ssize,
+    const TSK_IMG_OPTIONS * a_opts)
 {
     char error_string[TSK_VMDK_ERROR_STRING_SIZE];
     libvmdk_error_t *vmdk_error = NULL;
@@ -274,6 +404,9 @@ vmdk_open(int a_num_img,
     // initialize the read lock
     tsk_init_lock(&(vmdk_info->read_lock));
 
+    if (a_opts->decode_threads > 0)
+        vmdk_start_workers(vmdk_info, a_opts->decode_threads);
+
     return (img_info);
 }
 
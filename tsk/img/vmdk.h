@@ -27,12 +27,22 @@ extern "C" {
 #endif
 
     extern TSK_IMG_INFO *vmdk_open(int, const TSK_TCHAR * const images[],
-        unsigned int a_ssize);
+        unsigned int a_ssize, const TSK_IMG_OPTIONS * a_opts);
+
+/* Large reads are split over the decode workers in multiples of this size,
+ * which is the usual grain size of compressed VMDK images */
+#define VMDK_WORKER_PIECE_UNIT 65536
+
+/* Fewest bytes in a read before it is split over the decode workers */
+#define VMDK_WORKER_MIN_READ (4 * VMDK_WORKER_PIECE_UNIT)
 
     typedef struct {
         TSK_IMG_INFO img_info;
         libvmdk_handle_t *handle;
         tsk_lock_t read_lock;   // Lock for reads since according to documentation libvmdk is not fully thread safe yet
+        TSK_IMG_WORKERS *workers;       // Threads that decompress large reads in parallel (NULL if not used)
+        libvmdk_handle_t **worker_handles;      // Handle of each worker
+        int num_workers;        // Number of entries in worker_handles
     } IMG_VMDK_INFO;
 
 #ifdef __cplusplus
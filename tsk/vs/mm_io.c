@@ -94,3 +94,33 @@ tsk_vs_part_read_block(const TSK_VS_PART_INFO * a_vs_part,
         vs->offset + (TSK_OFF_T) (a_vs_part->start +
             a_addr) * vs->block_size, a_buf, a_len);
 }
+
+/**
+ * \ingroup vslib
+ * Reads several ranges of data from a VOLUME in a volume system.  See
+ * tsk_img_readv() for how the ranges are read.
+ *
+ * @param a_vs_part info Pointer to open volume in a volume system
+ * @param a_vecs Ranges to read, with offsets relative to start of VOLUME in
+ * volume system (their cnt values are set)
+ * @param a_num_vecs Number of entries in a_vecs
+ * @returns Total number of bytes read or -1 on error
+ */
+ssize_t
+tsk_vs_part_readv(const TSK_VS_PART_INFO * a_vs_part,
+    TSK_IMG_IOVEC * a_vecs, size_t a_num_vecs)
+{
+    TSK_VS_INFO *vs = a_vs_part->vs;
+    TSK_OFF_T base =
+        vs->offset + (TSK_OFF_T) a_vs_part->start * vs->block_size;
+    ssize_t retval;
+    size_t i;
+
+    // move the ranges into the image and back again afterwards
+    for (i = 0; i < a_num_vecs; i++)
+        a_vecs[i].off += base;
+    retval = tsk_img_readv(vs->img_info, a_vecs, a_num_vecs);
+    for (i = 0; i < a_num_vecs; i++)
+        a_vecs[i].off -= base;
+    return retval;
+}
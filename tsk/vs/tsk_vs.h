@@ -145,6 +145,8 @@ extern "C" {
         a_vs_part, TSK_OFF_T a_off, char *buf, size_t len);
     extern ssize_t tsk_vs_part_read_block(const TSK_VS_PART_INFO *
         a_vs_part, TSK_DADDR_T a_addr, char *buf, size_t len);
+    extern ssize_t tsk_vs_part_readv(const TSK_VS_PART_INFO *
+        a_vs_part, TSK_IMG_IOVEC * vecs, size_t num_vecs);
 
 #ifdef __cplusplus
 }
@@ -218,6 +220,20 @@ class TskVsPartInfo {
             return 0;
     };
 
+    /**
+    * Reads several ranges of data from a VOLUME in a volume system.
+    * See tsk_vs_part_readv() for details.
+    * @param a_vecs Ranges to read, relative to start of VOLUME in volume system (their cnt values are set)
+    * @param a_num_vecs Number of entries in a_vecs
+    * @return Total number of bytes read or -1 on error 
+    */
+    ssize_t readv(TSK_IMG_IOVEC * a_vecs, size_t a_num_vecs) {
+        if (m_vsPartInfo != NULL)
+            return tsk_vs_part_readv(m_vsPartInfo, a_vecs, a_num_vecs);
+        else
+            return 0;
+    };
+
     /**
     * Reads one or more blocks of data with an address relative to the start of a VOLUME in a volume system.
     * See tsk_vs_part_read_block() for details.